@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Content codecs and media type negotiation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_CODEC_HPP_
+#define ARROWHEAD_CODEC_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "arrowhead/config.h"
+
+#include "arrowhead/result.hpp"
+#include "arrowhead/service.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  codec
+ *
+ * @{
+ */
+
+/**
+ * @brief Extract the media type from a `Content-Type` or `Accept` element
+ *
+ * @param[in]  content_type  header value, possibly with parameters
+ *
+ * @return the media type in lower case, without parameters and surrounding
+ *         white space
+ */
+std::string media_type_of(const std::string& content_type);
+
+/**
+ * @brief Encoder and decoder for one service content format
+ *
+ * A codec ties a media type (e.g. `application/json`) to the parsers and
+ * serializers of the corresponding format, so that transports can pick the
+ * format at run time from the `Content-Type` of a response.
+ *
+ * The concrete codecs are final, they can also be used as compile time
+ * codec policies of ServiceRegistryClient without any virtual calls.
+ */
+class Codec {
+    public:
+        virtual ~Codec() {}
+
+        /**
+         * @brief Media type handled by this codec, in lower case without parameters
+         */
+        virtual const char *media_type() const = 0;
+
+        /**
+         * @brief Decode a single service
+         *
+         * @param[in]  buf     encoded service
+         * @param[in]  buflen  length of @p buf
+         *
+         * @return the decoded service
+         *
+         * @throws ContentError if there are any parsing errors
+         */
+        virtual ServiceDescription decode_service(const char *buf, size_t buflen) const = 0;
+
+        /**
+         * @brief Decode a service list and append the services to @p out
+         *
+         * @param[out] out     destination for the decoded services
+         * @param[in]  buf     encoded service list
+         * @param[in]  buflen  length of @p buf
+         *
+         * @throws ContentError if there are any parsing errors
+         */
+        virtual void decode_servicelist(std::vector<ServiceDescription>& out,
+            const char *buf, size_t buflen) const = 0;
+
+        /**
+         * @brief Decode a service list without throwing on malformed content
+         *
+         * The default turns the ContentError of decode_servicelist() into a
+         * Status. Codecs which parse without exceptions override it, so that
+         * malformed content does not abort builds without exceptions.
+         *
+         * @param[out] out     destination for the decoded services
+         * @param[in]  buf     encoded service list
+         * @param[in]  buflen  length of @p buf
+         *
+         * @return Errc::CONTENT if there are any parsing errors
+         */
+        virtual Status try_decode_servicelist(std::vector<ServiceDescription>& out,
+            const char *buf, size_t buflen) const;
+
+        /**
+         * @brief Encode a single service
+         *
+         * @param[in]  sd  service to encode
+         *
+         * @return the encoded service
+         */
+        virtual std::string encode_service(const ServiceDescription& sd) const = 0;
+
+        /**
+         * @brief Encode a service list
+         *
+         * @param[in]  services  services to encode
+         *
+         * @return the encoded service list
+         */
+        virtual std::string encode_servicelist(
+            const std::vector<ServiceDescription>& services) const = 0;
+
+        /**
+         * @brief Encode the body of an unpublish request, naming the service
+         *
+         * The default encodes a service with only the name set, the JSON
+         * codecs send the `{"name": ...}` object service registries expect.
+         *
+         * @param[in]  name  name of the service
+         *
+         * @return the encoded request body
+         */
+        virtual std::string encode_service_name(const std::string& name) const;
+
+        /**
+         * @brief Decode a service list and pass the services to @p oit
+         *
+         * @param[in]  oit     Output iterator where the parsed objects will be placed
+         * @param[in]  buf     encoded service list
+         * @param[in]  buflen  length of @p buf
+         *
+         * @return Output iterator after outputting the objects
+         *
+         * @throws ContentError if there are any parsing errors
+         */
+        template<class OutputIt>
+            OutputIt parse_servicelist(OutputIt oit, const char *buf, size_t buflen) const
+        {
+            std::vector<ServiceDescription> services;
+            decode_servicelist(services, buf, buflen);
+            for (auto& sd: services) {
+                *oit++ = std::move(sd);
+            }
+            return oit;
+        }
+
+        /**
+         * @brief Decode a service list and pass the services to @p oit,
+         * without throwing on malformed content
+         *
+         * Nothing is passed to @p oit if the content is malformed.
+         *
+         * @param[in]  oit     Output iterator where the parsed objects will be placed
+         * @param[in]  buf     encoded service list
+         * @param[in]  buflen  length of @p buf
+         *
+         * @return Output iterator after outputting the objects, or
+         *         Errc::CONTENT if there are any parsing errors
+         */
+        template<class OutputIt>
+            Result<OutputIt> try_parse_servicelist(OutputIt oit, const char *buf,
+                size_t buflen) const
+        {
+            std::vector<ServiceDescription> services;
+            Status status = try_decode_servicelist(services, buf, buflen);
+            if (!status.ok()) {
+                return status;
+            }
+            for (auto& sd: services) {
+                *oit++ = std::move(sd);
+            }
+            return oit;
+        }
+};
+
+#if ARROWHEAD_USE_JSON
+/**
+ * @brief `application/json` codec, the `{"service": [...]}` format
+ */
+class JSONCodec final : public Codec {
+    public:
+        const char *media_type() const override;
+        ServiceDescription decode_service(const char *buf, size_t buflen) const override;
+        void decode_servicelist(std::vector<ServiceDescription>& out,
+            const char *buf, size_t buflen) const override;
+        std::string encode_service(const ServiceDescription& sd) const override;
+        std::string encode_servicelist(
+            const std::vector<ServiceDescription>& services) const override;
+        std::string encode_service_name(const std::string& name) const override;
+};
+
+/**
+ * @brief `application/x-ndjson` codec, one JSON service object per line
+ */
+class NDJSONCodec final : public Codec {
+    public:
+        const char *media_type() const override;
+        ServiceDescription decode_service(const char *buf, size_t buflen) const override;
+        void decode_servicelist(std::vector<ServiceDescription>& out,
+            const char *buf, size_t buflen) const override;
+        std::string encode_service(const ServiceDescription& sd) const override;
+        std::string encode_servicelist(
+            const std::vector<ServiceDescription>& services) const override;
+        std::string encode_service_name(const std::string& name) const override;
+};
+#endif /* ARROWHEAD_USE_JSON */
+
+#if ARROWHEAD_USE_PUGIXML
+/**
+ * @brief `application/xml` codec, the `<serviceList>` format
+ */
+class XMLCodec final : public Codec {
+    public:
+        const char *media_type() const override;
+        ServiceDescription decode_service(const char *buf, size_t buflen) const override;
+        void decode_servicelist(std::vector<ServiceDescription>& out,
+            const char *buf, size_t buflen) const override;
+        Status try_decode_servicelist(std::vector<ServiceDescription>& out,
+            const char *buf, size_t buflen) const override;
+        std::string encode_service(const ServiceDescription& sd) const override;
+        std::string encode_servicelist(
+            const std::vector<ServiceDescription>& services) const override;
+};
+#endif /* ARROWHEAD_USE_PUGIXML */
+
+#if ARROWHEAD_USE_CBOR
+/**
+ * @brief `application/cbor` codec, see parse_servicelist_cbor()
+ */
+class CBORCodec final : public Codec {
+    public:
+        const char *media_type() const override;
+        ServiceDescription decode_service(const char *buf, size_t buflen) const override;
+        void decode_servicelist(std::vector<ServiceDescription>& out,
+            const char *buf, size_t buflen) const override;
+        std::string encode_service(const ServiceDescription& sd) const override;
+        std::string encode_servicelist(
+            const std::vector<ServiceDescription>& services) const override;
+};
+#endif /* ARROWHEAD_USE_CBOR */
+
+/**
+ * @brief Set of codecs in order of preference
+ *
+ * The registry builds the `Accept` header sent with requests and selects the
+ * decoder for a response from its `Content-Type`. The first codec is the
+ * preferred one, it is also used for encoding request bodies.
+ */
+class CodecRegistry {
+    public:
+        /**
+         * @brief Construct an empty registry
+         */
+        CodecRegistry() {}
+
+        /**
+         * @brief Registry with all codecs compiled into the library
+         *
+         * The default order is JSON, CBOR, NDJSON, XML. JSON comes first
+         * because it is the format every service registry understands, use
+         * prefer() to put a more compact format first.
+         */
+        static CodecRegistry builtin();
+
+        /**
+         * @brief Add a codec with the lowest preference
+         *
+         * A codec already registered for the same media type is replaced and
+         * keeps its position.
+         *
+         * @param[in]  codec  codec to add
+         */
+        void add(std::shared_ptr<const Codec> codec);
+
+        /**
+         * @brief Move the codec for @p media_type first
+         *
+         * @param[in]  media_type  media type of a registered codec
+         *
+         * @throws Error if no codec is registered for @p media_type
+         */
+        void prefer(const std::string& media_type);
+
+        /**
+         * @brief Find the codec for a `Content-Type` header value
+         *
+         * Parameters such as `; charset=utf-8` are ignored and the media type
+         * is compared case-insensitively.
+         *
+         * @param[in]  content_type  header value
+         *
+         * @return the matching codec, or NULL if there is none
+         */
+        const Codec *find(const std::string& content_type) const;
+
+        /**
+         * @brief The most preferred codec
+         *
+         * @throws Error if the registry is empty
+         */
+        const Codec& preferred() const;
+
+        /**
+         * @brief `Accept` header value listing all codecs
+         *
+         * Each codec after the first gets a lower quality value than the one
+         * before it, e.g. `application/json, application/cbor;q=0.9`. The
+         * value is built when the codecs change, not on every request.
+         *
+         * @return the header value, without the `Accept: ` prefix
+         */
+        const std::string& accept_header() const
+        {
+            return accept;
+        }
+
+        /**
+         * @brief All codecs in order of preference
+         */
+        const std::vector<std::shared_ptr<const Codec> >& codecs() const
+        {
+            return list;
+        }
+
+    private:
+        void update_accept();
+
+        std::vector<std::shared_ptr<const Codec> > list;
+        /// Cached accept_header()
+        std::string accept;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_CODEC_HPP_ */
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Content coding of request and response bodies of the HTTP transports
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_COMPRESSION_HPP_
+#define ARROWHEAD_COMPRESSION_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "arrowhead/config.h"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  http
+ *
+ * @{
+ */
+
+/**
+ * @brief Compression settings of a transport
+ *
+ * Compressed responses are decoded by libcurl as they arrive, so the body
+ * handed to the codec is always the plain content. Request bodies are
+ * compressed with gzip, which needs ARROWHEAD_USE_ZLIB and a server which
+ * accepts `Content-Encoding: gzip`, so it is off by default.
+ */
+struct CompressionOptions {
+    CompressionOptions() : accept_compressed(true), compress_requests(false),
+        min_request_size(1024), level(6) {}
+
+    /// Send `Accept-Encoding` and decode compressed responses
+    bool accept_compressed;
+    /**
+     * Encodings offered in `Accept-Encoding`, comma separated, empty for
+     * all which libcurl can decode, see supported_encodings()
+     */
+    std::string encodings;
+    /// Compress `POST` bodies with gzip
+    bool compress_requests;
+    /// Smaller bodies are sent as they are
+    size_t min_request_size;
+    /// zlib compression level, 1 (fastest) to 9 (smallest)
+    int level;
+};
+
+/**
+ * @brief Process wide counters of the bodies sent and received by the transports
+ */
+struct CompressionStats {
+    /// Responses received
+    uint64_t responses;
+    /// Of those, responses with a compressed body
+    uint64_t compressed_responses;
+    /// Response body bytes as transferred
+    uint64_t response_wire_bytes;
+    /// Response body bytes after decoding
+    uint64_t response_bytes;
+    /// Request bodies sent compressed
+    uint64_t compressed_requests;
+    /// Size of those bodies before compression
+    uint64_t request_bytes;
+    /// Size of those bodies after compression
+    uint64_t request_wire_bytes;
+    /// Sum of the times from the start of each request to its complete response
+    std::chrono::microseconds total_time;
+
+    /**
+     * @brief Decoded response bytes per transferred byte, 1 if nothing was received
+     */
+    double response_ratio() const
+    {
+        return response_wire_bytes == 0 ? 1.0 :
+            static_cast<double>(response_bytes) / response_wire_bytes;
+    }
+
+    /**
+     * @brief Request bytes per transferred byte of the compressed bodies
+     */
+    double request_ratio() const
+    {
+        return request_wire_bytes == 0 ? 1.0 :
+            static_cast<double>(request_bytes) / request_wire_bytes;
+    }
+
+    /**
+     * @brief Mean end-to-end latency of the responses, zero if there were none
+     */
+    std::chrono::microseconds mean_latency() const
+    {
+        return responses == 0 ? std::chrono::microseconds(0) :
+            std::chrono::microseconds(total_time.count() / static_cast<int64_t>(responses));
+    }
+};
+
+#if ARROWHEAD_USE_LIBCURL
+/**
+ * @brief Counters of the bodies transferred so far
+ */
+CompressionStats compression_stats();
+
+/**
+ * @brief Response encodings the linked libcurl can decode, e.g. `gzip, deflate, zstd`
+ */
+std::string supported_encodings();
+#endif
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_COMPRESSION_HPP_ */
@@ -0,0 +1,517 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service Registry client with compile time transport and codec policies
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_CORE_SERVICES_REGISTRYCLIENT_HPP_
+#define ARROWHEAD_CORE_SERVICES_REGISTRYCLIENT_HPP_
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arrowhead/config.h"
+
+#include "arrowhead/codec.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/metrics.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/retry.hpp"
+#include "arrowhead/service.hpp"
+#include "arrowhead/transport.hpp"
+
+namespace Arrowhead {
+
+namespace HTTP {
+
+/**
+ * @ingroup http_detail
+ * @{
+ */
+
+/**
+ * @internal
+ * @brief Default codec policy object, a default constructed @p Codec
+ */
+template<class Codec>
+    Codec default_codec()
+{
+    return Codec();
+}
+
+/**
+ * @internal
+ * @brief Default codec policy object, all built in codecs for a CodecRegistry
+ */
+template<>
+    inline CodecRegistry default_codec<CodecRegistry>()
+{
+    return CodecRegistry::builtin();
+}
+
+/**
+ * @internal
+ * @brief `Accept` header value of a fixed codec policy
+ */
+template<class Codec>
+    const char *accept_header(const Codec& codec)
+{
+    return codec.media_type();
+}
+
+/**
+ * @internal
+ * @brief `Accept` header value of a negotiating codec policy
+ */
+inline const std::string& accept_header(const CodecRegistry& codecs)
+{
+    return codecs.accept_header();
+}
+
+/**
+ * @internal
+ * @brief Codec used to encode request bodies with a fixed codec policy
+ */
+template<class Codec>
+    const Codec& request_codec(const Codec& codec)
+{
+    return codec;
+}
+
+/**
+ * @internal
+ * @brief Codec used to encode request bodies with a negotiating codec policy
+ */
+inline const Arrowhead::Codec& request_codec(const CodecRegistry& codecs)
+{
+    return codecs.preferred();
+}
+
+/**
+ * @internal
+ * @brief Codec used to decode a response with a fixed codec policy
+ *
+ * @return NULL if @p content_type is not empty and names another format
+ */
+template<class Codec>
+    const Codec *response_codec(const Codec& codec, const std::string& content_type)
+{
+    if (!content_type.empty() && media_type_of(content_type) != codec.media_type()) {
+        return NULL;
+    }
+    return &codec;
+}
+
+/**
+ * @internal
+ * @brief Codec used to decode a response with a negotiating codec policy
+ *
+ * @return NULL if no codec is registered for @p content_type
+ */
+inline const Arrowhead::Codec *response_codec(const CodecRegistry& codecs,
+    const std::string& content_type)
+{
+    if (content_type.empty()) {
+        return &codecs.preferred();
+    }
+    return codecs.find(content_type);
+}
+
+/**
+ * @internal
+ * @brief Request object of the calling thread, filled in from a request template
+ *
+ * The object is reused by every call the thread makes, so once its strings
+ * have grown to the size of the requests, filling it in allocates nothing.
+ * A nested call, e.g. from a loopback handler using a client itself, gets
+ * an object of its own instead.
+ */
+class ScratchRequest {
+    public:
+        /**
+         * @brief Take the request object of the thread and copy @p tmpl into it
+         */
+        explicit ScratchRequest(const HTTPRequest& tmpl) : busy(&in_use())
+        {
+            if (*busy) {
+                ARROWHEAD_LIB_COUNTER(allocation_count, "arrowhead_allocations_total",
+                    "object=\"request\"", "Objects allocated on the request path");
+                ARROWHEAD_LIB_ADD(allocation_count, 1);
+                own.reset(new HTTPRequest(tmpl));
+                req = own.get();
+                busy = NULL;
+            }
+            else {
+                *busy = true;
+                req = &thread_request();
+                *req = tmpl;
+            }
+        }
+
+        ~ScratchRequest()
+        {
+            if (busy != NULL) {
+                /* Do not keep a large published body around */
+                if (req->body.capacity() > MAX_KEPT_BODY) {
+                    std::string().swap(req->body);
+                }
+                *busy = false;
+            }
+        }
+
+        ScratchRequest(const ScratchRequest&) = delete;
+        ScratchRequest& operator=(const ScratchRequest&) = delete;
+
+        HTTPRequest& operator*()
+        {
+            return *req;
+        }
+
+        HTTPRequest *operator->()
+        {
+            return req;
+        }
+
+    private:
+        static const size_t MAX_KEPT_BODY = 64 * 1024;
+
+        static HTTPRequest& thread_request()
+        {
+            static thread_local HTTPRequest request;
+            return request;
+        }
+
+        static bool& in_use()
+        {
+            static thread_local bool used = false;
+            return used;
+        }
+
+        std::unique_ptr<HTTPRequest> own;
+        HTTPRequest *req;
+        bool *busy;
+};
+
+/** @} */
+
+} /* namespace HTTP */
+
+/**
+ * @ingroup core_services
+ * @{
+ */
+
+/**
+ * @brief Service Registry REST API client
+ *
+ * The transport and the content format are template policies, so the
+ * request path of a client with a fixed format, e.g.
+ * `ServiceRegistryClient<CURLEasyTransport, CBORCodec>`, contains neither
+ * virtual calls nor code for other formats.
+ *
+ * Every operation comes in two variants: the plain one throws
+ * TransportError or ContentError on failure, the `try_` one returns a
+ * Result or Status instead. Use the latter where failures are routine,
+ * e.g. when polling a registry that may be down, and in builds without
+ * exceptions.
+ *
+ * Every operation takes an optional Deadline, which is combined with the
+ * timeout set by set_timeout() and covers all attempts made under the
+ * RetryPolicy set by set_retry_policy(). By default there is no deadline and
+ * no retry.
+ *
+ * With the libcurl transports, the latency of every request is broken down
+ * by latency_stats() under the operations `types`, `list` (list() and
+ * list_services()), `publish` and `unpublish`.
+ *
+ * @tparam Transport  transport policy, see CURLEasyTransport and LoopbackTransport
+ * @tparam Codec      codec policy, either one of the final codec classes
+ *                    (JSONCodec, CBORCodec, ...) for a fixed format, or
+ *                    CodecRegistry to negotiate the format at run time
+ */
+template<class Transport, class Codec>
+class ServiceRegistryClient {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param[in] url_base   Base URL for the service registry REST API
+         * @param[in] codec      codec policy object, a CodecRegistry
+         *                       defaults to CodecRegistry::builtin()
+         * @param[in] transport  transport policy object
+         */
+        ServiceRegistryClient(const std::string& url_base,
+            const Codec& codec = HTTP::default_codec<Codec>(),
+            const Transport& transport = Transport())
+            : url_base(url_base), codec_policy(codec), transport_policy(transport),
+            call_timeout(0), connect_timeout(0),
+            types_template(make_template("GET", "/type", "types")),
+            list_template(make_template("GET", "/service", "list")),
+            publish_template(make_template("POST", "/publish", "publish")),
+            unpublish_template(make_template("POST", "/unpublish", "unpublish"))
+        {}
+
+        /**
+         * @brief List all available service types
+         *
+         * @return HTTP response content (JSON string)
+         */
+        std::string types(const Deadline& deadline = Deadline()) const
+        {
+            return try_types(deadline).value();
+        }
+
+        /**
+         * @brief List all available service types, without throwing
+         */
+        Result<std::string> try_types(const Deadline& deadline = Deadline()) const;
+
+        /**
+         * @brief List all services of the given type, or all services if type is empty
+         *
+         * @param[in] type      Service type, use "" to list all services of any type
+         * @param[in] deadline  Deadline for the call, including retries
+         *
+         * @return HTTP response content (JSON string)
+         */
+        std::string list(const std::string& type = std::string(),
+            const Deadline& deadline = Deadline()) const
+        {
+            return try_list(type, deadline).value();
+        }
+
+        /**
+         * @brief List all services of the given type, without throwing
+         */
+        Result<std::string> try_list(const std::string& type = std::string(),
+            const Deadline& deadline = Deadline()) const;
+
+        /**
+         * @brief List and parse all services of the given type, or all services if type is empty
+         *
+         * The media types of the codec policy are offered in the `Accept`
+         * header. A response with a `Content-Type` the codec policy does not
+         * handle is rejected, a response without `Content-Type` is parsed
+         * with the preferred codec.
+         *
+         * @param[in] type      Service type, use "" to list all services of any type
+         * @param[in] deadline  Deadline for the call, including retries
+         *
+         * @return the services in the registry
+         *
+         * @throws ContentError if the response format is not supported or
+         *         can not be parsed
+         */
+        std::vector<ServiceDescription> list_services(const std::string& type = std::string(),
+            const Deadline& deadline = Deadline()) const
+        {
+            return try_list_services(type, deadline).value();
+        }
+
+        /**
+         * @brief List and parse services, without throwing
+         *
+         * @see list_services(const std::string&)
+         *
+         * @return the services, or Errc::UNSUPPORTED_MEDIA_TYPE or
+         *         Errc::CONTENT if the response can not be parsed, in
+         *         addition to the errors of the request itself
+         */
+        Result<std::vector<ServiceDescription>> try_list_services(
+            const std::string& type = std::string(), const Deadline& deadline = Deadline()) const;
+
+        /**
+         * @brief List and parse services, passing them to @p oit
+         *
+         * @see list_services(const std::string&)
+         *
+         * @param[in] oit       Output iterator where the parsed objects will be placed
+         * @param[in] type      Service type, use "" to list all services of any type
+         * @param[in] deadline  Deadline for the call, including retries
+         *
+         * @return Output iterator after outputting the objects
+         */
+        template<class OutputIt>
+            OutputIt list_services(OutputIt oit, const std::string& type,
+                const Deadline& deadline = Deadline()) const
+        {
+            return try_list_services(oit, type, deadline).value();
+        }
+
+        /**
+         * @brief List and parse services, passing them to @p oit, without throwing
+         *
+         * Services parsed before a content error are already passed to @p oit.
+         */
+        template<class OutputIt>
+            Result<OutputIt> try_list_services(OutputIt oit, const std::string& type,
+                const Deadline& deadline = Deadline()) const;
+
+        /**
+         * @brief Publish the given service in the service registry
+         *
+         * The request body is encoded with the preferred codec.
+         *
+         * @param[in] service   Service description to publish
+         * @param[in] deadline  Deadline for the call, including retries
+         *
+         * @return HTTP response content
+         */
+        std::string publish(const ServiceDescription& service,
+            const Deadline& deadline = Deadline()) const
+        {
+            return try_publish(service, deadline).value();
+        }
+
+        /**
+         * @brief Publish the given service, without throwing
+         */
+        Result<std::string> try_publish(const ServiceDescription& service,
+            const Deadline& deadline = Deadline()) const;
+
+        /**
+         * @brief Unpublish a service from the service registry
+         *
+         * The request body is a service description with only the name set,
+         * encoded with the preferred codec.
+         *
+         * @param[in] name      Name of the service to unpublish, as seen in list()
+         * @param[in] deadline  Deadline for the call, including retries
+         *
+         * @return HTTP response content
+         */
+        std::string unpublish(const std::string& name,
+            const Deadline& deadline = Deadline()) const
+        {
+            return try_unpublish(name, deadline).value();
+        }
+
+        /**
+         * @brief Unpublish a service, without throwing
+         */
+        Result<std::string> try_unpublish(const std::string& name,
+            const Deadline& deadline = Deadline()) const;
+
+        /**
+         * @brief Give every call at most @p timeout, zero for no limit
+         *
+         * An earlier deadline passed to the call itself takes precedence.
+         */
+        void set_timeout(std::chrono::milliseconds timeout)
+        {
+            call_timeout = timeout;
+        }
+
+        /**
+         * @brief Limit the time for establishing a connection, zero for the
+         * transport default
+         */
+        void set_connect_timeout(std::chrono::milliseconds timeout)
+        {
+            connect_timeout = timeout;
+        }
+
+        /**
+         * @brief Retry failed requests according to @p policy
+         */
+        void set_retry_policy(const RetryPolicy& policy)
+        {
+            retry_policy = policy;
+        }
+
+        /**
+         * @brief The codec policy object
+         *
+         * For a CodecRegistry, use e.g. `codec().prefer("application/cbor")`
+         * to ask the registry for a more compact format.
+         */
+        Codec& codec()
+        {
+            return codec_policy;
+        }
+
+        /**
+         * @brief The transport policy object
+         */
+        Transport& transport()
+        {
+            return transport_policy;
+        }
+
+    private:
+        /**
+         * @internal
+         * @brief Perform @p req, retrying under the retry policy, and
+         * check that the response is a success
+         *
+         * @param[out]    resp      the response of the last attempt
+         * @param[in,out] req       request filled in from a template, the
+         *                          deadline and connect timeout are set here
+         * @param[in]     deadline  deadline of the call
+         *
+         * @return Errc::TRANSPORT if the transport fails, Errc::TIMEOUT if
+         *         the deadline passes, Errc::HTTP_STATUS if the HTTP status
+         *         of the last attempt is not 2xx
+         */
+        Status request(HTTPResponse& resp, HTTPRequest& req, const Deadline& deadline) const;
+
+        /**
+         * @internal
+         * @brief Template of the requests for the resource @p path
+         *
+         * The `Accept` header is `application/json`, the format of the raw
+         * responses returned by types() and list(). The requests are
+         * counted in latency_stats() under @p operation.
+         */
+        HTTPRequest make_template(const char *method, const char *path,
+            const char *operation) const;
+
+        /**
+         * @internal
+         * @brief Point @p req at the service list resource for @p type
+         */
+        void set_list_path(HTTPRequest& req, const std::string& type) const;
+
+        std::string url_base;
+        Codec codec_policy;
+        Transport transport_policy;
+        RetryPolicy retry_policy;
+        std::chrono::milliseconds call_timeout;
+        std::chrono::milliseconds connect_timeout;
+        /**
+         * Requests of the operations, built once, only the parts which
+         * depend on the codec and the arguments are filled in per call
+         */
+        HTTPRequest types_template;
+        HTTPRequest list_template;
+        HTTPRequest publish_template;
+        HTTPRequest unpublish_template;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#include "arrowhead/detail/_registryclient.hpp"
+
+#endif /* ARROWHEAD_CORE_SERVICES_REGISTRYCLIENT_HPP_ */
@@ -25,11 +25,12 @@
 #ifndef ARROWHEAD_CORE_SERVICES_SERVICEREGISTRY_HPP_
 #define ARROWHEAD_CORE_SERVICES_SERVICEREGISTRY_HPP_
 
-#include <string>
-
 #include "arrowhead/config.h"
 
-#include "arrowhead/service.hpp"
+#include "arrowhead/codec.hpp"
+#include "arrowhead/guard.hpp"
+#include "arrowhead/transport.hpp"
+#include "arrowhead/core_services/registryclient.hpp"
 
 namespace Arrowhead {
 
@@ -40,55 +41,52 @@ namespace Arrowhead {
 
 /**
  * @brief Service Registry HTTP REST API interface
+ *
+ * Uses libcurl and negotiates the content format at run time, see
+ * ServiceRegistryClient::codec() for choosing the preferred format. For an
+ * `https://` registry with its own CA or mutual TLS, pass
+ * `CURLEasyTransport(tls_options)` to the constructor. Responses are
+ * requested compressed, see CompressionOptions for compressing published
+ * service lists as well.
  */
-class ServiceRegistryHTTP {
-    private:
-        std::string url_base;
+typedef ServiceRegistryClient<CURLEasyTransport, CodecRegistry> ServiceRegistryHTTP;
 
-    public:
-        /**
-         * @brief Constructor
-         *
-         * @param[in] url_base Base URL for the service registry REST API
-         */
-        ServiceRegistryHTTP(const std::string& url_base)
-            : url_base(url_base)
-        {}
+/**
+ * @brief Service Registry HTTP REST API interface for replicated registries
+ *
+ * Pass the replica URLs to the transport, the URL base is not used, e.g.
+ * `ReplicatedServiceRegistryHTTP("", CodecRegistry::builtin(),
+ * CURLHedgedTransport({"http://a:8045/servicediscovery", ...}))`.
+ */
+typedef ServiceRegistryClient<CURLHedgedTransport, CodecRegistry> ReplicatedServiceRegistryHTTP;
 
-        /**
-         * @brief List all available service types
-         *
-         * @return HTTP response content (JSON string)
-         */
-        std::string types(void) const;
+/**
+ * @brief Service Registry HTTP REST API interface for many concurrent callers
+ *
+ * Concurrent operations from all threads using copies of one client share
+ * an HTTP/2 connection, see CURLMultiplexTransport.
+ */
+typedef ServiceRegistryClient<CURLMultiplexTransport, CodecRegistry>
+    MultiplexedServiceRegistryHTTP;
 
-        /**
-         * @brief List all services of the given type, or all services if type is empty
-         *
-         * @param[in] type   Service type, use "" to list all services of any type
-         *
-         * @return HTTP response content (JSON string)
-         */
-        std::string list(const std::string& type = std::string()) const;
+/**
+ * @brief Service Registry HTTP REST API interface which backs off when the
+ * registry is overloaded
+ *
+ * See GuardedTransport, use `transport().inner()` to reach the libcurl
+ * transport.
+ */
+typedef ServiceRegistryClient<GuardedTransport<CURLEasyTransport>, CodecRegistry>
+    GuardedServiceRegistryHTTP;
 
-        /**
-         * @brief Publish the given service in the service registry
-         *
-         * @param[in] service   Service description to publish
-         *
-         * @return HTTP response content
-         */
-        std::string publish(const ServiceDescription& service) const;
+#if ARROWHEAD_USE_LIBCURL
+/* Instantiated once in the library */
+extern template class ServiceRegistryClient<CURLEasyTransport, CodecRegistry>;
+extern template class ServiceRegistryClient<CURLHedgedTransport, CodecRegistry>;
+extern template class ServiceRegistryClient<CURLMultiplexTransport, CodecRegistry>;
+#endif
 
-        /**
-         * @brief Publish the given service in the service registry
-         *
-         * @param[in] name   Name of the service to unpublish, as seen in list()
-         *
-         * @return HTTP response content
-         */
-        std::string unpublish(const std::string& name) const;
-};
+/** @} */
 
 } /* namespace Arrowhead */
 #endif /* ARROWHEAD_CORE_SERVICES_SERVICEREGISTRY_HPP_ */
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       The bundled nlohmann::json, included without its warnings
+ *
+ * The bundled version derives its iterators from std::iterator, which is
+ * deprecated since C++17, and optimizing GCC builds falsely warn about an
+ * uninitialized value in its swap(). Include it through this header instead
+ * of directly, so only our own code is checked for these.
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_DETAIL_NLOHMANN_JSON_HPP_
+#define ARROWHEAD_DETAIL_NLOHMANN_JSON_HPP_
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "nlohmann/json.hpp"
+
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif /* ARROWHEAD_DETAIL_NLOHMANN_JSON_HPP_ */
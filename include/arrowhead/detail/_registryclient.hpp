@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service Registry client template definitions
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_DETAIL_REGISTRYCLIENT_HPP_
+#define ARROWHEAD_DETAIL_REGISTRYCLIENT_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "arrowhead/exception.hpp"
+#include "arrowhead/logging.hpp"
+#include "arrowhead/metrics.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/tracing.hpp"
+
+namespace Arrowhead {
+
+template<class Transport, class Codec>
+    Status ServiceRegistryClient<Transport, Codec>::request(HTTPResponse& resp,
+        HTTPRequest& req, const Deadline& deadline) const
+{
+    ARROWHEAD_LIB_LOGGER(logger, "ServiceRegistryClient::request");
+    req.deadline = deadline;
+    if (call_timeout.count() > 0) {
+        req.deadline = std::min(deadline, Deadline::after(call_timeout));
+    }
+    req.connect_timeout = connect_timeout;
+    bool idempotent = (req.method == "GET");
+
+    if (!req.body.empty()) {
+        ARROWHEAD_LIB_DEBUG(logger, req.method << " " << req.url << ": " << req.body);
+    }
+
+    for (unsigned int attempt = 1; ; ++attempt) {
+        Status status;
+        {
+            ARROWHEAD_LIB_SPAN(attempt_span, "registry.attempt");
+            ARROWHEAD_LIB_SPAN_ARG(attempt_span, "attempt", attempt);
+            status = transport_policy.perform(req, resp);
+            ARROWHEAD_LIB_SPAN_ARG(attempt_span, "status", status.ok() ? resp.status : 0);
+        }
+        if (status.ok()) {
+            if ((resp.status >= 200) && (resp.status < 299)) {
+                return status;
+            }
+            ARROWHEAD_LIB_ERROR(logger, "HTTPError " << resp.status);
+            ARROWHEAD_LIB_DEBUG(logger, std::string("Remote said: ") + resp.body);
+            status = Status(Errc::HTTP_STATUS, resp.status, "ServiceRegistryClient");
+        }
+        else {
+            ARROWHEAD_LIB_ERROR(logger, status.message());
+        }
+        if (!retry_policy.should_retry(attempt, status, idempotent)) {
+            /* Fail */
+            return status;
+        }
+        /* Give up early if the next attempt could not start before the deadline */
+        std::chrono::milliseconds pause = retry_policy.backoff(attempt);
+        if (pause >= req.deadline.remaining()) {
+            return status;
+        }
+        ARROWHEAD_LIB_COUNTER(retry_count, "arrowhead_registry_retries_total", "",
+            "Registry requests repeated under the retry policy");
+        ARROWHEAD_LIB_ADD(retry_count, 1);
+        ARROWHEAD_LIB_DEBUG(logger, "Retrying in " << pause.count() << " ms");
+        std::this_thread::sleep_for(pause);
+    }
+}
+
+template<class Transport, class Codec>
+    HTTPRequest ServiceRegistryClient<Transport, Codec>::make_template(const char *method,
+        const char *path, const char *operation) const
+{
+    HTTPRequest req;
+    req.method = method;
+    req.path = path;
+    req.operation = operation;
+    req.url = url_base + req.path;
+    req.accept = "application/json";
+    return req;
+}
+
+template<class Transport, class Codec>
+    void ServiceRegistryClient<Transport, Codec>::set_list_path(HTTPRequest& req,
+        const std::string& type) const
+{
+    if (!type.empty()) {
+        /* List only specific type of service, assign() keeps the capacity */
+        req.path.assign("/type/").append(type);
+        req.url.assign(url_base).append(req.path);
+    }
+    /* The template lists all services */
+}
+
+template<class Transport, class Codec>
+    Result<std::string> ServiceRegistryClient<Transport, Codec>::try_types(
+        const Deadline& deadline) const
+{
+    ARROWHEAD_LIB_LOGGER(logger, "ServiceRegistryClient::types");
+    ARROWHEAD_LIB_TRACE(logger, "+ServiceRegistryClient::types");
+    ARROWHEAD_LIB_SPAN(span, "registry.types");
+    HTTP::ScratchRequest req(types_template);
+    HTTPResponse resp;
+    Status status = request(resp, *req, deadline);
+    if (!status.ok()) {
+        return status;
+    }
+    return std::move(resp.body);
+}
+
+template<class Transport, class Codec>
+    Result<std::string> ServiceRegistryClient<Transport, Codec>::try_list(
+        const std::string& type, const Deadline& deadline) const
+{
+    ARROWHEAD_LIB_LOGGER(logger, "ServiceRegistryClient::list");
+    ARROWHEAD_LIB_TRACE(logger, "+ServiceRegistryClient::list");
+    ARROWHEAD_LIB_SPAN(span, "registry.list");
+    HTTP::ScratchRequest req(list_template);
+    set_list_path(*req, type);
+    HTTPResponse resp;
+    Status status = request(resp, *req, deadline);
+    if (!status.ok()) {
+        return status;
+    }
+    return std::move(resp.body);
+}
+
+template<class Transport, class Codec>
+    Result<std::vector<ServiceDescription>> ServiceRegistryClient<Transport, Codec>::try_list_services(
+        const std::string& type, const Deadline& deadline) const
+{
+    std::vector<ServiceDescription> services;
+    auto res = try_list_services(std::back_inserter(services), type, deadline);
+    if (!res) {
+        return res.error();
+    }
+    return services;
+}
+
+template<class Transport, class Codec>
+template<class OutputIt>
+    Result<OutputIt> ServiceRegistryClient<Transport, Codec>::try_list_services(OutputIt oit,
+        const std::string& type, const Deadline& deadline) const
+{
+    ARROWHEAD_LIB_LOGGER(logger, "ServiceRegistryClient::list_services");
+    ARROWHEAD_LIB_TRACE(logger, "+ServiceRegistryClient::list_services");
+    ARROWHEAD_LIB_SPAN(span, "registry.list_services");
+    HTTP::ScratchRequest req(list_template);
+    set_list_path(*req, type);
+    req->accept = HTTP::accept_header(codec_policy);
+    HTTPResponse resp;
+    Status status = request(resp, *req, deadline);
+    if (!status.ok()) {
+        return status;
+    }
+
+    /* Pick the parser from the response Content-Type */
+    const auto *codec = HTTP::response_codec(codec_policy, resp.content_type);
+    if (codec == NULL) {
+        ARROWHEAD_LIB_ERROR(logger, "Unsupported Content-Type " << resp.content_type);
+        return Status(Errc::UNSUPPORTED_MEDIA_TYPE, "ServiceRegistryClient",
+            std::move(resp.content_type));
+    }
+    ARROWHEAD_LIB_DEBUG(logger, "Parsing " << resp.body.size() << " bytes of " <<
+        codec->media_type());
+    /* Malformed content must not abort builds without exceptions */
+    auto parsed = codec->try_parse_servicelist(oit, resp.body.data(), resp.body.size());
+    if (!parsed) {
+        ARROWHEAD_LIB_ERROR(logger, parsed.error().message());
+        return parsed.error();
+    }
+    oit = *parsed;
+    ARROWHEAD_LIB_TRACE(logger, "-ServiceRegistryClient::list_services");
+    return oit;
+}
+
+template<class Transport, class Codec>
+    Result<std::string> ServiceRegistryClient<Transport, Codec>::try_publish(
+        const ServiceDescription& service, const Deadline& deadline) const
+{
+    ARROWHEAD_LIB_LOGGER(logger, "ServiceRegistryClient::publish");
+    ARROWHEAD_LIB_TRACE(logger, "+ServiceRegistryClient::publish");
+    ARROWHEAD_LIB_SPAN(span, "registry.publish");
+    const auto& codec = HTTP::request_codec(codec_policy);
+    HTTP::ScratchRequest req(publish_template);
+    req->content_type = codec.media_type();
+    req->body = codec.encode_service(service);
+    HTTPResponse resp;
+    Status status = request(resp, *req, deadline);
+    if (!status.ok()) {
+        return status;
+    }
+    return std::move(resp.body);
+}
+
+template<class Transport, class Codec>
+    Result<std::string> ServiceRegistryClient<Transport, Codec>::try_unpublish(
+        const std::string& name, const Deadline& deadline) const
+{
+    ARROWHEAD_LIB_LOGGER(logger, "ServiceRegistryClient::unpublish");
+    ARROWHEAD_LIB_TRACE(logger, "+ServiceRegistryClient::unpublish");
+    ARROWHEAD_LIB_SPAN(span, "registry.unpublish");
+    /* Only the name is needed to unpublish something */
+    const auto& codec = HTTP::request_codec(codec_policy);
+    HTTP::ScratchRequest req(unpublish_template);
+    req->content_type = codec.media_type();
+    req->body = codec.encode_service_name(name);
+    HTTPResponse resp;
+    Status status = request(resp, *req, deadline);
+    if (!status.ok()) {
+        return status;
+    }
+    return std::move(resp.body);
+}
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_DETAIL_REGISTRYCLIENT_HPP_ */
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       CBOR processing template definitions
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_DETAIL_SERVICE_CBOR_HPP_
+#define ARROWHEAD_DETAIL_SERVICE_CBOR_HPP_
+
+#include <cstddef> // for size_t
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <utility>
+
+#include "arrowhead/config.h"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/mappedfile.hpp"
+#include "arrowhead/service.hpp"
+
+namespace Arrowhead {
+
+namespace CBOR {
+
+/**
+ * @ingroup cbor
+ * @{
+ */
+
+#if ARROWHEAD_USE_CBOR
+
+/**
+ * @brief Encode a single service as a CBOR map
+ *
+ * Never allocates. Like snprintf, the encoder always returns the full encoded
+ * size, but only writes as much as fits in @p buf. Call with @p buflen 0 to
+ * measure the size first.
+ *
+ * @param[in]   sd      service to encode
+ * @param[out]  buf     destination buffer, may be NULL if @p buflen is 0
+ * @param[in]   buflen  size of @p buf
+ *
+ * @return number of bytes in the encoding, the output is complete if this is
+ *         less than or equal to @p buflen
+ */
+size_t encode_service(const ServiceDescription& sd, char *buf, size_t buflen);
+
+/**
+ * @brief Encode the head of a service list, `{"service": [` with @p count elements
+ *
+ * The list encoding is this head followed by @p count encode_service() outputs.
+ *
+ * @param[in]   count   number of services in the list
+ * @param[out]  buf     destination buffer, may be NULL if @p buflen is 0
+ * @param[in]   buflen  size of @p buf
+ *
+ * @return number of bytes in the encoding, see encode_service()
+ */
+size_t encode_servicelist_head(size_t count, char *buf, size_t buflen);
+
+/**
+ * @brief Encode the services in [first, last) as a CBOR service list
+ *
+ * Never allocates, see encode_service() for the buffer semantics.
+ *
+ * @param[in]   first   first service
+ * @param[in]   last    one past the last service
+ * @param[out]  buf     destination buffer, may be NULL if @p buflen is 0
+ * @param[in]   buflen  size of @p buf
+ *
+ * @return number of bytes in the encoding
+ */
+template<class ForwardIt>
+    size_t encode_servicelist(ForwardIt first, ForwardIt last, char *buf, size_t buflen);
+
+/**
+ * @brief Incremental decoder for CBOR service lists
+ *
+ * Input may be fed in arbitrary pieces, e.g. CoAP blocks as they arrive.
+ * Every service is emitted as soon as all of its bytes have been received.
+ * The rest of the service list map is checked after the service array, and
+ * input after the end of the map is rejected.
+ */
+class StreamDecoder {
+    public:
+        StreamDecoder();
+
+        /**
+         * @brief Feed more input and output all services completed by it
+         *
+         * @param[in]  oit     Output iterator where the parsed objects will be placed
+         * @param[in]  data    next piece of input
+         * @param[in]  len     length of @p data
+         *
+         * @return Output iterator after outputting the objects
+         *
+         * @throws ContentError if the input is not a valid CBOR service list
+         */
+        template<class OutputIt>
+            OutputIt feed(OutputIt oit, const char *data, size_t len);
+
+        /**
+         * @brief Check whether the complete service list has been decoded
+         */
+        bool finished() const
+        {
+            return state == STATE_DONE;
+        }
+
+    private:
+        /**
+         * @internal
+         * @brief Decode the next service from the input
+         *
+         * @param[in]     data  input buffer
+         * @param[in]     len   length of @p data
+         * @param[in,out] pos   position in @p data, advanced past consumed input
+         * @param[out]    sd    destination for the decoded service
+         *
+         * @return true if a service was decoded, false if more input is needed
+         */
+        bool next(const char *data, size_t len, size_t& pos, ServiceDescription& sd);
+
+        /**
+         * @internal
+         * @brief Decoder position in the service list structure
+         */
+        enum State {
+            STATE_LIST_HEAD,
+            STATE_LIST_KEY,
+            STATE_ITEMS,
+            STATE_LIST_REST,
+            STATE_DONE,
+        };
+
+        /// Incomplete input left over from the previous feed() call
+        std::string buffer;
+        State state;
+        /// Remaining entries of the top level map, after the service array
+        /// in STATE_LIST_REST
+        uint64_t keys_remaining;
+        bool keys_indefinite;
+        /// Remaining elements of the service array
+        uint64_t items_remaining;
+        bool items_indefinite;
+};
+
+/**
+ * @internal
+ * @brief Decode one service map at the start of a buffer
+ *
+ * @param[in]   buf     buffer containing an encoded CBOR map
+ * @param[in]   buflen  length of @p buf
+ * @param[out]  sd      destination for the decoded service
+ *
+ * @return number of bytes consumed
+ *
+ * @throws ContentError if the buffer does not start with a complete service map
+ */
+size_t decode_service(const char *buf, size_t buflen, ServiceDescription& sd);
+
+#endif /* ARROWHEAD_USE_CBOR */
+
+/** @} */
+
+} /* namespace CBOR */
+
+/* Definitions of templates declared in include/arrowhead/service.hpp */
+#if ARROWHEAD_USE_CBOR
+
+template<class ForwardIt>
+    size_t CBOR::encode_servicelist(ForwardIt first, ForwardIt last, char *buf, size_t buflen)
+{
+    size_t count = std::distance(first, last);
+    size_t pos = encode_servicelist_head(count, buf, buflen);
+    for (; first != last; ++first) {
+        char *dst = (pos < buflen) ? buf + pos : NULL;
+        pos += encode_service(*first, dst, (pos < buflen) ? buflen - pos : 0);
+    }
+    return pos;
+}
+
+template<class OutputIt>
+    OutputIt CBOR::StreamDecoder::feed(OutputIt oit, const char *data, size_t len)
+{
+    ServiceDescription sd;
+    size_t pos = 0;
+    if (buffer.empty()) {
+        /* Decode in place, only keep the incomplete tail */
+        while (next(data, len, pos, sd)) {
+            *oit++ = std::move(sd);
+        }
+        buffer.assign(data + pos, len - pos);
+    }
+    else {
+        buffer.append(data, len);
+        while (next(buffer.data(), buffer.size(), pos, sd)) {
+            *oit++ = std::move(sd);
+        }
+        buffer.erase(0, pos);
+    }
+    if (finished() && !buffer.empty()) {
+        throw ContentError("Arrowhead::CBOR: trailing data after the service list");
+    }
+    return oit;
+}
+
+template<class StringType>
+    ServiceDescription ServiceDescription::from_cbor(const StringType& cbor_str)
+{
+    return ServiceDescription::from_cbor(cbor_str.data(), cbor_str.size());
+}
+
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_cbor(OutputIt oit, const StringType& cbor_str)
+{
+    return parse_servicelist_cbor(oit, cbor_str.data(), cbor_str.size());
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_cbor(OutputIt oit, const char *cborbuf, size_t buflen)
+{
+    CBOR::StreamDecoder decoder;
+    oit = decoder.feed(oit, cborbuf, buflen);
+    if (!decoder.finished()) {
+        throw ContentError("Arrowhead::CBOR: truncated service list");
+    }
+    return oit;
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_cbor_file(OutputIt oit, const std::string& path)
+{
+    MappedFile file(path);
+    file.advise_sequential();
+    return parse_servicelist_cbor(oit, file.data(), file.size());
+}
+
+#endif /* ARROWHEAD_USE_CBOR */
+
+} /* namespace Arrowhead */
+#endif /* ARROWHEAD_DETAIL_SERVICE_CBOR_HPP_ */
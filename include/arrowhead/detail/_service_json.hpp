@@ -26,15 +26,24 @@
 #define ARROWHEAD_DETAIL_SERVICE_JSON_HPP_
 
 #include <cstddef> // for size_t
+#include <cstring>
+#include <istream>
+#include <ostream>
 #include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "arrowhead/config.h"
 
 #if ARROWHEAD_USE_JSON
-#include "nlohmann/json.hpp"
+#include "arrowhead/detail/_nlohmann_json.hpp"
 #endif
 
 #include "arrowhead/exception.hpp"
+#include "arrowhead/mappedfile.hpp"
 #include "arrowhead/service.hpp"
 
 namespace Arrowhead {
@@ -57,6 +66,18 @@ namespace JSON {
  */
 ServiceDescription service_from_obj(const nlohmann::json& srv);
 
+/**
+ * @internal
+ * @brief Translate a single JSON object into a pmr::ServiceDescription
+ *
+ * @param[in] srv  A JSON object
+ * @param[in] mr   memory resource for the returned object
+ *
+ * @return pmr::ServiceDescription object with fields filled from the JSON content
+ */
+pmr::ServiceDescription service_from_obj(const nlohmann::json& srv,
+    std::pmr::memory_resource *mr);
+
 /**
  * @internal
  * @brief Translate ServiceDescription into a JSON object
@@ -66,6 +87,209 @@ ServiceDescription service_from_obj(const nlohmann::json& srv);
  * @return JSON object representation of the given service description
  */
 nlohmann::json obj_from_service(const ServiceDescription& sd);
+
+/**
+ * @internal
+ * @brief Parse one line of a line delimited service list
+ *
+ * @param[in] line    start of the line, without the newline
+ * @param[in] len     length of the line
+ * @param[in] offset  byte offset of the line in the input, for error messages
+ *
+ * @return ServiceDescription object with fields filled from the JSON content
+ *
+ * @throws ContentError if the line is not a valid service object
+ */
+ServiceDescription service_from_line(const char *line, size_t len, size_t offset);
+
+/**
+ * @internal
+ * @brief Append a service as a single line JSON object, including the newline
+ *
+ * The output is equivalent to obj_from_service(), but is written directly
+ * into @p out without building an intermediate JSON tree.
+ *
+ * @param[in,out] out  string to append to
+ * @param[in]     sd   service to serialize
+ */
+void append_service_line(std::string& out, const ServiceDescription& sd);
+
+/**
+ * @internal
+ * @brief Parse a line delimited service list in chunks on several threads
+ *
+ * @param[in]  jsbuf    input buffer
+ * @param[in]  buflen   length of @p jsbuf
+ * @param[in]  threads  number of threads, 0 to use the hardware concurrency
+ *
+ * @return the parsed services of each chunk, in input order
+ */
+std::vector<std::vector<ServiceDescription> > parse_ndjson_chunks(const char *jsbuf,
+    size_t buflen, unsigned int threads);
+
+/**
+ * @internal
+ * @brief Read-only stream buffer over an existing memory region
+ *
+ * Lets std::istream based parsers read from a memory mapped file without
+ * copying it.
+ */
+class BufferStreambuf : public std::streambuf {
+    public:
+        BufferStreambuf(const char *buf, size_t buflen)
+        {
+            char *p = const_cast<char *>(buf);
+            setg(p, p, p + buflen);
+        }
+};
+
+/**
+ * @internal
+ * @brief Parse a `{"service": [...]}` document from a stream, one service at a time
+ *
+ * Unlike parse_servicelist_json(), the document tree is never built, every
+ * service object is converted and discarded as soon as it has been parsed, so
+ * the memory use does not grow with the size of the list.
+ *
+ * @param[in]  oit  Output iterator where the parsed objects will be placed
+ * @param[in]  is   input stream
+ *
+ * @return Output iterator after outputting the objects
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_stream(OutputIt oit, std::istream& is);
+
+/**
+ * @internal
+ * @brief Parse a `{"service": [...]}` document from a stream into a memory
+ * resource, one service at a time
+ *
+ * @see parse_servicelist_stream(OutputIt, std::istream&)
+ *
+ * @param[in]  oit  Output iterator where the parsed objects will be placed
+ * @param[in]  is   input stream
+ * @param[in]  mr   memory resource for the parsed objects
+ *
+ * @return Output iterator after outputting the objects
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_stream(OutputIt oit, std::istream& is,
+        std::pmr::memory_resource *mr);
+
+/**
+ * @internal
+ * @brief Pass every object of the "service" array of a `{"service": [...]}`
+ * document to @p fn as soon as it has been parsed
+ *
+ * @param[in]  is  input stream
+ * @param[in]  fn  called with each service object, which is discarded afterwards
+ */
+template<class Fn>
+    void for_each_service_obj(std::istream& is, Fn fn);
+
+/**
+ * @brief Incremental reader for line delimited JSON service lists
+ *
+ * Input may be fed in arbitrary pieces, e.g. as it is read from a pipe. Every
+ * service is emitted as soon as its line is complete, only an incomplete last
+ * line is buffered between calls.
+ */
+class LineReader {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  offset  byte offset of the first input byte, used in
+         *                     error messages
+         */
+        explicit LineReader(size_t offset = 0) : offset(offset) {}
+
+        /**
+         * @brief Feed more input and output all services completed by it
+         *
+         * @param[in]  oit     Output iterator where the parsed objects will be placed
+         * @param[in]  data    next piece of input
+         * @param[in]  len     length of @p data
+         *
+         * @return Output iterator after outputting the objects
+         *
+         * @throws ContentError if a line is not a valid service object
+         */
+        template<class OutputIt>
+            OutputIt feed(OutputIt oit, const char *data, size_t len);
+
+        /**
+         * @brief Parse the last line if the input did not end with a newline
+         *
+         * @param[in]  oit     Output iterator where the parsed objects will be placed
+         *
+         * @return Output iterator after outputting the objects
+         *
+         * @throws ContentError if the line is not a valid service object
+         */
+        template<class OutputIt>
+            OutputIt finish(OutputIt oit);
+
+    private:
+        /**
+         * @internal
+         * @brief Parse one complete line and advance the offset past it
+         *
+         * @return true if a service was parsed, false for blank lines
+         */
+        bool line(const char *data, size_t len, ServiceDescription& sd);
+
+        /// Incomplete last line of the previous feed() call
+        std::string partial;
+        /// Byte offset of the start of the next line
+        size_t offset;
+};
+
+/**
+ * @brief Buffered writer for line delimited JSON service lists
+ *
+ * Services are serialized directly into a large buffer which is written to
+ * the stream in blocks, suitable for streaming very long lists to files or
+ * pipes.
+ */
+class LineWriter {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  os           output stream
+         * @param[in]  buffer_size  number of bytes to collect before writing
+         */
+        explicit LineWriter(std::ostream& os, size_t buffer_size = 64 * 1024);
+
+        /**
+         * @brief Flush remaining output, errors are ignored, call flush() to see them
+         */
+        ~LineWriter();
+
+        /**
+         * @brief Write one service
+         */
+        void write(const ServiceDescription& sd)
+        {
+            append_service_line(buffer, sd);
+            if (buffer.size() >= buffer_size) {
+                flush();
+            }
+        }
+
+        /**
+         * @brief Write the buffered output to the stream
+         *
+         * @throws Error if the stream is in a failed state after writing
+         */
+        void flush();
+
+    private:
+        std::ostream& os;
+        std::string buffer;
+        size_t buffer_size;
+};
 #endif /* ARROWHEAD_USE_JSON */
 
 /** @} */
@@ -90,6 +314,26 @@ template<class OutputIt, class StringType>
 }
 #endif /* ARROWHEAD_USE_JSON */
 
+#if ARROWHEAD_USE_JSON
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_json(OutputIt oit, const StringType& js_str,
+        std::pmr::memory_resource *mr)
+{
+    return parse_servicelist_json(oit, js_str.data(), js_str.size(), mr);
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_json(OutputIt oit,
+        const char *jsbuf, size_t buflen, std::pmr::memory_resource *mr)
+{
+    /* Only the services go to the memory resource, so the document tree is
+     * never built on the global heap */
+    JSON::BufferStreambuf sb(jsbuf, buflen);
+    std::istream is(&sb);
+    return JSON::parse_servicelist_stream(oit, is, mr);
+}
+#endif /* ARROWHEAD_USE_JSON */
+
 #if ARROWHEAD_USE_JSON
 template<class StringType>
     ServiceDescription ServiceDescription::from_json(const StringType& js_str)
@@ -97,6 +341,168 @@ template<class StringType>
     nlohmann::json js = nlohmann::json::parse(js_str);
     return JSON::service_from_obj(js);
 }
+
+template<class StringType>
+    pmr::ServiceDescription pmr::ServiceDescription::from_json(
+        const StringType& js_str, std::pmr::memory_resource *mr)
+{
+    nlohmann::json js = nlohmann::json::parse(js_str);
+    return JSON::service_from_obj(js, mr);
+}
+#endif /* ARROWHEAD_USE_JSON */
+
+#if ARROWHEAD_USE_JSON
+template<class OutputIt>
+    OutputIt JSON::LineReader::feed(OutputIt oit, const char *data, size_t len)
+{
+    const char *end = data + len;
+    ServiceDescription sd;
+    if (!partial.empty()) {
+        const char *nl = static_cast<const char *>(std::memchr(data, '\n', len));
+        if (nl == NULL) {
+            partial.append(data, len);
+            return oit;
+        }
+        partial.append(data, nl - data);
+        if (line(partial.data(), partial.size(), sd)) {
+            *oit++ = std::move(sd);
+        }
+        partial.clear();
+        data = nl + 1;
+    }
+    while (data < end) {
+        const char *nl = static_cast<const char *>(std::memchr(data, '\n', end - data));
+        if (nl == NULL) {
+            partial.assign(data, end - data);
+            break;
+        }
+        if (line(data, nl - data, sd)) {
+            *oit++ = std::move(sd);
+        }
+        data = nl + 1;
+    }
+    return oit;
+}
+
+template<class OutputIt>
+    OutputIt JSON::LineReader::finish(OutputIt oit)
+{
+    ServiceDescription sd;
+    if (!partial.empty() && line(partial.data(), partial.size(), sd)) {
+        *oit++ = std::move(sd);
+    }
+    partial.clear();
+    return oit;
+}
+
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_ndjson(OutputIt oit, const StringType& js_str)
+{
+    return parse_servicelist_ndjson(oit, js_str.data(), js_str.size());
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_ndjson(OutputIt oit, const char *jsbuf, size_t buflen)
+{
+    JSON::LineReader reader;
+    oit = reader.feed(oit, jsbuf, buflen);
+    return reader.finish(oit);
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_ndjson_parallel(OutputIt oit, const char *jsbuf, size_t buflen,
+        unsigned int threads)
+{
+    std::vector<std::vector<ServiceDescription> > chunks =
+        JSON::parse_ndjson_chunks(jsbuf, buflen, threads);
+    for (auto& chunk: chunks) {
+        for (auto& sd: chunk) {
+            *oit++ = std::move(sd);
+        }
+    }
+    return oit;
+}
+
+template<class Fn>
+    void JSON::for_each_service_obj(std::istream& is, Fn fn)
+{
+    /* Depth 1 is the keys of the top level object, the services of the
+     * "service" array are the objects ending at depth 2 */
+    bool in_list = false;
+    nlohmann::json::parser_callback_t cb =
+        [&fn, &in_list](int depth, nlohmann::json::parse_event_t event, nlohmann::json& parsed) {
+            if (depth == 1 && event == nlohmann::json::parse_event_t::key) {
+                in_list = (parsed == "service");
+                return in_list;
+            }
+            if (depth == 2 && in_list && event == nlohmann::json::parse_event_t::object_end) {
+                fn(parsed);
+                return false;
+            }
+            return true;
+        };
+    nlohmann::json::parse(is, cb);
+}
+
+template<class OutputIt>
+    OutputIt JSON::parse_servicelist_stream(OutputIt oit, std::istream& is)
+{
+    JSON::for_each_service_obj(is,
+        [&oit](const nlohmann::json& srv) { *oit++ = JSON::service_from_obj(srv); });
+    return oit;
+}
+
+template<class OutputIt>
+    OutputIt JSON::parse_servicelist_stream(OutputIt oit, std::istream& is,
+        std::pmr::memory_resource *mr)
+{
+    JSON::for_each_service_obj(is,
+        [&oit, mr](const nlohmann::json& srv) { *oit++ = JSON::service_from_obj(srv, mr); });
+    return oit;
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_json_file(OutputIt oit, const std::string& path)
+{
+    MappedFile file(path);
+    file.advise_sequential();
+    JSON::BufferStreambuf sb(file.data(), file.size());
+    std::istream is(&sb);
+    try {
+        return JSON::parse_servicelist_stream(oit, is);
+    }
+    catch (const std::invalid_argument& e) {
+        throw ContentError("Arrowhead::JSON: " + path + ": " + e.what());
+    }
+    catch (const std::out_of_range& e) {
+        throw ContentError("Arrowhead::JSON: " + path + ": " + e.what());
+    }
+    catch (const std::domain_error& e) {
+        throw ContentError("Arrowhead::JSON: " + path + ": " + e.what());
+    }
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_ndjson_file(OutputIt oit, const std::string& path,
+        unsigned int threads)
+{
+    MappedFile file(path);
+    if (threads == 1) {
+        file.advise_sequential();
+        return parse_servicelist_ndjson(oit, file.data(), file.size());
+    }
+    return parse_servicelist_ndjson_parallel(oit, file.data(), file.size(), threads);
+}
+
+template<class InputIt>
+    void write_servicelist_ndjson(std::ostream& os, InputIt first, InputIt last)
+{
+    JSON::LineWriter writer(os);
+    for (; first != last; ++first) {
+        writer.write(*first);
+    }
+    writer.flush();
+}
 #endif /* ARROWHEAD_USE_JSON */
 
 template<class OutputIt>
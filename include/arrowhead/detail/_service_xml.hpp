@@ -35,6 +35,8 @@
 #endif
 
 #include "arrowhead/exception.hpp"
+#include "arrowhead/mappedfile.hpp"
+#include "arrowhead/result.hpp"
 #include "arrowhead/service.hpp"
 
 namespace Arrowhead {
@@ -60,6 +62,32 @@ namespace XML {
  */
 void parse_buffer(pugi::xml_document& doc, const char *xmlbuf, size_t buflen);
 
+/**
+ * @internal
+ * @brief Parse document without throwing
+ *
+ * @param[out]  doc     XML document object for containing the parsed tree
+ * @param[in]   xmlbuf  buffer containing XML data
+ * @param[in]   buflen  length of buffer, in bytes
+ *
+ * @return Errc::CONTENT if the buffer could not be parsed
+ */
+Status try_parse_buffer(pugi::xml_document& doc, const char *xmlbuf, size_t buflen);
+
+/**
+ * @internal
+ * @brief Parse document in place and throw exception if any errors occur.
+ *
+ * The buffer is modified by the parser and must outlive @p doc.
+ *
+ * @param[out]  doc     XML document object for containing the parsed tree
+ * @param[in]   xmlbuf  writable buffer containing XML data
+ * @param[in]   buflen  length of buffer, in bytes
+ *
+ * @throws Arrowhead::ContentError If the buffer could not be parsed
+ */
+void parse_buffer_inplace(pugi::xml_document& doc, char *xmlbuf, size_t buflen);
+
 #endif /* ARROWHEAD_USE_PUGIXML */
 
 #if ARROWHEAD_USE_PUGIXML
@@ -74,6 +102,18 @@ void parse_buffer(pugi::xml_document& doc, const char *xmlbuf, size_t buflen);
  */
 ServiceDescription service_from_node(const pugi::xml_node& srv);
 
+/**
+ * @internal
+ * @brief Translate a single XML `<service>` node into a pmr::ServiceDescription
+ *
+ * @param[in] srv  A `<service>` XML node object
+ * @param[in] mr   memory resource for the returned object
+ *
+ * @return pmr::ServiceDescription object with fields filled from the XML content
+ */
+pmr::ServiceDescription service_from_node(const pugi::xml_node& srv,
+    std::pmr::memory_resource *mr);
+
 #endif /* ARROWHEAD_USE_PUGIXML */
 
 /** @} */
@@ -94,6 +134,13 @@ template<class OutputIt, class StringType>
     return parse_servicelist_xml(oit, xml_str.c_str(), xml_str.size());
 }
 
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_xml(OutputIt oit, const StringType& xml_str,
+        std::pmr::memory_resource *mr)
+{
+    return parse_servicelist_xml(oit, xml_str.c_str(), xml_str.size(), mr);
+}
+
 #if ARROWHEAD_USE_PUGIXML
 
 template<class OutputIt>
@@ -113,6 +160,42 @@ template<class OutputIt>
 
     return oit;
 }
+
+template<class OutputIt>
+    OutputIt parse_servicelist_xml(OutputIt oit,
+        const char *xmlbuf, size_t buflen, std::pmr::memory_resource *mr)
+{
+    pugi::xml_document doc;
+    XML::parse_buffer(doc, xmlbuf, buflen);
+
+    auto listnode = doc.child("serviceList");
+    if (listnode) {
+        for (auto srv: listnode.children("service")) {
+            *oit++ = XML::service_from_node(srv, mr);
+        }
+    }
+
+    return oit;
+}
+
+template<class OutputIt>
+    OutputIt parse_servicelist_xml_file(OutputIt oit, const std::string& path)
+{
+    /* Declared before doc, the in-situ tree points into the mapping */
+    MappedFile file(path, MappedFile::COPY_ON_WRITE);
+    file.advise_sequential();
+    pugi::xml_document doc;
+    XML::parse_buffer_inplace(doc, file.writable_data(), file.size());
+
+    auto listnode = doc.child("serviceList");
+    if (listnode) {
+        for (auto srv: listnode.children("service")) {
+            *oit++ = XML::service_from_node(srv);
+        }
+    }
+
+    return oit;
+}
 #endif /* ARROWHEAD_USE_PUGIXML */
 
 } /* namespace Arrowhead */
@@ -69,13 +69,16 @@ template<class OutputIterator> class CURLCallback : public ACURLCallback {
          * @return     Number of bytes written
          */
         virtual size_t callback(char *ptr, size_t size, size_t nmemb) {
+#if ARROWHEAD_USE_EXCEPTIONS
             try {
+#endif
                 ARROWHEAD_LIB_LOGGER(logger, "curl_write_callback");
 
                 size_t nbytes = size * nmemb;
                 std::copy_n(ptr, nbytes, oit);
                 ARROWHEAD_LIB_DEBUG(logger, "Received " << nbytes << " bytes...");
                 return nbytes;
+#if ARROWHEAD_USE_EXCEPTIONS
             }
             catch (...) {
                 // It's not safe to throw exceptions across C functions (libcurl)
@@ -83,6 +86,7 @@ template<class OutputIterator> class CURLCallback : public ACURLCallback {
                 // the necessary cleanup.
                 return 0;
             }
+#endif
         }
 };
 
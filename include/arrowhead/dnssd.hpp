@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Canonical DNS-SD name decomposition
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_DNSSD_HPP_
+#define ARROWHEAD_DNSSD_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "arrowhead/config.h"
+#include "arrowhead/service.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  service
+ *
+ * @{
+ */
+
+/**
+ * @brief Domain name in canonical form
+ *
+ * The canonical form is ASCII lower case without the trailing root dot, so
+ * `Arrowhead.LTU.se.` and `arrowhead.ltu.se` are equal. The labels are split
+ * once at construction, honouring `\.` escapes, and a 64 bit hash of the
+ * canonical text is precomputed so that inequality can usually be decided by
+ * a single integer comparison.
+ */
+class CanonicalName {
+    public:
+        /**
+         * @brief Construct an empty name
+         */
+        CanonicalName() : hash_(0) {}
+
+        /**
+         * @brief Canonicalize a domain name
+         *
+         * @param[in]  name  domain name, with or without trailing dot
+         */
+        explicit CanonicalName(std::string_view name);
+
+        /**
+         * @brief Canonical text, lower case without trailing dot
+         */
+        const std::string& str() const
+        {
+            return text;
+        }
+
+        /**
+         * @brief Check whether the name is empty
+         */
+        bool empty() const
+        {
+            return text.empty();
+        }
+
+        /**
+         * @brief Number of labels in the name
+         */
+        size_t label_count() const
+        {
+            return spans.size();
+        }
+
+        /**
+         * @brief Get a label, 0 is the leftmost (most specific) label
+         *
+         * @param[in]  i  label index, must be less than label_count()
+         */
+        std::string_view label(size_t i) const
+        {
+            return std::string_view(text).substr(spans[i].first, spans[i].second);
+        }
+
+        /**
+         * @brief Case-insensitive hash of the name
+         */
+        uint64_t hash() const
+        {
+            return hash_;
+        }
+
+        /**
+         * @brief Case-insensitive comparison, hashes are compared first
+         */
+        bool operator==(const CanonicalName& other) const
+        {
+            return hash_ == other.hash_ && text == other.text;
+        }
+
+        /**
+         * @brief Case-insensitive comparison, hashes are compared first
+         */
+        bool operator!=(const CanonicalName& other) const
+        {
+            return !(*this == other);
+        }
+
+    private:
+        std::string text;
+        /// (offset, length) of each label in text
+        std::vector<std::pair<size_t, size_t> > spans;
+        uint64_t hash_;
+};
+
+/**
+ * @brief DNS-SD decomposition of the name, type and domain of a service
+ *
+ * A service name `<instance>.<service>.<protocol>.<domain>`, e.g.
+ * `orchestration-mgmt._orch-m-ws-http._tcp.srv.arrowhead.ltu.se.`, is split
+ * into instance `orchestration-mgmt`, service `_orch-m-ws-http`, protocol
+ * `_tcp` and domain `srv.arrowhead.ltu.se`. Names without a `_tcp` or `_udp`
+ * label are kept whole in @ref instance.
+ *
+ * ServiceIndex decomposes each of its services once, when it is first asked
+ * for, see ServiceIndex::name_components().
+ */
+struct ServiceNameComponents {
+    /// The whole service name
+    CanonicalName name;
+    /// Instance part of the name
+    CanonicalName instance;
+    /// Service part of the name, e.g. `_orch-m-ws-http`
+    CanonicalName service;
+    /// Protocol part of the name, `_tcp` or `_udp`
+    CanonicalName protocol;
+    /// Domain part of the name
+    CanonicalName name_domain;
+    /// ServiceDescription::type, e.g. `_orch-m-ws-http._tcp`
+    CanonicalName type;
+    /// ServiceDescription::domain
+    CanonicalName domain;
+
+    /**
+     * @brief Decompose the name, type and domain of a service
+     *
+     * @param[in]  sd  service to decompose
+     *
+     * @return the canonical components
+     */
+    static ServiceNameComponents from_service(const ServiceDescription& sd);
+};
+
+/**
+ * @brief Hash function object for using CanonicalName in unordered containers
+ */
+struct CanonicalNameHash {
+    size_t operator()(const CanonicalName& name) const
+    {
+        return static_cast<size_t>(name.hash());
+    }
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_DNSSD_HPP_ */
@@ -25,6 +25,7 @@
 #ifndef ARROWHEAD_EXCEPTION_HPP_
 #define ARROWHEAD_EXCEPTION_HPP_
 
+#include <exception>
 #include <stdexcept>
 
 #include "arrowhead/config.h"
@@ -83,6 +84,25 @@ class ContentError : public Error {
         {}
 };
 
+/**
+ * @ingroup  exception
+ * @brief    Print @p e to stderr and abort the program
+ *
+ * Used instead of throwing in builds without exception support.
+ */
+[[noreturn]] void fatal_error(const std::exception& e) noexcept;
+
 } /* namespace Arrowhead */
 
+/**
+ * @ingroup  exception
+ * @brief    Throw an exception, or call Arrowhead::fatal_error() with it if
+ *           the library is built without exceptions
+ */
+#if ARROWHEAD_USE_EXCEPTIONS
+#define ARROWHEAD_THROW(...) throw __VA_ARGS__
+#else
+#define ARROWHEAD_THROW(...) ::Arrowhead::fatal_error(__VA_ARGS__)
+#endif
+
 #endif /* ARROWHEAD_EXCEPTION_HPP_ */
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Circuit breaker and adaptive concurrency limit for transports
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_GUARD_HPP_
+#define ARROWHEAD_GUARD_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "arrowhead/config.h"
+#include "arrowhead/result.hpp"
+#include "arrowhead/transport.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  http
+ *
+ * @{
+ */
+
+/**
+ * @brief Stops calls to a server which fails most of them
+ *
+ * Counts the outcomes of the last calls. When enough of them failed, the
+ * breaker opens and rejects all calls for a while, then lets a few probe
+ * calls through (half-open). If they succeed it closes again, otherwise it
+ * stays open for another period.
+ *
+ * Thread safe.
+ */
+class CircuitBreaker {
+    public:
+        /**
+         * @brief Breaker states
+         */
+        enum State {
+            /// Calls pass
+            CLOSED,
+            /// Calls are rejected
+            OPEN,
+            /// A limited number of probe calls pass
+            HALF_OPEN,
+        };
+
+        /**
+         * @brief Tuning parameters
+         */
+        struct Options {
+            Options() : window(20), min_calls(10), failure_rate(0.5),
+                open_duration(5000), half_open_probes(1) {}
+
+            /// Number of recent calls the failure rate is computed over
+            unsigned int window;
+            /// Calls needed in the window before the breaker may open
+            unsigned int min_calls;
+            /// Share of failed calls in the window which opens the breaker
+            double failure_rate;
+            /// Time the breaker stays open before letting probes through
+            std::chrono::milliseconds open_duration;
+            /// Number of successful probes which close the breaker
+            unsigned int half_open_probes;
+        };
+
+        /**
+         * @brief Constructor
+         */
+        explicit CircuitBreaker(const Options& options = Options());
+
+        /**
+         * @brief Ask for permission to make a call
+         *
+         * Every call which was allowed must be followed by record().
+         *
+         * @return false if the call must not be made
+         */
+        bool allow();
+
+        /**
+         * @brief Record the outcome of an allowed call
+         *
+         * @param[in]  failure  true if the call failed or was too slow
+         */
+        void record(bool failure);
+
+        /**
+         * @brief Current state
+         */
+        State state() const;
+
+    private:
+        typedef std::chrono::steady_clock clock;
+
+        void open(clock::time_point now);
+
+        Options options;
+        mutable std::mutex mutex;
+        State state_;
+        /// Ring buffer of outcomes of the last calls, true for failures
+        std::vector<bool> outcomes;
+        size_t next_outcome;
+        unsigned int calls;
+        unsigned int failures;
+        clock::time_point opened_at;
+        unsigned int probes_in_flight;
+        unsigned int probe_successes;
+};
+
+/**
+ * @brief Additive increase, multiplicative decrease limit of concurrent calls
+ *
+ * Each call which completes without signs of overload raises the limit by
+ * 1 / limit, i.e. by about one per round of calls, each overloaded call
+ * multiplies it by the backoff factor. A client thus finds the load a server
+ * can take and backs off quickly when the server struggles.
+ *
+ * Thread safe.
+ */
+class AIMDLimit {
+    public:
+        /**
+         * @brief Tuning parameters
+         */
+        struct Options {
+            Options() : initial_limit(10), min_limit(1), max_limit(200), backoff(0.5) {}
+
+            /// Limit before any call completed
+            double initial_limit;
+            /// The limit never drops below this
+            double min_limit;
+            /// The limit never rises above this
+            double max_limit;
+            /// Factor applied to the limit on overload, in (0, 1)
+            double backoff;
+        };
+
+        /**
+         * @brief Constructor
+         */
+        explicit AIMDLimit(const Options& options = Options());
+
+        /**
+         * @brief Start a call if the limit allows
+         *
+         * @return false if the limit is reached, release() must be called
+         *         otherwise
+         */
+        bool try_acquire();
+
+        /**
+         * @brief Finish a call started with try_acquire() and adapt the limit
+         *
+         * @param[in]  overload  true if the call showed signs of overload
+         */
+        void release(bool overload);
+
+        /**
+         * @brief Finish a call started with try_acquire() which was not made
+         */
+        void release_unused();
+
+        /**
+         * @brief Current limit
+         */
+        double limit() const;
+
+        /**
+         * @brief Number of calls in flight
+         */
+        unsigned int in_flight() const;
+
+    private:
+        Options options;
+        mutable std::mutex mutex;
+        double limit_;
+        unsigned int in_flight_;
+};
+
+/**
+ * @internal
+ * @brief Transport independent part of GuardedTransport
+ */
+class TransportGuard {
+    public:
+        typedef std::chrono::steady_clock clock;
+
+        /**
+         * @brief Tuning parameters
+         */
+        struct Options {
+            Options() : slow_call(2000), serve_stale(true), cache_size(64) {}
+
+            /// Circuit breaker parameters
+            CircuitBreaker::Options breaker;
+            /// Concurrency limit parameters
+            AIMDLimit::Options limit;
+            /// Calls taking longer count as failed
+            std::chrono::milliseconds slow_call;
+            /// Answer rejected `GET` requests with the last successful response
+            bool serve_stale;
+            /// Maximum number of cached responses, the oldest one is dropped first
+            size_t cache_size;
+        };
+
+        /**
+         * @brief Constructor
+         */
+        explicit TransportGuard(const Options& options);
+
+        /**
+         * @brief Admit a call, or answer it from the cache
+         *
+         * @return ok() if the call may be made, Errc::CIRCUIT_OPEN or
+         *         Errc::OVERLOADED if it must not
+         */
+        Status admit();
+
+        /**
+         * @brief Record the outcome of an admitted call
+         */
+        void complete(const HTTPRequest& req, const Status& status, const HTTPResponse& resp,
+            clock::duration latency);
+
+        /**
+         * @brief Fill @p resp from the cache if possible
+         *
+         * @return true if @p resp holds a cached response for @p req
+         */
+        bool cached(const HTTPRequest& req, HTTPResponse& resp) const;
+
+        /// Circuit breaker
+        CircuitBreaker breaker;
+        /// Concurrency limit
+        AIMDLimit limit;
+
+    private:
+        /// Keys of the cached responses, the least recently stored first
+        typedef std::list<std::string> age_list;
+
+        struct CacheEntry {
+            HTTPResponse resp;
+            /// Position of the key in cache_age
+            age_list::iterator age;
+        };
+
+        static std::string cache_key(const HTTPRequest& req);
+
+        Options options;
+        mutable std::mutex cache_mutex;
+        std::map<std::string, CacheEntry> cache;
+        age_list cache_age;
+};
+
+/**
+ * @brief Transport policy protecting a struggling server from its clients
+ *
+ * Wraps another transport policy with a CircuitBreaker and an AIMDLimit.
+ * Transport errors, timeouts, 429 and 5xx statuses and calls slower than
+ * Options::slow_call count as failures. Calls rejected by the breaker fail
+ * at once with Errc::CIRCUIT_OPEN, calls over the concurrency limit with
+ * Errc::OVERLOADED. Neither is retried by a RetryPolicy. With
+ * Options::serve_stale a rejected `GET` is instead answered with the last
+ * successful response to the same request, if there is one.
+ *
+ * Copies share the breaker, the limit and the cache.
+ *
+ * @tparam Transport  wrapped transport policy
+ */
+template<class Transport>
+class GuardedTransport {
+    public:
+        /// Tuning parameters
+        typedef TransportGuard::Options Options;
+
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  transport  wrapped transport policy object
+         * @param[in]  options    tuning parameters
+         */
+        explicit GuardedTransport(const Transport& transport = Transport(),
+            const Options& options = Options()) :
+            transport(transport), guard(std::make_shared<TransportGuard>(options))
+        {}
+
+        /**
+         * @brief Perform @p req unless the server is considered overloaded
+         */
+        Status perform(const HTTPRequest& req, HTTPResponse& resp) const
+        {
+            Status status = guard->admit();
+            if (!status.ok()) {
+                if (guard->cached(req, resp)) {
+                    return Status();
+                }
+                return status;
+            }
+            TransportGuard::clock::time_point start = TransportGuard::clock::now();
+            status = transport.perform(req, resp);
+            guard->complete(req, status, resp, TransportGuard::clock::now() - start);
+            return status;
+        }
+
+        /**
+         * @brief Perform @p req unless the server is considered overloaded
+         *
+         * @throws TransportError if the call is rejected or fails
+         */
+        HTTPResponse perform(const HTTPRequest& req) const
+        {
+            HTTPResponse resp;
+            Status status = perform(req, resp);
+            if (!status.ok()) {
+                status.raise();
+            }
+            return resp;
+        }
+
+        /**
+         * @brief The circuit breaker
+         */
+        const CircuitBreaker& breaker() const
+        {
+            return guard->breaker;
+        }
+
+        /**
+         * @brief The concurrency limit
+         */
+        const AIMDLimit& limit() const
+        {
+            return guard->limit;
+        }
+
+        /**
+         * @brief The wrapped transport policy object
+         */
+        Transport& inner()
+        {
+            return transport;
+        }
+
+    private:
+        Transport transport;
+        std::shared_ptr<TransportGuard> guard;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_GUARD_HPP_ */
@@ -30,9 +30,18 @@
 #if ARROWHEAD_USE_LIBCURL
 
 #include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include <curl/curl.h>
 
+#include "arrowhead/compression.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/tracing.hpp"
+#include "arrowhead/transport.hpp"
+
 namespace Arrowhead {
 
 /**
@@ -70,6 +79,73 @@ class ACURLCallback {
 };
 
 
+/**
+ * @brief Write callback appending the received data to a string
+ *
+ * Unlike the iterator callbacks of set_write_iterator() it is a member of
+ * the CURLContext, so pointing it at the next response allocates nothing.
+ */
+class StringSink : public ACURLCallback {
+    public:
+        StringSink() : target(NULL) {}
+
+        size_t callback(char *ptr, size_t size, size_t nmemb) override;
+
+        /// String receiving the data
+        std::string *target;
+};
+
+/**
+ * @brief Process wide libcurl share handle
+ *
+ * Every CURLContext attaches to it, so the DNS cache and the TLS session
+ * IDs are shared by all handles the library creates, in all threads. A new
+ * handle thus reuses the resolved address and resumes the TLS session of an
+ * earlier request to the same host.
+ *
+ * Connections are not shared, libcurl does not support using a shared
+ * connection cache from concurrent threads. Each handle keeps its own
+ * connections open, transports reuse their handles to reuse connections.
+ */
+class CURLShare {
+    public:
+        /**
+         * @brief The instance, created on first use
+         */
+        static CURLShare& instance();
+
+        /**
+         * @brief The libcurl share handle
+         */
+        CURLSH *handle() const
+        {
+            return share;
+        }
+
+        /**
+         * @internal
+         * @brief Lock the data of type @p data, called by libcurl
+         */
+        void lock(curl_lock_data data);
+
+        /**
+         * @internal
+         * @brief Unlock the data of type @p data, called by libcurl
+         */
+        void unlock(curl_lock_data data);
+
+        CURLShare(const CURLShare&) = delete;
+        CURLShare& operator=(const CURLShare&) = delete;
+
+    private:
+        CURLShare();
+        ~CURLShare();
+
+        CURLSH *share;
+        /// One lock per kind of shared data, so DNS lookups do not wait for TLS
+        std::mutex mutexes[CURL_LOCK_DATA_LAST];
+};
+
 /**
  * @brief CURL context wrapper class
  */
@@ -110,6 +186,159 @@ class CURLContext {
          * @param[in]  oit  Output iterator where the received data will be written
          */
         template<class OutputIterator> void set_write_iterator(OutputIterator oit);
+
+        /**
+         * @brief Set up the handle to perform @p req on @p url
+         *
+         * Applies the method, headers, body and deadline of @p req and
+         * directs the response body to @p resp, which must outlive the
+         * transfer. Every option a previous request may have set is set
+         * again, so a handle can be prepared for any number of requests in
+         * turn. The header list is only rebuilt if the headers differ from
+         * those of the previous request, and the socket of a `unix://` URL
+         * is only looked up if the socket of the previous request is not a
+         * prefix of the URL.
+         *
+         * @param[in]  req   request to perform
+         * @param[in]  url   absolute URL, usually req.url
+         * @param[out] resp  response to receive the body
+         */
+        void prepare(const HTTPRequest& req, const std::string& url, HTTPResponse& resp);
+
+        /**
+         * @brief Apply the TLS settings @p tls to the handle
+         */
+        void apply_tls(const TLSOptions& tls);
+
+        /**
+         * @brief Let the handle negotiate the HTTP versions @p version
+         */
+        void set_http_version(HTTPVersion version);
+
+        /**
+         * @brief Apply the content coding settings @p compression to the
+         * handle, must be called before prepare()
+         */
+        void apply_compression(const CompressionOptions& compression);
+
+        /**
+         * @internal
+         * @brief Note whether the TLS session of the connection was resumed,
+         * called on the first response header
+         */
+        void check_tls_session();
+
+        /**
+         * @internal
+         * @brief Note whether the response body is compressed, called for
+         * every response header line
+         */
+        void check_content_encoding(const char *line, size_t len);
+
+        /**
+         * @brief Outcome of a finished transfer
+         *
+         * Stores the status code, `Content-Type` and RequestTiming in
+         * @p resp on success and counts the TLS handshake of the transfer,
+         * if any, in tls_stats(), the body sizes in compression_stats() and
+         * the timing in latency_stats(). While tracing, the phases of the
+         * transfer are recorded as children of the span current in prepare().
+         *
+         * @param[in]  curl_code  result of the transfer
+         * @param[out] resp       response prepared with prepare()
+         * @param[in]  context    static string naming the transport
+         *
+         * @return Errc::TIMEOUT or Errc::TRANSPORT if @p curl_code is an error
+         */
+        Status result(CURLcode curl_code, HTTPResponse& resp, const char *context) const;
+
+    private:
+        /// First header of the current response seen
+        bool headers_seen;
+        /// The TLS session of the connection was resumed
+        bool tls_resumed;
+        /// Content coding settings
+        CompressionOptions compression;
+        /// The compressed request body, if it was compressed
+        std::string request_body;
+        /// The current response has a `Content-Encoding`
+        bool compressed_response;
+        /// Receives the response bodies of prepare()
+        StringSink body_sink;
+        /// @ref headers was built by prepare() for these values
+        bool headers_prepared;
+        std::string prepared_accept;
+        std::string prepared_content_type;
+        bool prepared_gzip;
+        /// `unix://` URL up to the socket path of an earlier request, empty
+        /// if its socket was not found
+        std::string unix_prefix;
+        /// A socket path is set on the handle, that of @ref unix_prefix
+        /// unless it is empty
+        bool unix_socket_set;
+        /// URL of the request on the socket of a `unix://` URL
+        std::string unix_url;
+        /// Operation and endpoint of the current request in latency_stats()
+        std::string operation;
+        std::string endpoint;
+        /// Span current in prepare() and the time of it, while tracing
+        Tracing::SpanContext trace_parent;
+        Tracing::Clock::time_point trace_start;
+};
+
+/**
+ * @brief Idle easy handles of a transport, set up once and reused
+ *
+ * A new handle gets the options which are the same for every request of
+ * the transport, i.e. the TLS settings, the HTTP version and the content
+ * coding, when it is created. A released handle keeps them, together with
+ * its header list and the buffers libcurl allocated for it, so the next
+ * request only sets its own URL, method, body and deadline.
+ *
+ * Thread safe.
+ */
+class CURLHandlePool {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  tls          TLS settings of the handles
+         * @param[in]  version      HTTP versions to negotiate
+         * @param[in]  compression  content coding of requests and responses
+         * @param[in]  max_idle     handles kept for reuse, more are destroyed
+         *                          on release
+         */
+        CURLHandlePool(const TLSOptions& tls, HTTPVersion version,
+            const CompressionOptions& compression, size_t max_idle = 16);
+
+        ~CURLHandlePool();
+
+        /**
+         * @brief An idle handle, or a new one if there is none
+         */
+        std::unique_ptr<CURLContext> acquire();
+
+        /**
+         * @brief Give @p ctx back for reuse, it must not be in a multi handle
+         */
+        void release(std::unique_ptr<CURLContext> ctx);
+
+        /**
+         * @brief Number of handles created so far
+         */
+        size_t created() const;
+
+        CURLHandlePool(const CURLHandlePool&) = delete;
+        CURLHandlePool& operator=(const CURLHandlePool&) = delete;
+
+    private:
+        TLSOptions tls;
+        HTTPVersion version;
+        CompressionOptions compression;
+        size_t max_idle;
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<CURLContext> > idle;
+        size_t created_;
 };
 
 } /* namespace HTTP */
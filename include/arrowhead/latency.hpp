@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Latency breakdown of the requests made by the HTTP transports
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_LATENCY_HPP_
+#define ARROWHEAD_LATENCY_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "arrowhead/config.h"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  http
+ *
+ * @{
+ */
+
+/**
+ * @brief Where the time of one request went, as measured by libcurl
+ *
+ * The times are counted from the start of the request, like the
+ * `CURLINFO_*_TIME` values they come from, so each includes the ones
+ * before it. On a reused connection the name lookup, connect and TLS
+ * handshake times are zero.
+ */
+struct RequestTiming {
+    RequestTiming() : namelookup(0), connect(0), appconnect(0), pretransfer(0),
+        starttransfer(0), total(0), bytes_sent(0), bytes_received(0),
+        reused_connection(false) {}
+
+    /// Until the host name was resolved
+    std::chrono::microseconds namelookup;
+    /// Until the TCP connection, or the Unix domain socket, was established
+    std::chrono::microseconds connect;
+    /// Until the TLS handshake was done, zero without TLS
+    std::chrono::microseconds appconnect;
+    /// Until the request was about to be sent
+    std::chrono::microseconds pretransfer;
+    /// Until the first byte of the response arrived
+    std::chrono::microseconds starttransfer;
+    /// Until the response was complete
+    std::chrono::microseconds total;
+    /// Request body bytes sent, after compression
+    uint64_t bytes_sent;
+    /// Response body bytes received, before decoding
+    uint64_t bytes_received;
+    /// The request was sent on an already open connection
+    bool reused_connection;
+
+    /**
+     * @brief Time from sending the request to the first response byte,
+     * i.e. the server processing time plus a round trip
+     */
+    std::chrono::microseconds server_time() const
+    {
+        return starttransfer - pretransfer;
+    }
+
+    /**
+     * @brief Time spent receiving the response after its first byte
+     */
+    std::chrono::microseconds transfer_time() const
+    {
+        return total - starttransfer;
+    }
+};
+
+/**
+ * @brief Histogram of durations in buckets growing by powers of two
+ *
+ * Bucket 0 counts durations below 1 µs, bucket `i` durations of at least
+ * 2^(i-1) µs and below 2^i µs, and the last bucket everything longer, i.e.
+ * from 2^(BUCKETS-2) µs, about 67 s, on. Percentiles are therefore exact to
+ * a factor of two, which is enough to tell a slow DNS server from a slow
+ * registry, and recording a value is a handful of instructions.
+ */
+class LatencyHistogram {
+    public:
+        /// Number of buckets
+        static const size_t BUCKETS = 28;
+
+        LatencyHistogram();
+
+        /**
+         * @brief Count one duration
+         */
+        void record(std::chrono::microseconds value);
+
+        /**
+         * @brief Add the counts of @p other
+         */
+        void merge(const LatencyHistogram& other);
+
+        /**
+         * @brief Number of durations counted
+         */
+        uint64_t count() const
+        {
+            return count_;
+        }
+
+        /**
+         * @brief Sum of the durations counted
+         */
+        std::chrono::microseconds sum() const
+        {
+            return std::chrono::microseconds(sum_);
+        }
+
+        /**
+         * @brief Longest duration counted, zero if there were none
+         */
+        std::chrono::microseconds max() const
+        {
+            return std::chrono::microseconds(max_);
+        }
+
+        /**
+         * @brief Mean of the durations, zero if there were none
+         */
+        std::chrono::microseconds mean() const
+        {
+            return std::chrono::microseconds(count_ == 0 ? 0 : sum_ / count_);
+        }
+
+        /**
+         * @brief Number of durations in bucket @p i
+         */
+        uint64_t bucket(size_t i) const
+        {
+            return counts[i];
+        }
+
+        /**
+         * @brief Exclusive upper limit of bucket @p i, the last bucket has none
+         */
+        static std::chrono::microseconds bucket_limit(size_t i)
+        {
+            return std::chrono::microseconds(int64_t(1) << i);
+        }
+
+        /**
+         * @brief Upper estimate of the @p q quantile, e.g. 0.99 for the 99th
+         * percentile
+         *
+         * @return the upper limit of the bucket holding the quantile, but
+         *         at most max(), zero if nothing was counted
+         */
+        std::chrono::microseconds percentile(double q) const;
+
+    private:
+        uint64_t counts[BUCKETS];
+        uint64_t count_;
+        uint64_t sum_;
+        uint64_t max_;
+};
+
+/**
+ * @brief Latency breakdown of the requests of one operation to one endpoint
+ *
+ * There is a histogram for each of the times of RequestTiming.
+ */
+struct RequestLatency {
+    RequestLatency() : requests(0), reused_connections(0), bytes_sent(0),
+        bytes_received(0) {}
+
+    /**
+     * @brief Count the request timed by @p timing
+     */
+    void record(const RequestTiming& timing);
+
+    /**
+     * @brief Add the counts of @p other
+     */
+    void merge(const RequestLatency& other);
+
+    /// Requests which got a response
+    uint64_t requests;
+    /// Of those, requests sent on an already open connection
+    uint64_t reused_connections;
+    /// Request body bytes sent
+    uint64_t bytes_sent;
+    /// Response body bytes received
+    uint64_t bytes_received;
+    LatencyHistogram namelookup;
+    LatencyHistogram connect;
+    LatencyHistogram appconnect;
+    LatencyHistogram pretransfer;
+    LatencyHistogram starttransfer;
+    LatencyHistogram total;
+};
+
+/**
+ * @brief Latency breakdowns by operation and endpoint
+ *
+ * The operation is HTTPRequest::operation, e.g. `list` for the requests
+ * of ServiceRegistryClient::list_services(). The endpoint is the scheme,
+ * host and port of the URL, e.g. `http://10.0.0.1:8045`, or the socket
+ * path for `unix://` URLs, e.g. `unix:///run/arrowhead.sock`.
+ */
+typedef std::map<std::pair<std::string, std::string>, RequestLatency> LatencyStats;
+
+#if ARROWHEAD_USE_LIBCURL
+/**
+ * @brief Latency breakdowns of the responses the libcurl transports
+ * received so far
+ *
+ * Requests which failed without a response are not counted.
+ */
+LatencyStats latency_stats();
+#endif
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_LATENCY_HPP_ */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Memory mapped input files
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_MAPPEDFILE_HPP_
+#define ARROWHEAD_MAPPEDFILE_HPP_
+
+#include <cstddef>
+#include <string>
+
+#include "arrowhead/config.h"
+
+#include "arrowhead/result.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  service
+ *
+ * @{
+ */
+
+/**
+ * @brief RAII wrapper around a memory mapping of a whole file
+ *
+ * The file is mapped at construction and unmapped at destruction, the pages
+ * are read from disk on demand by the kernel, so mapping a large file does
+ * not allocate any memory up front.
+ */
+class MappedFile {
+    public:
+        /**
+         * @brief Mapping modes
+         */
+        enum Mode {
+            /// Shared read-only mapping
+            READ_ONLY,
+            /**
+             * Private writable mapping, modified pages are copied on write
+             * and the changes are never written back to the file. Used for
+             * in-situ parsers which modify their input buffer.
+             */
+            COPY_ON_WRITE,
+        };
+
+        /**
+         * @brief Construct an empty mapping
+         */
+        MappedFile() : addr(NULL), length(0) {}
+
+        /**
+         * @brief Map the file at @p path
+         *
+         * @param[in]  path  file to map
+         * @param[in]  mode  mapping mode
+         *
+         * @throws Error if the file can not be opened or mapped
+         */
+        explicit MappedFile(const std::string& path, Mode mode = READ_ONLY);
+
+        /**
+         * @brief Map the file at @p path in place of the current mapping,
+         * without throwing
+         *
+         * @param[in]  path  file to map
+         * @param[in]  mode  mapping mode
+         *
+         * @return Errc::IO if the file can not be opened or mapped, the
+         *         mapping is empty then
+         */
+        Status map(const std::string& path, Mode mode = READ_ONLY);
+
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        ~MappedFile();
+
+        /**
+         * @brief Start of the mapping, NULL for empty files
+         */
+        const char *data() const
+        {
+            return addr;
+        }
+
+        /**
+         * @brief Start of the mapping for COPY_ON_WRITE mappings
+         */
+        char *writable_data()
+        {
+            return addr;
+        }
+
+        /**
+         * @brief Size of the file in bytes
+         */
+        size_t size() const
+        {
+            return length;
+        }
+
+        /**
+         * @brief Check whether the mapping is empty
+         */
+        bool empty() const
+        {
+            return length == 0;
+        }
+
+        /**
+         * @brief Hint to the kernel that the mapping will be read sequentially
+         *
+         * Enables aggressive read-ahead and early reclaim of pages already
+         * read, this keeps the resident memory low while parsing huge files.
+         */
+        void advise_sequential() const;
+
+    private:
+        char *addr;
+        size_t length;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_MAPPEDFILE_HPP_ */
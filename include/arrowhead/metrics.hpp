@@ -0,0 +1,491 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Run time metrics of the library and their Prometheus exposition
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_METRICS_HPP_
+#define ARROWHEAD_METRICS_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_METRICS
+
+/**
+ * @ingroup  metrics
+ *
+ * @{
+ */
+
+/* macros instrumenting the library, compiled out without ARROWHEAD_USE_METRICS */
+
+/**
+ * @brief  Declare a reference @p var to the counter @p name{@p labels}
+ *
+ * The counter is registered on first use, later uses cost nothing but the
+ * check of the static initialization.
+ */
+#define ARROWHEAD_LIB_COUNTER(var, name, labels, help) \
+    static ::Arrowhead::Metrics::Counter& var = \
+        ::Arrowhead::Metrics::Registry::instance().counter((name), (labels), (help))
+
+/**
+ * @brief  Declare a reference @p var to the gauge @p name{@p labels}
+ */
+#define ARROWHEAD_LIB_GAUGE(var, name, labels, help) \
+    static ::Arrowhead::Metrics::Gauge& var = \
+        ::Arrowhead::Metrics::Registry::instance().gauge((name), (labels), (help))
+
+/**
+ * @brief  Declare a reference @p var to the histogram @p name{@p labels}
+ */
+#define ARROWHEAD_LIB_HISTOGRAM(var, name, labels, help) \
+    static ::Arrowhead::Metrics::Histogram& var = \
+        ::Arrowhead::Metrics::Registry::instance().histogram((name), (labels), (help))
+
+/**
+ * @brief  Add @p n to the counter or gauge @p var
+ */
+#define ARROWHEAD_LIB_ADD(var, n) (var).add(n)
+
+/**
+ * @brief  Record a duration in the histogram @p var
+ */
+#define ARROWHEAD_LIB_OBSERVE(var, duration) (var).observe(duration)
+
+/**
+ * @brief  Record the time until the end of the scope in the histogram @p var
+ */
+#define ARROWHEAD_LIB_TIME_SCOPE(timer_var, var) \
+    ::Arrowhead::Metrics::ScopedTimer timer_var(var)
+
+/** @} */
+
+#else /* ARROWHEAD_USE_METRICS */
+
+/* stub macros */
+#define ARROWHEAD_LIB_COUNTER(var, name, labels, help)
+#define ARROWHEAD_LIB_GAUGE(var, name, labels, help)
+#define ARROWHEAD_LIB_HISTOGRAM(var, name, labels, help)
+#define ARROWHEAD_LIB_ADD(var, n)
+#define ARROWHEAD_LIB_OBSERVE(var, duration)
+#define ARROWHEAD_LIB_TIME_SCOPE(timer_var, var)
+
+#endif /* ARROWHEAD_USE_METRICS */
+
+namespace Arrowhead {
+
+namespace Metrics {
+
+/**
+ * @ingroup  metrics
+ *
+ * @{
+ */
+
+/// Number of shards of a counter or histogram
+static const size_t SHARDS = 8;
+
+/**
+ * @internal
+ * @brief Shard of the calling thread plus one, zero until it is assigned
+ */
+extern thread_local size_t thread_shard_slot;
+
+/**
+ * @internal
+ * @brief Assign the calling thread a shard, round robin
+ */
+size_t assign_thread_shard();
+
+/**
+ * @internal
+ * @brief Shard of the calling thread
+ */
+inline size_t thread_shard()
+{
+    size_t slot = thread_shard_slot;
+    return slot != 0 ? slot - 1 : assign_thread_shard();
+}
+
+/**
+ * @brief Monotonic counter, e.g. of requests made
+ */
+class Counter {
+    public:
+        Counter();
+
+        /**
+         * @brief Add @p n
+         */
+        void add(uint64_t n = 1)
+        {
+            cells[thread_shard()].value.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Sum of all additions so far
+         */
+        uint64_t value() const;
+
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+
+    private:
+        struct alignas(64) Cell {
+            std::atomic<uint64_t> value;
+        };
+        Cell cells[SHARDS];
+};
+
+/**
+ * @brief Value which goes up and down, e.g. the number of idle handles
+ */
+class Gauge {
+    public:
+        Gauge() : value_(0) {}
+
+        /**
+         * @brief Set the value to @p v
+         */
+        void set(int64_t v)
+        {
+            value_.store(v, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Add @p n, which may be negative
+         */
+        void add(int64_t n)
+        {
+            value_.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief The current value
+         */
+        int64_t value() const
+        {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+        Gauge(const Gauge&) = delete;
+        Gauge& operator=(const Gauge&) = delete;
+
+    private:
+        std::atomic<int64_t> value_;
+};
+
+/**
+ * @brief Counts of a Histogram at one point in time
+ */
+struct HistogramSnapshot {
+    HistogramSnapshot() : count(0), sum(0) {}
+
+    /// Count of each bucket, see Histogram::bucket_of()
+    std::vector<uint64_t> buckets;
+    /// Number of durations recorded
+    uint64_t count;
+    /// Sum of the durations, in nanoseconds
+    uint64_t sum;
+
+    /**
+     * @brief Number of durations shorter than @p limit
+     *
+     * Exact if @p limit is the start of a bucket, e.g. a power of two
+     * nanoseconds, otherwise it includes the whole bucket holding @p limit.
+     */
+    uint64_t count_below(std::chrono::nanoseconds limit) const;
+
+    /**
+     * @brief Upper estimate of the @p q quantile, e.g. 0.99 for the 99th
+     * percentile, within 12.5%, zero if nothing was recorded
+     */
+    std::chrono::nanoseconds percentile(double q) const;
+};
+
+/**
+ * @brief Histogram of durations with a bounded relative error
+ *
+ * Like an HDR histogram, each power of two nanoseconds is split into
+ * SUB_BUCKETS buckets of equal width, so a recorded duration is known to
+ * within 12.5% from 8 ns up to centuries, in a fixed amount of memory and
+ * without configuring a range.
+ */
+class Histogram {
+    public:
+        /// Buckets per power of two
+        static const size_t SUB_BUCKETS = 8;
+        /// Number of buckets
+        static const size_t BUCKETS = (64 - 2) * SUB_BUCKETS;
+
+        Histogram();
+
+        /**
+         * @brief Record a duration
+         */
+        void observe(std::chrono::nanoseconds duration)
+        {
+            uint64_t ns = duration.count() > 0 ? static_cast<uint64_t>(duration.count()) : 0;
+            Shard& shard = shards[thread_shard()];
+            shard.buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+            shard.sum.fetch_add(ns, std::memory_order_relaxed);
+        }
+
+        /**
+         * @brief Bucket counting @p ns nanoseconds
+         */
+        static size_t bucket_of(uint64_t ns)
+        {
+            if (ns < SUB_BUCKETS) {
+                return static_cast<size_t>(ns);
+            }
+            /* Position of the highest bit, at least 3, and the next 3 bits */
+            unsigned int msb = 63 - static_cast<unsigned int>(__builtin_clzll(ns));
+            return (msb - 2) * SUB_BUCKETS + static_cast<size_t>((ns >> (msb - 3)) & 7);
+        }
+
+        /**
+         * @brief Smallest duration counted by bucket @p i, in nanoseconds
+         */
+        static uint64_t bucket_start(size_t i)
+        {
+            if (i < 2 * SUB_BUCKETS) {
+                return i;
+            }
+            unsigned int msb = static_cast<unsigned int>(i / SUB_BUCKETS) + 2;
+            return (uint64_t(SUB_BUCKETS) + i % SUB_BUCKETS) << (msb - 3);
+        }
+
+        /**
+         * @brief Sum up the shards
+         */
+        HistogramSnapshot snapshot() const;
+
+        Histogram(const Histogram&) = delete;
+        Histogram& operator=(const Histogram&) = delete;
+
+    private:
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> buckets[BUCKETS];
+            std::atomic<uint64_t> sum;
+        };
+        std::unique_ptr<Shard[]> shards;
+};
+
+/**
+ * @brief Record the time from construction to destruction in a Histogram
+ */
+class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram) :
+            histogram(histogram), start(std::chrono::steady_clock::now()) {}
+
+        ~ScopedTimer()
+        {
+            histogram.observe(std::chrono::steady_clock::now() - start);
+        }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& histogram;
+        std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Kinds of metrics
+ */
+enum class Type {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+};
+
+/**
+ * @brief Value of one metric at one point in time
+ */
+struct Sample {
+    /// Metric name, e.g. `arrowhead_http_requests_total`
+    std::string name;
+    /// Prometheus label set without braces, e.g. `result="ok"`, may be empty
+    std::string labels;
+    /// Description of the metric
+    std::string help;
+    /// Kind of the metric
+    Type type;
+    /// Value of a counter or gauge
+    int64_t value;
+    /// Counts of a histogram
+    HistogramSnapshot histogram;
+};
+
+/**
+ * @brief Named metrics
+ *
+ * A metric is identified by its name and label set. Asking for it again
+ * returns the same object, which lives as long as the registry, so callers
+ * keep the reference and record into it without any lookup.
+ *
+ * Thread safe.
+ */
+class Registry {
+    public:
+        /**
+         * @brief The registry the library records its metrics in, created
+         * on first use and never destroyed, so metrics may still be
+         * recorded while static objects are destroyed
+         */
+        static Registry& instance();
+
+        Registry();
+
+        /**
+         * @brief The counter @p name{@p labels}, registered on first use
+         *
+         * @param[in]  name    metric name, by convention ending in `_total`
+         * @param[in]  labels  label set without braces, e.g. `result="ok"`
+         * @param[in]  help    description, the one of the first registration
+         *                     of @p name is used
+         *
+         * @throws Error if @p name is registered as another type
+         */
+        Counter& counter(const std::string& name, const std::string& labels,
+            const std::string& help);
+
+        /**
+         * @brief The gauge @p name{@p labels}, registered on first use
+         *
+         * @throws Error if @p name is registered as another type
+         */
+        Gauge& gauge(const std::string& name, const std::string& labels,
+            const std::string& help);
+
+        /**
+         * @brief The duration histogram @p name{@p labels}, registered on
+         * first use, by convention @p name ends in `_seconds`
+         *
+         * @throws Error if @p name is registered as another type
+         */
+        Histogram& histogram(const std::string& name, const std::string& labels,
+            const std::string& help);
+
+        /**
+         * @brief Current values of all metrics, ordered by name and labels
+         */
+        std::vector<Sample> snapshot() const;
+
+        /**
+         * @brief Current values of all metrics in the Prometheus text
+         * exposition format, version 0.0.4
+         *
+         * Histograms are rendered with buckets at the powers of two
+         * nanoseconds from about 1 µs to about 69 s.
+         */
+        std::string prometheus() const;
+
+        Registry(const Registry&) = delete;
+        Registry& operator=(const Registry&) = delete;
+
+    private:
+        struct Entry {
+            Type type;
+            std::string help;
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Gauge> gauge;
+            std::unique_ptr<Histogram> histogram;
+        };
+
+        Entry& entry(const std::string& name, const std::string& labels,
+            const std::string& help, Type type);
+
+        mutable std::mutex mutex;
+        std::map<std::pair<std::string, std::string>, Entry> entries;
+};
+
+/**
+ * @brief Minimal HTTP server exposing a Registry to Prometheus
+ *
+ * Answers `GET /metrics` with Registry::prometheus() from a background
+ * thread, one connection at a time, and every other request with 404. It
+ * is meant for a scraper on a trusted network, not as a general web server.
+ */
+class Endpoint {
+    public:
+        /**
+         * @brief Start listening
+         *
+         * @param[in]  registry  metrics to serve, must outlive the endpoint
+         * @param[in]  port      TCP port, 0 for any free port, see port()
+         * @param[in]  address   IPv4 address to listen on
+         *
+         * @throws Error if the socket can not be set up
+         */
+        explicit Endpoint(const Registry& registry = Registry::instance(),
+            unsigned short port = 0, const std::string& address = "127.0.0.1");
+
+        /**
+         * @brief Stop listening, waits for the current scrape
+         */
+        ~Endpoint();
+
+        /**
+         * @brief Port the endpoint listens on
+         */
+        unsigned short port() const
+        {
+            return port_;
+        }
+
+        Endpoint(const Endpoint&) = delete;
+        Endpoint& operator=(const Endpoint&) = delete;
+
+    private:
+        void run();
+        void serve(int fd);
+
+        const Registry& registry;
+        int listen_fd;
+        unsigned short port_;
+        std::atomic<bool> stopping;
+        std::thread thread;
+};
+
+/** @} */
+
+} /* namespace Metrics */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_METRICS_HPP_ */
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Error codes and results for the non-throwing API
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_RESULT_HPP_
+#define ARROWHEAD_RESULT_HPP_
+
+#include <cassert>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "arrowhead/config.h"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  exception
+ * @{
+ */
+
+/**
+ * @brief Error categories reported by the non-throwing API
+ */
+enum class Errc {
+    /// No error
+    OK = 0,
+    /// No response could be obtained, Status::detail() is the CURLcode if any
+    TRANSPORT,
+    /// The deadline passed, Status::detail() is the CURLcode if any
+    TIMEOUT,
+    /// The server answered with a non-2xx status, Status::detail() is the status
+    HTTP_STATUS,
+    /// The content could not be parsed
+    CONTENT,
+    /// No codec handles the `Content-Type` of the response
+    UNSUPPORTED_MEDIA_TYPE,
+    /// The request was not sent, the circuit breaker is open
+    CIRCUIT_OPEN,
+    /// The request was not sent, too many requests are in flight
+    OVERLOADED,
+    /// A file could not be opened or mapped
+    IO,
+};
+
+/**
+ * @brief Outcome of an operation, an error code instead of an exception
+ *
+ * A failing Status stores only the error code, a numeric detail and a
+ * pointer to a static context string, the message is formatted by
+ * message() when somebody asks for it. Failing in a tight polling loop
+ * thus costs neither an allocation nor a stack unwind.
+ */
+class Status {
+    public:
+        /**
+         * @brief Success
+         */
+        Status() : code_(Errc::OK), detail_(0), context(NULL) {}
+
+        /**
+         * @brief Failure
+         *
+         * @param[in]  code     error category
+         * @param[in]  detail   CURLcode or HTTP status, depending on @p code
+         * @param[in]  context  static string naming the failing operation
+         */
+        explicit Status(Errc code, long detail = 0, const char *context = NULL) :
+            code_(code), detail_(detail), context(context) {}
+
+        /**
+         * @brief Failure with a message from a lower layer, e.g. a parser
+         *
+         * @param[in]  code     error category
+         * @param[in]  context  static string naming the failing operation
+         * @param[in]  text     description of the error
+         */
+        Status(Errc code, const char *context, std::string text) :
+            code_(code), detail_(0), context(context), text(std::move(text)) {}
+
+        /**
+         * @brief true on success
+         */
+        bool ok() const noexcept
+        {
+            return code_ == Errc::OK;
+        }
+
+        /**
+         * @brief Error category
+         */
+        Errc code() const noexcept
+        {
+            return code_;
+        }
+
+        /**
+         * @brief CURLcode for Errc::TRANSPORT and Errc::TIMEOUT, status code
+         * for Errc::HTTP_STATUS
+         */
+        long detail() const noexcept
+        {
+            return detail_;
+        }
+
+        /**
+         * @brief Human readable description, formatted on every call
+         */
+        std::string message() const;
+
+        /**
+         * @brief Throw the exception the throwing API uses for this error
+         *
+         * Errc::TRANSPORT, Errc::TIMEOUT, Errc::HTTP_STATUS and rejected
+         * requests become TransportError, content errors become
+         * ContentError. In builds without exceptions the message is printed
+         * and the program aborted instead.
+         *
+         * @pre !ok()
+         */
+        [[noreturn]] void raise() const;
+
+    private:
+        Errc code_;
+        long detail_;
+        const char *context;
+        std::string text;
+};
+
+/**
+ * @brief Either a value or the Status of the failure preventing it
+ *
+ * @tparam T  type of the value
+ */
+template<class T>
+class Result {
+    public:
+        /**
+         * @brief Success
+         */
+        Result(const T& value) : value_(value) {}
+
+        /**
+         * @brief Success
+         */
+        Result(T&& value) : value_(std::move(value)) {}
+
+        /**
+         * @brief Failure
+         *
+         * @pre !status.ok()
+         */
+        Result(Status status) : status(std::move(status))
+        {
+            assert(!this->status.ok());
+        }
+
+        /**
+         * @brief true if there is a value
+         */
+        bool has_value() const noexcept
+        {
+            return status.ok();
+        }
+
+        /**
+         * @brief true if there is a value
+         */
+        explicit operator bool() const noexcept
+        {
+            return has_value();
+        }
+
+        /**
+         * @brief The value, Status::raise() if there is none
+         */
+        T& value() &
+        {
+            if (!has_value()) {
+                status.raise();
+            }
+            return *value_;
+        }
+
+        /**
+         * @brief The value, Status::raise() if there is none
+         */
+        const T& value() const &
+        {
+            if (!has_value()) {
+                status.raise();
+            }
+            return *value_;
+        }
+
+        /**
+         * @brief The value, Status::raise() if there is none
+         */
+        T&& value() &&
+        {
+            if (!has_value()) {
+                status.raise();
+            }
+            return std::move(*value_);
+        }
+
+        /**
+         * @brief The value, or @p fallback if there is none
+         */
+        template<class U>
+            T value_or(U&& fallback) const &
+        {
+            return has_value() ? *value_ : static_cast<T>(std::forward<U>(fallback));
+        }
+
+        /**
+         * @brief Status of the operation, ok() if there is a value
+         */
+        const Status& error() const noexcept
+        {
+            return status;
+        }
+
+        /**
+         * @brief The value, undefined if there is none
+         */
+        T& operator*() noexcept
+        {
+            return *value_;
+        }
+
+        /**
+         * @brief The value, undefined if there is none
+         */
+        const T& operator*() const noexcept
+        {
+            return *value_;
+        }
+
+        /**
+         * @brief The value, undefined if there is none
+         */
+        T *operator->() noexcept
+        {
+            return &*value_;
+        }
+
+        /**
+         * @brief The value, undefined if there is none
+         */
+        const T *operator->() const noexcept
+        {
+            return &*value_;
+        }
+
+    private:
+        Status status;
+        std::optional<T> value_;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_RESULT_HPP_ */
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Deadlines and retry policies for requests
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_RETRY_HPP_
+#define ARROWHEAD_RETRY_HPP_
+
+#include <chrono>
+
+#include "arrowhead/config.h"
+#include "arrowhead/result.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  http
+ *
+ * @{
+ */
+
+/**
+ * @brief Point in time by which an operation must be finished
+ *
+ * A default constructed Deadline never expires.
+ */
+class Deadline {
+    public:
+        /// Clock deadlines are measured with
+        typedef std::chrono::steady_clock clock;
+
+        /**
+         * @brief A deadline which never expires
+         */
+        Deadline() : when(clock::time_point::max()) {}
+
+        /**
+         * @brief A deadline at @p when
+         */
+        explicit Deadline(clock::time_point when) : when(when) {}
+
+        /**
+         * @brief A deadline @p timeout from now
+         */
+        static Deadline after(std::chrono::milliseconds timeout)
+        {
+            return Deadline(clock::now() + timeout);
+        }
+
+        /**
+         * @brief false for a deadline which never expires
+         */
+        bool is_set() const
+        {
+            return when != clock::time_point::max();
+        }
+
+        /**
+         * @brief Time left until the deadline, zero if it has passed and
+         * `milliseconds::max()` if it is not set
+         */
+        std::chrono::milliseconds remaining(clock::time_point now = clock::now()) const
+        {
+            if (!is_set()) {
+                return std::chrono::milliseconds::max();
+            }
+            if (now >= when) {
+                return std::chrono::milliseconds(0);
+            }
+            return std::chrono::duration_cast<std::chrono::milliseconds>(when - now);
+        }
+
+        /**
+         * @brief true if the deadline has passed
+         */
+        bool expired(clock::time_point now = clock::now()) const
+        {
+            return now >= when;
+        }
+
+        /**
+         * @brief The point in time of the deadline
+         */
+        clock::time_point time() const
+        {
+            return when;
+        }
+
+        /**
+         * @brief true if @p a expires before @p b
+         */
+        friend bool operator<(const Deadline& a, const Deadline& b)
+        {
+            return a.when < b.when;
+        }
+
+    private:
+        clock::time_point when;
+};
+
+/**
+ * @brief When and how often to repeat a failed request
+ *
+ * Failures which may go away by themselves are retried: transport errors,
+ * timeouts of a single attempt, and the HTTP statuses 408, 429 and 5xx.
+ * Content errors and other statuses are not. Only idempotent requests
+ * (`GET`) are retried unless retry_non_idempotent() is set, since a `POST`
+ * which timed out may well have been processed by the server.
+ *
+ * The pause before attempt n + 1 is drawn uniformly from
+ * [0, min(max_backoff, initial_backoff * 2^(n-1))], i.e. exponential
+ * backoff with full jitter, so that clients failing at the same time do not
+ * retry in lock step. The deadline of the call caps the total time spent on
+ * all attempts and pauses together.
+ */
+class RetryPolicy {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  max_attempts     total number of attempts, 1 disables retries
+         * @param[in]  initial_backoff  upper bound of the first pause
+         * @param[in]  max_backoff      upper bound of any pause
+         */
+        explicit RetryPolicy(unsigned int max_attempts = 1,
+            std::chrono::milliseconds initial_backoff = std::chrono::milliseconds(100),
+            std::chrono::milliseconds max_backoff = std::chrono::milliseconds(5000)) :
+            max_attempts_(max_attempts), initial_backoff(initial_backoff),
+            max_backoff(max_backoff), non_idempotent(false)
+        {}
+
+        /**
+         * @brief Also retry requests which are not idempotent
+         *
+         * Use this if the server handles duplicates of them, e.g. because
+         * publishing the same service twice has no further effect.
+         */
+        RetryPolicy& retry_non_idempotent(bool enable = true)
+        {
+            non_idempotent = enable;
+            return *this;
+        }
+
+        /**
+         * @brief Total number of attempts
+         */
+        unsigned int max_attempts() const
+        {
+            return max_attempts_;
+        }
+
+        /**
+         * @brief Decide whether to try again after attempt number @p attempt failed
+         *
+         * @param[in]  attempt     number of the failed attempt, starting at 1
+         * @param[in]  status      outcome of the failed attempt
+         * @param[in]  idempotent  true if the request may be repeated safely
+         */
+        bool should_retry(unsigned int attempt, const Status& status, bool idempotent) const;
+
+        /**
+         * @brief Randomized pause after attempt number @p attempt failed
+         */
+        std::chrono::milliseconds backoff(unsigned int attempt) const;
+
+    private:
+        unsigned int max_attempts_;
+        std::chrono::milliseconds initial_backoff;
+        std::chrono::milliseconds max_backoff;
+        bool non_idempotent;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_RETRY_HPP_ */
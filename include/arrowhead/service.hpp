@@ -25,8 +25,11 @@
 #ifndef ARROWHEAD_SERVICE_HPP_
 #define ARROWHEAD_SERVICE_HPP_
 
+#include <cstddef>
+#include <iosfwd>
 #include <string>
 #include <map>
+#include <memory_resource>
 
 #include "arrowhead/config.h"
 
@@ -124,8 +127,186 @@ struct ServiceDescription {
     static ServiceDescription from_xml(const char *xmlbuf, size_t buflen);
 
     /** @} */
+
+    /**
+     * @ingroup  cbor
+     * @{
+     */
+
+    /**
+     * @brief Parse a CBOR representation of a single service
+     *
+     * @param[in]    cbor_str  string containing an encoded CBOR map
+     *
+     * @return ServiceDescription object with fields filled from the CBOR content
+     *
+     * @throws ContentError if there are any parsing errors
+     */
+    template<class StringType>
+        static ServiceDescription from_cbor(const StringType& cbor_str);
+
+    /**
+     * @brief Parse a CBOR representation of a single service
+     *
+     * @param[in]    cborbuf  buffer containing an encoded CBOR map
+     * @param[in]    buflen   length of @p cborbuf
+     *
+     * @return ServiceDescription object with fields filled from the CBOR content
+     *
+     * @throws ContentError if there are any parsing errors
+     */
+    static ServiceDescription from_cbor(const char *cborbuf, size_t buflen);
+
+    /** @} */
+};
+
+namespace pmr {
+
+/**
+ * @brief Service information data structure allocated from a memory resource
+ *
+ * Same fields as Arrowhead::ServiceDescription, but all strings and the
+ * property map obtain their storage from the std::pmr::memory_resource given
+ * at construction. This makes it possible to allocate a whole batch of parsed
+ * services from a single arena (e.g. std::pmr::monotonic_buffer_resource) and
+ * release all of it at once by destroying the arena.
+ *
+ * The type is allocator-aware, so containers such as
+ * `std::pmr::vector<pmr::ServiceDescription>` propagate their memory resource
+ * to the elements.
+ */
+struct ServiceDescription {
+    /// Allocator type, used by containers for uses-allocator construction
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    /// Service name, see Arrowhead::ServiceDescription::name
+    std::pmr::string name;
+    /// Service type, see Arrowhead::ServiceDescription::type
+    std::pmr::string type;
+    /// Domain, see Arrowhead::ServiceDescription::domain
+    std::pmr::string domain;
+    /// Host providing the service, see Arrowhead::ServiceDescription::host
+    std::pmr::string host;
+    /// Port (TCP or UDP) where the service is available
+    unsigned int port;
+    /// Additional properties (key-value pairs)
+    std::pmr::map<std::pmr::string, std::pmr::string> properties;
+
+    /**
+     * @brief Construct an empty service description
+     *
+     * @param[in]  alloc  allocator for all member storage
+     */
+    explicit ServiceDescription(const allocator_type& alloc = allocator_type()) :
+        name(alloc), type(alloc), domain(alloc), host(alloc), port(0),
+        properties(alloc)
+    {}
+
+    /**
+     * @brief Copy constructor, optionally using another allocator
+     *
+     * @param[in]  other  service description to copy
+     * @param[in]  alloc  allocator for all member storage
+     */
+    ServiceDescription(const ServiceDescription& other,
+        const allocator_type& alloc = allocator_type()) :
+        name(other.name, alloc), type(other.type, alloc),
+        domain(other.domain, alloc), host(other.host, alloc),
+        port(other.port), properties(other.properties, alloc)
+    {}
+
+    /**
+     * @brief Move constructor, keeps the allocator of @p other
+     */
+    ServiceDescription(ServiceDescription&& other) = default;
+
+    /**
+     * @brief Move constructor using another allocator
+     *
+     * Equivalent to a copy if @p alloc differs from the allocator of @p other
+     *
+     * @param[in]  other  service description to move from
+     * @param[in]  alloc  allocator for all member storage
+     */
+    ServiceDescription(ServiceDescription&& other, const allocator_type& alloc) :
+        name(std::move(other.name), alloc), type(std::move(other.type), alloc),
+        domain(std::move(other.domain), alloc), host(std::move(other.host), alloc),
+        port(other.port), properties(std::move(other.properties), alloc)
+    {}
+
+    /**
+     * @brief Copy the contents of a heap allocated service description
+     *
+     * @param[in]  other  service description to copy
+     * @param[in]  alloc  allocator for all member storage
+     */
+    explicit ServiceDescription(const Arrowhead::ServiceDescription& other,
+        const allocator_type& alloc = allocator_type()) :
+        name(other.name, alloc), type(other.type, alloc),
+        domain(other.domain, alloc), host(other.host, alloc),
+        port(other.port), properties(alloc)
+    {
+        for (auto& kv: other.properties) {
+            properties.emplace(kv.first, kv.second);
+        }
+    }
+
+    ServiceDescription& operator=(const ServiceDescription&) = default;
+    ServiceDescription& operator=(ServiceDescription&&) = default;
+
+    /**
+     * @brief Get the allocator used by this object
+     */
+    allocator_type get_allocator() const
+    {
+        return name.get_allocator();
+    }
+
+    /**
+     * @ingroup  json
+     * @{
+     */
+
+    /**
+     * @brief Parse a JSON representation of a single service
+     *
+     * @param[in]    js_str  string containing a serialized JSON object
+     * @param[in]    mr      memory resource for the returned object
+     *
+     * @return ServiceDescription object with fields filled from the JSON content
+     *
+     * @throws ContentError if there are any parsing errors
+     */
+    template<class StringType>
+        static ServiceDescription from_json(const StringType& js_str,
+            std::pmr::memory_resource *mr);
+
+    /** @} */
+
+    /**
+     * @ingroup  xml
+     * @{
+     */
+
+    /**
+     * @brief Parse an XML representation of a single service
+     *
+     * @param[in]    xmlbuf  XML document C-string containing a `<service>` tag
+     * @param[in]    buflen  length of xmlbuf
+     * @param[in]    mr      memory resource for the returned object
+     *
+     * @return ServiceDescription object with fields filled from the XML content
+     *
+     * @throws ContentError if there are any XML parsing errors
+     */
+    static ServiceDescription from_xml(const char *xmlbuf, size_t buflen,
+        std::pmr::memory_resource *mr);
+
+    /** @} */
 };
 
+} /* namespace pmr */
+
 /**
  * @ingroup  json
  * @{
@@ -162,6 +343,139 @@ template<class OutputIt, class StringType>
 template<class OutputIt>
     OutputIt parse_servicelist_json(OutputIt oit, const char *jsbuf, size_t buflen);
 
+/**
+ * @brief Parse a JSON service list into objects allocated from @p mr
+ *
+ * Every parsed service is a pmr::ServiceDescription whose storage comes from
+ * @p mr. Pair this with a std::pmr::monotonic_buffer_resource and a
+ * `std::pmr::vector<pmr::ServiceDescription>` using the same resource to keep
+ * a whole poll cycle in one arena.
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    js_str  string containing a serialized JSON object
+ * @param[in]    mr      memory resource for the parsed objects
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_json(OutputIt oit, const StringType& js_str,
+        std::pmr::memory_resource *mr);
+
+/**
+ * @brief Parse a JSON service list into objects allocated from @p mr
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    jsbuf   C-string containing a serialized JSON object
+ * @param[in]    buflen  length of @p jsbuf
+ * @param[in]    mr      memory resource for the parsed objects
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_json(OutputIt oit, const char *jsbuf, size_t buflen,
+        std::pmr::memory_resource *mr);
+
+/**
+ * @brief Parse a line delimited JSON (NDJSON) service list and pass the parsed objects to @p oit
+ *
+ * Every non-empty line holds one service object in the same format as
+ * ServiceDescription::from_json(). Unlike a `{"service": [...]}` document, a
+ * line delimited list can be appended to, split at any newline and parsed in
+ * parallel, see parse_servicelist_ndjson_parallel().
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    js_str  string containing one JSON object per line
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_ndjson(OutputIt oit, const StringType& js_str);
+
+/**
+ * @brief Parse a line delimited JSON (NDJSON) service list and pass the parsed objects to @p oit
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    jsbuf   buffer containing one JSON object per line
+ * @param[in]    buflen  length of @p jsbuf
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_ndjson(OutputIt oit, const char *jsbuf, size_t buflen);
+
+/**
+ * @brief Parse a line delimited JSON service list using several threads
+ *
+ * The buffer is split into one chunk per thread at line boundaries, the
+ * services are output in the same order as parse_servicelist_ndjson() would.
+ *
+ * @param[in]    oit      Output iterator where the parsed objects will be placed
+ * @param[in]    jsbuf    buffer containing one JSON object per line
+ * @param[in]    buflen   length of @p jsbuf
+ * @param[in]    threads  number of threads, 0 to use the hardware concurrency
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_ndjson_parallel(OutputIt oit, const char *jsbuf, size_t buflen,
+        unsigned int threads = 0);
+
+/**
+ * @brief Write the services in [first, last) as line delimited JSON to @p os
+ *
+ * @see JSON::LineWriter for writing services one at a time
+ *
+ * @param[in]    os      output stream
+ * @param[in]    first   first service
+ * @param[in]    last    one past the last service
+ */
+template<class InputIt>
+    void write_servicelist_ndjson(std::ostream& os, InputIt first, InputIt last);
+
+/**
+ * @brief Parse a JSON service list file without reading it into memory first
+ *
+ * The file is memory mapped and parsed one service at a time, the document
+ * tree is never built, so neither the file size nor the number of services
+ * affects the peak memory use of the parser.
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    path    file containing a `{"service": [...]}` document
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws Error if the file can not be mapped
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_json_file(OutputIt oit, const std::string& path);
+
+/**
+ * @brief Parse a line delimited JSON service list file in place
+ *
+ * @param[in]    oit      Output iterator where the parsed objects will be placed
+ * @param[in]    path     file containing one JSON object per line
+ * @param[in]    threads  number of threads, 0 to use the hardware concurrency
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws Error if the file can not be mapped
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_ndjson_file(OutputIt oit, const std::string& path,
+        unsigned int threads = 1);
+
 /** @} */
 
 /**
@@ -200,6 +514,110 @@ template<class OutputIt, class StringType>
 template<class OutputIt>
     OutputIt parse_servicelist_xml(OutputIt oit, const char *xmlbuf, size_t buflen);
 
+/**
+ * @brief Parse an XML service list into objects allocated from @p mr
+ *
+ * @see parse_servicelist_json(OutputIt, const StringType&, std::pmr::memory_resource*)
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    xml_str XML document string containing a `<serviceList>` tag
+ * @param[in]    mr      memory resource for the parsed objects
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any XML parsing errors
+ */
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_xml(OutputIt oit, const StringType& xml_str,
+        std::pmr::memory_resource *mr);
+
+/**
+ * @brief Parse an XML service list into objects allocated from @p mr
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    xmlbuf  XML document C-string containing a `<serviceList>` tag
+ * @param[in]    buflen  length of xmlbuf
+ * @param[in]    mr      memory resource for the parsed objects
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any XML parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_xml(OutputIt oit, const char *xmlbuf, size_t buflen,
+        std::pmr::memory_resource *mr);
+
+/**
+ * @brief Parse an XML service list file in place
+ *
+ * The file is mapped copy-on-write and parsed with the in-situ mode of
+ * PugiXML, the strings of the document tree point into the mapping instead of
+ * being copied. Only the pages modified by the parser are duplicated, the
+ * file itself is never written to.
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    path    file containing a `<serviceList>` document
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws Error if the file can not be mapped
+ * @throws ContentError if there are any XML parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_xml_file(OutputIt oit, const std::string& path);
+
+/** @} */
+
+/**
+ * @ingroup  cbor
+ * @{
+ */
+
+/**
+ * @brief Parse a CBOR representation of a service list and pass the parsed objects to @p oit
+ *
+ * The CBOR structure mirrors the JSON format: a map with the key `service`
+ * holding an array of service maps. The properties of each service are
+ * encoded as a plain map from property name to value.
+ *
+ * @param[in]    oit       Output iterator where the parsed objects will be placed
+ * @param[in]    cbor_str  string containing an encoded CBOR map
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt, class StringType>
+    OutputIt parse_servicelist_cbor(OutputIt oit, const StringType& cbor_str);
+
+/**
+ * @brief Parse a CBOR representation of a service list and pass the parsed objects to @p oit
+ *
+ * @param[in]    oit      Output iterator where the parsed objects will be placed
+ * @param[in]    cborbuf  buffer containing an encoded CBOR map
+ * @param[in]    buflen   length of @p cborbuf
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_cbor(OutputIt oit, const char *cborbuf, size_t buflen);
+
+/**
+ * @brief Parse a CBOR service list file in place
+ *
+ * @param[in]    oit     Output iterator where the parsed objects will be placed
+ * @param[in]    path    file containing an encoded CBOR service list
+ *
+ * @return Output iterator after outputting the objects
+ *
+ * @throws Error if the file can not be mapped
+ * @throws ContentError if there are any parsing errors
+ */
+template<class OutputIt>
+    OutputIt parse_servicelist_cbor_file(OutputIt oit, const std::string& path);
+
 /** @} */
 
 /** @} */
@@ -209,5 +627,6 @@ template<class OutputIt>
 /* Template definitions are found in detail/_service_*.hpp */
 #include "arrowhead/detail/_service_json.hpp"
 #include "arrowhead/detail/_service_xml.hpp"
+#include "arrowhead/detail/_service_cbor.hpp"
 
 #endif /* ARROWHEAD_SERVICE_HPP_ */
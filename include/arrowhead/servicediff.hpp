@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service list snapshot comparison
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_SERVICEDIFF_HPP_
+#define ARROWHEAD_SERVICEDIFF_HPP_
+
+#include <vector>
+
+#include "arrowhead/config.h"
+#include "arrowhead/service.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  service
+ *
+ * @{
+ */
+
+/**
+ * @brief Bit flags identifying the fields of a ServiceDescription
+ *
+ * The service name is the identity of a service and is therefore not part of
+ * the change mask.
+ */
+enum ServiceField : unsigned int {
+    SERVICE_FIELD_NONE       = 0,
+    SERVICE_FIELD_TYPE       = (1u << 0),
+    SERVICE_FIELD_DOMAIN     = (1u << 1),
+    SERVICE_FIELD_HOST       = (1u << 2),
+    SERVICE_FIELD_PORT       = (1u << 3),
+    SERVICE_FIELD_PROPERTIES = (1u << 4),
+};
+
+/**
+ * @brief A service which exists in both snapshots but has changed
+ */
+struct ServiceModification {
+    /// The service as it was in the old snapshot
+    const ServiceDescription *old_service;
+    /// The service as it is in the new snapshot
+    const ServiceDescription *new_service;
+    /// Bitwise OR of ServiceField flags for the fields that differ
+    unsigned int changed;
+};
+
+/**
+ * @brief Differences between two service list snapshots
+ *
+ * All pointers refer to elements of the snapshots passed to the diff
+ * function, the snapshots must outlive the diff object.
+ */
+struct ServiceListDiff {
+    /// Services only present in the new snapshot, in new snapshot order
+    std::vector<const ServiceDescription *> added;
+    /// Services only present in the old snapshot, in old snapshot order
+    std::vector<const ServiceDescription *> removed;
+    /// Services present in both snapshots with at least one differing field
+    std::vector<ServiceModification> modified;
+
+    /**
+     * @brief Check whether the snapshots were equivalent
+     *
+     * @return true if nothing was added, removed or modified
+     */
+    bool empty() const
+    {
+        return added.empty() && removed.empty() && modified.empty();
+    }
+};
+
+/**
+ * @brief Compare all fields except the name of two service descriptions
+ *
+ * @param[in]  a  first service
+ * @param[in]  b  second service
+ *
+ * @return Bitwise OR of ServiceField flags for the fields that differ,
+ *         SERVICE_FIELD_NONE if the services are equal
+ */
+unsigned int compare_services(const ServiceDescription& a, const ServiceDescription& b);
+
+/**
+ * @brief Compute the differences between two service list snapshots
+ *
+ * Services are matched by name using a hash table, so the snapshots may be in
+ * any order. Runs in O(n + m) expected time. Service names are expected to be
+ * unique within each snapshot.
+ *
+ * @param[in]  old_list  previous snapshot
+ * @param[in]  new_list  current snapshot
+ *
+ * @return the added, removed and modified services
+ */
+ServiceListDiff diff_servicelists(const std::vector<ServiceDescription>& old_list,
+    const std::vector<ServiceDescription>& new_list);
+
+/**
+ * @brief Compute the differences between two snapshots sorted by name
+ *
+ * Same as diff_servicelists(), but matches the services with a single merge
+ * pass and no auxiliary hash table. Both snapshots must be sorted by
+ * ServiceDescription::name in ascending order, see sort_servicelist().
+ *
+ * @param[in]  old_list  previous snapshot, sorted by name
+ * @param[in]  new_list  current snapshot, sorted by name
+ *
+ * @return the added, removed and modified services
+ */
+ServiceListDiff diff_sorted_servicelists(const std::vector<ServiceDescription>& old_list,
+    const std::vector<ServiceDescription>& new_list);
+
+/**
+ * @brief Sort a service list by name, in preparation for diff_sorted_servicelists()
+ *
+ * @param[in,out]  list  service list to sort
+ */
+void sort_servicelist(std::vector<ServiceDescription>& list);
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_SERVICEDIFF_HPP_ */
@@ -0,0 +1,294 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       In-memory multi-key service index
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_SERVICEINDEX_HPP_
+#define ARROWHEAD_SERVICEINDEX_HPP_
+
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "arrowhead/config.h"
+#include "arrowhead/dnssd.hpp"
+#include "arrowhead/service.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  service
+ *
+ * @{
+ */
+
+/**
+ * @brief Compound query against a ServiceIndex
+ *
+ * All criteria that have been set must match (logical AND). A query without
+ * any criteria matches every service in the index.
+ */
+class ServiceQuery {
+    public:
+        /**
+         * @brief Match only services of the given type
+         */
+        ServiceQuery& type(const std::string& value)
+        {
+            type_ = value;
+            has_type = true;
+            return *this;
+        }
+
+        /**
+         * @brief Match only services in the given domain
+         */
+        ServiceQuery& domain(const std::string& value)
+        {
+            domain_ = value;
+            has_domain = true;
+            return *this;
+        }
+
+        /**
+         * @brief Match only services provided by the given host
+         */
+        ServiceQuery& host(const std::string& value)
+        {
+            host_ = value;
+            has_host = true;
+            return *this;
+        }
+
+        /**
+         * @brief Match only services where property @p name equals @p value
+         *
+         * May be given several times, all properties must match.
+         */
+        ServiceQuery& property(const std::string& name, const std::string& value)
+        {
+            properties_.emplace_back(name, value);
+            return *this;
+        }
+
+    private:
+        friend class ServiceIndex;
+
+        std::string type_;
+        std::string domain_;
+        std::string host_;
+        std::vector<std::pair<std::string, std::string> > properties_;
+        bool has_type = false;
+        bool has_domain = false;
+        bool has_host = false;
+};
+
+/**
+ * @brief Container of services with hash indexes on the most queried fields
+ *
+ * Services are keyed by name, inserting a service with an existing name
+ * replaces the old entry. Secondary hash indexes are kept on type, host and
+ * domain, and an inverted index on property name/value pairs. Lookups by name
+ * are O(1), lookups by a single key are O(k) in the number of results and
+ * compound queries are O(k) in the size of the most selective criterion.
+ *
+ * The DNS-SD decomposition of a service is computed once, when it is first
+ * asked for, see name_components().
+ *
+ * Pointers returned by the lookup methods remain valid until the service is
+ * erased or replaced. Moving an index keeps them valid, a copy has indexes
+ * of its own, pointing into its own services.
+ */
+class ServiceIndex {
+    public:
+        /// Result set of a lookup
+        typedef std::vector<const ServiceDescription *> result_type;
+
+        ServiceIndex() = default;
+
+        /**
+         * @brief Take over the services of @p other, pointers into it stay valid
+         */
+        ServiceIndex(ServiceIndex&& other);
+
+        /**
+         * @brief Take over the services of @p other, pointers into it stay valid
+         */
+        ServiceIndex& operator=(ServiceIndex&& other);
+
+        /**
+         * @brief Copy the services of @p other and index them anew
+         */
+        ServiceIndex(const ServiceIndex& other);
+
+        /**
+         * @brief Replace the contents with a copy of those of @p other
+         */
+        ServiceIndex& operator=(const ServiceIndex& other);
+
+        /**
+         * @brief Insert a service, replacing any existing service with the same name
+         *
+         * @param[in]  sd  service to insert
+         *
+         * @return pointer to the stored service
+         */
+        const ServiceDescription *insert(ServiceDescription sd);
+
+        /**
+         * @brief Insert all services in the range [first, last)
+         */
+        template<class InputIt>
+            void insert(InputIt first, InputIt last)
+        {
+            for (; first != last; ++first) {
+                insert(*first);
+            }
+        }
+
+        /**
+         * @brief Remove the service with the given name
+         *
+         * @param[in]  name  service name
+         *
+         * @return true if a service was removed
+         */
+        bool erase(const std::string& name);
+
+        /**
+         * @brief Remove all services
+         */
+        void clear();
+
+        /**
+         * @brief Number of services in the index
+         */
+        size_t size() const
+        {
+            return services.size();
+        }
+
+        /**
+         * @brief Check whether the index is empty
+         */
+        bool empty() const
+        {
+            return services.empty();
+        }
+
+        /**
+         * @brief Find a service by name
+         *
+         * @param[in]  name  service name
+         *
+         * @return pointer to the service, or NULL if not found
+         */
+        const ServiceDescription *find(const std::string& name) const;
+
+        /**
+         * @brief All services of the given type
+         */
+        result_type find_by_type(const std::string& type) const;
+
+        /**
+         * @brief All services in the given domain
+         */
+        result_type find_by_domain(const std::string& domain) const;
+
+        /**
+         * @brief All services provided by the given host
+         */
+        result_type find_by_host(const std::string& host) const;
+
+        /**
+         * @brief All services where property @p name has the value @p value
+         */
+        result_type find_by_property(const std::string& name, const std::string& value) const;
+
+        /**
+         * @brief All services matching every criterion in @p query
+         */
+        result_type select(const ServiceQuery& query) const;
+
+        /**
+         * @brief The DNS-SD decomposition of a service in the index
+         *
+         * The components are computed on the first call for @p sd and kept
+         * until the service is erased or replaced. Safe to call concurrently
+         * with the other const methods.
+         *
+         * @param[in]  sd  service returned by a lookup in this index, and not
+         *                 erased or replaced since, or any other service
+         *
+         * @return the components of @p sd, or NULL if @p sd is NULL or not
+         *         in the index
+         */
+        const ServiceNameComponents *name_components(const ServiceDescription *sd) const;
+
+    private:
+        /// Set of services sharing a key
+        typedef std::unordered_set<const ServiceDescription *> postings_type;
+        /// Hash index from a field value to the services having that value
+        typedef std::unordered_map<std::string, postings_type> key_index_type;
+
+        /**
+         * @internal
+         * @brief Add @p sd to all secondary indexes
+         */
+        void index(const ServiceDescription *sd);
+
+        /**
+         * @internal
+         * @brief Remove @p sd from all secondary indexes
+         */
+        void unindex(const ServiceDescription *sd);
+
+        /**
+         * @internal
+         * @brief Find the postings for the given property name/value pair
+         *
+         * @return pointer to the postings, or NULL if there are none
+         */
+        const postings_type *property_postings(const std::string& name,
+            const std::string& value) const;
+
+        /// Primary storage, keyed by name. Node based, so element addresses are stable
+        std::unordered_map<std::string, ServiceDescription> services;
+        key_index_type by_type;
+        key_index_type by_domain;
+        key_index_type by_host;
+        /// Inverted index: property name -> property value -> services
+        std::unordered_map<std::string, key_index_type> by_property;
+        /// Decomposed names of the services, filled in by name_components()
+        mutable std::unordered_map<const ServiceDescription *, ServiceNameComponents> components;
+        /// Guards @ref components against concurrent name_components() calls
+        mutable std::mutex components_mutex;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_SERVICEINDEX_HPP_ */
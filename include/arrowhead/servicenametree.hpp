@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Radix tree index over DNS-SD service names
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_SERVICENAMETREE_HPP_
+#define ARROWHEAD_SERVICENAMETREE_HPP_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arrowhead/config.h"
+#include "arrowhead/service.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  service
+ *
+ * @{
+ */
+
+/**
+ * @brief Prefix, suffix and wildcard search over ServiceDescription::name
+ *
+ * The names are kept in two compressed radix trees: one keyed by the name as
+ * is, for instance prefix queries, and one keyed by the name with its labels
+ * in reverse order (`a.b.c.` is stored as `c.b.a.`), for domain suffix
+ * queries. Both queries run in time proportional to the length of the query
+ * plus the number of results.
+ *
+ * Names are domain names with an optional trailing dot, `a.b` and `a.b.` are
+ * the same name. Inserting one replaces a service inserted as the other.
+ *
+ * The tree stores pointers to the inserted services, the services must
+ * outlive the tree or be erased from it before they are destroyed.
+ */
+class ServiceNameTree {
+    public:
+        /// Result set of a lookup
+        typedef std::vector<const ServiceDescription *> result_type;
+
+        ServiceNameTree();
+        ~ServiceNameTree();
+
+        ServiceNameTree(ServiceNameTree&&);
+        ServiceNameTree& operator=(ServiceNameTree&&);
+
+        // Disable copying, the tree holds pointers into the caller's containers
+        ServiceNameTree(ServiceNameTree const&) = delete;
+        ServiceNameTree& operator=(ServiceNameTree const&) = delete;
+
+        /**
+         * @brief Add a service, replacing any service with the same name
+         *
+         * @param[in]  sd  service to add, must outlive the tree
+         */
+        void insert(const ServiceDescription& sd);
+
+        /**
+         * @brief Add all services in the range [first, last)
+         */
+        template<class InputIt>
+            void insert(InputIt first, InputIt last)
+        {
+            for (; first != last; ++first) {
+                insert(*first);
+            }
+        }
+
+        /**
+         * @brief Remove the service with the given name
+         *
+         * @param[in]  name  service name
+         *
+         * @return true if a service was removed
+         */
+        bool erase(const std::string& name);
+
+        /**
+         * @brief Remove all services
+         */
+        void clear();
+
+        /**
+         * @brief Number of services in the tree
+         */
+        size_t size() const
+        {
+            return count;
+        }
+
+        /**
+         * @brief Find a service by its exact name, the trailing dot is optional
+         *
+         * @return pointer to the service, or NULL if not found
+         */
+        const ServiceDescription *find(const std::string& name) const;
+
+        /**
+         * @brief All services whose name starts with @p prefix
+         *
+         * e.g. `orchestration-` matches `orchestration-mgmt._orch-m-ws-http._tcp.srv.arrowhead.ltu.se.`
+         */
+        result_type find_prefix(const std::string& prefix) const;
+
+        /**
+         * @brief All services whose name ends with the labels in @p suffix
+         *
+         * The match is label aligned, `ltu.se.` matches `x.arrowhead.ltu.se.`
+         * but not `x.altu.se.`. A trailing dot in @p suffix is optional.
+         */
+        result_type find_suffix(const std::string& suffix) const;
+
+        /**
+         * @brief All services whose name matches a label-wise wildcard pattern
+         *
+         * A label consisting of only `*` matches exactly one non-empty label,
+         * all other labels must match exactly, e.g.
+         * `*._orch-m-ws-http._tcp.srv.*.ltu.se.`
+         *
+         * The trailing dot of @p pattern is optional. Patterns ending in a
+         * literal label are evaluated against the reversed tree if that
+         * gives a longer literal lead-in.
+         */
+        result_type match(const std::string& pattern) const;
+
+        /**
+         * @brief Reverse the order of the labels in a domain name
+         *
+         * `a.b.c.` and `a.b.c` both become `c.b.a.`
+         *
+         * @param[in]  name  domain name
+         *
+         * @return the reversed name, always with a trailing dot
+         */
+        static std::string reverse_labels(const std::string& name);
+
+        /**
+         * @internal
+         * @brief Radix tree node, defined in servicenametree.cpp
+         */
+        struct Node;
+
+    private:
+        std::unique_ptr<Node> forward;
+        std::unique_ptr<Node> reversed;
+        size_t count;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_SERVICENAMETREE_HPP_ */
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Compile time field table of ServiceDescription
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_SERVICESCHEMA_HPP_
+#define ARROWHEAD_SERVICESCHEMA_HPP_
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "arrowhead/config.h"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  service
+ *
+ * @{
+ */
+
+/**
+ * @brief Field table shared by all service parsers and serializers
+ *
+ * Every codec maps the same set of keys to the members of
+ * ServiceDescription (and pmr::ServiceDescription). The keys and member
+ * pointers are listed once here; codecs iterate the table with
+ * for_each_field() when serializing and look up incoming keys with
+ * visit_field() when parsing. Both are expanded at compile time, the key
+ * lookup is a perfect hash on the key length and first byte followed by a
+ * single comparison.
+ *
+ * To add a field, add its key to @ref keys and its member pointer to
+ * members() at the same position, then give every codec a value reader and
+ * writer for the member type if it does not already have one.
+ */
+namespace Schema {
+
+/// Keys of the serialized fields, in serialization order
+inline constexpr std::string_view keys[] = {
+    "name",
+    "type",
+    "domain",
+    "host",
+    "port",
+    "properties",
+};
+
+/// Number of fields
+inline constexpr size_t FIELD_COUNT = sizeof(keys) / sizeof(keys[0]);
+
+/// Bit mask with the bit of every field set, see visit_field()
+inline constexpr unsigned int ALL_FIELDS = (1u << FIELD_COUNT) - 1;
+
+/**
+ * @brief Member pointers of the fields, in the same order as @ref keys
+ *
+ * @tparam Service  ServiceDescription or pmr::ServiceDescription
+ */
+template<class Service>
+    constexpr auto members()
+{
+    return std::make_tuple(
+        &Service::name,
+        &Service::type,
+        &Service::domain,
+        &Service::host,
+        &Service::port,
+        &Service::properties);
+}
+
+/**
+ * @internal
+ * @brief Number of slots in the key hash table, a power of two
+ */
+inline constexpr size_t HASH_SIZE = 16;
+
+/**
+ * @internal
+ * @brief Hash of a key, computed from its length and first byte only
+ */
+constexpr size_t key_hash(const char *key, size_t len)
+{
+    return (len == 0) ? 0 :
+        (static_cast<unsigned char>(key[0]) + len * 7) & (HASH_SIZE - 1);
+}
+
+/**
+ * @internal
+ * @brief Key hash table, slot to field index or -1 for empty slots
+ */
+struct HashTable {
+    signed char slot[HASH_SIZE];
+};
+
+/**
+ * @internal
+ * @brief Build the key hash table, see @ref key_table
+ */
+constexpr HashTable make_key_table()
+{
+    HashTable table{};
+    for (size_t i = 0; i < HASH_SIZE; ++i) {
+        table.slot[i] = -1;
+    }
+    for (size_t i = 0; i < FIELD_COUNT; ++i) {
+        table.slot[key_hash(keys[i].data(), keys[i].size())] = static_cast<signed char>(i);
+    }
+    return table;
+}
+
+/**
+ * @internal
+ * @brief Check that no two keys share a hash table slot
+ */
+constexpr bool key_hash_is_perfect()
+{
+    for (size_t i = 0; i < FIELD_COUNT; ++i) {
+        for (size_t k = i + 1; k < FIELD_COUNT; ++k) {
+            if (key_hash(keys[i].data(), keys[i].size()) ==
+                key_hash(keys[k].data(), keys[k].size())) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(key_hash_is_perfect(),
+    "Schema::key_hash has collisions, change the multiplier or HASH_SIZE");
+
+/**
+ * @internal
+ * @brief Key hash table, computed at compile time
+ */
+inline constexpr HashTable key_table = make_key_table();
+
+/**
+ * @brief Look up the field index of a key
+ *
+ * @param[in]  key  key, not necessarily NUL terminated
+ * @param[in]  len  length of @p key
+ *
+ * @return index into @ref keys, or -1 if @p key is not a field
+ */
+inline int field_index(const char *key, size_t len)
+{
+    int index = key_table.slot[key_hash(key, len)];
+    if (index < 0 || keys[index].size() != len ||
+        std::memcmp(keys[index].data(), key, len) != 0) {
+        return -1;
+    }
+    return index;
+}
+
+/**
+ * @internal
+ * @brief Call @p visit for the field with the given index, see visit_field()
+ */
+template<class Service, class Visitor, size_t... I>
+    void dispatch_field(Service& sd, int index, Visitor& visit, std::index_sequence<I...>)
+{
+    constexpr auto m = members<typename std::remove_const<Service>::type>();
+    /* Expands to a chain of comparisons which compilers turn into a jump table */
+    (void)((index == static_cast<int>(I) ?
+        (visit(keys[I], sd.*std::get<I>(m)), true) : false) || ...);
+}
+
+/**
+ * @internal
+ * @brief Call @p visit for every field, see for_each_field()
+ */
+template<class Service, class Visitor, size_t... I>
+    void visit_all_fields(Service& sd, Visitor& visit, std::index_sequence<I...>)
+{
+    constexpr auto m = members<typename std::remove_const<Service>::type>();
+    static_assert(std::tuple_size<decltype(m)>::value == FIELD_COUNT,
+        "Schema::keys and Schema::members() must list the same fields");
+    (visit(keys[I], sd.*std::get<I>(m)), ...);
+}
+
+/**
+ * @brief Call `visit(key, member)` for every field of @p sd, in key order
+ *
+ * @p visit is typically a generic lambda dispatching on the member type to
+ * overloaded writer functions. The members are const if @p sd is const.
+ *
+ * @param[in]  sd     service to visit
+ * @param[in]  visit  visitor
+ */
+template<class Service, class Visitor>
+    void for_each_field(Service& sd, Visitor&& visit)
+{
+    visit_all_fields(sd, visit, std::make_index_sequence<FIELD_COUNT>());
+}
+
+/**
+ * @brief Call `visit(key, member)` for the field of @p sd named @p key
+ *
+ * @param[in]  sd     service to visit
+ * @param[in]  key    key, not necessarily NUL terminated
+ * @param[in]  len    length of @p key
+ * @param[in]  visit  visitor
+ *
+ * @return index of the field, -1 if @p key is not a field and @p visit was
+ *         not called. Callers which require every field can collect
+ *         `1u << index` and compare with @ref ALL_FIELDS.
+ */
+template<class Service, class Visitor>
+    int visit_field(Service& sd, const char *key, size_t len, Visitor&& visit)
+{
+    int index = field_index(key, len);
+    if (index >= 0) {
+        dispatch_field(sd, index, visit, std::make_index_sequence<FIELD_COUNT>());
+    }
+    return index;
+}
+
+} /* namespace Schema */
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_SERVICESCHEMA_HPP_ */
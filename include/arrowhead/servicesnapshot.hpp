@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Memory mappable binary service list snapshots
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_SERVICESNAPSHOT_HPP_
+#define ARROWHEAD_SERVICESNAPSHOT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "arrowhead/config.h"
+#include "arrowhead/mappedfile.hpp"
+#include "arrowhead/service.hpp"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  service
+ *
+ * @{
+ */
+
+/**
+ * @brief Read-only service list mapped from a binary snapshot file
+ *
+ * A snapshot stores a service list in a versioned, checksummed binary format
+ * designed to be used in place: all strings are stored once in a string pool
+ * and referenced by offset, and sorted indexes on name, type and host are
+ * prebuilt by the writer. Opening a snapshot maps the file read-only and
+ * validates the header, the checksum and all offsets, after which lookups read
+ * directly from the mapping without any parse step.
+ *
+ * Snapshots are written with write(), which replaces the file atomically, so
+ * readers never observe a partially written snapshot. Use SnapshotCache to keep
+ * a mapping up to date while another thread refreshes the file.
+ *
+ * The format uses host byte order, a snapshot written on a host of different
+ * endianness is rejected when opened.
+ */
+class ServiceSnapshot {
+    public:
+        /// Current version of the file format
+        static const uint32_t FORMAT_VERSION = 1;
+
+        /**
+         * @brief Lightweight reference to one service in a snapshot
+         *
+         * Views are valid as long as the snapshot they came from is alive.
+         */
+        class View {
+            public:
+                std::string_view name() const;
+                std::string_view type() const;
+                std::string_view domain() const;
+                std::string_view host() const;
+                unsigned int port() const;
+
+                /**
+                 * @brief Number of properties of the service
+                 */
+                size_t property_count() const;
+
+                /**
+                 * @brief Get a property by position, properties are sorted by name
+                 *
+                 * @param[in]  i  position, must be less than property_count()
+                 *
+                 * @return (name, value) pair
+                 */
+                std::pair<std::string_view, std::string_view> property(size_t i) const;
+
+                /**
+                 * @brief Look up a property value by name
+                 *
+                 * @param[in]  name  property name
+                 *
+                 * @return the value, or nothing if the service has no such property
+                 */
+                std::optional<std::string_view> property(std::string_view name) const;
+
+                /**
+                 * @brief Copy the service out of the snapshot
+                 */
+                ServiceDescription to_service() const;
+
+            private:
+                friend class ServiceSnapshot;
+
+                View(const ServiceSnapshot *snap, uint32_t index) :
+                    snap(snap), index(index) {}
+
+                const ServiceSnapshot *snap;
+                uint32_t index;
+        };
+
+        /// Result set of a lookup
+        typedef std::vector<View> result_type;
+
+        /**
+         * @brief Construct an empty snapshot
+         */
+        ServiceSnapshot();
+
+        /**
+         * @brief Map a snapshot file
+         *
+         * @param[in]  path            snapshot file
+         * @param[in]  verify_checksum verify the checksum of the whole file,
+         *                             this reads every page of the file once
+         *
+         * @throws Error if the file can not be mapped
+         * @throws ContentError if the file is not a valid snapshot
+         */
+        explicit ServiceSnapshot(const std::string& path, bool verify_checksum = true);
+
+        /**
+         * @brief Map a snapshot file in place of the current one, without throwing
+         *
+         * @param[in]  path            snapshot file
+         * @param[in]  verify_checksum verify the checksum of the whole file
+         *
+         * @return Errc::IO if the file can not be mapped, Errc::CONTENT if
+         *         it is not a valid snapshot, the snapshot is empty then
+         */
+        Status open(const std::string& path, bool verify_checksum = true);
+
+        ServiceSnapshot(ServiceSnapshot&& other) noexcept;
+        ServiceSnapshot& operator=(ServiceSnapshot&& other) noexcept;
+        ServiceSnapshot(const ServiceSnapshot&) = delete;
+        ServiceSnapshot& operator=(const ServiceSnapshot&) = delete;
+        ~ServiceSnapshot();
+
+        /**
+         * @brief Build the snapshot image of the services in [first, last)
+         *
+         * @return the complete file contents
+         */
+        template<class InputIt>
+            static std::string serialize(InputIt first, InputIt last)
+        {
+            std::vector<const ServiceDescription *> services;
+            for (; first != last; ++first) {
+                services.push_back(&*first);
+            }
+            return serialize(services);
+        }
+
+        /**
+         * @brief Build the snapshot image of a list of services
+         *
+         * @return the complete file contents
+         */
+        static std::string serialize(const std::vector<const ServiceDescription *>& services);
+
+        /**
+         * @brief Atomically replace @p path with a snapshot of [first, last)
+         *
+         * The image is written to a temporary file in the same directory,
+         * flushed to disk and renamed over @p path. Existing mappings of the old
+         * file remain valid.
+         *
+         * @throws Error if the file can not be written
+         */
+        template<class InputIt>
+            static void write(const std::string& path, InputIt first, InputIt last)
+        {
+            write_file(path, serialize(first, last));
+        }
+
+        /**
+         * @brief Atomically replace @p path with the given snapshot image
+         *
+         * @param[in]  path   destination file
+         * @param[in]  image  output of serialize()
+         *
+         * @throws Error if the file can not be written
+         */
+        static void write_file(const std::string& path, const std::string& image);
+
+        /**
+         * @brief Number of services in the snapshot
+         */
+        size_t size() const
+        {
+            return service_count;
+        }
+
+        /**
+         * @brief Check whether the snapshot is empty
+         */
+        bool empty() const
+        {
+            return service_count == 0;
+        }
+
+        /**
+         * @brief Get a service by position
+         *
+         * @param[in]  i  position, must be less than size()
+         */
+        View operator[](size_t i) const
+        {
+            return View(this, static_cast<uint32_t>(i));
+        }
+
+        /**
+         * @brief Find a service by name, O(log n)
+         *
+         * @param[in]  name  service name
+         *
+         * @return the service, or nothing if not found
+         */
+        std::optional<View> find(std::string_view name) const;
+
+        /**
+         * @brief All services of the given type, O(log n + k)
+         */
+        result_type find_by_type(std::string_view type) const;
+
+        /**
+         * @brief All services provided by the given host, O(log n + k)
+         */
+        result_type find_by_host(std::string_view host) const;
+
+        /**
+         * @brief Copy all services out of the snapshot
+         *
+         * @param[in]  oit  Output iterator where the services will be placed
+         *
+         * @return Output iterator after outputting the services
+         */
+        template<class OutputIt>
+            OutputIt copy(OutputIt oit) const
+        {
+            for (size_t i = 0; i < size(); ++i) {
+                *oit++ = (*this)[i].to_service();
+            }
+            return oit;
+        }
+
+    private:
+        /**
+         * @internal
+         * @brief Look up all services with the given key in a sorted index
+         *
+         * @param[in]  index_offset  file offset of the index
+         * @param[in]  field         which string field the index is sorted on
+         * @param[in]  key           key to look up
+         */
+        result_type lookup(uint64_t index_offset, size_t field, std::string_view key) const;
+
+        /**
+         * @internal
+         * @brief Check all offsets in the mapped file
+         *
+         * @return Errc::CONTENT if anything points outside the file
+         */
+        Status validate(bool verify_checksum) const;
+
+        MappedFile file;
+        /// Start of the mapping, NULL for an empty snapshot
+        const char *base;
+        uint32_t service_count;
+};
+
+/**
+ * @brief Shared, reloadable mapping of a snapshot file
+ *
+ * Readers call current() to get the snapshot to use for a batch of lookups.
+ * A background refresh fetches the service list from the registry and calls
+ * update(), which atomically replaces the file and swaps in the new mapping.
+ * Readers still holding the previous snapshot keep using it until they
+ * release it. All methods are safe to call concurrently.
+ */
+class SnapshotCache {
+    public:
+        /**
+         * @brief Create a cache for the snapshot at @p path
+         *
+         * The file is mapped if it exists and is valid, otherwise the cache
+         * starts out with an empty snapshot.
+         *
+         * @param[in]  path  snapshot file
+         */
+        explicit SnapshotCache(const std::string& path);
+
+        /**
+         * @brief Get the current snapshot
+         */
+        std::shared_ptr<const ServiceSnapshot> current() const;
+
+        /**
+         * @brief Remap the file if it has been replaced since it was mapped
+         *
+         * @return true if a new snapshot was mapped
+         *
+         * @throws Error, ContentError if the new file can not be mapped, the
+         *         current snapshot is kept in that case
+         */
+        bool reload();
+
+        /**
+         * @brief Remap the file if it has been replaced, without throwing
+         *
+         * @see reload()
+         *
+         * @return true if a new snapshot was mapped, Errc::IO or
+         *         Errc::CONTENT if the new file can not be mapped
+         */
+        Result<bool> try_reload();
+
+        /**
+         * @brief Write a new snapshot of [first, last) and switch to it
+         *
+         * @throws Error if the file can not be written
+         */
+        template<class InputIt>
+            void update(InputIt first, InputIt last)
+        {
+            ServiceSnapshot::write(path, first, last);
+            reload();
+        }
+
+    private:
+        std::string path;
+        /// Accessed with std::atomic_load/std::atomic_store
+        std::shared_ptr<const ServiceSnapshot> snapshot;
+        /// Serializes reload()
+        std::mutex reload_lock;
+        /// Identity (device, inode, mtime, size) of the mapped file
+        uint64_t file_id[4];
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_SERVICESNAPSHOT_HPP_ */
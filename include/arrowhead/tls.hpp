@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       TLS configuration and handshake statistics of the HTTPS transports
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TLS_HPP_
+#define ARROWHEAD_TLS_HPP_
+
+#include <cstdint>
+#include <string>
+
+#include "arrowhead/config.h"
+
+namespace Arrowhead {
+
+/**
+ * @ingroup  http
+ *
+ * @{
+ */
+
+/**
+ * @brief TLS settings of a transport, used for `https://` URLs
+ *
+ * Empty paths leave the libcurl defaults in place, i.e. the system CA
+ * bundle and no client certificate.
+ */
+struct TLSOptions {
+    TLSOptions() : verify_peer(true), verify_host(true), session_resumption(true) {}
+
+    /// CA certificates (PEM file) trusted to sign the server certificate
+    std::string ca_file;
+    /// Directory of CA certificates trusted to sign the server certificate
+    std::string ca_path;
+    /// Client certificate (PEM file) for mutual TLS
+    std::string client_cert;
+    /// Private key (PEM file) of the client certificate
+    std::string client_key;
+    /// Passphrase of the private key, empty if it is not encrypted
+    std::string key_password;
+    /// Verify the certificate chain of the server, disable for testing only
+    bool verify_peer;
+    /// Verify that the server certificate names the host of the URL
+    bool verify_host;
+    /// Resume earlier TLS sessions to skip the full handshake on new connections
+    bool session_resumption;
+};
+
+/**
+ * @brief Process wide counters of the TLS connections made by the transports
+ *
+ * A request which reuses an open connection makes no handshake at all. A
+ * new connection either resumes an earlier session, which saves a round
+ * trip and the public key operations, or makes a full handshake.
+ */
+struct TLSStats {
+    /// New connections with a full handshake
+    uint64_t full_handshakes;
+    /// New connections resuming an earlier session
+    uint64_t resumed_handshakes;
+    /// Requests served on an already established TLS connection
+    uint64_t reused_connections;
+};
+
+#if ARROWHEAD_USE_LIBCURL
+/**
+ * @brief Counters of the TLS connections made so far
+ *
+ * Resumed handshakes are only told apart from full ones with
+ * ARROWHEAD_USE_OPENSSL and a libcurl using OpenSSL, otherwise every
+ * handshake counts as full.
+ */
+TLSStats tls_stats();
+#endif
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_TLS_HPP_ */
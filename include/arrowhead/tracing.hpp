@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Tracing spans of the library's operations, written as Chrome trace events
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TRACING_HPP_
+#define ARROWHEAD_TRACING_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_TRACING
+
+/**
+ * @ingroup  tracing
+ *
+ * @{
+ */
+
+/* macros instrumenting the library, compiled out without ARROWHEAD_USE_TRACING */
+
+/**
+ * @brief  Open the span @p var, named @p name, a child of the current span
+ */
+#define ARROWHEAD_LIB_SPAN(var, name) \
+    ::Arrowhead::Tracing::Span var(name)
+
+/**
+ * @brief  Open the span @p var, named @p name, a child of the span @p parent
+ *
+ * For work continuing in another thread or callback, with @p parent taken
+ * from Tracing::current() where the work was started.
+ */
+#define ARROWHEAD_LIB_SPAN_CHILD(var, name, parent) \
+    ::Arrowhead::Tracing::Span var((name), (parent))
+
+/**
+ * @brief  Attach the number @p value to the span @p var as @p key
+ */
+#define ARROWHEAD_LIB_SPAN_ARG(var, key, value) \
+    (var).arg((key), static_cast<int64_t>(value))
+
+/** @} */
+
+#else /* ARROWHEAD_USE_TRACING */
+
+/* stub macros */
+#define ARROWHEAD_LIB_SPAN(var, name)
+#define ARROWHEAD_LIB_SPAN_CHILD(var, name, parent)
+#define ARROWHEAD_LIB_SPAN_ARG(var, key, value)
+
+#endif /* ARROWHEAD_USE_TRACING */
+
+namespace Arrowhead {
+
+namespace Tracing {
+
+/**
+ * @ingroup  tracing
+ *
+ * @{
+ */
+
+/// Clock of the span timestamps
+typedef std::chrono::steady_clock Clock;
+
+/**
+ * @brief Identity of a span, to make it the parent of spans elsewhere
+ *
+ * A span without a parent starts a trace, its descendants inherit the
+ * trace ID. Zero IDs denote no span.
+ */
+struct SpanContext {
+    /// ID of the root span of the trace
+    uint64_t trace_id;
+    /// ID of the span
+    uint64_t span_id;
+
+    /**
+     * @brief true if this is a span, not the empty context
+     */
+    bool valid() const
+    {
+        return span_id != 0;
+    }
+};
+
+/**
+ * @internal
+ * @brief Numeric argument of a span
+ */
+struct SpanArg {
+    const char *key;
+    int64_t value;
+};
+
+/**
+ * @internal
+ * @brief Whether a TraceFile is open, read without a lock by every span
+ */
+extern std::atomic<bool> tracing_enabled;
+
+/**
+ * @internal
+ * @brief Innermost open span of the calling thread
+ *
+ * Constant initialized, so reading it needs no initialization check.
+ */
+extern thread_local SpanContext current_span;
+
+/**
+ * @brief true if spans are recorded
+ *
+ * A relaxed atomic load, the whole cost of a span while tracing is off.
+ */
+inline bool enabled()
+{
+    return tracing_enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief The innermost open span of the calling thread
+ *
+ * Capture it before handing work to another thread or a callback and open
+ * the spans there as its children.
+ *
+ * @return the span, or an empty context if there is none or tracing is off
+ */
+inline SpanContext current()
+{
+    return current_span;
+}
+
+/**
+ * @brief Record a span whose times are known after the fact
+ *
+ * E.g. the phases of a transfer, known from the timing information of the
+ * transfer once it is complete.
+ *
+ * @param[in]  name      name of the span, a string literal
+ * @param[in]  parent    parent of the span, the empty context for none
+ * @param[in]  start     start of the span
+ * @param[in]  duration  length of the span
+ */
+void record(const char *name, const SpanContext& parent, Clock::time_point start,
+    Clock::duration duration);
+
+/**
+ * @brief Scoped span, from construction to destruction
+ *
+ * While it is open, the span is the current span of the thread, the parent
+ * of the spans opened within it. Spans must be closed in the reverse order
+ * of opening, which scoping guarantees.
+ *
+ * Names and argument keys are not copied and not escaped, use string
+ * literals without characters special to JSON.
+ */
+class Span {
+    public:
+        /// Number of arguments a span keeps, further ones are dropped
+        static const size_t MAX_ARGS = 4;
+
+        /**
+         * @brief Open a span as a child of the current span of the thread
+         *
+         * @param[in]  name  name of the span, a string literal
+         */
+        explicit Span(const char *name) : name(name), nargs(0), active(enabled())
+        {
+            if (active) {
+                begin(current_span);
+            }
+        }
+
+        /**
+         * @brief Open a span as a child of @p parent
+         *
+         * @param[in]  name    name of the span, a string literal
+         * @param[in]  parent  parent of the span, e.g. from current() in the
+         *                     thread which started the work
+         */
+        Span(const char *name, const SpanContext& parent) :
+            name(name), nargs(0), active(enabled())
+        {
+            if (active) {
+                begin(parent);
+            }
+        }
+
+        /**
+         * @brief Close the span and record it
+         */
+        ~Span()
+        {
+            if (active) {
+                end();
+            }
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        /**
+         * @brief Attach the number @p value to the span as @p key
+         *
+         * @param[in]  key    name of the argument, a string literal
+         * @param[in]  value  value of the argument
+         */
+        void arg(const char *key, int64_t value)
+        {
+            if (active && nargs < MAX_ARGS) {
+                args[nargs].key = key;
+                args[nargs].value = value;
+                ++nargs;
+            }
+        }
+
+        /**
+         * @brief The identity of the span, empty if tracing was off when it opened
+         */
+        SpanContext context() const
+        {
+            return active ? self : SpanContext{0, 0};
+        }
+
+    private:
+        /**
+         * @internal
+         * @brief Start the span and make it current
+         */
+        void begin(const SpanContext& parent);
+
+        /**
+         * @internal
+         * @brief Restore the previous current span and record this one
+         */
+        void end();
+
+        const char *name;
+        size_t nargs;
+        bool active;
+        Clock::time_point start;
+        SpanContext self;
+        uint64_t parent_id;
+        /// Current span of the thread before this one was opened
+        SpanContext previous;
+        SpanArg args[MAX_ARGS];
+};
+
+/**
+ * @brief Records the spans of all threads to a file while it exists
+ *
+ * The file is in the Chrome trace event format, one complete (`"ph":"X"`)
+ * event per span, which chrome://tracing and Perfetto display as a
+ * timeline per thread. The trace, span and parent IDs are in the arguments
+ * of each event. The events are written as the spans close, a file cut
+ * short by a crash still loads.
+ *
+ * Only one TraceFile can be open at a time.
+ */
+class TraceFile {
+    public:
+        /**
+         * @brief Start recording spans to @p path
+         *
+         * @throws Error if the file can not be created or another TraceFile
+         *         is open
+         */
+        explicit TraceFile(const std::string& path);
+
+        /**
+         * @brief Stop recording and complete the file
+         */
+        ~TraceFile();
+
+        TraceFile(const TraceFile&) = delete;
+        TraceFile& operator=(const TraceFile&) = delete;
+
+        /**
+         * @brief Number of spans written so far
+         */
+        size_t events() const;
+
+    private:
+        std::FILE *file;
+};
+
+/** @} */
+
+} /* namespace Tracing */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_TRACING_HPP_ */
@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Request/response transports for the core service clients
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TRANSPORT_HPP_
+#define ARROWHEAD_TRANSPORT_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arrowhead/compression.hpp"
+#include "arrowhead/config.h"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/latency.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/retry.hpp"
+#include "arrowhead/tls.hpp"
+
+namespace Arrowhead {
+
+namespace HTTP {
+class CURLHandlePool;
+} /* namespace HTTP */
+
+/**
+ * @ingroup  http
+ *
+ * @{
+ */
+
+/**
+ * @brief Transport independent REST request
+ */
+struct HTTPRequest {
+    /// Request method, `GET` or `POST`
+    std::string method;
+    /// Absolute URL of the resource, see CURLEasyTransport for `unix://` URLs
+    std::string url;
+    /// Path of the resource relative to the API base URL, e.g. `/service`
+    std::string path;
+    /// Value of the `Accept` header, empty to omit the header
+    std::string accept;
+    /// Media type of @ref body, empty to omit the header
+    std::string content_type;
+    /// Request body, only sent with `POST`
+    std::string body;
+    /// The request fails with Errc::TIMEOUT if it is not done by then
+    Deadline deadline;
+    /// Limit for establishing the connection, zero for the transport default
+    std::chrono::milliseconds connect_timeout{0};
+    /// Operation the request belongs to, e.g. `list`, see latency_stats()
+    std::string operation;
+};
+
+/**
+ * @brief Transport independent REST response
+ */
+struct HTTPResponse {
+    /// Status code, e.g. 200
+    long status;
+    /// Value of the `Content-Type` header, empty if there was none
+    std::string content_type;
+    /// Response body
+    std::string body;
+    /// Where the time went, filled in by the libcurl transports
+    RequestTiming timing;
+};
+
+/**
+ * @brief HTTP protocol versions a libcurl transport may use
+ */
+enum class HTTPVersion {
+    /// HTTP/1.1 only
+    HTTP1_1,
+    /// HTTP/2 for `https://` if the server offers it (ALPN), HTTP/1.1 otherwise
+    HTTP2_TLS,
+    /// Like HTTP2_TLS, and plain text requests ask for an upgrade to h2c
+    HTTP2,
+    /**
+     * Plain text HTTP/2 (h2c) without negotiation, fails on HTTP/1.1 servers.
+     * libcurl 7.88 fails to reuse such connections with CURLE_HTTP2, use
+     * HTTP2 with it.
+     */
+    HTTP2_PRIOR_KNOWLEDGE,
+};
+
+/**
+ * @brief Transport policy performing requests with a libcurl easy handle
+ *
+ * Transport policies are used as template arguments to
+ * ServiceRegistryClient. A policy provides
+ * `Status perform(const HTTPRequest&, HTTPResponse&) const`, which fails
+ * with Errc::TRANSPORT if no response could be obtained, and stores the
+ * response for any status code. The throwing overload
+ * `HTTPResponse perform(const HTTPRequest&) const` is a convenience for
+ * direct use.
+ *
+ * The libcurl transports also reach servers on Unix domain sockets, e.g. a
+ * registry or caching agent on the same host, without the loopback TCP
+ * stack. The URL `unix:///run/arrowhead.sock/service` requests `/service`
+ * over the socket `/run/arrowhead.sock`, the socket path ends at the first
+ * path component which is a socket. Connections to a socket are pooled like
+ * TCP connections.
+ *
+ * Easy handles are set up once and reused by later requests, see
+ * HTTP::CURLHandlePool. Copies of a transport share the handles.
+ */
+class CURLEasyTransport {
+    public:
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  tls          TLS settings for `https://` URLs
+         * @param[in]  version      HTTP versions to negotiate
+         * @param[in]  compression  content coding of requests and responses
+         */
+        explicit CURLEasyTransport(const TLSOptions& tls = TLSOptions(),
+            HTTPVersion version = HTTPVersion::HTTP2_TLS,
+            const CompressionOptions& compression = CompressionOptions());
+
+        /**
+         * @brief Perform @p req and wait for the response, without throwing
+         * on transport failures
+         *
+         * @param[in]  req   request to perform
+         * @param[out] resp  the response, if the Status is ok()
+         *
+         * @return Errc::TRANSPORT with the CURLcode as detail if libcurl
+         *         signals an error, Errc::TIMEOUT if the deadline of @p req
+         *         passes first
+         */
+        Status perform(const HTTPRequest& req, HTTPResponse& resp) const;
+
+        /**
+         * @brief Perform @p req and wait for the response
+         *
+         * @param[in]  req  request to perform
+         *
+         * @return the response
+         *
+         * @throws TransportError if libcurl signals an error
+         */
+        HTTPResponse perform(const HTTPRequest& req) const;
+
+        /**
+         * @brief Number of easy handles created so far, at most the number
+         * of requests which were in flight at the same time
+         */
+        size_t handles() const;
+
+    private:
+        std::shared_ptr<HTTP::CURLHandlePool> pool;
+};
+
+/**
+ * @brief Transport policy multiplexing concurrent requests over HTTP/2
+ *
+ * All requests, from any number of threads, are handed to one libcurl multi
+ * handle driven by a background thread. Requests to the same server share
+ * one HTTP/2 connection with up to Options::max_concurrent_streams streams
+ * in flight, instead of one TCP connection each. A new request waits for
+ * the connection being set up rather than opening another one.
+ *
+ * If the server only speaks HTTP/1.1, libcurl falls back to it and opens a
+ * connection per concurrent request, up to Options::max_host_connections.
+ *
+ * Copies share the multi handle and the background thread, which stops
+ * when the last copy is destroyed.
+ */
+class CURLMultiplexTransport {
+    public:
+        /**
+         * @brief Tuning parameters
+         */
+        struct Options {
+            Options() : http_version(HTTPVersion::HTTP2), max_concurrent_streams(100),
+                max_host_connections(0) {}
+
+            /// HTTP versions to negotiate
+            HTTPVersion http_version;
+            /// Maximum number of streams in flight on one HTTP/2 connection
+            unsigned int max_concurrent_streams;
+            /// Maximum number of connections to one server, 0 for no limit
+            unsigned int max_host_connections;
+            /// TLS settings for `https://` URLs
+            TLSOptions tls;
+            /// Content coding of requests and responses
+            CompressionOptions compression;
+        };
+
+        /**
+         * @brief Counters of the requests made by a transport and its copies
+         */
+        struct Stats {
+            /// Requests which got a response
+            uint64_t requests;
+            /// Of those, requests which were answered over HTTP/2
+            uint64_t http2_requests;
+            /// Connections opened
+            uint64_t connections;
+        };
+
+        /**
+         * @brief Constructor, starts the background thread
+         */
+        explicit CURLMultiplexTransport(const Options& options = Options());
+
+        /**
+         * @brief Perform @p req and wait for the response, without throwing
+         * on transport failures
+         *
+         * @return Errc::TRANSPORT with the CURLcode as detail if libcurl
+         *         signals an error, Errc::TIMEOUT if the deadline of @p req
+         *         passes first
+         */
+        Status perform(const HTTPRequest& req, HTTPResponse& resp) const;
+
+        /**
+         * @brief Perform @p req and wait for the response
+         *
+         * @throws TransportError if libcurl signals an error
+         */
+        HTTPResponse perform(const HTTPRequest& req) const;
+
+        /**
+         * @brief Counters of the requests made so far
+         */
+        Stats stats() const;
+
+    private:
+        struct State;
+        std::shared_ptr<State> state;
+};
+
+/**
+ * @brief Transport policy spreading requests over replicated registries
+ *
+ * Every request is sent to the endpoint with the lowest observed latency
+ * first, the request path (HTTPRequest::path) is appended to the endpoint
+ * URL and HTTPRequest::url is ignored, so the client URL base can be empty.
+ *
+ * A `GET` which has not been answered after the hedge delay is sent to the
+ * next endpoint as well. The hedge delay is a high percentile of the recent
+ * latencies of the first endpoint, so only the slowest few percent of the
+ * requests are duplicated. The first success wins and the other transfers
+ * are cancelled. An endpoint which fails, with a transport error or a 5xx
+ * status, is replaced by the next one at once, and is ranked behind the
+ * healthy endpoints until it succeeds again.
+ *
+ * Other methods are not duplicated, they fail over only if the connection
+ * could not be established, since the server may already have acted on a
+ * request which failed later.
+ *
+ * Connections are kept open for the following requests. Copies share the
+ * endpoint statistics and connections, the transport is thread safe.
+ */
+class CURLHedgedTransport {
+    public:
+        /**
+         * @brief Tuning parameters
+         */
+        struct Options {
+            Options() : initial_hedge_delay(50), min_hedge_delay(2),
+                hedge_percentile(0.95), max_hedges(1) {}
+
+            /// Hedge delay until an endpoint has enough latency samples
+            std::chrono::milliseconds initial_hedge_delay;
+            /// Lower bound of the hedge delay
+            std::chrono::milliseconds min_hedge_delay;
+            /// Latency percentile used as hedge delay, in (0, 1]
+            double hedge_percentile;
+            /// Maximum number of duplicates of one request, 0 disables hedging
+            unsigned int max_hedges;
+            /// TLS settings for `https://` endpoints
+            TLSOptions tls;
+            /// Content coding of requests and responses
+            CompressionOptions compression;
+        };
+
+        /**
+         * @brief Observed behaviour of one endpoint
+         */
+        struct EndpointStats {
+            /// Endpoint URL
+            std::string url;
+            /// Transfers started, including hedges
+            uint64_t requests;
+            /// Transfers which failed
+            uint64_t failures;
+            /// Transfers cancelled because another endpoint answered first
+            uint64_t cancelled;
+            /// Failures since the last success
+            unsigned int consecutive_failures;
+            /// Median of the recent latencies, zero without samples
+            std::chrono::microseconds median_latency;
+            /// Current hedge delay for requests starting at this endpoint
+            std::chrono::microseconds hedge_delay;
+        };
+
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  endpoints  URL bases of the registry replicas
+         * @param[in]  options    tuning parameters
+         */
+        explicit CURLHedgedTransport(const std::vector<std::string>& endpoints,
+            const Options& options = Options());
+
+        /**
+         * @brief Perform @p req on the best endpoints, without throwing on
+         * transport failures
+         *
+         * @return the status of the last failed attempt if every endpoint
+         *         failed, the response of the last endpoint is stored in
+         *         @p resp if it answered with an error status
+         */
+        Status perform(const HTTPRequest& req, HTTPResponse& resp) const;
+
+        /**
+         * @brief Perform @p req on the best endpoints
+         *
+         * @throws TransportError if no endpoint answered
+         */
+        HTTPResponse perform(const HTTPRequest& req) const;
+
+        /**
+         * @brief Statistics of every endpoint, in the order given to the constructor
+         */
+        std::vector<EndpointStats> endpoint_stats() const;
+
+        /**
+         * @brief Number of easy handles created so far, at most the number
+         * of transfers which were in flight at the same time
+         */
+        size_t handles() const;
+
+    private:
+        struct State;
+        std::shared_ptr<State> state;
+};
+
+/**
+ * @brief In-process transport policy passing requests to a handler function
+ *
+ * No network is involved, the handler plays the role of the server. Useful
+ * for testing and for embedding a registry in the same process as its
+ * clients.
+ */
+class LoopbackTransport {
+    public:
+        /// Server side request handler
+        typedef std::function<HTTPResponse(const HTTPRequest&)> Handler;
+
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  handler  function handling every request
+         */
+        explicit LoopbackTransport(Handler handler = Handler()) : handler(handler) {}
+
+        /**
+         * @brief Pass @p req to the handler and store its response in @p resp
+         *
+         * The handler is not interrupted when the deadline passes, only a
+         * deadline which passed before the call is honoured.
+         *
+         * @return Errc::TRANSPORT if there is no handler, Errc::TIMEOUT if
+         *         the deadline of @p req has passed
+         */
+        Status perform(const HTTPRequest& req, HTTPResponse& resp) const
+        {
+            if (!handler) {
+                return Status(Errc::TRANSPORT, 0, "LoopbackTransport: no handler");
+            }
+            if (req.deadline.expired()) {
+                return Status(Errc::TIMEOUT, 0, "LoopbackTransport");
+            }
+            resp = handler(req);
+            return Status();
+        }
+
+        /**
+         * @brief Pass @p req to the handler and return its response
+         *
+         * @throws TransportError if there is no handler
+         */
+        HTTPResponse perform(const HTTPRequest& req) const
+        {
+            HTTPResponse resp;
+            Status status = perform(req, resp);
+            if (!status.ok()) {
+                status.raise();
+            }
+            return resp;
+        }
+
+    private:
+        Handler handler;
+};
+
+/** @} */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_TRANSPORT_HPP_ */
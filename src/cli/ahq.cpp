@@ -22,12 +22,15 @@
  * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
  *
  */
+#include <chrono>
 #include <exception>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
 #include <list>
+#include <memory>
+#include <vector>
 
 #include <boost/program_options.hpp>
 
@@ -35,6 +38,10 @@
 #include "arrowhead/service.hpp"
 #include "arrowhead/http.hpp"
 #include "arrowhead/core_services/serviceregistry.hpp"
+#include "arrowhead/retry.hpp"
+#include "arrowhead/compression.hpp"
+#include "arrowhead/tls.hpp"
+#include "arrowhead/tracing.hpp"
 #include "project_version.h"
 
 namespace po = boost::program_options;
@@ -86,6 +93,13 @@ class ArrowheadQueryApp {
          */
         void list(std::list<std::string> args);
 
+        /**
+         * @brief  Read a service list from the file given by the input option
+         *
+         * @param[out] servicelist  destination for the services
+         */
+        void read_input(std::vector<ServiceDescription>& servicelist);
+
         /**
          * @brief  Publish a service in the service registry
          *
@@ -106,6 +120,13 @@ class ArrowheadQueryApp {
          * @param[in]  args  arguments passed from command line
          */
         void unpublish(std::list<std::string> args);
+
+    private:
+        /**
+         * @brief  Service registry client configured by the url, prefer,
+         *         timeout and retries options
+         */
+        ServiceRegistryHTTP registry_client();
 };
 
 const std::string ArrowheadQueryApp::version = VCS_VERSION_STR;
@@ -142,10 +163,44 @@ int ArrowheadQueryApp::init(int argc, char * argv[])
             po::value<std::string>()->
             default_value("http://localhost:8045/servicediscovery"),
             "REST API URL base")
+        ("prefer",
+            po::value<std::string>(),
+            "media type to prefer when talking to the registry, e.g. application/cbor")
+        ("timeout",
+            po::value<unsigned int>()->default_value(30000),
+            "deadline in milliseconds for each registry operation, 0 for none")
+        ("retries",
+            po::value<unsigned int>()->default_value(2),
+            "number of times to retry a failed registry query")
+        ("cacert",
+            po::value<std::string>(),
+            "CA certificates (PEM) to verify an https registry with")
+        ("cert",
+            po::value<std::string>(),
+            "client certificate (PEM) for mutual TLS")
+        ("key",
+            po::value<std::string>(),
+            "private key (PEM) of the client certificate")
+        ("insecure",
+            "do not verify the certificate of an https registry")
+        ("compress",
+            "compress published service lists, the registry must accept gzip")
+        ("trace",
+            po::value<std::string>(),
+            "write the stages of the registry calls to a Chrome trace event file")
         ("logconf",
             po::value<std::string>()->
             default_value("log4cplus.properties"),
             "logging configuration file")
+        ("input,i",
+            po::value<std::string>(),
+            "read the service list from a file instead of the registry, - for standard input")
+        ("input-format",
+            po::value<std::string>()->default_value("json"),
+            "input file format (json, ndjson)")
+        ("format,f",
+            po::value<std::string>()->default_value("log"),
+            "service list output format (log, json, ndjson)")
         ;
 
     // Hidden options, will be allowed both on command line and
@@ -222,6 +277,11 @@ int ArrowheadQueryApp::run()
 
     std::string action = options["action"].as<std::string>();
 
+    std::unique_ptr<Tracing::TraceFile> trace;
+    if (options.count("trace")) {
+        trace.reset(new Tracing::TraceFile(options["trace"].as<std::string>()));
+    }
+
     std::list<std::string> args;
 
     if (options.count("action_args")) {
@@ -250,16 +310,45 @@ void ArrowheadQueryApp::list(std::list<std::string> args)
 {
     ARROWHEAD_LIB_LOGGER(logger, "ahq::list");
     ARROWHEAD_LIB_TRACE(logger, "+ArrowheadQueryApp::list");
-    ServiceRegistryHTTP servicereg(options["url"].as<std::string>());
     std::string type;
 
     if (!args.empty()) {
         type = args.front();
         args.pop_front();
     }
-    std::string js = servicereg.list(type);
     std::vector<ServiceDescription> servicelist;
-    parse_servicelist_json(std::back_inserter(servicelist), js);
+    if (options.count("input")) {
+        read_input(servicelist);
+        if (!type.empty()) {
+            servicelist.erase(std::remove_if(servicelist.begin(), servicelist.end(),
+                [&type](const ServiceDescription& srv) { return srv.type != type; }),
+                servicelist.end());
+        }
+    }
+    else {
+        servicelist = registry_client().list_services(type);
+    }
+
+    std::string format = options["format"].as<std::string>();
+    if (format == "ndjson") {
+        write_servicelist_ndjson(std::cout, servicelist.begin(), servicelist.end());
+        std::cout.flush();
+        ARROWHEAD_LIB_TRACE(logger, "-ArrowheadQueryApp::list");
+        return;
+    }
+    if (format == "json") {
+        nlohmann::json js;
+        js["service"] = nlohmann::json::array();
+        for (auto& srv: servicelist) {
+            js["service"].push_back(JSON::obj_from_service(srv));
+        }
+        std::cout << js.dump(4) << std::endl;
+        ARROWHEAD_LIB_TRACE(logger, "-ArrowheadQueryApp::list");
+        return;
+    }
+    if (format != "log") {
+        throw(std::runtime_error("ahq::list Unknown output format '" + format + "'"));
+    }
 
     ARROWHEAD_LIB_INFO(logger, servicelist.size() << " services:");
     for (auto& srv: servicelist) {
@@ -281,11 +370,46 @@ void ArrowheadQueryApp::list(std::list<std::string> args)
     ARROWHEAD_LIB_TRACE(logger, "-ArrowheadQueryApp::list");
 }
 
+void ArrowheadQueryApp::read_input(std::vector<ServiceDescription>& servicelist)
+{
+    ARROWHEAD_LIB_LOGGER(logger, "ahq::read_input");
+    std::string path = options["input"].as<std::string>();
+    std::string format = options["input-format"].as<std::string>();
+    std::ifstream ifs;
+    std::istream *is = &std::cin;
+    if (path != "-") {
+        ifs.open(path.c_str(), std::ios::binary);
+        if (!ifs.good()) {
+            throw(std::runtime_error("ahq::read_input Failed to open '" + path + "'"));
+        }
+        is = &ifs;
+    }
+    ARROWHEAD_LIB_INFO(logger, "Reading " << format << " service list from " << path);
+    if (format == "ndjson") {
+        // Parse while reading, only a partial line is buffered
+        JSON::LineReader reader;
+        std::vector<char> buf(64 * 1024);
+        auto oit = std::back_inserter(servicelist);
+        while (is->read(buf.data(), buf.size()) || is->gcount() > 0) {
+            oit = reader.feed(oit, buf.data(), is->gcount());
+        }
+        reader.finish(oit);
+    }
+    else if (format == "json") {
+        std::ostringstream ss;
+        ss << is->rdbuf();
+        parse_servicelist_json(std::back_inserter(servicelist), ss.str());
+    }
+    else {
+        throw(std::runtime_error("ahq::read_input Unknown input format '" + format + "'"));
+    }
+}
+
 void ArrowheadQueryApp::publish(std::list<std::string> args)
 {
     ARROWHEAD_LIB_LOGGER(logger, "ahq::publish");
     ARROWHEAD_LIB_TRACE(logger, "+ArrowheadQueryApp::publish");
-    ServiceRegistryHTTP servicereg(options["url"].as<std::string>());
+    ServiceRegistryHTTP servicereg = registry_client();
 
     if (args.empty()) {
         throw(std::runtime_error("ahq::publish Missing name"));
@@ -334,7 +458,7 @@ void ArrowheadQueryApp::unpublish(std::list<std::string> args)
 {
     ARROWHEAD_LIB_LOGGER(logger, "ahq::unpublish");
     ARROWHEAD_LIB_TRACE(logger, "+ArrowheadQueryApp::unpublish");
-    ServiceRegistryHTTP servicereg(options["url"].as<std::string>());
+    ServiceRegistryHTTP servicereg = registry_client();
     if (args.empty()) {
         throw(std::runtime_error("ahq::unpublish Missing name"));
     }
@@ -345,6 +469,34 @@ void ArrowheadQueryApp::unpublish(std::list<std::string> args)
     ARROWHEAD_LIB_TRACE(logger, "-ArrowheadQueryApp::unpublish");
 }
 
+ServiceRegistryHTTP ArrowheadQueryApp::registry_client()
+{
+    TLSOptions tls;
+    if (options.count("cacert")) {
+        tls.ca_file = options["cacert"].as<std::string>();
+    }
+    if (options.count("cert")) {
+        tls.client_cert = options["cert"].as<std::string>();
+    }
+    if (options.count("key")) {
+        tls.client_key = options["key"].as<std::string>();
+    }
+    if (options.count("insecure")) {
+        tls.verify_peer = false;
+        tls.verify_host = false;
+    }
+    CompressionOptions compression;
+    compression.compress_requests = options.count("compress") > 0;
+    ServiceRegistryHTTP servicereg(options["url"].as<std::string>(),
+        CodecRegistry::builtin(), CURLEasyTransport(tls, HTTPVersion::HTTP2_TLS, compression));
+    if (options.count("prefer")) {
+        servicereg.codec().prefer(options["prefer"].as<std::string>());
+    }
+    servicereg.set_timeout(std::chrono::milliseconds(options["timeout"].as<unsigned int>()));
+    servicereg.set_retry_policy(RetryPolicy(1 + options["retries"].as<unsigned int>()));
+    return servicereg;
+}
+
 int main(int argc, char * argv[])
 {
     ArrowheadQueryApp app;
@@ -0,0 +1,602 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Arrowhead CBOR encoding and decoding implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <string_view>
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_CBOR
+
+#include "arrowhead/service.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/serviceschema.hpp"
+
+namespace Arrowhead {
+
+namespace CBOR {
+
+namespace {
+
+/**
+ * @ingroup cbor_detail
+ * @{
+ */
+
+/**
+ * @brief CBOR major types (RFC 7049, section 2.1)
+ */
+enum MajorType {
+    MAJOR_UINT = 0,
+    MAJOR_NINT = 1,
+    MAJOR_BSTR = 2,
+    MAJOR_TSTR = 3,
+    MAJOR_ARRAY = 4,
+    MAJOR_MAP = 5,
+    MAJOR_TAG = 6,
+    MAJOR_SIMPLE = 7,
+};
+
+/**
+ * @brief Additional information value for indefinite length items
+ */
+const unsigned int AI_INDEFINITE = 31;
+
+/**
+ * @brief The "break" stop code, terminates indefinite length items
+ */
+const unsigned char CBOR_BREAK = 0xff;
+
+/**
+ * @brief Nesting limit when skipping unknown items
+ */
+const unsigned int MAX_SKIP_DEPTH = 16;
+
+/**
+ * @brief Key of the service array in a service list map
+ */
+const char LIST_KEY[] = "service";
+
+/**
+ * @brief Thrown by Reader when the input ends in the middle of an item
+ */
+struct Truncated {};
+
+/**
+ * @brief Bounded writer which counts all bytes but only stores what fits
+ */
+class Writer {
+    public:
+        Writer(char *buf, size_t buflen) : buf(buf), buflen(buflen), pos(0) {}
+
+        void put(unsigned char byte)
+        {
+            if (pos < buflen) {
+                buf[pos] = static_cast<char>(byte);
+            }
+            ++pos;
+        }
+
+        void put(const char *data, size_t len)
+        {
+            if (pos < buflen) {
+                size_t n = (buflen - pos < len) ? buflen - pos : len;
+                std::memcpy(buf + pos, data, n);
+            }
+            pos += len;
+        }
+
+        /**
+         * @brief Write an item head using the shortest argument encoding
+         */
+        void head(MajorType major, uint64_t value)
+        {
+            unsigned char ib = static_cast<unsigned char>(major << 5);
+            if (value < 24) {
+                put(ib | static_cast<unsigned char>(value));
+                return;
+            }
+            unsigned int bytes;
+            if (value <= 0xff) {
+                put(ib | 24);
+                bytes = 1;
+            }
+            else if (value <= 0xffff) {
+                put(ib | 25);
+                bytes = 2;
+            }
+            else if (value <= 0xffffffffull) {
+                put(ib | 26);
+                bytes = 4;
+            }
+            else {
+                put(ib | 27);
+                bytes = 8;
+            }
+            while (bytes-- > 0) {
+                put(static_cast<unsigned char>(value >> (8 * bytes)));
+            }
+        }
+
+        template<class StringType>
+        void text(const StringType& str)
+        {
+            head(MAJOR_TSTR, str.size());
+            put(str.data(), str.size());
+        }
+
+        size_t size() const
+        {
+            return pos;
+        }
+
+    private:
+        char *buf;
+        size_t buflen;
+        size_t pos;
+};
+
+/**
+ * @brief Bounds checked reader over a CBOR buffer
+ *
+ * Throws Truncated when the input ends early and ContentError on malformed
+ * input.
+ */
+class Reader {
+    public:
+        Reader(const char *buf, size_t buflen, size_t pos = 0) :
+            buf(reinterpret_cast<const unsigned char *>(buf)), buflen(buflen), pos(pos) {}
+
+        /**
+         * @brief Read an item head
+         *
+         * @param[out]  major       major type of the item
+         * @param[out]  indefinite  true if the item has indefinite length
+         *
+         * @return the argument of the head, 0 for indefinite length items
+         */
+        uint64_t head(unsigned int& major, bool& indefinite)
+        {
+            need(1);
+            unsigned char ib = buf[pos++];
+            major = ib >> 5;
+            unsigned int ai = ib & 0x1f;
+            indefinite = false;
+            if (ai < 24) {
+                return ai;
+            }
+            if (ai == AI_INDEFINITE) {
+                if (major == MAJOR_UINT || major == MAJOR_NINT || major == MAJOR_TAG) {
+                    throw ContentError("Arrowhead::CBOR: invalid indefinite length item");
+                }
+                indefinite = true;
+                return 0;
+            }
+            if (ai > 27) {
+                throw ContentError("Arrowhead::CBOR: reserved additional information value");
+            }
+            size_t bytes = size_t(1) << (ai - 24);
+            need(bytes);
+            uint64_t value = 0;
+            for (size_t i = 0; i < bytes; ++i) {
+                value = (value << 8) | buf[pos++];
+            }
+            return value;
+        }
+
+        /**
+         * @brief Read a container head of the given major type
+         *
+         * @param[in]   major       expected major type
+         * @param[out]  indefinite  true if the container has indefinite length
+         *
+         * @return number of entries, 0 for indefinite length containers
+         */
+        uint64_t container(MajorType major, bool& indefinite, const char *what)
+        {
+            unsigned int mt;
+            uint64_t count = head(mt, indefinite);
+            if (mt != static_cast<unsigned int>(major)) {
+                throw ContentError(std::string("Arrowhead::CBOR: expected ") + what);
+            }
+            return count;
+        }
+
+        /**
+         * @brief Check for, and consume, a break stop code
+         */
+        bool at_break()
+        {
+            need(1);
+            if (buf[pos] == CBOR_BREAK) {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Check whether another entry follows in a container
+         *
+         * @param[in,out] remaining   entries left in a definite length container
+         * @param[in]     indefinite  whether the container has indefinite length
+         */
+        bool more(uint64_t& remaining, bool indefinite)
+        {
+            if (indefinite) {
+                return !at_break();
+            }
+            if (remaining == 0) {
+                return false;
+            }
+            --remaining;
+            return true;
+        }
+
+        /**
+         * @brief Read a text string, indefinite length strings are joined
+         */
+        template<class StringType>
+        void text(StringType& out)
+        {
+            unsigned int major;
+            bool indefinite;
+            uint64_t len = head(major, indefinite);
+            if (major != MAJOR_TSTR) {
+                throw ContentError("Arrowhead::CBOR: expected text string");
+            }
+            if (!indefinite) {
+                need(len);
+                out.assign(reinterpret_cast<const char *>(buf + pos), len);
+                pos += len;
+                return;
+            }
+            out.clear();
+            while (!at_break()) {
+                len = head(major, indefinite);
+                if (major != MAJOR_TSTR || indefinite) {
+                    throw ContentError("Arrowhead::CBOR: invalid text string chunk");
+                }
+                need(len);
+                out.append(reinterpret_cast<const char *>(buf + pos), len);
+                pos += len;
+            }
+        }
+
+        /**
+         * @brief Compare a text string key without copying it
+         *
+         * Only definite length keys are compared, an indefinite length key
+         * never matches and is skipped.
+         */
+        bool key_equals(const char *key)
+        {
+            size_t start = pos;
+            unsigned int major;
+            bool indefinite;
+            uint64_t len = head(major, indefinite);
+            if (major != MAJOR_TSTR) {
+                throw ContentError("Arrowhead::CBOR: map key is not a text string");
+            }
+            if (indefinite) {
+                pos = start;
+                skip(0);
+                return false;
+            }
+            need(len);
+            bool equal = (std::strlen(key) == len &&
+                std::memcmp(buf + pos, key, len) == 0);
+            pos += len;
+            return equal;
+        }
+
+        uint64_t uint()
+        {
+            unsigned int major;
+            bool indefinite;
+            uint64_t value = head(major, indefinite);
+            if (major != MAJOR_UINT) {
+                throw ContentError("Arrowhead::CBOR: expected unsigned integer");
+            }
+            return value;
+        }
+
+        /**
+         * @brief Skip over one complete data item
+         */
+        void skip(unsigned int depth)
+        {
+            if (depth > MAX_SKIP_DEPTH) {
+                throw ContentError("Arrowhead::CBOR: nesting too deep");
+            }
+            unsigned int major;
+            bool indefinite;
+            uint64_t arg = head(major, indefinite);
+            switch (major) {
+                case MAJOR_UINT:
+                case MAJOR_NINT:
+                    break;
+                case MAJOR_BSTR:
+                case MAJOR_TSTR:
+                    if (indefinite) {
+                        while (!at_break()) {
+                            skip(depth + 1);
+                        }
+                    }
+                    else {
+                        need(arg);
+                        pos += arg;
+                    }
+                    break;
+                case MAJOR_ARRAY:
+                case MAJOR_MAP:
+                {
+                    uint64_t items = (major == MAJOR_MAP) ? 2 * arg : arg;
+                    if (indefinite) {
+                        while (!at_break()) {
+                            skip(depth + 1);
+                            if (major == MAJOR_MAP) {
+                                skip(depth + 1);
+                            }
+                        }
+                    }
+                    else {
+                        while (items-- > 0) {
+                            skip(depth + 1);
+                        }
+                    }
+                    break;
+                }
+                case MAJOR_TAG:
+                    skip(depth + 1);
+                    break;
+                default:
+                    /* simple values and floats, the argument was the value */
+                    if (indefinite) {
+                        throw ContentError("Arrowhead::CBOR: unexpected break");
+                    }
+                    break;
+            }
+        }
+
+        size_t position() const
+        {
+            return pos;
+        }
+
+    private:
+        void need(uint64_t n) const
+        {
+            if (n > buflen - pos) {
+                throw Truncated();
+            }
+        }
+
+        const unsigned char *buf;
+        size_t buflen;
+        size_t pos;
+};
+
+/**
+ * @brief Decode a string field
+ */
+void read_value(Reader& rd, std::string& str)
+{
+    rd.text(str);
+}
+
+/**
+ * @brief Decode the port field
+ */
+void read_value(Reader& rd, unsigned int& port)
+{
+    uint64_t value = rd.uint();
+    if (value > 0xffff) {
+        throw ContentError("Arrowhead::CBOR: port out of range");
+    }
+    port = static_cast<unsigned int>(value);
+}
+
+/**
+ * @brief Decode the properties field, a map from property name to value
+ */
+void read_value(Reader& rd, std::map<std::string, std::string>& properties)
+{
+    bool indefinite;
+    uint64_t remaining = rd.container(MAJOR_MAP, indefinite, "properties map");
+    std::string name;
+    while (rd.more(remaining, indefinite)) {
+        rd.text(name);
+        rd.text(properties[name]);
+    }
+}
+
+/**
+ * @brief Encode a string field
+ */
+void write_value(Writer& wr, const std::string& str)
+{
+    wr.text(str);
+}
+
+/**
+ * @brief Encode the port field
+ */
+void write_value(Writer& wr, unsigned int port)
+{
+    wr.head(MAJOR_UINT, port);
+}
+
+/**
+ * @brief Encode the properties field
+ */
+void write_value(Writer& wr, const std::map<std::string, std::string>& properties)
+{
+    wr.head(MAJOR_MAP, properties.size());
+    for (auto it = properties.begin(); it != properties.end(); ++it) {
+        wr.text(it->first);
+        wr.text(it->second);
+    }
+}
+
+/**
+ * @brief Decode the service map at the reader position
+ */
+void read_service(Reader& rd, ServiceDescription& sd)
+{
+    bool indefinite;
+    uint64_t remaining = rd.container(MAJOR_MAP, indefinite, "service map");
+    sd.name.clear();
+    sd.type.clear();
+    sd.domain.clear();
+    sd.host.clear();
+    sd.port = 0;
+    sd.properties.clear();
+    std::string key;
+    while (rd.more(remaining, indefinite)) {
+        rd.text(key);
+        int index = Schema::visit_field(sd, key.data(), key.size(),
+            [&rd](std::string_view, auto& member) { read_value(rd, member); });
+        if (index < 0) {
+            /* Unknown keys are ignored for forward compatibility */
+            rd.skip(0);
+        }
+    }
+}
+
+/** @} */
+} /* anonymous namespace */
+
+size_t encode_service(const ServiceDescription& sd, char *buf, size_t buflen)
+{
+    Writer wr(buf, buflen);
+    wr.head(MAJOR_MAP, Schema::FIELD_COUNT);
+    Schema::for_each_field(sd, [&wr](std::string_view key, const auto& member) {
+        wr.text(key);
+        write_value(wr, member);
+    });
+    return wr.size();
+}
+
+size_t encode_servicelist_head(size_t count, char *buf, size_t buflen)
+{
+    Writer wr(buf, buflen);
+    wr.head(MAJOR_MAP, 1);
+    wr.text(std::string_view(LIST_KEY));
+    wr.head(MAJOR_ARRAY, count);
+    return wr.size();
+}
+
+size_t decode_service(const char *buf, size_t buflen, ServiceDescription& sd)
+{
+    Reader rd(buf, buflen);
+    try {
+        read_service(rd, sd);
+    }
+    catch (const Truncated&) {
+        throw ContentError("Arrowhead::CBOR: truncated service");
+    }
+    return rd.position();
+}
+
+StreamDecoder::StreamDecoder() :
+    state(STATE_LIST_HEAD),
+    keys_remaining(0), keys_indefinite(false),
+    items_remaining(0), items_indefinite(false)
+{
+}
+
+bool StreamDecoder::next(const char *data, size_t len, size_t& pos, ServiceDescription& sd)
+{
+    while (state != STATE_DONE) {
+        /* Every step either completes, or rewinds to pos and waits for more
+         * input, the counters are only updated when a step completes */
+        Reader rd(data, len, pos);
+        uint64_t keys = keys_remaining;
+        uint64_t items = items_remaining;
+        try {
+            switch (state) {
+                case STATE_LIST_HEAD:
+                    keys_remaining = rd.container(MAJOR_MAP, keys_indefinite, "service list map");
+                    state = STATE_LIST_KEY;
+                    break;
+                case STATE_LIST_KEY:
+                    if (!rd.more(keys, keys_indefinite)) {
+                        throw ContentError("Arrowhead::CBOR: service list has no service array");
+                    }
+                    if (rd.key_equals(LIST_KEY)) {
+                        items_remaining = rd.container(MAJOR_ARRAY, items_indefinite,
+                            "service array");
+                        state = STATE_ITEMS;
+                    }
+                    else {
+                        rd.skip(0);
+                    }
+                    keys_remaining = keys;
+                    break;
+                case STATE_ITEMS:
+                    if (!rd.more(items, items_indefinite)) {
+                        state = STATE_LIST_REST;
+                        break;
+                    }
+                    read_service(rd, sd);
+                    items_remaining = items;
+                    pos = rd.position();
+                    return true;
+                case STATE_LIST_REST:
+                    /* Keys after the service array are skipped like those before it */
+                    if (!rd.more(keys, keys_indefinite)) {
+                        state = STATE_DONE;
+                        break;
+                    }
+                    rd.skip(0);
+                    rd.skip(0);
+                    keys_remaining = keys;
+                    break;
+                case STATE_DONE:
+                    break;
+            }
+        }
+        catch (const Truncated&) {
+            return false;
+        }
+        pos = rd.position();
+    }
+    return false;
+}
+
+} /* namespace CBOR */
+
+ServiceDescription ServiceDescription::from_cbor(const char *cborbuf, size_t buflen)
+{
+    ServiceDescription sd;
+    CBOR::decode_service(cborbuf, buflen, sd);
+    return sd;
+}
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_USE_CBOR */
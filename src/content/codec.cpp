@@ -0,0 +1,470 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Content codecs and media type negotiation implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arrowhead/codec.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/metrics.hpp"
+#include "arrowhead/serviceschema.hpp"
+#include "arrowhead/tracing.hpp"
+
+namespace Arrowhead {
+
+namespace {
+
+/**
+ * @ingroup codec
+ * @{
+ */
+
+#if ARROWHEAD_USE_PUGIXML
+/**
+ * @brief Append @p str to @p out with the XML special characters escaped
+ */
+void append_xml_escaped(std::string& out, const std::string& str)
+{
+    for (char c: str) {
+        switch (c) {
+            case '&':  out += "&amp;";  break;
+            case '<':  out += "&lt;";   break;
+            case '>':  out += "&gt;";   break;
+            case '"':  out += "&quot;"; break;
+            case '\'': out += "&apos;"; break;
+            default:   out += c;        break;
+        }
+    }
+}
+
+/**
+ * @brief Append `<tag>value</tag>` to @p out
+ */
+void append_xml_element(std::string& out, const char *tag, const std::string& value)
+{
+    out += '<';
+    out += tag;
+    out += '>';
+    append_xml_escaped(out, value);
+    out += "</";
+    out += tag;
+    out += '>';
+}
+
+/**
+ * @brief Append the text of a string field
+ */
+void append_xml_value(std::string& out, const std::string& str)
+{
+    append_xml_escaped(out, str);
+}
+
+/**
+ * @brief Append the text of the port field
+ */
+void append_xml_value(std::string& out, unsigned int port)
+{
+    out += std::to_string(port);
+}
+
+/**
+ * @brief Append the `<property>` elements of the properties field
+ */
+void append_xml_value(std::string& out, const std::map<std::string, std::string>& properties)
+{
+    for (auto& kv: properties) {
+        out += "<property>";
+        append_xml_element(out, "name", kv.first);
+        append_xml_element(out, "value", kv.second);
+        out += "</property>";
+    }
+}
+
+/**
+ * @brief Append a `<service>` element to @p out
+ *
+ * The element layout is the one read by XML::service_from_node()
+ */
+void append_xml_service(std::string& out, const ServiceDescription& sd)
+{
+    out += "<service>";
+    Schema::for_each_field(sd, [&out](std::string_view key, const auto& member) {
+        out += '<';
+        out.append(key.data(), key.size());
+        out += '>';
+        append_xml_value(out, member);
+        out += "</";
+        out.append(key.data(), key.size());
+        out += '>';
+    });
+    out += "</service>";
+}
+#endif /* ARROWHEAD_USE_PUGIXML */
+
+/** @} */
+} /* anonymous namespace */
+
+std::string media_type_of(const std::string& content_type)
+{
+    size_t end = content_type.find(';');
+    if (end == std::string::npos) {
+        end = content_type.size();
+    }
+    size_t begin = 0;
+    while (begin < end && std::isspace(static_cast<unsigned char>(content_type[begin]))) {
+        ++begin;
+    }
+    while (end > begin && std::isspace(static_cast<unsigned char>(content_type[end - 1]))) {
+        --end;
+    }
+    std::string type(content_type, begin, end - begin);
+    for (auto& c: type) {
+        c = std::tolower(static_cast<unsigned char>(c));
+    }
+    return type;
+}
+
+Status Codec::try_decode_servicelist(std::vector<ServiceDescription>& out,
+    const char *buf, size_t buflen) const
+{
+#if ARROWHEAD_USE_EXCEPTIONS
+    try {
+        decode_servicelist(out, buf, buflen);
+    }
+    catch (const ContentError& e) {
+        return Status(Errc::CONTENT, "Codec", e.what());
+    }
+#else
+    decode_servicelist(out, buf, buflen);
+#endif
+    return Status();
+}
+
+std::string Codec::encode_service_name(const std::string& name) const
+{
+    ServiceDescription sd;
+    sd.name = name;
+    sd.port = 0;
+    return encode_service(sd);
+}
+
+#if ARROWHEAD_USE_JSON
+const char *JSONCodec::media_type() const
+{
+    return "application/json";
+}
+
+ServiceDescription JSONCodec::decode_service(const char *buf, size_t buflen) const
+{
+    /* nlohmann::json reports syntax errors with standard library exceptions */
+    try {
+        return ServiceDescription::from_json(buf, buflen);
+    }
+    catch (std::invalid_argument& e) {
+        throw ContentError(std::string("Arrowhead::JSONCodec: ") + e.what());
+    }
+    catch (std::out_of_range& e) {
+        throw ContentError(std::string("Arrowhead::JSONCodec: ") + e.what());
+    }
+    catch (std::domain_error& e) {
+        throw ContentError(std::string("Arrowhead::JSONCodec: ") + e.what());
+    }
+}
+
+void JSONCodec::decode_servicelist(std::vector<ServiceDescription>& out,
+    const char *buf, size_t buflen) const
+{
+    ARROWHEAD_LIB_HISTOGRAM(parse_time, "arrowhead_parse_duration_seconds", "format=\"json\"",
+        "Time to decode a service list");
+    ARROWHEAD_LIB_TIME_SCOPE(timer, parse_time);
+    ARROWHEAD_LIB_SPAN(span, "parse.json");
+    ARROWHEAD_LIB_SPAN_ARG(span, "bytes", buflen);
+    try {
+        parse_servicelist_json(std::back_inserter(out), buf, buflen);
+    }
+    catch (std::invalid_argument& e) {
+        throw ContentError(std::string("Arrowhead::JSONCodec: ") + e.what());
+    }
+    catch (std::out_of_range& e) {
+        throw ContentError(std::string("Arrowhead::JSONCodec: ") + e.what());
+    }
+    catch (std::domain_error& e) {
+        throw ContentError(std::string("Arrowhead::JSONCodec: ") + e.what());
+    }
+}
+
+std::string JSONCodec::encode_service(const ServiceDescription& sd) const
+{
+    return JSON::obj_from_service(sd).dump();
+}
+
+std::string JSONCodec::encode_servicelist(const std::vector<ServiceDescription>& services) const
+{
+    nlohmann::json js;
+    js["service"] = nlohmann::json::array();
+    for (auto& sd: services) {
+        js["service"].push_back(JSON::obj_from_service(sd));
+    }
+    return js.dump();
+}
+
+std::string JSONCodec::encode_service_name(const std::string& name) const
+{
+    nlohmann::json js;
+    js["name"] = name;
+    return js.dump();
+}
+
+const char *NDJSONCodec::media_type() const
+{
+    return "application/x-ndjson";
+}
+
+ServiceDescription NDJSONCodec::decode_service(const char *buf, size_t buflen) const
+{
+    return JSON::service_from_line(buf, buflen, 0);
+}
+
+void NDJSONCodec::decode_servicelist(std::vector<ServiceDescription>& out,
+    const char *buf, size_t buflen) const
+{
+    ARROWHEAD_LIB_HISTOGRAM(parse_time, "arrowhead_parse_duration_seconds", "format=\"ndjson\"",
+        "Time to decode a service list");
+    ARROWHEAD_LIB_TIME_SCOPE(timer, parse_time);
+    ARROWHEAD_LIB_SPAN(span, "parse.ndjson");
+    ARROWHEAD_LIB_SPAN_ARG(span, "bytes", buflen);
+    parse_servicelist_ndjson(std::back_inserter(out), buf, buflen);
+}
+
+std::string NDJSONCodec::encode_service(const ServiceDescription& sd) const
+{
+    std::string line;
+    JSON::append_service_line(line, sd);
+    return line;
+}
+
+std::string NDJSONCodec::encode_servicelist(const std::vector<ServiceDescription>& services) const
+{
+    std::string lines;
+    for (auto& sd: services) {
+        JSON::append_service_line(lines, sd);
+    }
+    return lines;
+}
+
+std::string NDJSONCodec::encode_service_name(const std::string& name) const
+{
+    nlohmann::json js;
+    js["name"] = name;
+    return js.dump() + '\n';
+}
+#endif /* ARROWHEAD_USE_JSON */
+
+#if ARROWHEAD_USE_PUGIXML
+const char *XMLCodec::media_type() const
+{
+    return "application/xml";
+}
+
+ServiceDescription XMLCodec::decode_service(const char *buf, size_t buflen) const
+{
+    return ServiceDescription::from_xml(buf, buflen);
+}
+
+void XMLCodec::decode_servicelist(std::vector<ServiceDescription>& out,
+    const char *buf, size_t buflen) const
+{
+    Status status = try_decode_servicelist(out, buf, buflen);
+    if (!status.ok()) {
+        status.raise();
+    }
+}
+
+Status XMLCodec::try_decode_servicelist(std::vector<ServiceDescription>& out,
+    const char *buf, size_t buflen) const
+{
+    ARROWHEAD_LIB_HISTOGRAM(parse_time, "arrowhead_parse_duration_seconds", "format=\"xml\"",
+        "Time to decode a service list");
+    ARROWHEAD_LIB_TIME_SCOPE(timer, parse_time);
+    ARROWHEAD_LIB_SPAN(span, "parse.xml");
+    ARROWHEAD_LIB_SPAN_ARG(span, "bytes", buflen);
+    /* PugiXML reports errors in the result, nothing here throws */
+    pugi::xml_document doc;
+    Status status = XML::try_parse_buffer(doc, buf, buflen);
+    if (!status.ok()) {
+        return status;
+    }
+    auto listnode = doc.child("serviceList");
+    if (listnode) {
+        for (auto srv: listnode.children("service")) {
+            out.push_back(XML::service_from_node(srv));
+        }
+    }
+    return Status();
+}
+
+std::string XMLCodec::encode_service(const ServiceDescription& sd) const
+{
+    std::string xml;
+    append_xml_service(xml, sd);
+    return xml;
+}
+
+std::string XMLCodec::encode_servicelist(const std::vector<ServiceDescription>& services) const
+{
+    std::string xml = "<serviceList>";
+    for (auto& sd: services) {
+        append_xml_service(xml, sd);
+    }
+    xml += "</serviceList>";
+    return xml;
+}
+#endif /* ARROWHEAD_USE_PUGIXML */
+
+#if ARROWHEAD_USE_CBOR
+const char *CBORCodec::media_type() const
+{
+    return "application/cbor";
+}
+
+ServiceDescription CBORCodec::decode_service(const char *buf, size_t buflen) const
+{
+    return ServiceDescription::from_cbor(buf, buflen);
+}
+
+void CBORCodec::decode_servicelist(std::vector<ServiceDescription>& out,
+    const char *buf, size_t buflen) const
+{
+    ARROWHEAD_LIB_HISTOGRAM(parse_time, "arrowhead_parse_duration_seconds", "format=\"cbor\"",
+        "Time to decode a service list");
+    ARROWHEAD_LIB_TIME_SCOPE(timer, parse_time);
+    ARROWHEAD_LIB_SPAN(span, "parse.cbor");
+    ARROWHEAD_LIB_SPAN_ARG(span, "bytes", buflen);
+    parse_servicelist_cbor(std::back_inserter(out), buf, buflen);
+}
+
+std::string CBORCodec::encode_service(const ServiceDescription& sd) const
+{
+    std::string cbor(CBOR::encode_service(sd, NULL, 0), '\0');
+    CBOR::encode_service(sd, &cbor[0], cbor.size());
+    return cbor;
+}
+
+std::string CBORCodec::encode_servicelist(const std::vector<ServiceDescription>& services) const
+{
+    std::string cbor(CBOR::encode_servicelist(services.begin(), services.end(), NULL, 0), '\0');
+    CBOR::encode_servicelist(services.begin(), services.end(), &cbor[0], cbor.size());
+    return cbor;
+}
+#endif /* ARROWHEAD_USE_CBOR */
+
+CodecRegistry CodecRegistry::builtin()
+{
+    CodecRegistry registry;
+#if ARROWHEAD_USE_JSON
+    registry.add(std::make_shared<JSONCodec>());
+#endif
+#if ARROWHEAD_USE_CBOR
+    registry.add(std::make_shared<CBORCodec>());
+#endif
+#if ARROWHEAD_USE_JSON
+    registry.add(std::make_shared<NDJSONCodec>());
+#endif
+#if ARROWHEAD_USE_PUGIXML
+    registry.add(std::make_shared<XMLCodec>());
+#endif
+    return registry;
+}
+
+void CodecRegistry::add(std::shared_ptr<const Codec> codec)
+{
+    std::string type = codec->media_type();
+    for (auto& c: list) {
+        if (type == c->media_type()) {
+            c = std::move(codec);
+            update_accept();
+            return;
+        }
+    }
+    list.push_back(std::move(codec));
+    update_accept();
+}
+
+void CodecRegistry::prefer(const std::string& media_type)
+{
+    std::string type = media_type_of(media_type);
+    auto it = std::find_if(list.begin(), list.end(),
+        [&type](const std::shared_ptr<const Codec>& c) { return type == c->media_type(); });
+    if (it == list.end()) {
+        ARROWHEAD_THROW(Error("Arrowhead::CodecRegistry: no codec for " + media_type));
+    }
+    std::rotate(list.begin(), it, it + 1);
+    update_accept();
+}
+
+const Codec *CodecRegistry::find(const std::string& content_type) const
+{
+    std::string type = media_type_of(content_type);
+    for (auto& c: list) {
+        if (type == c->media_type()) {
+            return c.get();
+        }
+    }
+    return NULL;
+}
+
+const Codec& CodecRegistry::preferred() const
+{
+    if (list.empty()) {
+        ARROWHEAD_THROW(Error("Arrowhead::CodecRegistry: no codecs registered"));
+    }
+    return *list.front();
+}
+
+void CodecRegistry::update_accept()
+{
+    accept.clear();
+    /* Quality values are given in tenths, every codec is still acceptable */
+    int q = 10;
+    for (auto& c: list) {
+        if (!accept.empty()) {
+            accept += ", ";
+        }
+        accept += c->media_type();
+        if (q < 10) {
+            accept += ";q=0." + std::to_string(q);
+        }
+        if (q > 1) {
+            --q;
+        }
+    }
+}
+
+} /* namespace Arrowhead */
@@ -22,59 +22,163 @@
  * @author      Joakim Nohlgård <joakim@nohlgard.se>
  */
 
+#include <map>
 #include <string>
+#include <string_view>
 #include "arrowhead/config.h"
 
 #if ARROWHEAD_USE_JSON
 
+#include "arrowhead/exception.hpp"
 #include "arrowhead/service.hpp"
+#include "arrowhead/serviceschema.hpp"
 
-#include "nlohmann/json.hpp"
+#include "arrowhead/detail/_nlohmann_json.hpp"
 
 namespace Arrowhead {
 
 namespace JSON {
 
-ServiceDescription service_from_obj(const nlohmann::json& srv)
+namespace {
+
+/**
+ * @ingroup json_detail
+ * @{
+ */
+
+/**
+ * @brief Read a string field
+ */
+template<class CharT, class Traits, class Alloc>
+void read_value(std::basic_string<CharT, Traits, Alloc>& str, const nlohmann::json& js)
 {
-    ServiceDescription sd;
-    sd.name = srv["name"];
-    sd.type = srv["type"];
-    sd.domain = srv["domain"];
-    sd.host = srv["host"];
-    sd.port = srv["port"];
-    nlohmann::json props = srv["properties"]["property"];
+    const std::string& value = js.get_ref<const std::string&>();
+    str.assign(value.data(), value.size());
+}
+
+/**
+ * @brief Read the port field
+ */
+void read_value(unsigned int& port, const nlohmann::json& js)
+{
+    port = js;
+}
+
+/**
+ * @brief Read the properties field, `{"property": [{"name": ..., "value": ...}, ...]}`
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void read_value(std::map<Key, Value, Compare, Alloc>& properties, const nlohmann::json& js)
+{
+    properties.clear();
+    const nlohmann::json& props = js.at("property");
     for (auto it = props.begin(); it != props.end(); ++it)
     {
-        std::string name = (*it)["name"];
-        std::string value = (*it)["value"];
-        sd.properties[name] = value;
+        const std::string& name = it->at("name").get_ref<const std::string&>();
+        const std::string& value = it->at("value").get_ref<const std::string&>();
+        Key key(name, properties.get_allocator());
+        properties[std::move(key)] = value;
     }
-    return sd;
 }
 
-nlohmann::json obj_from_service(const ServiceDescription& sd)
+/**
+ * @brief Fill the fields of @p sd from a JSON object
+ *
+ * Shared between the std::allocator and std::pmr variants of ServiceDescription
+ *
+ * @param[out] sd   service description to fill
+ * @param[in]  srv  A JSON object
+ *
+ * @throws ContentError if @p srv is not an object or a field is missing
+ */
+template<class ServiceType>
+void fill_service(ServiceType& sd, const nlohmann::json& srv)
+{
+    if (!srv.is_object()) {
+        throw ContentError("Arrowhead::JSON: service is not an object");
+    }
+    unsigned int seen = 0;
+    for (auto it = srv.begin(); it != srv.end(); ++it)
+    {
+        const std::string& key = it.key();
+        const nlohmann::json& value = it.value();
+        int index = Schema::visit_field(sd, key.data(), key.size(),
+            [&value](std::string_view, auto& member) { read_value(member, value); });
+        if (index >= 0) {
+            seen |= 1u << index;
+        }
+    }
+    if (seen != Schema::ALL_FIELDS) {
+        for (size_t i = 0; i < Schema::FIELD_COUNT; ++i) {
+            if (!(seen & (1u << i))) {
+                throw ContentError("Arrowhead::JSON: missing key '" +
+                    std::string(Schema::keys[i]) + "'");
+            }
+        }
+    }
+}
+
+/**
+ * @brief Convert a string field
+ */
+nlohmann::json write_value(const std::string& str)
+{
+    return str;
+}
+
+/**
+ * @brief Convert the port field
+ */
+nlohmann::json write_value(unsigned int port)
+{
+    return port;
+}
+
+/**
+ * @brief Convert the properties field
+ */
+nlohmann::json write_value(const std::map<std::string, std::string>& properties)
 {
-    using nlohmann::json; // Convenience
-    json js;
-    js["name"]   = sd.name;
-    js["type"]   = sd.type;
-    js["host"]   = sd.host;
-    js["domain"] = sd.domain;
-    js["port"]   = sd.port;
     // Silly format, change the below monstrosity to simply
     // js["properties"] = sd.properties;
     // when/if the format specification is updated
-    js["properties"] = json::object();
-    std::vector<std::map<std::string, std::string> > props;
-    for (auto it = sd.properties.begin(); it != sd.properties.end(); ++it)
+    nlohmann::json props = nlohmann::json::array();
+    for (auto it = properties.begin(); it != properties.end(); ++it)
     {
-        std::map<std::string, std::string> prop;
+        nlohmann::json prop;
         prop["name"] = it->first;
         prop["value"] = it->second;
         props.push_back(prop);
     }
-    js["properties"]["property"] = props;
+    nlohmann::json js;
+    js["property"] = props;
+    return js;
+}
+
+/** @} */
+} /* anonymous namespace */
+
+ServiceDescription service_from_obj(const nlohmann::json& srv)
+{
+    ServiceDescription sd;
+    fill_service(sd, srv);
+    return sd;
+}
+
+pmr::ServiceDescription service_from_obj(const nlohmann::json& srv,
+    std::pmr::memory_resource *mr)
+{
+    pmr::ServiceDescription sd(mr);
+    fill_service(sd, srv);
+    return sd;
+}
+
+nlohmann::json obj_from_service(const ServiceDescription& sd)
+{
+    nlohmann::json js = nlohmann::json::object();
+    Schema::for_each_field(sd, [&js](std::string_view key, const auto& member) {
+        js[std::string(key)] = write_value(member);
+    });
     return js;
 }
 
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Memory mapped input files implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arrowhead/mappedfile.hpp"
+
+namespace Arrowhead {
+
+MappedFile::MappedFile(const std::string& path, Mode mode) : addr(NULL), length(0)
+{
+    Status status = map(path, mode);
+    if (!status.ok()) {
+        status.raise();
+    }
+}
+
+Status MappedFile::map(const std::string& path, Mode mode)
+{
+    *this = MappedFile();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Status(Errc::IO, "MappedFile", "can not open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        std::string msg = "can not stat " + path + ": " + std::strerror(errno);
+        ::close(fd);
+        return Status(Errc::IO, "MappedFile", std::move(msg));
+    }
+    if (st.st_size == 0) {
+        /* mmap does not accept zero length mappings */
+        ::close(fd);
+        return Status();
+    }
+    int prot = PROT_READ;
+    int flags = MAP_SHARED;
+    if (mode == COPY_ON_WRITE) {
+        prot |= PROT_WRITE;
+        flags = MAP_PRIVATE;
+    }
+    void *ptr = ::mmap(NULL, st.st_size, prot, flags, fd, 0);
+    int err = errno;
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        return Status(Errc::IO, "MappedFile", "can not map " + path + ": " + std::strerror(err));
+    }
+    addr = static_cast<char *>(ptr);
+    length = st.st_size;
+    return Status();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : addr(other.addr), length(other.length)
+{
+    other.addr = NULL;
+    other.length = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    std::swap(addr, other.addr);
+    std::swap(length, other.length);
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    if (addr != NULL) {
+        ::munmap(addr, length);
+    }
+}
+
+void MappedFile::advise_sequential() const
+{
+    if (addr != NULL) {
+        ::madvise(addr, length, MADV_SEQUENTIAL);
+    }
+}
+
+} /* namespace Arrowhead */
@@ -0,0 +1,265 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Line delimited JSON (NDJSON) service list implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_JSON
+
+#include "arrowhead/service.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/serviceschema.hpp"
+
+#include "arrowhead/detail/_nlohmann_json.hpp"
+
+namespace Arrowhead {
+
+namespace JSON {
+
+namespace {
+
+/**
+ * @ingroup json_detail
+ * @{
+ */
+
+/**
+ * @brief Do not split the input into chunks smaller than this
+ *
+ * Smaller chunks are not worth the cost of starting a thread.
+ */
+const size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * @brief Append @p str as a quoted and escaped JSON string
+ */
+void append_string(std::string& out, const std::string& str)
+{
+    static const char hex[] = "0123456789abcdef";
+    out.push_back('"');
+    size_t run = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(str[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        /* Copy the run of characters not needing escapes in one go */
+        out.append(str, run, i - run);
+        run = i + 1;
+        switch (c) {
+            case '"':  out.append("\\\""); break;
+            case '\\': out.append("\\\\"); break;
+            case '\b': out.append("\\b"); break;
+            case '\f': out.append("\\f"); break;
+            case '\n': out.append("\\n"); break;
+            case '\r': out.append("\\r"); break;
+            case '\t': out.append("\\t"); break;
+            default:
+                out.append("\\u00");
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0xf]);
+                break;
+        }
+    }
+    out.append(str, run, std::string::npos);
+    out.push_back('"');
+}
+
+/**
+ * @brief Append a string field
+ */
+void append_value(std::string& out, const std::string& str)
+{
+    append_string(out, str);
+}
+
+/**
+ * @brief Append the port field
+ */
+void append_value(std::string& out, unsigned int port)
+{
+    out.append(std::to_string(port));
+}
+
+/**
+ * @brief Append the properties field in the same layout as obj_from_service()
+ */
+void append_value(std::string& out, const std::map<std::string, std::string>& properties)
+{
+    out.append("{\"property\":[");
+    for (auto it = properties.begin(); it != properties.end(); ++it) {
+        if (it != properties.begin()) {
+            out.push_back(',');
+        }
+        out.append("{\"name\":");
+        append_string(out, it->first);
+        out.append(",\"value\":");
+        append_string(out, it->second);
+        out.push_back('}');
+    }
+    out.append("]}");
+}
+
+/** @} */
+} /* anonymous namespace */
+
+ServiceDescription service_from_line(const char *line, size_t len, size_t offset)
+{
+    try {
+        nlohmann::json js = nlohmann::json::parse(std::string(line, len));
+        return service_from_obj(js);
+    }
+    catch (const std::exception& e) {
+        throw ContentError("Arrowhead::JSON: invalid service at byte offset " +
+            std::to_string(offset) + ": " + e.what());
+    }
+}
+
+void append_service_line(std::string& out, const ServiceDescription& sd)
+{
+    char sep = '{';
+    Schema::for_each_field(sd, [&out, &sep](std::string_view key, const auto& member) {
+        out.push_back(sep);
+        out.push_back('"');
+        out.append(key.data(), key.size());
+        out.append("\":");
+        append_value(out, member);
+        sep = ',';
+    });
+    out.append("}\n");
+}
+
+std::vector<std::vector<ServiceDescription> > parse_ndjson_chunks(const char *jsbuf,
+    size_t buflen, unsigned int threads)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    size_t max_chunks = buflen / MIN_CHUNK_SIZE + 1;
+    size_t nchunks = (threads == 0) ? 1 : threads;
+    if (nchunks > max_chunks) {
+        nchunks = max_chunks;
+    }
+
+    /* Chunk i is [bounds[i], bounds[i + 1]), every boundary follows a newline */
+    std::vector<size_t> bounds(1, 0);
+    for (size_t i = 1; i < nchunks; ++i) {
+        size_t pos = buflen / nchunks * i;
+        if (pos < bounds.back()) {
+            continue;
+        }
+        const char *nl = static_cast<const char *>(
+            std::memchr(jsbuf + pos, '\n', buflen - pos));
+        if (nl == NULL) {
+            break;
+        }
+        bounds.push_back(nl + 1 - jsbuf);
+    }
+    bounds.push_back(buflen);
+    nchunks = bounds.size() - 1;
+
+    std::vector<std::vector<ServiceDescription> > chunks(nchunks);
+    std::vector<std::exception_ptr> errors(nchunks);
+    auto parse_chunk = [&](size_t i) {
+        try {
+            LineReader reader(bounds[i]);
+            auto oit = reader.feed(std::back_inserter(chunks[i]),
+                jsbuf + bounds[i], bounds[i + 1] - bounds[i]);
+            reader.finish(oit);
+        }
+        catch (...) {
+            errors[i] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < nchunks; ++i) {
+        workers.emplace_back(parse_chunk, i);
+    }
+    parse_chunk(0);
+    for (auto& worker: workers) {
+        worker.join();
+    }
+    for (auto& error: errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return chunks;
+}
+
+bool LineReader::line(const char *data, size_t len, ServiceDescription& sd)
+{
+    size_t line_offset = offset;
+    offset += len + 1;
+    /* Tolerate CRLF line endings and blank lines */
+    while (len > 0 && std::strchr(" \t\r", data[len - 1]) != NULL) {
+        --len;
+    }
+    if (len == 0) {
+        return false;
+    }
+    sd = service_from_line(data, len, line_offset);
+    return true;
+}
+
+LineWriter::LineWriter(std::ostream& os, size_t buffer_size) :
+    os(os), buffer_size(buffer_size)
+{
+    buffer.reserve(buffer_size + 1024);
+}
+
+LineWriter::~LineWriter()
+{
+    try {
+        flush();
+    }
+    catch (const Error&) {
+        /* Destructors must not throw */
+    }
+}
+
+void LineWriter::flush()
+{
+    if (!buffer.empty()) {
+        os.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+    if (!os) {
+        throw Error("Arrowhead::JSON: failed writing service list");
+    }
+}
+
+} /* namespace JSON */
+
+} /* namespace Arrowhead */
+
+#endif /* ARROWHEAD_USE_JSON */
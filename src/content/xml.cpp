@@ -26,13 +26,18 @@
 
 #if ARROWHEAD_USE_PUGIXML
 
+#include <cstring>
+#include <map>
 #include <string>
+#include <string_view>
 #include <sstream>
 
 #include <pugixml.hpp>
 
 #include "arrowhead/exception.hpp"
+#include "arrowhead/result.hpp"
 #include "arrowhead/service.hpp"
+#include "arrowhead/serviceschema.hpp"
 
 namespace Arrowhead {
 
@@ -42,11 +47,23 @@ ServiceDescription ServiceDescription::from_xml(const char *xmlbuf, size_t bufle
     XML::parse_buffer(doc, xmlbuf, buflen);
     auto srv = doc.child("service");
     if (!srv) {
-        throw ContentError("Arrowhead::XML::parse_service: no <service> tag");
+        ARROWHEAD_THROW(ContentError("Arrowhead::XML::parse_service: no <service> tag"));
     }
     return XML::service_from_node(srv);
 }
 
+pmr::ServiceDescription pmr::ServiceDescription::from_xml(const char *xmlbuf,
+    size_t buflen, std::pmr::memory_resource *mr)
+{
+    pugi::xml_document doc;
+    XML::parse_buffer(doc, xmlbuf, buflen);
+    auto srv = doc.child("service");
+    if (!srv) {
+        ARROWHEAD_THROW(ContentError("Arrowhead::XML::parse_service: no <service> tag"));
+    }
+    return XML::service_from_node(srv, mr);
+}
+
 namespace XML {
 
 namespace {
@@ -72,34 +89,101 @@ std::string xml_error_string(const pugi::xml_parse_result& result)
     return ss.str();
 }
 
+/**
+ * @brief Read a string field from the text of @p node
+ */
+template<class CharT, class Traits, class Alloc>
+void read_value(std::basic_string<CharT, Traits, Alloc>& str, const pugi::xml_node& node)
+{
+    str = node.text().get();
+}
+
+/**
+ * @brief Read the port field from the text of @p node
+ */
+void read_value(unsigned int& port, const pugi::xml_node& node)
+{
+    port = node.text().as_uint();
+}
+
+/**
+ * @brief Read the properties field, `<properties><property><name/><value/></property>...`
+ */
+template<class Key, class Value, class Compare, class Alloc>
+void read_value(std::map<Key, Value, Compare, Alloc>& properties, const pugi::xml_node& node)
+{
+    for (auto child: node.children())
+    {
+        Key key(child.child("name").text().get(),
+            properties.get_allocator());
+        properties[std::move(key)] = child.child("value").text().get();
+    }
+}
+
+/**
+ * @brief Fill the fields of @p sd from a `<service>` node
+ *
+ * Shared between the std::allocator and std::pmr variants of ServiceDescription.
+ * Missing fields are left empty.
+ *
+ * @param[out] sd   service description to fill
+ * @param[in]  srv  A `<service>` XML node object
+ */
+template<class ServiceType>
+void fill_service(ServiceType& sd, const pugi::xml_node& srv)
+{
+    sd.port = 0;
+    for (auto child: srv.children())
+    {
+        const char *name = child.name();
+        Schema::visit_field(sd, name, std::strlen(name),
+            [&child](std::string_view, auto& member) { read_value(member, child); });
+    }
+}
+
 /** @} */
 } /* anonymous namespace */
 
 void parse_buffer(pugi::xml_document& doc, const char *xmlbuf, size_t buflen)
+{
+    Status status = try_parse_buffer(doc, xmlbuf, buflen);
+    if (!status.ok()) {
+        status.raise();
+    }
+}
+
+Status try_parse_buffer(pugi::xml_document& doc, const char *xmlbuf, size_t buflen)
 {
     pugi::xml_parse_result result = doc.load_buffer(xmlbuf, buflen);
 
+    if (result.status != pugi::status_ok) {
+        return Status(Errc::CONTENT, "XML::parse_buffer", xml_error_string(result));
+    }
+    return Status();
+}
+
+void parse_buffer_inplace(pugi::xml_document& doc, char *xmlbuf, size_t buflen)
+{
+    pugi::xml_parse_result result = doc.load_buffer_inplace(xmlbuf, buflen);
+
     if (result.status != pugi::status_ok) {
         std::string errmsg = xml_error_string(result);
-        throw ContentError(errmsg);
+        ARROWHEAD_THROW(ContentError(errmsg));
     }
 }
 
 ServiceDescription service_from_node(const pugi::xml_node& srv)
 {
-    pugi::xpath_query inner_text(".");
     ServiceDescription sd;
-    sd.name = inner_text.evaluate_string(srv.child("name"));
-    sd.type = inner_text.evaluate_string(srv.child("type"));
-    sd.domain = inner_text.evaluate_string(srv.child("domain"));
-    sd.host = inner_text.evaluate_string(srv.child("host"));
-    sd.port = inner_text.evaluate_number(srv.child("port"));
-    for (auto child: srv.child("properties").children())
-    {
-        std::string name = inner_text.evaluate_string(child.child("name"));
-        std::string value = inner_text.evaluate_string(child.child("value"));
-        sd.properties[name] = value;
-    }
+    fill_service(sd, srv);
+    return sd;
+}
+
+pmr::ServiceDescription service_from_node(const pugi::xml_node& srv,
+    std::pmr::memory_resource *mr)
+{
+    pmr::ServiceDescription sd(mr);
+    fill_service(sd, srv);
     return sd;
 }
 
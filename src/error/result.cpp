@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Error codes and results implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+#include <curl/curl.h>
+#endif
+
+#include "arrowhead/exception.hpp"
+#include "arrowhead/result.hpp"
+
+namespace Arrowhead {
+
+std::string Status::message() const
+{
+    std::string msg;
+    if (context != NULL) {
+        msg = context;
+        msg += ": ";
+    }
+    switch (code_) {
+        case Errc::OK:
+            msg += "success";
+            break;
+        case Errc::TRANSPORT:
+        case Errc::TIMEOUT:
+            if (detail_ == 0) {
+                msg += (code_ == Errc::TIMEOUT) ? "deadline exceeded" : "transport error";
+                break;
+            }
+            msg += "CURLError " + std::to_string(detail_);
+#if ARROWHEAD_USE_LIBCURL
+            msg += ": ";
+            msg += curl_easy_strerror(static_cast<CURLcode>(detail_));
+#endif
+            break;
+        case Errc::HTTP_STATUS:
+            msg += "HTTPError " + std::to_string(detail_);
+            break;
+        case Errc::CONTENT:
+            msg += "content error";
+            break;
+        case Errc::UNSUPPORTED_MEDIA_TYPE:
+            msg += "unsupported media type";
+            break;
+        case Errc::CIRCUIT_OPEN:
+            msg += "circuit breaker open";
+            break;
+        case Errc::OVERLOADED:
+            msg += "concurrency limit reached";
+            break;
+        case Errc::IO:
+            msg += "I/O error";
+            break;
+    }
+    if (!text.empty()) {
+        msg += ": ";
+        msg += text;
+    }
+    return msg;
+}
+
+void Status::raise() const
+{
+    switch (code_) {
+        case Errc::TRANSPORT:
+        case Errc::TIMEOUT:
+        case Errc::HTTP_STATUS:
+        case Errc::CIRCUIT_OPEN:
+        case Errc::OVERLOADED:
+            ARROWHEAD_THROW(TransportError(message()));
+        case Errc::CONTENT:
+        case Errc::UNSUPPORTED_MEDIA_TYPE:
+            ARROWHEAD_THROW(ContentError(message()));
+        default:
+            ARROWHEAD_THROW(Error(message()));
+    }
+}
+
+void fatal_error(const std::exception& e) noexcept
+{
+    std::fprintf(stderr, "Arrowhead: fatal error: %s\n", e.what());
+    std::abort();
+}
+
+} /* namespace Arrowhead */
@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Prometheus metrics endpoint implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "arrowhead/exception.hpp"
+#include "arrowhead/metrics.hpp"
+
+namespace Arrowhead {
+
+namespace Metrics {
+
+namespace {
+
+/* Requests are a single line plus headers, anything larger is not a scraper */
+const size_t MAX_REQUEST = 8192;
+
+bool send_all(int fd, const std::string& data)
+{
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} /* anonymous namespace */
+
+Endpoint::Endpoint(const Registry& registry, unsigned short port, const std::string& address) :
+    registry(registry), listen_fd(::socket(AF_INET, SOCK_STREAM, 0)), port_(0), stopping(false)
+{
+    if (listen_fd < 0) {
+        ARROWHEAD_THROW(Error("Arrowhead::Metrics::Endpoint: socket() failed"));
+    }
+    int one = 1;
+    ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    if (::inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1 ||
+        ::bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd, 16) != 0 ||
+        ::getsockname(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0) {
+        ::close(listen_fd);
+        ARROWHEAD_THROW(Error("Arrowhead::Metrics::Endpoint: can not listen on " +
+            address + ':' + std::to_string(port)));
+    }
+    port_ = ntohs(addr.sin_port);
+    thread = std::thread(&Endpoint::run, this);
+}
+
+Endpoint::~Endpoint()
+{
+    stopping = true;
+    /* Wakes up the blocking accept() */
+    ::shutdown(listen_fd, SHUT_RDWR);
+    thread.join();
+    ::close(listen_fd);
+}
+
+void Endpoint::run()
+{
+    while (!stopping) {
+        int fd = ::accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            /* Shut down */
+            return;
+        }
+        /* A stalled client must not block the scrapes for long */
+        struct timeval timeout = {2, 0};
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        serve(fd);
+        ::close(fd);
+    }
+}
+
+void Endpoint::serve(int fd)
+{
+    std::string request;
+    char buf[1024];
+    while (request.find("\r\n\r\n") == std::string::npos &&
+        request.find("\n\n") == std::string::npos) {
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0 || request.size() + static_cast<size_t>(n) > MAX_REQUEST) {
+            return;
+        }
+        request.append(buf, static_cast<size_t>(n));
+    }
+    size_t end = request.find_first_of("\r\n");
+    std::string line = request.substr(0, end);
+    bool head = line.compare(0, 5, "HEAD ") == 0;
+    bool metrics = line.compare(0, 13, "GET /metrics ") == 0 ||
+        line.compare(0, 13, "GET /metrics?") == 0 ||
+        line.compare(0, 14, "HEAD /metrics ") == 0 ||
+        line.compare(0, 14, "HEAD /metrics?") == 0;
+    std::string body = metrics ? registry.prometheus() : std::string("Not Found\n");
+    std::string response = metrics ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n";
+    response += metrics ? "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n" :
+        "Content-Type: text/plain\r\n";
+    response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    if (!head) {
+        response += body;
+    }
+    send_all(fd, response);
+}
+
+} /* namespace Metrics */
+
+} /* namespace Arrowhead */
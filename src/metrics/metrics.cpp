@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Metrics registry implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "arrowhead/exception.hpp"
+#include "arrowhead/metrics.hpp"
+
+namespace Arrowhead {
+
+namespace Metrics {
+
+namespace {
+
+/* Powers of two nanoseconds rendered as Prometheus histogram buckets */
+const unsigned int FIRST_LE_BIT = 10;
+const unsigned int LAST_LE_BIT = 36;
+
+const char *type_name(Type type)
+{
+    switch (type) {
+        case Type::COUNTER:
+            return "counter";
+        case Type::GAUGE:
+            return "gauge";
+        case Type::HISTOGRAM:
+            return "histogram";
+    }
+    return "untyped";
+}
+
+/* Append @p labels and @p extra, a further label, in braces if any */
+void append_labels(std::string& out, const std::string& labels, const char *extra = NULL)
+{
+    if (labels.empty() && extra == NULL) {
+        return;
+    }
+    out += '{';
+    out += labels;
+    if (extra != NULL) {
+        if (!labels.empty()) {
+            out += ',';
+        }
+        out += extra;
+    }
+    out += '}';
+}
+
+void append_number(std::string& out, double value)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", value);
+    out += buf;
+}
+
+} /* anonymous namespace */
+
+const size_t Histogram::SUB_BUCKETS;
+const size_t Histogram::BUCKETS;
+
+/* Constant initialized, so reading it needs no initialization check */
+thread_local size_t thread_shard_slot = 0;
+
+size_t assign_thread_shard()
+{
+    static std::atomic<size_t> next(0);
+    size_t shard = next.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    thread_shard_slot = shard + 1;
+    return shard;
+}
+
+Counter::Counter()
+{
+    for (Cell& cell: cells) {
+        cell.value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Counter::value() const
+{
+    uint64_t sum = 0;
+    for (const Cell& cell: cells) {
+        sum += cell.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+uint64_t HistogramSnapshot::count_below(std::chrono::nanoseconds limit) const
+{
+    if (limit.count() <= 0) {
+        return 0;
+    }
+    size_t end = Histogram::bucket_of(static_cast<uint64_t>(limit.count()));
+    if (Histogram::bucket_start(end) != static_cast<uint64_t>(limit.count())) {
+        ++end;
+    }
+    end = std::min(end, buckets.size());
+    uint64_t sum = 0;
+    for (size_t i = 0; i < end; ++i) {
+        sum += buckets[i];
+    }
+    return sum;
+}
+
+std::chrono::nanoseconds HistogramSnapshot::percentile(double q) const
+{
+    if (count == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i + 1 < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::chrono::nanoseconds(Histogram::bucket_start(i + 1));
+        }
+    }
+    return std::chrono::nanoseconds(Histogram::bucket_start(buckets.size() - 1));
+}
+
+Histogram::Histogram() : shards(new Shard[SHARDS])
+{
+    for (size_t s = 0; s < SHARDS; ++s) {
+        for (auto& bucket: shards[s].buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        shards[s].sum.store(0, std::memory_order_relaxed);
+    }
+}
+
+HistogramSnapshot Histogram::snapshot() const
+{
+    HistogramSnapshot snap;
+    snap.buckets.assign(BUCKETS, 0);
+    for (size_t s = 0; s < SHARDS; ++s) {
+        for (size_t i = 0; i < BUCKETS; ++i) {
+            snap.buckets[i] += shards[s].buckets[i].load(std::memory_order_relaxed);
+        }
+        snap.sum += shards[s].sum.load(std::memory_order_relaxed);
+    }
+    /* Counted from the buckets, so the count agrees with them even while
+     * other threads record, and recording has one update less */
+    for (uint64_t n: snap.buckets) {
+        snap.count += n;
+    }
+    return snap;
+}
+
+Registry& Registry::instance()
+{
+    /* Never destroyed, see the documentation */
+    static Registry *the_registry = new Registry;
+    return *the_registry;
+}
+
+Registry::Registry()
+{}
+
+Registry::Entry& Registry::entry(const std::string& name, const std::string& labels,
+    const std::string& help, Type type)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    /* Every series of a name has the same type */
+    auto first = entries.lower_bound(std::make_pair(name, std::string()));
+    if (first != entries.end() && first->first.first == name && first->second.type != type) {
+        ARROWHEAD_THROW(Error("Arrowhead::Metrics: " + name + " is a " +
+            type_name(first->second.type)));
+    }
+    auto it = entries.find(std::make_pair(name, labels));
+    if (it != entries.end()) {
+        return it->second;
+    }
+    Entry& e = entries[std::make_pair(name, labels)];
+    e.type = type;
+    e.help = (first != entries.end() && first->first.first == name) ? first->second.help : help;
+    switch (type) {
+        case Type::COUNTER:
+            e.counter.reset(new Counter);
+            break;
+        case Type::GAUGE:
+            e.gauge.reset(new Gauge);
+            break;
+        case Type::HISTOGRAM:
+            e.histogram.reset(new Histogram);
+            break;
+    }
+    return e;
+}
+
+Counter& Registry::counter(const std::string& name, const std::string& labels,
+    const std::string& help)
+{
+    return *entry(name, labels, help, Type::COUNTER).counter;
+}
+
+Gauge& Registry::gauge(const std::string& name, const std::string& labels,
+    const std::string& help)
+{
+    return *entry(name, labels, help, Type::GAUGE).gauge;
+}
+
+Histogram& Registry::histogram(const std::string& name, const std::string& labels,
+    const std::string& help)
+{
+    return *entry(name, labels, help, Type::HISTOGRAM).histogram;
+}
+
+std::vector<Sample> Registry::snapshot() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Sample> samples;
+    samples.reserve(entries.size());
+    for (const auto& kv: entries) {
+        Sample sample;
+        sample.name = kv.first.first;
+        sample.labels = kv.first.second;
+        sample.help = kv.second.help;
+        sample.type = kv.second.type;
+        sample.value = 0;
+        switch (sample.type) {
+            case Type::COUNTER:
+                sample.value = static_cast<int64_t>(kv.second.counter->value());
+                break;
+            case Type::GAUGE:
+                sample.value = kv.second.gauge->value();
+                break;
+            case Type::HISTOGRAM:
+                sample.histogram = kv.second.histogram->snapshot();
+                break;
+        }
+        samples.push_back(std::move(sample));
+    }
+    return samples;
+}
+
+std::string Registry::prometheus() const
+{
+    std::vector<Sample> samples = snapshot();
+    std::string out;
+    const std::string *previous = NULL;
+    for (const Sample& sample: samples) {
+        /* The samples are ordered by name, so all series of a name follow
+         * its HELP and TYPE lines */
+        if (previous == NULL || *previous != sample.name) {
+            out += "# HELP " + sample.name + ' ' + sample.help + '\n';
+            out += "# TYPE " + sample.name + ' ' + type_name(sample.type) + '\n';
+            previous = &sample.name;
+        }
+        if (sample.type != Type::HISTOGRAM) {
+            out += sample.name;
+            append_labels(out, sample.labels);
+            out += ' ' + std::to_string(sample.value) + '\n';
+            continue;
+        }
+        const HistogramSnapshot& h = sample.histogram;
+        for (unsigned int bit = FIRST_LE_BIT; bit <= LAST_LE_BIT; ++bit) {
+            std::string le = "le=\"";
+            append_number(le, static_cast<double>(uint64_t(1) << bit) * 1e-9);
+            le += '"';
+            out += sample.name + "_bucket";
+            append_labels(out, sample.labels, le.c_str());
+            out += ' ' + std::to_string(h.count_below(std::chrono::nanoseconds(
+                int64_t(1) << bit))) + '\n';
+        }
+        out += sample.name + "_bucket";
+        append_labels(out, sample.labels, "le=\"+Inf\"");
+        out += ' ' + std::to_string(h.count) + '\n';
+        out += sample.name + "_sum";
+        append_labels(out, sample.labels);
+        out += ' ';
+        append_number(out, static_cast<double>(h.sum) * 1e-9);
+        out += '\n';
+        out += sample.name + "_count";
+        append_labels(out, sample.labels);
+        out += ' ' + std::to_string(h.count) + '\n';
+    }
+    return out;
+}
+
+} /* namespace Metrics */
+
+} /* namespace Arrowhead */
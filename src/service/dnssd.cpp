@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Canonical DNS-SD name decomposition implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/dnssd.hpp"
+
+namespace Arrowhead {
+
+namespace {
+
+/**
+ * @brief FNV-1a 64 bit offset basis
+ */
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+
+/**
+ * @brief FNV-1a 64 bit prime
+ */
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+/**
+ * @brief ASCII lower case conversion, DNS names are case-insensitive for ASCII only
+ */
+char to_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+/**
+ * @brief Check whether a label is a DNS-SD protocol label
+ */
+bool is_protocol_label(std::string_view label)
+{
+    return label == "_tcp" || label == "_udp";
+}
+
+/**
+ * @brief Join labels [first, last) of @p name into a new canonical name
+ */
+CanonicalName join_labels(const CanonicalName& name, size_t first, size_t last)
+{
+    if (first >= last) {
+        return CanonicalName();
+    }
+    size_t begin = name.label(first).data() - name.str().data();
+    std::string_view tail = name.label(last - 1);
+    size_t end = (tail.data() - name.str().data()) + tail.size();
+    return CanonicalName(std::string_view(name.str()).substr(begin, end - begin));
+}
+
+} /* anonymous namespace */
+
+CanonicalName::CanonicalName(std::string_view name) : hash_(FNV_OFFSET_BASIS)
+{
+    /* Strip the root label, unless the dot is escaped */
+    if (!name.empty() && name.back() == '.' &&
+        !(name.size() >= 2 && name[name.size() - 2] == '\\')) {
+        name.remove_suffix(1);
+    }
+    text.reserve(name.size());
+    size_t label_start = 0;
+    bool escaped = false;
+    for (char c: name) {
+        c = to_lower(c);
+        if (!escaped && c == '.') {
+            spans.emplace_back(label_start, text.size() - label_start);
+            label_start = text.size() + 1;
+        }
+        escaped = (!escaped && c == '\\');
+        text.push_back(c);
+        hash_ = (hash_ ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+    }
+    if (!text.empty()) {
+        spans.emplace_back(label_start, text.size() - label_start);
+    }
+}
+
+ServiceNameComponents ServiceNameComponents::from_service(const ServiceDescription& sd)
+{
+    ServiceNameComponents comp;
+    comp.name = CanonicalName(sd.name);
+    comp.type = CanonicalName(sd.type);
+    comp.domain = CanonicalName(sd.domain);
+
+    /* <instance>.<service>.<protocol>.<domain>, find the protocol label */
+    size_t count = comp.name.label_count();
+    size_t proto = count;
+    for (size_t i = 2; i < count; ++i) {
+        if (is_protocol_label(comp.name.label(i)) &&
+            comp.name.label(i - 1).substr(0, 1) == "_") {
+            proto = i;
+            break;
+        }
+    }
+    if (proto == count) {
+        /* Not a DNS-SD service instance name */
+        comp.instance = comp.name;
+        return comp;
+    }
+    comp.instance = join_labels(comp.name, 0, proto - 1);
+    comp.service = join_labels(comp.name, proto - 1, proto);
+    comp.protocol = join_labels(comp.name, proto, proto + 1);
+    comp.name_domain = join_labels(comp.name, proto + 1, count);
+    return comp;
+}
+
+} /* namespace Arrowhead */
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service list snapshot comparison implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+
+#include "arrowhead/servicediff.hpp"
+
+namespace Arrowhead {
+
+namespace {
+
+/**
+ * @brief Record @p new_service as modified if any field differs from @p old_service
+ */
+void diff_pair(ServiceListDiff& diff, const ServiceDescription& old_service,
+    const ServiceDescription& new_service)
+{
+    unsigned int changed = compare_services(old_service, new_service);
+    if (changed != SERVICE_FIELD_NONE) {
+        diff.modified.push_back({&old_service, &new_service, changed});
+    }
+}
+
+} /* anonymous namespace */
+
+unsigned int compare_services(const ServiceDescription& a, const ServiceDescription& b)
+{
+    unsigned int changed = SERVICE_FIELD_NONE;
+    if (a.type != b.type) {
+        changed |= SERVICE_FIELD_TYPE;
+    }
+    if (a.domain != b.domain) {
+        changed |= SERVICE_FIELD_DOMAIN;
+    }
+    if (a.host != b.host) {
+        changed |= SERVICE_FIELD_HOST;
+    }
+    if (a.port != b.port) {
+        changed |= SERVICE_FIELD_PORT;
+    }
+    if (a.properties != b.properties) {
+        changed |= SERVICE_FIELD_PROPERTIES;
+    }
+    return changed;
+}
+
+ServiceListDiff diff_servicelists(const std::vector<ServiceDescription>& old_list,
+    const std::vector<ServiceDescription>& new_list)
+{
+    ServiceListDiff diff;
+
+    /* Index the old snapshot by name, the views point into old_list */
+    std::unordered_map<std::string_view, size_t> old_index;
+    old_index.reserve(old_list.size());
+    for (size_t i = 0; i < old_list.size(); ++i) {
+        old_index.emplace(old_list[i].name, i);
+    }
+
+    std::vector<bool> matched(old_list.size(), false);
+    for (auto& srv: new_list) {
+        auto it = old_index.find(srv.name);
+        if (it == old_index.end()) {
+            diff.added.push_back(&srv);
+            continue;
+        }
+        matched[it->second] = true;
+        diff_pair(diff, old_list[it->second], srv);
+    }
+
+    for (size_t i = 0; i < old_list.size(); ++i) {
+        if (!matched[i]) {
+            diff.removed.push_back(&old_list[i]);
+        }
+    }
+
+    return diff;
+}
+
+ServiceListDiff diff_sorted_servicelists(const std::vector<ServiceDescription>& old_list,
+    const std::vector<ServiceDescription>& new_list)
+{
+    ServiceListDiff diff;
+
+    auto old_it = old_list.begin();
+    auto new_it = new_list.begin();
+    while (old_it != old_list.end() && new_it != new_list.end()) {
+        int cmp = old_it->name.compare(new_it->name);
+        if (cmp < 0) {
+            diff.removed.push_back(&*old_it++);
+        }
+        else if (cmp > 0) {
+            diff.added.push_back(&*new_it++);
+        }
+        else {
+            diff_pair(diff, *old_it++, *new_it++);
+        }
+    }
+    for (; old_it != old_list.end(); ++old_it) {
+        diff.removed.push_back(&*old_it);
+    }
+    for (; new_it != new_list.end(); ++new_it) {
+        diff.added.push_back(&*new_it);
+    }
+
+    return diff;
+}
+
+void sort_servicelist(std::vector<ServiceDescription>& list)
+{
+    std::sort(list.begin(), list.end(),
+        [](const ServiceDescription& a, const ServiceDescription& b) {
+            return a.name < b.name;
+        });
+}
+
+} /* namespace Arrowhead */
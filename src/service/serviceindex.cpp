@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       In-memory multi-key service index implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <utility>
+
+#include "arrowhead/serviceindex.hpp"
+
+namespace Arrowhead {
+
+namespace {
+
+/**
+ * @brief Add @p sd to the postings for @p key
+ */
+template<class Index>
+void add_posting(Index& idx, const std::string& key, const ServiceDescription *sd)
+{
+    idx[key].insert(sd);
+}
+
+/**
+ * @brief Remove @p sd from the postings for @p key, dropping empty postings
+ */
+template<class Index>
+void remove_posting(Index& idx, const std::string& key, const ServiceDescription *sd)
+{
+    auto it = idx.find(key);
+    if (it == idx.end()) {
+        return;
+    }
+    it->second.erase(sd);
+    if (it->second.empty()) {
+        idx.erase(it);
+    }
+}
+
+/**
+ * @brief Look up the postings for @p key
+ *
+ * @return pointer to the postings, or NULL if there are none
+ */
+template<class Index>
+const typename Index::mapped_type *find_postings(const Index& idx, const std::string& key)
+{
+    auto it = idx.find(key);
+    if (it == idx.end()) {
+        return NULL;
+    }
+    return &it->second;
+}
+
+/**
+ * @brief Copy a set of postings into a result vector
+ */
+template<class Postings>
+ServiceIndex::result_type to_result(const Postings *postings)
+{
+    if (postings == NULL) {
+        return ServiceIndex::result_type();
+    }
+    return ServiceIndex::result_type(postings->begin(), postings->end());
+}
+
+} /* anonymous namespace */
+
+ServiceIndex::ServiceIndex(const ServiceIndex& other) : services(other.services)
+{
+    /* The secondary indexes of other point into its own services */
+    for (const auto& kv: services) {
+        index(&kv.second);
+    }
+}
+
+ServiceIndex::ServiceIndex(ServiceIndex&& other) :
+    services(std::move(other.services)), by_type(std::move(other.by_type)),
+    by_domain(std::move(other.by_domain)), by_host(std::move(other.by_host)),
+    by_property(std::move(other.by_property)), components(std::move(other.components))
+{
+}
+
+ServiceIndex& ServiceIndex::operator=(ServiceIndex&& other)
+{
+    services = std::move(other.services);
+    by_type = std::move(other.by_type);
+    by_domain = std::move(other.by_domain);
+    by_host = std::move(other.by_host);
+    by_property = std::move(other.by_property);
+    components = std::move(other.components);
+    return *this;
+}
+
+ServiceIndex& ServiceIndex::operator=(const ServiceIndex& other)
+{
+    if (this != &other) {
+        ServiceIndex copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+const ServiceDescription *ServiceIndex::insert(ServiceDescription sd)
+{
+    auto it = services.find(sd.name);
+    if (it != services.end()) {
+        unindex(&it->second);
+        it->second = std::move(sd);
+    }
+    else {
+        std::string name = sd.name;
+        it = services.emplace(std::move(name), std::move(sd)).first;
+    }
+    index(&it->second);
+    return &it->second;
+}
+
+bool ServiceIndex::erase(const std::string& name)
+{
+    auto it = services.find(name);
+    if (it == services.end()) {
+        return false;
+    }
+    unindex(&it->second);
+    services.erase(it);
+    return true;
+}
+
+void ServiceIndex::clear()
+{
+    components.clear();
+    by_property.clear();
+    by_host.clear();
+    by_domain.clear();
+    by_type.clear();
+    services.clear();
+}
+
+const ServiceDescription *ServiceIndex::find(const std::string& name) const
+{
+    auto it = services.find(name);
+    if (it == services.end()) {
+        return NULL;
+    }
+    return &it->second;
+}
+
+ServiceIndex::result_type ServiceIndex::find_by_type(const std::string& type) const
+{
+    return to_result(find_postings(by_type, type));
+}
+
+ServiceIndex::result_type ServiceIndex::find_by_domain(const std::string& domain) const
+{
+    return to_result(find_postings(by_domain, domain));
+}
+
+ServiceIndex::result_type ServiceIndex::find_by_host(const std::string& host) const
+{
+    return to_result(find_postings(by_host, host));
+}
+
+ServiceIndex::result_type ServiceIndex::find_by_property(const std::string& name,
+    const std::string& value) const
+{
+    return to_result(property_postings(name, value));
+}
+
+ServiceIndex::result_type ServiceIndex::select(const ServiceQuery& query) const
+{
+    std::vector<const postings_type *> criteria;
+    if (query.has_type) {
+        criteria.push_back(find_postings(by_type, query.type_));
+    }
+    if (query.has_domain) {
+        criteria.push_back(find_postings(by_domain, query.domain_));
+    }
+    if (query.has_host) {
+        criteria.push_back(find_postings(by_host, query.host_));
+    }
+    for (auto& prop: query.properties_) {
+        criteria.push_back(property_postings(prop.first, prop.second));
+    }
+
+    result_type result;
+    if (criteria.empty()) {
+        result.reserve(services.size());
+        for (auto& kv: services) {
+            result.push_back(&kv.second);
+        }
+        return result;
+    }
+
+    /* Drive the intersection from the most selective criterion */
+    const postings_type *smallest = NULL;
+    for (auto postings: criteria) {
+        if (postings == NULL) {
+            /* Some criterion has no matches at all */
+            return result;
+        }
+        if (smallest == NULL || postings->size() < smallest->size()) {
+            smallest = postings;
+        }
+    }
+
+    for (auto sd: *smallest) {
+        bool match = true;
+        for (auto postings: criteria) {
+            if (postings != smallest && postings->count(sd) == 0) {
+                match = false;
+                break;
+            }
+        }
+        if (match) {
+            result.push_back(sd);
+        }
+    }
+    return result;
+}
+
+const ServiceNameComponents *ServiceIndex::name_components(const ServiceDescription *sd) const
+{
+    if (sd == NULL) {
+        return NULL;
+    }
+    std::lock_guard<std::mutex> lock(components_mutex);
+    auto it = components.find(sd);
+    if (it == components.end()) {
+        auto srv = services.find(sd->name);
+        if (srv == services.end() || &srv->second != sd) {
+            return NULL;
+        }
+        /* Map nodes are stable, earlier results stay valid */
+        it = components.emplace(sd, ServiceNameComponents::from_service(*sd)).first;
+    }
+    return &it->second;
+}
+
+void ServiceIndex::index(const ServiceDescription *sd)
+{
+    add_posting(by_type, sd->type, sd);
+    add_posting(by_domain, sd->domain, sd);
+    add_posting(by_host, sd->host, sd);
+    for (auto& kv: sd->properties) {
+        add_posting(by_property[kv.first], kv.second, sd);
+    }
+}
+
+void ServiceIndex::unindex(const ServiceDescription *sd)
+{
+    components.erase(sd);
+    remove_posting(by_type, sd->type, sd);
+    remove_posting(by_domain, sd->domain, sd);
+    remove_posting(by_host, sd->host, sd);
+    for (auto& kv: sd->properties) {
+        auto it = by_property.find(kv.first);
+        if (it == by_property.end()) {
+            continue;
+        }
+        remove_posting(it->second, kv.second, sd);
+        if (it->second.empty()) {
+            by_property.erase(it);
+        }
+    }
+}
+
+const ServiceIndex::postings_type *ServiceIndex::property_postings(
+    const std::string& name, const std::string& value) const
+{
+    auto it = by_property.find(name);
+    if (it == by_property.end()) {
+        return NULL;
+    }
+    return find_postings(it->second, value);
+}
+
+} /* namespace Arrowhead */
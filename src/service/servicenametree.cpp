@@ -0,0 +1,378 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Radix tree index over DNS-SD service names implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "arrowhead/servicenametree.hpp"
+
+namespace Arrowhead {
+
+struct ServiceNameTree::Node {
+    /// Label of the edge leading to this node, empty only for the root
+    std::string label;
+    /// Service whose key ends at this node, if any
+    const ServiceDescription *value = NULL;
+    /// Child nodes, sorted by the first character of their label
+    std::vector<std::unique_ptr<Node> > children;
+};
+
+namespace {
+
+typedef ServiceNameTree::Node Node;
+
+/**
+ * @brief Find the position of the child whose label starts with @p c
+ *
+ * @return iterator to the child, or to the insert position if there is none
+ */
+template<class NodeType>
+auto child_pos(NodeType& n, char c) -> decltype(n.children.begin())
+{
+    return std::lower_bound(n.children.begin(), n.children.end(), c,
+        [](const std::unique_ptr<Node>& child, char ch) {
+            return child->label[0] < ch;
+        });
+}
+
+/**
+ * @brief Find the child whose label starts with @p c
+ *
+ * @return pointer to the child, or NULL
+ */
+const Node *find_child(const Node& n, char c)
+{
+    auto it = child_pos(n, c);
+    if (it == n.children.end() || (*it)->label[0] != c) {
+        return NULL;
+    }
+    return it->get();
+}
+
+/**
+ * @brief Insert or replace @p key in the tree rooted at @p root
+ *
+ * @return true if the key was not present before
+ */
+bool tree_insert(Node& root, const std::string& key, const ServiceDescription *value)
+{
+    Node *n = &root;
+    size_t pos = 0;
+    while (pos < key.size()) {
+        auto it = child_pos(*n, key[pos]);
+        if (it == n->children.end() || (*it)->label[0] != key[pos]) {
+            std::unique_ptr<Node> leaf(new Node);
+            leaf->label = key.substr(pos);
+            leaf->value = value;
+            n->children.insert(it, std::move(leaf));
+            return true;
+        }
+        Node *c = it->get();
+        size_t len = 0;
+        while (len < c->label.size() && pos + len < key.size() &&
+            c->label[len] == key[pos + len]) {
+            ++len;
+        }
+        if (len < c->label.size()) {
+            /* Split the edge at the first differing character */
+            std::unique_ptr<Node> mid(new Node);
+            mid->label = c->label.substr(0, len);
+            c->label.erase(0, len);
+            mid->children.push_back(std::move(*it));
+            *it = std::move(mid);
+        }
+        n = it->get();
+        pos += len;
+    }
+    bool fresh = (n->value == NULL);
+    n->value = value;
+    return fresh;
+}
+
+/**
+ * @brief Remove @p key from the subtree at @p n, merging nodes left with a single child
+ *
+ * @return the removed value, or NULL if the key was not found
+ */
+const ServiceDescription *tree_erase(Node& n, const std::string& key, size_t pos)
+{
+    if (pos == key.size()) {
+        const ServiceDescription *value = n.value;
+        n.value = NULL;
+        return value;
+    }
+    auto it = child_pos(n, key[pos]);
+    if (it == n.children.end() || key.compare(pos, (*it)->label.size(), (*it)->label) != 0) {
+        return NULL;
+    }
+    Node& c = **it;
+    const ServiceDescription *value = tree_erase(c, key, pos + c.label.size());
+    if (value == NULL || c.value != NULL) {
+        return value;
+    }
+    if (c.children.empty()) {
+        n.children.erase(it);
+    }
+    else if (c.children.size() == 1) {
+        std::unique_ptr<Node> only = std::move(c.children.front());
+        only->label = c.label + only->label;
+        *it = std::move(only);
+    }
+    return value;
+}
+
+/**
+ * @brief Find the node where the exact key @p key ends
+ *
+ * @return pointer to the node, or NULL
+ */
+const Node *tree_find(const Node& root, const std::string& key)
+{
+    const Node *n = &root;
+    size_t pos = 0;
+    while (pos < key.size()) {
+        n = find_child(*n, key[pos]);
+        if (n == NULL || key.compare(pos, n->label.size(), n->label) != 0) {
+            return NULL;
+        }
+        pos += n->label.size();
+    }
+    return n;
+}
+
+/**
+ * @brief Append all values in the subtree at @p n to @p out
+ */
+void collect(const Node& n, ServiceNameTree::result_type& out)
+{
+    if (n.value != NULL) {
+        out.push_back(n.value);
+    }
+    for (auto& c: n.children) {
+        collect(*c, out);
+    }
+}
+
+/**
+ * @brief Append all values whose key starts with @p prefix to @p out
+ */
+void tree_prefix(const Node& root, const std::string& prefix, ServiceNameTree::result_type& out)
+{
+    const Node *n = &root;
+    size_t pos = 0;
+    while (pos < prefix.size()) {
+        n = find_child(*n, prefix[pos]);
+        if (n == NULL) {
+            return;
+        }
+        size_t len = std::min(n->label.size(), prefix.size() - pos);
+        if (prefix.compare(pos, len, n->label, 0, len) != 0) {
+            return;
+        }
+        pos += len;
+    }
+    collect(*n, out);
+}
+
+/**
+ * @brief Match the keys in the subtree at @p n against a wildcard pattern
+ *
+ * @param[in]  n        current node
+ * @param[in]  off      position in the label of @p n
+ * @param[in]  pat      pattern
+ * @param[in]  pp       position in @p pat
+ * @param[in]  in_star  true while consuming a label matched by `*`
+ * @param[out] out      matching values
+ */
+void tree_match(const Node& n, size_t off, const std::string& pat, size_t pp,
+    bool in_star, ServiceNameTree::result_type& out)
+{
+    for (;;) {
+        if (off == n.label.size()) {
+            size_t end_pp = in_star ? pp + 1 : pp;
+            if (end_pp == pat.size() && n.value != NULL) {
+                out.push_back(n.value);
+            }
+            for (auto& c: n.children) {
+                tree_match(*c, 0, pat, pp, in_star, out);
+            }
+            return;
+        }
+        char c = n.label[off];
+        if (in_star) {
+            if (c == '.') {
+                /* End of the wildcard label, continue after the '*' */
+                in_star = false;
+                ++pp;
+                continue;
+            }
+            ++off;
+            continue;
+        }
+        if (pp == pat.size()) {
+            return;
+        }
+        if (pat[pp] == '*') {
+            if (c == '.') {
+                /* A wildcard never matches an empty label */
+                return;
+            }
+            in_star = true;
+            ++off;
+            continue;
+        }
+        if (pat[pp] != c) {
+            return;
+        }
+        ++pp;
+        ++off;
+    }
+}
+
+/**
+ * @brief @p name with a trailing dot, the key of both trees
+ *
+ * @param[in]  name  domain name
+ * @param[out] buf   storage for the result if @p name has no trailing dot
+ *
+ * @return @p name itself if it is empty or already ends with a dot, else @p buf
+ */
+const std::string& absolute_name(const std::string& name, std::string& buf)
+{
+    if (name.empty() || name.back() == '.') {
+        return name;
+    }
+    buf.reserve(name.size() + 1);
+    buf.assign(name);
+    buf.push_back('.');
+    return buf;
+}
+
+/**
+ * @brief Length of the pattern before the first wildcard
+ */
+size_t literal_lead(const std::string& pattern)
+{
+    size_t pos = pattern.find('*');
+    return (pos == std::string::npos) ? pattern.size() : pos;
+}
+
+} /* anonymous namespace */
+
+ServiceNameTree::ServiceNameTree() :
+    forward(new Node), reversed(new Node), count(0)
+{}
+
+ServiceNameTree::~ServiceNameTree() = default;
+ServiceNameTree::ServiceNameTree(ServiceNameTree&&) = default;
+ServiceNameTree& ServiceNameTree::operator=(ServiceNameTree&&) = default;
+
+void ServiceNameTree::insert(const ServiceDescription& sd)
+{
+    /* a.b and a.b. have the same reversed key, so they must be one name in
+     * both trees */
+    std::string buf;
+    if (tree_insert(*forward, absolute_name(sd.name, buf), &sd)) {
+        ++count;
+    }
+    tree_insert(*reversed, reverse_labels(sd.name), &sd);
+}
+
+bool ServiceNameTree::erase(const std::string& name)
+{
+    std::string buf;
+    if (tree_erase(*forward, absolute_name(name, buf), 0) == NULL) {
+        return false;
+    }
+    tree_erase(*reversed, reverse_labels(name), 0);
+    --count;
+    return true;
+}
+
+void ServiceNameTree::clear()
+{
+    forward.reset(new Node);
+    reversed.reset(new Node);
+    count = 0;
+}
+
+const ServiceDescription *ServiceNameTree::find(const std::string& name) const
+{
+    std::string buf;
+    const Node *n = tree_find(*forward, absolute_name(name, buf));
+    return (n == NULL) ? NULL : n->value;
+}
+
+ServiceNameTree::result_type ServiceNameTree::find_prefix(const std::string& prefix) const
+{
+    result_type out;
+    tree_prefix(*forward, prefix, out);
+    return out;
+}
+
+ServiceNameTree::result_type ServiceNameTree::find_suffix(const std::string& suffix) const
+{
+    result_type out;
+    if (suffix.empty() || suffix == ".") {
+        collect(*forward, out);
+        return out;
+    }
+    /* The trailing dot of the reversed key makes the match label aligned */
+    tree_prefix(*reversed, reverse_labels(suffix), out);
+    return out;
+}
+
+ServiceNameTree::result_type ServiceNameTree::match(const std::string& pattern) const
+{
+    result_type out;
+    std::string buf;
+    const std::string& apattern = absolute_name(pattern, buf);
+    std::string rpattern = reverse_labels(apattern);
+    if (literal_lead(rpattern) > literal_lead(apattern)) {
+        tree_match(*reversed, 0, rpattern, 0, false, out);
+        return out;
+    }
+    tree_match(*forward, 0, apattern, 0, false, out);
+    return out;
+}
+
+std::string ServiceNameTree::reverse_labels(const std::string& name)
+{
+    std::string out;
+    out.reserve(name.size() + 1);
+    size_t end = name.size();
+    if (end > 0 && name[end - 1] == '.') {
+        --end;
+    }
+    while (end > 0) {
+        size_t start = name.rfind('.', end - 1);
+        start = (start == std::string::npos) ? 0 : start + 1;
+        out.append(name, start, end - start);
+        out.push_back('.');
+        end = (start > 0) ? start - 1 : 0;
+    }
+    return out;
+}
+
+} /* namespace Arrowhead */
@@ -0,0 +1,632 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Memory mappable binary service list snapshots implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "arrowhead/servicesnapshot.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/metrics.hpp"
+
+namespace Arrowhead {
+
+namespace {
+
+/*
+ * File layout, all sections start at 8 byte aligned offsets:
+ *
+ *   Header
+ *   ServiceRecord[service_count]
+ *   PropertyRecord[property_count]
+ *   uint32_t name_index[service_count]   service numbers sorted by name
+ *   uint32_t type_index[service_count]   service numbers sorted by type, name
+ *   uint32_t host_index[service_count]   service numbers sorted by host, name
+ *   char strings[strings_size]           string pool, each distinct string once
+ *
+ * The checksum is the FNV-1a hash of everything after the header.
+ */
+
+/// Context string of the Status objects of snapshot errors
+const char CONTEXT[] = "ServiceSnapshot";
+
+const char SNAPSHOT_MAGIC[8] = {'A', 'H', 'S', 'N', 'A', 'P', '\0', '\0'};
+
+/**
+ * @brief Written in host byte order, used to detect foreign endianness
+ */
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    uint64_t checksum;
+    uint32_t service_count;
+    uint32_t property_count;
+    uint64_t services_offset;
+    uint64_t properties_offset;
+    uint64_t name_index_offset;
+    uint64_t type_index_offset;
+    uint64_t host_index_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+};
+
+/**
+ * @brief Reference to a string in the string pool
+ */
+struct StringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+/**
+ * @brief Indexes into ServiceRecord::fields
+ */
+enum Field {
+    FIELD_NAME = 0,
+    FIELD_TYPE = 1,
+    FIELD_DOMAIN = 2,
+    FIELD_HOST = 3,
+    FIELD_COUNT = 4,
+};
+
+struct ServiceRecord {
+    StringRef fields[FIELD_COUNT];
+    uint32_t port;
+    uint32_t first_property;
+    uint32_t property_count;
+    uint32_t reserved;
+};
+
+struct PropertyRecord {
+    StringRef name;
+    StringRef value;
+};
+
+static_assert(sizeof(Header) == 96, "unexpected snapshot header padding");
+static_assert(sizeof(ServiceRecord) == 48, "unexpected snapshot record padding");
+static_assert(sizeof(PropertyRecord) == 16, "unexpected snapshot record padding");
+
+uint64_t fnv1a(const char *data, size_t len)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < len; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * FNV_PRIME;
+    }
+    return hash;
+}
+
+size_t align8(size_t offset)
+{
+    return (offset + 7) & ~size_t(7);
+}
+
+const Header& header_of(const char *base)
+{
+    return *reinterpret_cast<const Header *>(base);
+}
+
+const ServiceRecord& record_of(const char *base, uint32_t index)
+{
+    const Header& hdr = header_of(base);
+    return reinterpret_cast<const ServiceRecord *>(base + hdr.services_offset)[index];
+}
+
+const PropertyRecord& property_of(const char *base, uint32_t index)
+{
+    const Header& hdr = header_of(base);
+    return reinterpret_cast<const PropertyRecord *>(base + hdr.properties_offset)[index];
+}
+
+std::string_view string_of(const char *base, StringRef ref)
+{
+    return std::string_view(base + header_of(base).strings_offset + ref.offset, ref.length);
+}
+
+/**
+ * @brief Check that @p count elements of @p size bytes at @p offset fit in the file
+ */
+bool section_fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t length)
+{
+    return offset % 4 == 0 && offset <= length && count <= (length - offset) / size;
+}
+
+bool string_fits(StringRef ref, uint64_t strings_size)
+{
+    return ref.offset <= strings_size && ref.length <= strings_size - ref.offset;
+}
+
+/**
+ * @brief Builds the string pool, storing every distinct string once
+ */
+class StringPool {
+    public:
+        StringRef add(const std::string& str)
+        {
+            auto it = offsets.find(str);
+            if (it != offsets.end()) {
+                return StringRef{it->second, static_cast<uint32_t>(str.size())};
+            }
+            if (pool.size() + str.size() > UINT32_MAX) {
+                ARROWHEAD_THROW(ContentError("Arrowhead::ServiceSnapshot: string pool too large"));
+            }
+            uint32_t offset = static_cast<uint32_t>(pool.size());
+            pool.append(str);
+            offsets.emplace(str, offset);
+            return StringRef{offset, static_cast<uint32_t>(str.size())};
+        }
+
+        const std::string& data() const
+        {
+            return pool;
+        }
+
+    private:
+        std::string pool;
+        std::unordered_map<std::string, uint32_t> offsets;
+};
+
+std::string errno_message(const std::string& what, const std::string& path)
+{
+    return "Arrowhead::ServiceSnapshot: " + what + " " + path + ": " + std::strerror(errno);
+}
+
+} /* anonymous namespace */
+
+std::string_view ServiceSnapshot::View::name() const
+{
+    return string_of(snap->base, record_of(snap->base, index).fields[FIELD_NAME]);
+}
+
+std::string_view ServiceSnapshot::View::type() const
+{
+    return string_of(snap->base, record_of(snap->base, index).fields[FIELD_TYPE]);
+}
+
+std::string_view ServiceSnapshot::View::domain() const
+{
+    return string_of(snap->base, record_of(snap->base, index).fields[FIELD_DOMAIN]);
+}
+
+std::string_view ServiceSnapshot::View::host() const
+{
+    return string_of(snap->base, record_of(snap->base, index).fields[FIELD_HOST]);
+}
+
+unsigned int ServiceSnapshot::View::port() const
+{
+    return record_of(snap->base, index).port;
+}
+
+size_t ServiceSnapshot::View::property_count() const
+{
+    return record_of(snap->base, index).property_count;
+}
+
+std::pair<std::string_view, std::string_view> ServiceSnapshot::View::property(size_t i) const
+{
+    const ServiceRecord& rec = record_of(snap->base, index);
+    const PropertyRecord& prop = property_of(snap->base, rec.first_property + i);
+    return std::make_pair(string_of(snap->base, prop.name), string_of(snap->base, prop.value));
+}
+
+std::optional<std::string_view> ServiceSnapshot::View::property(std::string_view name) const
+{
+    /* Properties are written in std::map order, i.e. sorted by name */
+    size_t lo = 0;
+    size_t hi = property_count();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        std::pair<std::string_view, std::string_view> prop = property(mid);
+        if (prop.first < name) {
+            lo = mid + 1;
+        }
+        else if (name < prop.first) {
+            hi = mid;
+        }
+        else {
+            return prop.second;
+        }
+    }
+    return std::nullopt;
+}
+
+ServiceDescription ServiceSnapshot::View::to_service() const
+{
+    ServiceDescription sd;
+    sd.name = name();
+    sd.type = type();
+    sd.domain = domain();
+    sd.host = host();
+    sd.port = port();
+    for (size_t i = 0; i < property_count(); ++i) {
+        std::pair<std::string_view, std::string_view> prop = property(i);
+        sd.properties.emplace(prop.first, prop.second);
+    }
+    return sd;
+}
+
+ServiceSnapshot::ServiceSnapshot() : base(NULL), service_count(0)
+{
+}
+
+ServiceSnapshot::ServiceSnapshot(const std::string& path, bool verify_checksum) :
+    base(NULL), service_count(0)
+{
+    Status status = open(path, verify_checksum);
+    if (!status.ok()) {
+        status.raise();
+    }
+}
+
+Status ServiceSnapshot::open(const std::string& path, bool verify_checksum)
+{
+    *this = ServiceSnapshot();
+    MappedFile mapped;
+    Status status = mapped.map(path);
+    if (!status.ok()) {
+        return status;
+    }
+    if (mapped.size() < sizeof(Header)) {
+        return Status(Errc::CONTENT, CONTEXT, path + " is too short");
+    }
+    file = std::move(mapped);
+    base = file.data();
+    status = validate(verify_checksum);
+    if (!status.ok()) {
+        *this = ServiceSnapshot();
+        return status;
+    }
+    service_count = header_of(base).service_count;
+    return Status();
+}
+
+ServiceSnapshot::ServiceSnapshot(ServiceSnapshot&& other) noexcept :
+    file(std::move(other.file)), base(other.base), service_count(other.service_count)
+{
+    other.base = NULL;
+    other.service_count = 0;
+}
+
+ServiceSnapshot& ServiceSnapshot::operator=(ServiceSnapshot&& other) noexcept
+{
+    if (this != &other) {
+        file = std::move(other.file);
+        base = other.base;
+        service_count = other.service_count;
+        other.file = MappedFile();
+        other.base = NULL;
+        other.service_count = 0;
+    }
+    return *this;
+}
+
+ServiceSnapshot::~ServiceSnapshot()
+{
+}
+
+Status ServiceSnapshot::validate(bool verify_checksum) const
+{
+    const Header& hdr = header_of(base);
+    const size_t length = file.size();
+    if (std::memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        return Status(Errc::CONTENT, CONTEXT, "not a snapshot file");
+    }
+    if (hdr.byte_order != BYTE_ORDER_MARK) {
+        return Status(Errc::CONTENT, CONTEXT, "snapshot has foreign byte order");
+    }
+    if (hdr.version != FORMAT_VERSION) {
+        return Status(Errc::CONTENT, CONTEXT, "unsupported format version " +
+            std::to_string(hdr.version));
+    }
+    if (hdr.file_size != length) {
+        return Status(Errc::CONTENT, CONTEXT, "file size mismatch");
+    }
+    if (!section_fits(hdr.services_offset, hdr.service_count, sizeof(ServiceRecord), length) ||
+        !section_fits(hdr.properties_offset, hdr.property_count, sizeof(PropertyRecord), length) ||
+        !section_fits(hdr.name_index_offset, hdr.service_count, sizeof(uint32_t), length) ||
+        !section_fits(hdr.type_index_offset, hdr.service_count, sizeof(uint32_t), length) ||
+        !section_fits(hdr.host_index_offset, hdr.service_count, sizeof(uint32_t), length) ||
+        !section_fits(hdr.strings_offset, hdr.strings_size, 1, length)) {
+        return Status(Errc::CONTENT, CONTEXT, "section out of bounds");
+    }
+    if (verify_checksum &&
+        fnv1a(base + sizeof(Header), length - sizeof(Header)) != hdr.checksum) {
+        return Status(Errc::CONTENT, CONTEXT, "checksum mismatch");
+    }
+    for (uint32_t i = 0; i < hdr.service_count; ++i) {
+        const ServiceRecord& rec = record_of(base, i);
+        for (size_t f = 0; f < FIELD_COUNT; ++f) {
+            if (!string_fits(rec.fields[f], hdr.strings_size)) {
+                return Status(Errc::CONTENT, CONTEXT, "string out of bounds");
+            }
+        }
+        if (rec.first_property > hdr.property_count ||
+            rec.property_count > hdr.property_count - rec.first_property) {
+            return Status(Errc::CONTENT, CONTEXT, "properties out of bounds");
+        }
+    }
+    for (uint32_t i = 0; i < hdr.property_count; ++i) {
+        const PropertyRecord& prop = property_of(base, i);
+        if (!string_fits(prop.name, hdr.strings_size) ||
+            !string_fits(prop.value, hdr.strings_size)) {
+            return Status(Errc::CONTENT, CONTEXT, "string out of bounds");
+        }
+    }
+    const uint64_t indexes[] = {
+        hdr.name_index_offset, hdr.type_index_offset, hdr.host_index_offset,
+    };
+    for (uint64_t offset: indexes) {
+        const uint32_t *idx = reinterpret_cast<const uint32_t *>(base + offset);
+        for (uint32_t i = 0; i < hdr.service_count; ++i) {
+            if (idx[i] >= hdr.service_count) {
+                return Status(Errc::CONTENT, CONTEXT, "index out of bounds");
+            }
+        }
+    }
+    return Status();
+}
+
+std::string ServiceSnapshot::serialize(const std::vector<const ServiceDescription *>& services)
+{
+    if (services.size() > UINT32_MAX) {
+        ARROWHEAD_THROW(ContentError("Arrowhead::ServiceSnapshot: too many services"));
+    }
+    StringPool strings;
+    std::vector<ServiceRecord> records;
+    std::vector<PropertyRecord> props;
+    records.reserve(services.size());
+    for (const ServiceDescription *sd: services) {
+        ServiceRecord rec = ServiceRecord();
+        rec.fields[FIELD_NAME] = strings.add(sd->name);
+        rec.fields[FIELD_TYPE] = strings.add(sd->type);
+        rec.fields[FIELD_DOMAIN] = strings.add(sd->domain);
+        rec.fields[FIELD_HOST] = strings.add(sd->host);
+        rec.port = sd->port;
+        rec.first_property = static_cast<uint32_t>(props.size());
+        rec.property_count = static_cast<uint32_t>(sd->properties.size());
+        for (auto it = sd->properties.begin(); it != sd->properties.end(); ++it) {
+            props.push_back(PropertyRecord{strings.add(it->first), strings.add(it->second)});
+        }
+        records.push_back(rec);
+    }
+
+    uint32_t count = static_cast<uint32_t>(services.size());
+    std::vector<uint32_t> order(count);
+    std::vector<uint32_t> indexes[3];
+    const std::string ServiceDescription::*keys[3] = {
+        &ServiceDescription::name, &ServiceDescription::type, &ServiceDescription::host,
+    };
+    for (size_t k = 0; k < 3; ++k) {
+        indexes[k].resize(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            indexes[k][i] = i;
+        }
+        const std::string ServiceDescription::*key = keys[k];
+        std::sort(indexes[k].begin(), indexes[k].end(),
+            [&services, key](uint32_t a, uint32_t b) {
+                const ServiceDescription& sa = *services[a];
+                const ServiceDescription& sb = *services[b];
+                int cmp = (sa.*key).compare(sb.*key);
+                return cmp < 0 || (cmp == 0 && sa.name < sb.name);
+            });
+    }
+
+    Header hdr = Header();
+    std::memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    hdr.version = FORMAT_VERSION;
+    hdr.byte_order = BYTE_ORDER_MARK;
+    hdr.service_count = count;
+    hdr.property_count = static_cast<uint32_t>(props.size());
+    size_t offset = align8(sizeof(Header));
+    hdr.services_offset = offset;
+    offset = align8(offset + records.size() * sizeof(ServiceRecord));
+    hdr.properties_offset = offset;
+    offset = align8(offset + props.size() * sizeof(PropertyRecord));
+    uint64_t *index_offsets[3] = {
+        &hdr.name_index_offset, &hdr.type_index_offset, &hdr.host_index_offset,
+    };
+    for (size_t k = 0; k < 3; ++k) {
+        *index_offsets[k] = offset;
+        offset = align8(offset + count * sizeof(uint32_t));
+    }
+    hdr.strings_offset = offset;
+    hdr.strings_size = strings.data().size();
+    hdr.file_size = offset + strings.data().size();
+
+    std::string image(hdr.file_size, '\0');
+    if (!records.empty()) {
+        std::memcpy(&image[hdr.services_offset], records.data(),
+            records.size() * sizeof(ServiceRecord));
+    }
+    if (!props.empty()) {
+        std::memcpy(&image[hdr.properties_offset], props.data(),
+            props.size() * sizeof(PropertyRecord));
+    }
+    for (size_t k = 0; k < 3; ++k) {
+        if (count > 0) {
+            std::memcpy(&image[*index_offsets[k]], indexes[k].data(), count * sizeof(uint32_t));
+        }
+    }
+    std::memcpy(&image[hdr.strings_offset], strings.data().data(), strings.data().size());
+    hdr.checksum = fnv1a(image.data() + sizeof(Header), image.size() - sizeof(Header));
+    std::memcpy(&image[0], &hdr, sizeof(Header));
+    return image;
+}
+
+void ServiceSnapshot::write_file(const std::string& path, const std::string& image)
+{
+    /* Unique per process and call, so concurrent writers never share a temporary */
+    static std::atomic<unsigned int> serial(0);
+    std::string tmp = path + ".tmp." + std::to_string(::getpid()) + "." +
+        std::to_string(serial++);
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ARROWHEAD_THROW(Error(errno_message("can not create", tmp)));
+    }
+    const char *data = image.data();
+    size_t remaining = image.size();
+    while (remaining > 0) {
+        ssize_t ret = ::write(fd, data, remaining);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret < 0) {
+            std::string msg = errno_message("can not write", tmp);
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            ARROWHEAD_THROW(Error(msg));
+        }
+        data += ret;
+        remaining -= ret;
+    }
+    if (::fsync(fd) != 0 || ::close(fd) != 0) {
+        std::string msg = errno_message("can not flush", tmp);
+        ::unlink(tmp.c_str());
+        ARROWHEAD_THROW(Error(msg));
+    }
+    if (::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::string msg = errno_message("can not rename to", path);
+        ::unlink(tmp.c_str());
+        ARROWHEAD_THROW(Error(msg));
+    }
+    /* Make the rename itself durable */
+    size_t slash = path.rfind('/');
+    std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    int dirfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd >= 0) {
+        ::fsync(dirfd);
+        ::close(dirfd);
+    }
+}
+
+std::optional<ServiceSnapshot::View> ServiceSnapshot::find(std::string_view name) const
+{
+    if (base == NULL) {
+        return std::nullopt;
+    }
+    result_type res = lookup(header_of(base).name_index_offset, FIELD_NAME, name);
+    if (res.empty()) {
+        return std::nullopt;
+    }
+    return res.front();
+}
+
+ServiceSnapshot::result_type ServiceSnapshot::find_by_type(std::string_view type) const
+{
+    if (base == NULL) {
+        return result_type();
+    }
+    return lookup(header_of(base).type_index_offset, FIELD_TYPE, type);
+}
+
+ServiceSnapshot::result_type ServiceSnapshot::find_by_host(std::string_view host) const
+{
+    if (base == NULL) {
+        return result_type();
+    }
+    return lookup(header_of(base).host_index_offset, FIELD_HOST, host);
+}
+
+ServiceSnapshot::result_type ServiceSnapshot::lookup(uint64_t index_offset, size_t field,
+    std::string_view key) const
+{
+    const uint32_t *first = reinterpret_cast<const uint32_t *>(base + index_offset);
+    const uint32_t *last = first + service_count;
+    const char *b = base;
+    auto field_of = [b, field](uint32_t i) {
+        return string_of(b, record_of(b, i).fields[field]);
+    };
+    const uint32_t *lo = std::lower_bound(first, last, key,
+        [&field_of](uint32_t i, std::string_view k) { return field_of(i) < k; });
+    const uint32_t *hi = std::upper_bound(lo, last, key,
+        [&field_of](std::string_view k, uint32_t i) { return k < field_of(i); });
+    result_type res;
+    res.reserve(hi - lo);
+    for (; lo != hi; ++lo) {
+        res.push_back(View(this, *lo));
+    }
+    return res;
+}
+
+SnapshotCache::SnapshotCache(const std::string& path) :
+    path(path), snapshot(std::make_shared<const ServiceSnapshot>()), file_id{0, 0, 0, 0}
+{
+    /* Start out empty if the file is bad, a later update() or reload() will fix it */
+    try_reload();
+}
+
+std::shared_ptr<const ServiceSnapshot> SnapshotCache::current() const
+{
+    return std::atomic_load(&snapshot);
+}
+
+bool SnapshotCache::reload()
+{
+    return try_reload().value();
+}
+
+Result<bool> SnapshotCache::try_reload()
+{
+    std::lock_guard<std::mutex> lock(reload_lock);
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    uint64_t id[4] = {
+        static_cast<uint64_t>(st.st_dev),
+        static_cast<uint64_t>(st.st_ino),
+        static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ull +
+            static_cast<uint64_t>(st.st_mtim.tv_nsec),
+        static_cast<uint64_t>(st.st_size),
+    };
+    if (std::equal(id, id + 4, file_id)) {
+        return false;
+    }
+    ARROWHEAD_LIB_COUNTER(reload_count, "arrowhead_snapshot_reloads_total", "",
+        "Snapshot files mapped by SnapshotCache::reload()");
+    auto next = std::make_shared<ServiceSnapshot>();
+    Status status = next->open(path);
+    if (!status.ok()) {
+        return status;
+    }
+    std::atomic_store(&snapshot, std::shared_ptr<const ServiceSnapshot>(std::move(next)));
+    ARROWHEAD_LIB_ADD(reload_count, 1);
+    std::copy(id, id + 4, file_id);
+    return true;
+}
+
+} /* namespace Arrowhead */
@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Tracing spans implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <mutex>
+
+#include <unistd.h>
+
+#include "arrowhead/exception.hpp"
+#include "arrowhead/tracing.hpp"
+
+namespace Arrowhead {
+
+namespace Tracing {
+
+namespace {
+
+/* The open trace file and its state, all guarded by file_mutex */
+std::mutex file_mutex;
+std::FILE *trace_file = NULL;
+size_t written = 0;
+
+std::atomic<uint64_t> next_span_id(1);
+std::atomic<unsigned int> next_thread_number(1);
+
+/* Small numbers are easier to tell apart in the viewer than thread IDs */
+thread_local unsigned int thread_number = 0;
+
+unsigned int this_thread_number()
+{
+    if (thread_number == 0) {
+        thread_number = next_thread_number.fetch_add(1, std::memory_order_relaxed);
+    }
+    return thread_number;
+}
+
+SpanContext new_span(const SpanContext& parent)
+{
+    SpanContext self;
+    self.span_id = next_span_id.fetch_add(1, std::memory_order_relaxed);
+    self.trace_id = parent.valid() ? parent.trace_id : self.span_id;
+    return self;
+}
+
+void append_id(std::string& out, const char *key, uint64_t id)
+{
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "\"%s\":\"%016llx\"", key,
+        static_cast<unsigned long long>(id));
+    out += buf;
+}
+
+/* Write one complete event, the IDs as hex strings, 64 bits do not fit a
+ * JSON number. The viewers show the times relative to the first event. */
+void write_event(const char *name, Clock::time_point start, Clock::duration duration,
+    const SpanContext& self, uint64_t parent_id, const SpanArg *args, size_t nargs)
+{
+    unsigned int tid = this_thread_number();
+    std::string event;
+    event.reserve(256);
+    char buf[160];
+    std::snprintf(buf, sizeof(buf),
+        "\"cat\":\"arrowhead\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u",
+        std::chrono::duration<double, std::micro>(start.time_since_epoch()).count(),
+        std::chrono::duration<double, std::micro>(duration).count(),
+        static_cast<int>(::getpid()), tid);
+    event += "{\"name\":\"";
+    event += name;
+    event += "\",";
+    event += buf;
+    event += ",\"args\":{";
+    append_id(event, "trace_id", self.trace_id);
+    event += ',';
+    append_id(event, "span_id", self.span_id);
+    if (parent_id != 0) {
+        event += ',';
+        append_id(event, "parent_id", parent_id);
+    }
+    for (size_t i = 0; i < nargs; ++i) {
+        event += ",\"";
+        event += args[i].key;
+        event += "\":";
+        event += std::to_string(args[i].value);
+    }
+    event += "}}";
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (trace_file == NULL) {
+        /* Closed while the span was open */
+        return;
+    }
+    if (written != 0) {
+        std::fputs(",\n", trace_file);
+    }
+    std::fwrite(event.data(), 1, event.size(), trace_file);
+    ++written;
+}
+
+} /* anonymous namespace */
+
+std::atomic<bool> tracing_enabled(false);
+
+thread_local SpanContext current_span = {0, 0};
+
+const size_t Span::MAX_ARGS;
+
+void record(const char *name, const SpanContext& parent, Clock::time_point start,
+    Clock::duration duration)
+{
+    if (!enabled()) {
+        return;
+    }
+    SpanContext self = new_span(parent);
+    write_event(name, start, duration, self, parent.span_id, NULL, 0);
+}
+
+void Span::begin(const SpanContext& parent)
+{
+    self = new_span(parent);
+    parent_id = parent.span_id;
+    previous = current_span;
+    current_span = self;
+    start = Clock::now();
+}
+
+void Span::end()
+{
+    Clock::duration duration = Clock::now() - start;
+    current_span = previous;
+    write_event(name, start, duration, self, parent_id, args, nargs);
+}
+
+TraceFile::TraceFile(const std::string& path) : file(NULL)
+{
+    std::lock_guard<std::mutex> lock(file_mutex);
+    if (trace_file != NULL) {
+        ARROWHEAD_THROW(Error("Arrowhead::Tracing::TraceFile: another trace file is open"));
+    }
+    file = std::fopen(path.c_str(), "w");
+    if (file == NULL) {
+        ARROWHEAD_THROW(Error("Arrowhead::Tracing::TraceFile: can not create " + path));
+    }
+    /* The JSON array form of the format, which loads without the closing
+     * bracket */
+    std::fputs("[\n", file);
+    trace_file = file;
+    written = 0;
+    tracing_enabled.store(true, std::memory_order_relaxed);
+}
+
+TraceFile::~TraceFile()
+{
+    tracing_enabled.store(false, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(file_mutex);
+    std::fputs("\n]\n", file);
+    std::fclose(file);
+    trace_file = NULL;
+}
+
+size_t TraceFile::events() const
+{
+    std::lock_guard<std::mutex> lock(file_mutex);
+    return written;
+}
+
+} /* namespace Tracing */
+
+} /* namespace Arrowhead */
@@ -35,6 +35,8 @@
 #include <boost/system/system_error.hpp>
 
 #include "arrowhead/coap.hpp"
+#include "arrowhead/metrics.hpp"
+#include "arrowhead/tracing.hpp"
 
 namespace Arrowhead {
 
@@ -121,11 +123,17 @@ void CoAPContext::add_resource(CoAPResource& res)
 
 void CoAPContext::perform_read()
 {
+    ARROWHEAD_LIB_COUNTER(read_count, "arrowhead_coap_packets_received_total", "",
+        "Datagrams read by the CoAP contexts");
     coap_read(ctx);
+    ARROWHEAD_LIB_ADD(read_count, 1);
 }
 
 void CoAPContext::handle_read(const boost::system::error_code& ec)
 {
+    /* Every datagram starts a trace of its own, the spans opened by the
+     * resource handlers are its children */
+    ARROWHEAD_LIB_SPAN(span, "coap.read");
     read_queued = false;
     if (!ec) {
         // call libcoap to let it know that a read is possible
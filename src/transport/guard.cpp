@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Circuit breaker and adaptive concurrency limit implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <utility>
+
+#include "arrowhead/guard.hpp"
+#include "arrowhead/metrics.hpp"
+#include "arrowhead/tracing.hpp"
+
+namespace Arrowhead {
+
+CircuitBreaker::CircuitBreaker(const Options& options) :
+    options(options), state_(CLOSED), outcomes(std::max(1u, options.window), false),
+    next_outcome(0), calls(0), failures(0), probes_in_flight(0), probe_successes(0)
+{
+}
+
+bool CircuitBreaker::allow()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (state_ == OPEN) {
+        if (clock::now() < opened_at + options.open_duration) {
+            return false;
+        }
+        state_ = HALF_OPEN;
+        probes_in_flight = 0;
+        probe_successes = 0;
+    }
+    if (state_ == HALF_OPEN) {
+        if (probes_in_flight + probe_successes >= std::max(1u, options.half_open_probes)) {
+            return false;
+        }
+        ++probes_in_flight;
+    }
+    return true;
+}
+
+void CircuitBreaker::record(bool failure)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    switch (state_) {
+        case CLOSED:
+            if (calls == outcomes.size()) {
+                failures -= outcomes[next_outcome];
+            }
+            else {
+                ++calls;
+            }
+            outcomes[next_outcome] = failure;
+            failures += failure;
+            next_outcome = (next_outcome + 1) % outcomes.size();
+            if (calls >= options.min_calls && failures >= options.failure_rate * calls) {
+                open(clock::now());
+            }
+            break;
+        case HALF_OPEN:
+            if (probes_in_flight > 0) {
+                --probes_in_flight;
+            }
+            if (failure) {
+                open(clock::now());
+            }
+            else if (++probe_successes >= std::max(1u, options.half_open_probes)) {
+                state_ = CLOSED;
+            }
+            break;
+        case OPEN:
+            /* A call which started before the breaker opened */
+            break;
+    }
+}
+
+CircuitBreaker::State CircuitBreaker::state() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return state_;
+}
+
+void CircuitBreaker::open(clock::time_point now)
+{
+    state_ = OPEN;
+    opened_at = now;
+    /* Start over with a clean window after closing again */
+    std::fill(outcomes.begin(), outcomes.end(), false);
+    next_outcome = 0;
+    calls = 0;
+    failures = 0;
+}
+
+AIMDLimit::AIMDLimit(const Options& options) :
+    options(options), limit_(options.initial_limit), in_flight_(0)
+{
+}
+
+bool AIMDLimit::try_acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (in_flight_ >= std::max(1.0, std::floor(limit_))) {
+        return false;
+    }
+    ++in_flight_;
+    return true;
+}
+
+void AIMDLimit::release(bool overload)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    --in_flight_;
+    if (overload) {
+        limit_ = std::max(options.min_limit, limit_ * options.backoff);
+    }
+    else {
+        limit_ = std::min(options.max_limit, limit_ + 1.0 / limit_);
+    }
+}
+
+void AIMDLimit::release_unused()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    --in_flight_;
+}
+
+double AIMDLimit::limit() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return limit_;
+}
+
+unsigned int AIMDLimit::in_flight() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return in_flight_;
+}
+
+TransportGuard::TransportGuard(const Options& options) :
+    breaker(options.breaker), limit(options.limit), options(options)
+{
+}
+
+Status TransportGuard::admit()
+{
+    /* The limit first, a probe admitted by a half-open breaker must be made */
+    if (!limit.try_acquire()) {
+        return Status(Errc::OVERLOADED, 0, "GuardedTransport");
+    }
+    if (!breaker.allow()) {
+        limit.release_unused();
+        return Status(Errc::CIRCUIT_OPEN, 0, "GuardedTransport");
+    }
+    return Status();
+}
+
+void TransportGuard::complete(const HTTPRequest& req, const Status& status,
+    const HTTPResponse& resp, clock::duration latency)
+{
+    bool failure = latency > options.slow_call;
+    if (!status.ok()) {
+        failure = failure || status.code() == Errc::TRANSPORT || status.code() == Errc::TIMEOUT;
+    }
+    else {
+        failure = failure || resp.status == 429 || resp.status >= 500;
+    }
+    breaker.record(failure);
+    limit.release(failure);
+
+    if (options.serve_stale && status.ok() && req.method == "GET" &&
+        resp.status >= 200 && resp.status < 300) {
+        ARROWHEAD_LIB_SPAN(span, "cache.insert");
+        ARROWHEAD_LIB_SPAN_ARG(span, "bytes", resp.body.size());
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        std::string key = cache_key(req);
+        auto it = cache.find(key);
+        if (it != cache.end()) {
+            /* Refreshed, it is the newest entry now */
+            it->second.resp = resp;
+            cache_age.splice(cache_age.end(), cache_age, it->second.age);
+            return;
+        }
+        if (options.cache_size == 0) {
+            return;
+        }
+        if (cache.size() >= options.cache_size) {
+            cache.erase(cache_age.front());
+            cache_age.pop_front();
+        }
+        cache_age.push_back(key);
+        CacheEntry& entry = cache[std::move(key)];
+        entry.resp = resp;
+        entry.age = std::prev(cache_age.end());
+    }
+}
+
+bool TransportGuard::cached(const HTTPRequest& req, HTTPResponse& resp) const
+{
+    ARROWHEAD_LIB_COUNTER(hit_count, "arrowhead_cache_requests_total",
+        "cache=\"stale_response\",result=\"hit\"", "Lookups in the caches of the library");
+    ARROWHEAD_LIB_COUNTER(miss_count, "arrowhead_cache_requests_total",
+        "cache=\"stale_response\",result=\"miss\"", "Lookups in the caches of the library");
+    if (!options.serve_stale || req.method != "GET") {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    auto it = cache.find(cache_key(req));
+    if (it == cache.end()) {
+        ARROWHEAD_LIB_ADD(miss_count, 1);
+        return false;
+    }
+    ARROWHEAD_LIB_ADD(hit_count, 1);
+    resp = it->second.resp;
+    return true;
+}
+
+std::string TransportGuard::cache_key(const HTTPRequest& req)
+{
+    /* The representation depends on the Accept header */
+    return req.url + '\n' + req.path + '\n' + req.accept;
+}
+
+} /* namespace Arrowhead */
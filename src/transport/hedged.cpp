@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Hedging multi-endpoint transport implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <curl/curl.h>
+#include "arrowhead/http.hpp"
+#include "arrowhead/logging.hpp"
+#include "arrowhead/tracing.hpp"
+#include "arrowhead/transport.hpp"
+
+namespace Arrowhead {
+
+namespace {
+
+typedef std::chrono::steady_clock clock;
+
+/// Context string of the Status objects returned by the transport
+const char CONTEXT[] = "CURLHedgedTransport";
+
+/// Number of latency samples kept per endpoint
+const size_t SAMPLE_COUNT = 64;
+
+/// Number of samples needed before the hedge delay follows the latencies
+const size_t MIN_SAMPLES = 8;
+
+/**
+ * @internal
+ * @brief One transfer of a hedged request
+ */
+struct Attempt {
+    size_t endpoint;
+    std::unique_ptr<HTTP::CURLContext> ctx;
+    HTTPResponse resp;
+    clock::time_point start;
+    bool running;
+};
+
+/**
+ * @internal
+ * @brief Idle multi handles, which keep the connections of earlier requests
+ *
+ * libcurl caches connections in the multi handle, a request taking a multi
+ * handle used by an earlier one reuses its connections. There are as many
+ * multi handles as requests were in flight at the same time.
+ */
+class MultiPool {
+    public:
+        MultiPool() = default;
+
+        ~MultiPool()
+        {
+            for (CURLM *multi: idle) {
+                curl_multi_cleanup(multi);
+            }
+        }
+
+        MultiPool(const MultiPool&) = delete;
+        MultiPool& operator=(const MultiPool&) = delete;
+
+        CURLM *acquire()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!idle.empty()) {
+                    CURLM *multi = idle.back();
+                    idle.pop_back();
+                    return multi;
+                }
+            }
+            CURLM *multi = curl_multi_init();
+            if (multi == NULL) {
+                ARROWHEAD_THROW(TransportError("curl_multi_init() failed!"));
+            }
+            return multi;
+        }
+
+        void release(CURLM *multi)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            idle.push_back(multi);
+        }
+
+    private:
+        std::mutex mutex;
+        std::vector<CURLM *> idle;
+};
+
+/**
+ * @internal
+ * @brief RAII wrapper of a pooled multi handle, removes unfinished transfers
+ * and returns the handle to the pool on destruction
+ */
+class MultiHandle {
+    public:
+        explicit MultiHandle(MultiPool& pool) : multi(pool.acquire()), pool(pool)
+        {}
+
+        ~MultiHandle()
+        {
+            for (CURL *easy: added) {
+                curl_multi_remove_handle(multi, easy);
+            }
+            pool.release(multi);
+        }
+
+        MultiHandle(const MultiHandle&) = delete;
+        MultiHandle& operator=(const MultiHandle&) = delete;
+
+        void add(CURL *easy)
+        {
+            curl_multi_add_handle(multi, easy);
+            added.push_back(easy);
+        }
+
+        void remove(CURL *easy)
+        {
+            curl_multi_remove_handle(multi, easy);
+            added.erase(std::find(added.begin(), added.end(), easy));
+        }
+
+        /**
+         * @brief Wait at most @p wait_ms for activity on the transfers
+         */
+        void wait(int wait_ms)
+        {
+#if LIBCURL_VERSION_NUM >= 0x074200
+            curl_multi_poll(multi, NULL, 0, wait_ms, NULL);
+#else
+            curl_multi_wait(multi, NULL, 0, wait_ms, NULL);
+#endif
+        }
+
+        /**
+         * @brief Run the single transfer @p easy to completion
+         *
+         * @return the result of the transfer
+         */
+        CURLcode perform(CURL *easy)
+        {
+            add(easy);
+            for (;;) {
+                int running;
+                curl_multi_perform(multi, &running);
+                CURLMsg *msg;
+                int queued;
+                while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+                    if (msg->msg == CURLMSG_DONE && msg->easy_handle == easy) {
+                        CURLcode result = msg->data.result;
+                        remove(easy);
+                        return result;
+                    }
+                }
+                /* The transfer timeout is set on the easy handle */
+                wait(1000);
+            }
+        }
+
+        CURLM *multi;
+
+    private:
+        MultiPool& pool;
+        std::vector<CURL *> added;
+};
+
+} // anonymous namespace
+
+/**
+ * @internal
+ * @brief Endpoint statistics and curl handles shared by all copies of a transport
+ */
+struct CURLHedgedTransport::State {
+    /* libcurl negotiates HTTP/2 for https:// by default, keep doing so */
+    explicit State(const Options& options) : options(options),
+        pool(options.tls, HTTPVersion::HTTP2_TLS, options.compression)
+    {}
+
+    struct Endpoint {
+        std::string url;
+        /// Ring buffer of recent latencies in microseconds
+        std::array<uint32_t, SAMPLE_COUNT> samples;
+        size_t nsamples = 0;
+        size_t next_sample = 0;
+        uint64_t requests = 0;
+        uint64_t failures = 0;
+        uint64_t cancelled = 0;
+        unsigned int consecutive_failures = 0;
+    };
+
+    Options options;
+    /// Easy handles of finished attempts, for the next ones
+    HTTP::CURLHandlePool pool;
+    /// Multi handles of finished requests, with their connections
+    MultiPool multis;
+    std::mutex mutex;
+    std::vector<Endpoint> endpoints;
+
+    /* Callers must hold the mutex for the following */
+
+    static std::chrono::microseconds percentile(const Endpoint& ep, double p)
+    {
+        if (ep.nsamples == 0) {
+            return std::chrono::microseconds(0);
+        }
+        std::array<uint32_t, SAMPLE_COUNT> sorted{};
+        std::copy_n(ep.samples.begin(), ep.nsamples, sorted.begin());
+        size_t k = static_cast<size_t>(std::ceil(p * ep.nsamples));
+        k = std::min(std::max<size_t>(k, 1), ep.nsamples) - 1;
+        std::nth_element(sorted.begin(), sorted.begin() + k, sorted.begin() + ep.nsamples);
+        return std::chrono::microseconds(sorted[k]);
+    }
+
+    std::chrono::microseconds hedge_delay_of(const Endpoint& ep) const
+    {
+        if (ep.nsamples < MIN_SAMPLES) {
+            return options.initial_hedge_delay;
+        }
+        return std::max<std::chrono::microseconds>(options.min_hedge_delay,
+            percentile(ep, options.hedge_percentile));
+    }
+
+    void add_sample(Endpoint& ep, clock::duration latency)
+    {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        ep.samples[ep.next_sample] = static_cast<uint32_t>(
+            std::min<decltype(us)>(us, UINT32_MAX));
+        ep.next_sample = (ep.next_sample + 1) % SAMPLE_COUNT;
+        ep.nsamples = std::min(ep.nsamples + 1, SAMPLE_COUNT);
+    }
+
+    /* The following lock the mutex themselves */
+
+    /**
+     * @brief Endpoint indices, healthy endpoints first, faster ones first
+     */
+    std::vector<size_t> ranking()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<std::pair<std::pair<bool, std::chrono::microseconds>, size_t>> keys;
+        for (size_t i = 0; i < endpoints.size(); ++i) {
+            keys.push_back(std::make_pair(std::make_pair(endpoints[i].consecutive_failures > 0,
+                percentile(endpoints[i], 0.5)), i));
+        }
+        std::stable_sort(keys.begin(), keys.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<size_t> order;
+        for (const auto& key: keys) {
+            order.push_back(key.second);
+        }
+        return order;
+    }
+
+    std::chrono::microseconds hedge_delay(size_t idx)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return hedge_delay_of(endpoints[idx]);
+    }
+
+    void started(size_t idx)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++endpoints[idx].requests;
+    }
+
+    void succeeded(size_t idx, clock::duration latency)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        endpoints[idx].consecutive_failures = 0;
+        add_sample(endpoints[idx], latency);
+    }
+
+    void failed(size_t idx)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++endpoints[idx].failures;
+        ++endpoints[idx].consecutive_failures;
+    }
+
+    void cancelled(size_t idx)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        /* The elapsed time is only a lower bound of the latency, a hedge
+         * cancelled right after its start would look fast */
+        ++endpoints[idx].cancelled;
+    }
+};
+
+CURLHedgedTransport::CURLHedgedTransport(const std::vector<std::string>& endpoints,
+    const Options& options) : state(std::make_shared<State>(options))
+{
+    state->endpoints.resize(endpoints.size());
+    for (size_t i = 0; i < endpoints.size(); ++i) {
+        state->endpoints[i].url = endpoints[i];
+    }
+}
+
+Status CURLHedgedTransport::perform(const HTTPRequest& req, HTTPResponse& resp) const
+{
+    ARROWHEAD_LIB_LOGGER(logger, "CURLHedgedTransport::perform");
+    if (req.deadline.expired()) {
+        return Status(Errc::TIMEOUT, 0, CONTEXT);
+    }
+    /* The phases of every attempt are children of this span */
+    ARROWHEAD_LIB_SPAN(span, "http.request");
+    std::vector<size_t> order = state->ranking();
+    if (order.empty()) {
+        return Status(Errc::TRANSPORT, 0, CONTEXT);
+    }
+
+    /* Declared before the multi handle, which must go first */
+    std::vector<std::unique_ptr<Attempt>> attempts;
+    MultiHandle multi(state->multis);
+    if (req.method != "GET") {
+        /* Not idempotent, try the next endpoint only if nothing was sent */
+        Status status;
+        for (size_t idx: order) {
+            if (req.deadline.expired()) {
+                return Status(Errc::TIMEOUT, 0, CONTEXT);
+            }
+            std::unique_ptr<HTTP::CURLContext> ctx = state->pool.acquire();
+            ctx->prepare(req, state->endpoints[idx].url + req.path, resp);
+            state->started(idx);
+            clock::time_point start = clock::now();
+            CURLcode curl_code = multi.perform(ctx->curl);
+            status = ctx->result(curl_code, resp, CONTEXT);
+            state->pool.release(std::move(ctx));
+            if (status.ok() && resp.status < 500) {
+                state->succeeded(idx, clock::now() - start);
+                return status;
+            }
+            state->failed(idx);
+            if (curl_code != CURLE_COULDNT_CONNECT && curl_code != CURLE_COULDNT_RESOLVE_HOST) {
+                return status;
+            }
+            ARROWHEAD_LIB_DEBUG(logger, "Failing over from " << state->endpoints[idx].url);
+        }
+        return status;
+    }
+
+    size_t next = 0;
+    size_t active = 0;
+    unsigned int hedges = 0;
+    auto launch = [&]() {
+        if (next >= order.size()) {
+            return false;
+        }
+        std::unique_ptr<Attempt> attempt(new Attempt);
+        attempt->endpoint = order[next++];
+        attempt->ctx = state->pool.acquire();
+        attempt->ctx->prepare(req, state->endpoints[attempt->endpoint].url + req.path,
+            attempt->resp);
+        curl_easy_setopt(attempt->ctx->curl, CURLOPT_PRIVATE, static_cast<void *>(attempt.get()));
+        state->started(attempt->endpoint);
+        attempt->start = clock::now();
+        attempt->running = true;
+        multi.add(attempt->ctx->curl);
+        attempts.push_back(std::move(attempt));
+        ++active;
+        return true;
+    };
+
+    launch();
+    clock::duration hedge_delay = state->hedge_delay(order[0]);
+    clock::time_point hedge_at = clock::now() + hedge_delay;
+    Attempt *winner = NULL;
+    /* A failed attempt which at least got a response, preferred over a transport error */
+    Attempt *answered = NULL;
+    Status last = Status(Errc::TRANSPORT, 0, CONTEXT);
+    while (winner == NULL) {
+        int running;
+        curl_multi_perform(multi.multi, &running);
+        CURLMsg *msg;
+        int queued;
+        while (winner == NULL && (msg = curl_multi_info_read(multi.multi, &queued)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            char *priv = NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+            Attempt *attempt = reinterpret_cast<Attempt *>(priv);
+            CURLcode curl_code = msg->data.result;
+            /* msg is invalid after removing the handle */
+            multi.remove(attempt->ctx->curl);
+            attempt->running = false;
+            --active;
+            Status status = attempt->ctx->result(curl_code, attempt->resp, CONTEXT);
+            state->pool.release(std::move(attempt->ctx));
+            if (status.ok() && attempt->resp.status < 500) {
+                state->succeeded(attempt->endpoint, clock::now() - attempt->start);
+                winner = attempt;
+                break;
+            }
+            state->failed(attempt->endpoint);
+            if (status.ok()) {
+                answered = attempt;
+            }
+            else {
+                last = status;
+            }
+            ARROWHEAD_LIB_DEBUG(logger, "Failing over from " <<
+                state->endpoints[attempt->endpoint].url);
+            launch();
+        }
+        if (winner != NULL || (active == 0 && !launch())) {
+            break;
+        }
+        clock::time_point now = clock::now();
+        if (req.deadline.expired(now)) {
+            last = Status(Errc::TIMEOUT, 0, CONTEXT);
+            answered = NULL;
+            break;
+        }
+        bool may_hedge = hedges < state->options.max_hedges && next < order.size();
+        if (may_hedge && now >= hedge_at) {
+            ARROWHEAD_LIB_DEBUG(logger, "Hedging to " << state->endpoints[order[next]].url);
+            launch();
+            ++hedges;
+            hedge_at = now + hedge_delay;
+            may_hedge = hedges < state->options.max_hedges && next < order.size();
+        }
+        clock::duration wait = std::chrono::seconds(1);
+        if (may_hedge) {
+            wait = std::min(wait, hedge_at - now);
+        }
+        if (req.deadline.is_set()) {
+            wait = std::min<clock::duration>(wait, req.deadline.time() - now);
+        }
+        /* Round up, a zero timeout would spin */
+        int wait_ms = static_cast<int>(
+            std::chrono::duration_cast<std::chrono::milliseconds>(wait).count()) + 1;
+        multi.wait(wait_ms);
+    }
+
+    /* Cancel the losers, their handles can only be reused once out of the
+     * multi handle */
+    for (const auto& attempt: attempts) {
+        if (attempt->running) {
+            state->cancelled(attempt->endpoint);
+            multi.remove(attempt->ctx->curl);
+            attempt->running = false;
+            state->pool.release(std::move(attempt->ctx));
+        }
+    }
+    if (winner == NULL) {
+        winner = answered;
+    }
+    if (winner == NULL) {
+        return last;
+    }
+    resp = std::move(winner->resp);
+    return Status();
+}
+
+HTTPResponse CURLHedgedTransport::perform(const HTTPRequest& req) const
+{
+    HTTPResponse resp;
+    Status status = perform(req, resp);
+    if (!status.ok()) {
+        status.raise();
+    }
+    return resp;
+}
+
+std::vector<CURLHedgedTransport::EndpointStats> CURLHedgedTransport::endpoint_stats() const
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    std::vector<EndpointStats> stats;
+    for (const State::Endpoint& ep: state->endpoints) {
+        EndpointStats st;
+        st.url = ep.url;
+        st.requests = ep.requests;
+        st.failures = ep.failures;
+        st.cancelled = ep.cancelled;
+        st.consecutive_failures = ep.consecutive_failures;
+        st.median_latency = State::percentile(ep, 0.5);
+        st.hedge_delay = std::chrono::duration_cast<std::chrono::microseconds>(
+            state->hedge_delay_of(ep));
+        stats.push_back(st);
+    }
+    return stats;
+}
+
+size_t CURLHedgedTransport::handles() const
+{
+    return state->pool.created();
+}
+
+} // namespace Arrowhead
+
+#endif /* ARROWHEAD_USE_LIBCURL */
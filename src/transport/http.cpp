@@ -26,9 +26,32 @@
 
 #if ARROWHEAD_USE_LIBCURL
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <new>
 #include <stdexcept>
+#include <strings.h>
+#include <sys/stat.h>
 #include <curl/curl.h>
+#if ARROWHEAD_USE_OPENSSL
+#include <openssl/ssl.h>
+#endif
+#if ARROWHEAD_USE_ZLIB
+#include <zlib.h>
+#endif
+#include "arrowhead/compression.hpp"
 #include "arrowhead/http.hpp"
+#include "arrowhead/latency.hpp"
+#include "arrowhead/metrics.hpp"
+#include "arrowhead/tls.hpp"
+#include "arrowhead/tracing.hpp"
+#include "arrowhead/transport.hpp"
 
 /**
  * @ingroup  http
@@ -65,15 +88,271 @@ extern "C" size_t curl_callback_wrapper(char *ptr, size_t size, size_t nmemb, vo
     return obj->callback(ptr, size, nmemb);
 }
 
+/**
+ * @brief  Header callback, lets the CURLContext look at the connection once
+ * the response starts
+ */
+extern "C" size_t curl_header_wrapper(char *ptr, size_t size, size_t nitems, void *userdata) {
+    CURLContext *ctx = reinterpret_cast<CURLContext *>(userdata);
+    ctx->check_tls_session();
+    ctx->check_content_encoding(ptr, size * nitems);
+    return size * nitems;
+}
+
+/**
+ * @brief  C wrapper for CURLShare::lock()
+ */
+extern "C" void curl_share_lock_wrapper(CURL *, curl_lock_data data, curl_lock_access,
+    void *userptr)
+{
+    reinterpret_cast<CURLShare *>(userptr)->lock(data);
+}
+
+/**
+ * @brief  C wrapper for CURLShare::unlock()
+ */
+extern "C" void curl_share_unlock_wrapper(CURL *, curl_lock_data data, void *userptr)
+{
+    reinterpret_cast<CURLShare *>(userptr)->unlock(data);
+}
+
+/// Length of the `unix://` scheme prefix
+const size_t UNIX_SCHEME_LEN = sizeof("unix://") - 1;
+
+/**
+ * @brief  Find the end of the socket path in a `unix://` URL
+ *
+ * The socket path ends at the first path component which is a socket, the
+ * rest is the request path. If no component is a socket, the whole path is
+ * taken as the socket path and the connection attempt reports the error.
+ *
+ * @param[in]  url    URL starting with `unix://`
+ * @param[out] found  set if a path component is a socket
+ *
+ * @return the offset in @p url after the socket path
+ */
+size_t unix_socket_end(const std::string& url, bool& found)
+{
+    size_t end = url.find_first_of("?#", UNIX_SCHEME_LEN);
+    if (end == std::string::npos) {
+        end = url.size();
+    }
+    std::string socket_path;
+    size_t pos = UNIX_SCHEME_LEN;
+    while (pos < end) {
+        size_t slash = url.find('/', pos + 1);
+        if (slash == std::string::npos || slash > end) {
+            slash = end;
+        }
+        struct stat st;
+        socket_path.assign(url, UNIX_SCHEME_LEN, slash - UNIX_SCHEME_LEN);
+        if (::stat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            found = true;
+            return slash;
+        }
+        pos = slash;
+    }
+    found = false;
+    return end;
+}
+
+#if ARROWHEAD_USE_ZLIB
+/**
+ * @brief  Compress @p in to a gzip member in @p out
+ *
+ * @return false if zlib failed
+ */
+bool gzip(const std::string& in, int level, std::string& out)
+{
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    /* 16 + MAX_WBITS selects the gzip wrapper instead of zlib */
+    if (deflateInit2(&zs, level, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    /* Large enough for a single deflate() call */
+    out.resize(deflateBound(&zs, in.size()));
+    zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast<Bytef *>(&out[0]);
+    zs.avail_out = out.size();
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END;
+}
+#endif
+
 /** @} */
+
+/* Counters behind tls_stats() */
+std::atomic<uint64_t> full_handshakes(0);
+std::atomic<uint64_t> resumed_handshakes(0);
+std::atomic<uint64_t> reused_connections(0);
+
+/* Counters behind compression_stats() */
+std::atomic<uint64_t> responses(0);
+std::atomic<uint64_t> compressed_responses(0);
+std::atomic<uint64_t> response_wire_bytes(0);
+std::atomic<uint64_t> response_bytes(0);
+std::atomic<uint64_t> compressed_requests(0);
+std::atomic<uint64_t> request_bytes(0);
+std::atomic<uint64_t> request_wire_bytes(0);
+std::atomic<uint64_t> total_time_us(0);
+
+/* Breakdowns behind latency_stats(), by operation and then endpoint. The
+ * transparent comparators find the entry of a request without building a
+ * key, so only the first request to an endpoint allocates. Each thread
+ * records into the shard of Metrics::thread_shard(), so the transports of
+ * different threads do not contend for one lock, and latency_stats() merges
+ * the shards. */
+typedef std::map<std::string, RequestLatency, std::less<> > EndpointLatency;
+struct LatencyShard {
+    std::mutex mutex;
+    std::map<std::string, EndpointLatency, std::less<> > latency;
+};
+LatencyShard latency_shards[Metrics::SHARDS];
+
+void record_latency(const std::string& operation, const std::string& endpoint,
+    const RequestTiming& timing)
+{
+    LatencyShard& shard = latency_shards[Metrics::thread_shard()];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto op = shard.latency.find(operation);
+    if (op == shard.latency.end()) {
+        op = shard.latency.emplace(operation, EndpointLatency()).first;
+    }
+    auto ep = op->second.find(endpoint);
+    if (ep == op->second.end()) {
+        ep = op->second.emplace(endpoint, RequestLatency()).first;
+    }
+    ep->second.record(timing);
+}
+
+/**
+ * @brief  Time @p info of the finished transfer on @p curl
+ */
+std::chrono::microseconds transfer_time(CURL *curl, CURLINFO info)
+{
+#if LIBCURL_VERSION_NUM >= 0x073d00
+    curl_off_t us = 0;
+    curl_easy_getinfo(curl, info, &us);
+    return std::chrono::microseconds(us);
+#else
+    double s = 0;
+    curl_easy_getinfo(curl, info, &s);
+    return std::chrono::microseconds(static_cast<int64_t>(s * 1e6));
+#endif
+}
+
+#if ARROWHEAD_USE_TRACING
+/**
+ * @brief  Record the phases of a transfer started at @p start as spans
+ *
+ * The times in @p timing are cumulative from the start, phases which did
+ * not take place, e.g. the connect on a reused connection, are left out.
+ */
+void record_phases(const Tracing::SpanContext& parent, Tracing::Clock::time_point start,
+    const RequestTiming& timing)
+{
+    struct Phase {
+        const char *name;
+        std::chrono::microseconds begin;
+        std::chrono::microseconds end;
+    };
+    const Phase phases[] = {
+        {"http.dns", std::chrono::microseconds(0), timing.namelookup},
+        {"http.connect", timing.namelookup, timing.connect},
+        {"http.tls", timing.connect, timing.appconnect},
+        {"http.first_byte", timing.pretransfer, timing.starttransfer},
+        {"http.last_byte", timing.starttransfer, timing.total},
+    };
+    for (const Phase& phase: phases) {
+        if (phase.end > phase.begin) {
+            Tracing::record(phase.name, parent, start + phase.begin, phase.end - phase.begin);
+        }
+    }
+}
+#endif
+
+/**
+ * @brief  Scheme, host and port of @p url, the part before the path
+ */
+void url_origin(const std::string& url, std::string& origin)
+{
+    size_t start = url.find("://");
+    start = (start == std::string::npos) ? 0 : start + 3;
+    size_t end = url.find_first_of("/?#", start);
+    origin.assign(url, 0, end);
+}
+
 } // anonymous namespace
 
-CURLContext::CURLContext() : curl(curl_easy_init()), headers(NULL), write_cb(NULL)
+size_t StringSink::callback(char *ptr, size_t size, size_t nmemb)
+{
+    size_t nbytes = size * nmemb;
+#if ARROWHEAD_USE_EXCEPTIONS
+    try {
+#endif
+        target->append(ptr, nbytes);
+#if ARROWHEAD_USE_EXCEPTIONS
+    }
+    catch (...) {
+        /* Exceptions must not cross libcurl, this aborts the transfer */
+        return 0;
+    }
+#endif
+    return nbytes;
+}
+
+CURLShare& CURLShare::instance()
+{
+    /* Initialized thread safely on first use */
+    static CURLShare the_share;
+    return the_share;
+}
+
+CURLShare::CURLShare() : share(curl_share_init())
+{
+    if (share == NULL) {
+        ARROWHEAD_THROW(TransportError("curl_share_init() failed!"));
+    }
+    curl_share_setopt(share, CURLSHOPT_USERDATA, static_cast<void *>(this));
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, curl_share_lock_wrapper);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, curl_share_unlock_wrapper);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    /* Not CURL_LOCK_DATA_CONNECT, a shared connection cache must not be used
+     * by concurrent threads */
+}
+
+CURLShare::~CURLShare()
+{
+    /* Fails harmlessly if an easy handle outlives us at program exit */
+    curl_share_cleanup(share);
+}
+
+void CURLShare::lock(curl_lock_data data)
+{
+    mutexes[data].lock();
+}
+
+void CURLShare::unlock(curl_lock_data data)
+{
+    mutexes[data].unlock();
+}
+
+CURLContext::CURLContext() : curl(curl_easy_init()), headers(NULL), write_cb(NULL),
+    headers_seen(false), tls_resumed(false), compressed_response(false),
+    headers_prepared(false), prepared_gzip(false), unix_socket_set(false), trace_parent{0, 0}
 {
     /* Verify initialization went OK */
     if (curl == NULL) {
-        throw TransportError("curl_easy_init() failed!");
+        ARROWHEAD_THROW(TransportError("curl_easy_init() failed!"));
     }
+    /* Share DNS cache and TLS sessions with all other handles */
+    curl_easy_setopt(curl, CURLOPT_SHARE, CURLShare::instance().handle());
+
     /* provide a buffer to store errors in */
     errbuf[0] = '\0';
     curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, errbuf);
@@ -85,11 +364,18 @@ CURLContext::CURLContext() : curl(curl_easy_init()), headers(NULL), write_cb(NUL
     /* some servers don't like requests that are made without a user-agent
        field, so we provide one */
     if (curl_easy_setopt(curl, CURLOPT_USERAGENT, HTTP_USERAGENT_STRING) != CURLE_OK) {
-        throw std::bad_alloc();
+        ARROWHEAD_THROW(std::bad_alloc());
     }
 
     /* Set up write callback */
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, curl_callback_wrapper);
+
+    /* The TLS session can only be inspected while the connection is open */
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, curl_header_wrapper);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, static_cast<void *>(this));
+
+    /* Timeouts must not use signals, the client may run in any thread */
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
 }
 
 CURLContext::~CURLContext()
@@ -107,12 +393,456 @@ void CURLContext::add_header(const char *str)
 {
     headers = curl_slist_append(headers, str);
     if (headers == NULL) {
-        throw std::bad_alloc();
+        ARROWHEAD_THROW(std::bad_alloc());
     }
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 }
 
+void CURLContext::prepare(const HTTPRequest& req, const std::string& url, HTTPResponse& resp)
+{
+    resp.body.clear();
+    resp.content_type.clear();
+    headers_seen = false;
+    tls_resumed = false;
+    compressed_response = false;
+    errbuf[0] = '\0';
+
+    /* A blackholed server would otherwise block us until the kernel gives up */
+    long timeout_ms = 0;
+    if (req.deadline.is_set()) {
+        /* At least 1 ms, zero would disable the timeout */
+        timeout_ms = std::max<long>(1, req.deadline.remaining().count());
+    }
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, timeout_ms);
+    /* Zero restores the libcurl default */
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS,
+        static_cast<long>(req.connect_timeout.count()));
+
+    operation.assign(req.operation);
+    trace_parent = Tracing::current();
+    if (trace_parent.valid()) {
+        trace_start = Tracing::Clock::now();
+    }
+    if (url.compare(0, UNIX_SCHEME_LEN, "unix://") == 0) {
+        /* Finding the socket takes a stat() per path component, the requests
+         * of a client mostly go to the same socket */
+        size_t end = unix_prefix.size();
+        if (end == 0 || url.compare(0, end, unix_prefix) != 0 ||
+            (end < url.size() && url[end] != '/' && url[end] != '?' && url[end] != '#')) {
+            bool found;
+            end = unix_socket_end(url, found);
+            /* Without a socket, look again next time, it may appear */
+            unix_prefix.assign(url, 0, found ? end : 0);
+            unix_socket_set = false;
+        }
+        if (!unix_socket_set) {
+            /* libcurl copies the string */
+            curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH,
+                url.substr(UNIX_SCHEME_LEN, end - UNIX_SCHEME_LEN).c_str());
+            unix_socket_set = true;
+        }
+        unix_url.assign("http://localhost");
+        if (end == url.size() || url[end] != '/') {
+            unix_url += '/';
+        }
+        unix_url.append(url, end, std::string::npos);
+        curl_easy_setopt(curl, CURLOPT_URL, unix_url.c_str());
+        endpoint.assign(url, 0, end);
+    }
+    else {
+        if (unix_socket_set) {
+            curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, static_cast<char *>(NULL));
+            unix_socket_set = false;
+        }
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        url_origin(url, endpoint);
+    }
+    bool gzip_body = false;
+    if (req.method == "POST") {
+        const std::string *body = &req.body;
+#if ARROWHEAD_USE_ZLIB
+        if (compression.compress_requests && req.body.size() >= compression.min_request_size &&
+            gzip(req.body, compression.level, request_body)) {
+            body = &request_body;
+            gzip_body = true;
+            ++compressed_requests;
+            request_bytes += req.body.size();
+            request_wire_bytes += request_body.size();
+        }
+#endif
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body->data());
+        /* if we don't provide POSTFIELDSIZE, libcurl will call strlen() by itself */
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body->size()));
+    }
+    else {
+        /* Undoes the POST of a previous request */
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    }
+
+    /* Consecutive requests of a client mostly have the same headers */
+    if (!headers_prepared || gzip_body != prepared_gzip || req.accept != prepared_accept ||
+        req.content_type != prepared_content_type) {
+        curl_slist_free_all(headers);
+        headers = NULL;
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, static_cast<struct curl_slist *>(NULL));
+        if (!req.accept.empty()) {
+            add_header("Accept: " + req.accept);
+        }
+        if (!req.content_type.empty()) {
+            add_header("Content-Type: " + req.content_type);
+        }
+        if (gzip_body) {
+            add_header("Content-Encoding: gzip");
+        }
+        prepared_accept = req.accept;
+        prepared_content_type = req.content_type;
+        prepared_gzip = gzip_body;
+        headers_prepared = true;
+    }
+
+    /* Set up callback */
+    body_sink.target = &resp.body;
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, static_cast<void *>(&body_sink));
+}
+
+void CURLContext::apply_tls(const TLSOptions& tls)
+{
+    /* libcurl copies the strings */
+    if (!tls.ca_file.empty()) {
+        curl_easy_setopt(curl, CURLOPT_CAINFO, tls.ca_file.c_str());
+    }
+    if (!tls.ca_path.empty()) {
+        curl_easy_setopt(curl, CURLOPT_CAPATH, tls.ca_path.c_str());
+    }
+    if (!tls.client_cert.empty()) {
+        curl_easy_setopt(curl, CURLOPT_SSLCERT, tls.client_cert.c_str());
+    }
+    if (!tls.client_key.empty()) {
+        curl_easy_setopt(curl, CURLOPT_SSLKEY, tls.client_key.c_str());
+    }
+    if (!tls.key_password.empty()) {
+        curl_easy_setopt(curl, CURLOPT_KEYPASSWD, tls.key_password.c_str());
+    }
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, tls.verify_peer ? 1L : 0L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, tls.verify_host ? 2L : 0L);
+    /* The session cache itself lives in the CURLShare */
+    curl_easy_setopt(curl, CURLOPT_SSL_SESSIONID_CACHE, tls.session_resumption ? 1L : 0L);
+}
+
+void CURLContext::set_http_version(HTTPVersion version)
+{
+    long value = CURL_HTTP_VERSION_1_1;
+    switch (version) {
+        case HTTPVersion::HTTP1_1:
+            value = CURL_HTTP_VERSION_1_1;
+            break;
+        case HTTPVersion::HTTP2_TLS:
+            value = CURL_HTTP_VERSION_2TLS;
+            break;
+        case HTTPVersion::HTTP2:
+            value = CURL_HTTP_VERSION_2_0;
+            break;
+        case HTTPVersion::HTTP2_PRIOR_KNOWLEDGE:
+            value = CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE;
+            break;
+    }
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, value);
+}
+
+void CURLContext::apply_compression(const CompressionOptions& compression)
+{
+    this->compression = compression;
+    if (compression.accept_compressed) {
+        /* An empty string offers every encoding libcurl was built with */
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, compression.encodings.c_str());
+    }
+}
+
+void CURLContext::check_tls_session()
+{
+    if (headers_seen) {
+        return;
+    }
+    headers_seen = true;
+#if ARROWHEAD_USE_OPENSSL
+    const struct curl_tlssessioninfo *info = NULL;
+    if (curl_easy_getinfo(curl, CURLINFO_TLS_SSL_PTR, &info) == CURLE_OK && info != NULL &&
+        info->backend == CURLSSLBACKEND_OPENSSL && info->internals != NULL) {
+        tls_resumed = SSL_session_reused(static_cast<SSL *>(info->internals)) == 1;
+    }
+#endif
+}
+
+void CURLContext::check_content_encoding(const char *line, size_t len)
+{
+    static const char status_line[] = "HTTP/";
+    static const char name[] = "content-encoding:";
+    if (len >= sizeof(status_line) - 1 && std::memcmp(line, status_line, sizeof(status_line) - 1) == 0) {
+        /* Headers of the next response after a redirect or 100 Continue */
+        compressed_response = false;
+    }
+    else if (len > sizeof(name) - 1 && strncasecmp(line, name, sizeof(name) - 1) == 0) {
+        size_t pos = sizeof(name) - 1;
+        while (pos < len && (line[pos] == ' ' || line[pos] == '\t')) {
+            ++pos;
+        }
+        static const char identity[] = "identity";
+        compressed_response = pos < len && line[pos] != '\r' && line[pos] != '\n' &&
+            strncasecmp(line + pos, identity, sizeof(identity) - 1) != 0;
+    }
+}
+
+Status CURLContext::result(CURLcode curl_code, HTTPResponse& resp, const char *context) const
+{
+    ARROWHEAD_LIB_COUNTER(ok_count, "arrowhead_http_requests_total", "result=\"ok\"",
+        "Requests made by the libcurl transports");
+    ARROWHEAD_LIB_COUNTER(timeout_count, "arrowhead_http_requests_total",
+        "result=\"timeout\"", "Requests made by the libcurl transports");
+    ARROWHEAD_LIB_COUNTER(error_count, "arrowhead_http_requests_total",
+        "result=\"error\"", "Requests made by the libcurl transports");
+    ARROWHEAD_LIB_HISTOGRAM(duration, "arrowhead_http_request_duration_seconds", "",
+        "Time from the start of a request to its complete response");
+    ARROWHEAD_LIB_COUNTER(sent_count, "arrowhead_http_request_body_bytes_total", "",
+        "Request body bytes sent, after compression");
+    ARROWHEAD_LIB_COUNTER(received_count, "arrowhead_http_response_body_bytes_total", "",
+        "Response body bytes received, before decoding");
+
+    /* Check for errors, the message is only formatted if somebody asks */
+    if (curl_code == CURLE_OPERATION_TIMEDOUT) {
+        ARROWHEAD_LIB_ADD(timeout_count, 1);
+        return Status(Errc::TIMEOUT, curl_code, context);
+    }
+    if (curl_code != CURLE_OK) {
+        ARROWHEAD_LIB_ADD(error_count, 1);
+        return Status(Errc::TRANSPORT, curl_code, context);
+    }
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    const char *scheme = NULL;
+    curl_easy_getinfo(curl, CURLINFO_SCHEME, &scheme);
+    if (scheme != NULL && strcasecmp(scheme, "https") == 0) {
+        if (connects == 0) {
+            ++reused_connections;
+        }
+        else if (tls_resumed) {
+            ++resumed_handshakes;
+        }
+        else {
+            ++full_handshakes;
+        }
+    }
+    /* The download size counts the body as transferred, before decoding */
+#if LIBCURL_VERSION_NUM >= 0x073d00
+    curl_off_t wire_bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire_bytes);
+    curl_off_t sent_bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &sent_bytes);
+    static const CURLINFO times[] = {
+        CURLINFO_NAMELOOKUP_TIME_T, CURLINFO_CONNECT_TIME_T, CURLINFO_APPCONNECT_TIME_T,
+        CURLINFO_PRETRANSFER_TIME_T, CURLINFO_STARTTRANSFER_TIME_T, CURLINFO_TOTAL_TIME_T,
+    };
+#else
+    /* The curl_off_t variants need libcurl 7.61.0 */
+    double wire_bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD, &wire_bytes);
+    double sent_bytes = 0;
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD, &sent_bytes);
+    static const CURLINFO times[] = {
+        CURLINFO_NAMELOOKUP_TIME, CURLINFO_CONNECT_TIME, CURLINFO_APPCONNECT_TIME,
+        CURLINFO_PRETRANSFER_TIME, CURLINFO_STARTTRANSFER_TIME, CURLINFO_TOTAL_TIME,
+    };
+#endif
+    RequestTiming& timing = resp.timing;
+    timing.namelookup = transfer_time(curl, times[0]);
+    timing.connect = transfer_time(curl, times[1]);
+    timing.appconnect = transfer_time(curl, times[2]);
+    timing.pretransfer = transfer_time(curl, times[3]);
+    timing.starttransfer = transfer_time(curl, times[4]);
+    timing.total = transfer_time(curl, times[5]);
+    timing.bytes_sent = static_cast<uint64_t>(sent_bytes);
+    timing.bytes_received = static_cast<uint64_t>(wire_bytes);
+    timing.reused_connection = (connects == 0);
+    record_latency(operation, endpoint, timing);
+#if ARROWHEAD_USE_TRACING
+    if (trace_parent.valid()) {
+        record_phases(trace_parent, trace_start, timing);
+    }
+#endif
+    ARROWHEAD_LIB_ADD(ok_count, 1);
+    ARROWHEAD_LIB_OBSERVE(duration, timing.total);
+    ARROWHEAD_LIB_ADD(sent_count, timing.bytes_sent);
+    ARROWHEAD_LIB_ADD(received_count, timing.bytes_received);
+
+    ++responses;
+    if (compressed_response) {
+        ++compressed_responses;
+    }
+    response_wire_bytes += timing.bytes_received;
+    response_bytes += resp.body.size();
+    total_time_us += static_cast<uint64_t>(timing.total.count());
+
+    resp.status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &resp.status);
+    const char *content_type = NULL;
+    curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &content_type);
+    if (content_type != NULL) {
+        resp.content_type = content_type;
+    }
+    return Status();
+}
+
+CURLHandlePool::CURLHandlePool(const TLSOptions& tls, HTTPVersion version,
+    const CompressionOptions& compression, size_t max_idle) :
+    tls(tls), version(version), compression(compression), max_idle(max_idle), created_(0)
+{
+    /* release() never allocates */
+    idle.reserve(max_idle);
+}
+
+CURLHandlePool::~CURLHandlePool()
+{
+    ARROWHEAD_LIB_GAUGE(idle_gauge, "arrowhead_curl_idle_handles", "",
+        "Easy handles kept for reuse by the libcurl transports");
+    ARROWHEAD_LIB_ADD(idle_gauge, -static_cast<int64_t>(idle.size()));
+}
+
+std::unique_ptr<CURLContext> CURLHandlePool::acquire()
+{
+    ARROWHEAD_LIB_GAUGE(idle_gauge, "arrowhead_curl_idle_handles", "",
+        "Easy handles kept for reuse by the libcurl transports");
+    ARROWHEAD_LIB_COUNTER(created_count, "arrowhead_allocations_total",
+        "object=\"curl_handle\"", "Objects allocated on the request path");
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!idle.empty()) {
+            std::unique_ptr<CURLContext> ctx = std::move(idle.back());
+            idle.pop_back();
+            ARROWHEAD_LIB_ADD(idle_gauge, -1);
+            return ctx;
+        }
+        ++created_;
+    }
+    ARROWHEAD_LIB_ADD(created_count, 1);
+    std::unique_ptr<CURLContext> ctx(new CURLContext);
+    ctx->apply_tls(tls);
+    ctx->set_http_version(version);
+    ctx->apply_compression(compression);
+    return ctx;
+}
+
+void CURLHandlePool::release(std::unique_ptr<CURLContext> ctx)
+{
+    ARROWHEAD_LIB_GAUGE(idle_gauge, "arrowhead_curl_idle_handles", "",
+        "Easy handles kept for reuse by the libcurl transports");
+    std::lock_guard<std::mutex> lock(mutex);
+    if (idle.size() < max_idle) {
+        idle.push_back(std::move(ctx));
+        ARROWHEAD_LIB_ADD(idle_gauge, 1);
+    }
+    /* Otherwise ctx is destroyed on return, after the lock is released */
+}
+
+size_t CURLHandlePool::created() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return created_;
+}
+
 } // namespace HTTP
+
+TLSStats tls_stats()
+{
+    TLSStats stats;
+    stats.full_handshakes = HTTP::full_handshakes;
+    stats.resumed_handshakes = HTTP::resumed_handshakes;
+    stats.reused_connections = HTTP::reused_connections;
+    return stats;
+}
+
+CompressionStats compression_stats()
+{
+    CompressionStats stats;
+    stats.responses = HTTP::responses;
+    stats.compressed_responses = HTTP::compressed_responses;
+    stats.response_wire_bytes = HTTP::response_wire_bytes;
+    stats.response_bytes = HTTP::response_bytes;
+    stats.compressed_requests = HTTP::compressed_requests;
+    stats.request_bytes = HTTP::request_bytes;
+    stats.request_wire_bytes = HTTP::request_wire_bytes;
+    stats.total_time = std::chrono::microseconds(HTTP::total_time_us);
+    return stats;
+}
+
+LatencyStats latency_stats()
+{
+    LatencyStats stats;
+    for (auto& shard: HTTP::latency_shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& op: shard.latency) {
+            for (const auto& ep: op.second) {
+                stats[std::make_pair(op.first, ep.first)].merge(ep.second);
+            }
+        }
+    }
+    return stats;
+}
+
+std::string supported_encodings()
+{
+    const curl_version_info_data *info = curl_version_info(CURLVERSION_NOW);
+    std::string encodings;
+    if (info->features & CURL_VERSION_LIBZ) {
+        encodings = "gzip, deflate";
+    }
+#ifdef CURL_VERSION_BROTLI
+    if (info->features & CURL_VERSION_BROTLI) {
+        encodings += encodings.empty() ? "br" : ", br";
+    }
+#endif
+#ifdef CURL_VERSION_ZSTD
+    if (info->features & CURL_VERSION_ZSTD) {
+        encodings += encodings.empty() ? "zstd" : ", zstd";
+    }
+#endif
+    return encodings;
+}
+
+CURLEasyTransport::CURLEasyTransport(const TLSOptions& tls, HTTPVersion version,
+    const CompressionOptions& compression) :
+    pool(std::make_shared<HTTP::CURLHandlePool>(tls, version, compression))
+{}
+
+Status CURLEasyTransport::perform(const HTTPRequest& req, HTTPResponse& resp) const
+{
+    if (req.deadline.expired()) {
+        return Status(Errc::TIMEOUT, 0, "CURLEasyTransport");
+    }
+    ARROWHEAD_LIB_SPAN(span, "http.request");
+    std::unique_ptr<HTTP::CURLContext> ctx = pool->acquire();
+    ctx->prepare(req, req.url, resp);
+
+    /* Perform the request */
+    CURLcode curl_code = curl_easy_perform(ctx->curl);
+    Status status = ctx->result(curl_code, resp, "CURLEasyTransport");
+    pool->release(std::move(ctx));
+    return status;
+}
+
+size_t CURLEasyTransport::handles() const
+{
+    return pool->created();
+}
+
+HTTPResponse CURLEasyTransport::perform(const HTTPRequest& req) const
+{
+    HTTPResponse resp;
+    Status status = perform(req, resp);
+    if (!status.ok()) {
+        status.raise();
+    }
+    return resp;
+}
+
 } // namespace Arrowhead
 
 #endif /* ARROWHEAD_USE_LIBCURL */
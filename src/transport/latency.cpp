@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Latency histogram implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+
+#include "arrowhead/latency.hpp"
+
+namespace Arrowhead {
+
+const size_t LatencyHistogram::BUCKETS;
+
+LatencyHistogram::LatencyHistogram() : count_(0), sum_(0), max_(0)
+{
+    std::fill(counts, counts + BUCKETS, 0);
+}
+
+void LatencyHistogram::record(std::chrono::microseconds value)
+{
+    uint64_t us = value.count() > 0 ? static_cast<uint64_t>(value.count()) : 0;
+    /* The bucket is the number of significant bits */
+    size_t i = 0;
+    for (uint64_t v = us; v != 0 && i < BUCKETS - 1; v >>= 1) {
+        ++i;
+    }
+    ++counts[i];
+    ++count_;
+    sum_ += us;
+    max_ = std::max(max_, us);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        counts[i] += other.counts[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+std::chrono::microseconds LatencyHistogram::percentile(double q) const
+{
+    if (count_ == 0) {
+        return std::chrono::microseconds(0);
+    }
+    /* Rank of the quantile, at least the first value */
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS - 1; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucket_limit(i), max());
+        }
+    }
+    return max();
+}
+
+void RequestLatency::record(const RequestTiming& timing)
+{
+    ++requests;
+    if (timing.reused_connection) {
+        ++reused_connections;
+    }
+    bytes_sent += timing.bytes_sent;
+    bytes_received += timing.bytes_received;
+    namelookup.record(timing.namelookup);
+    connect.record(timing.connect);
+    appconnect.record(timing.appconnect);
+    pretransfer.record(timing.pretransfer);
+    starttransfer.record(timing.starttransfer);
+    total.record(timing.total);
+}
+
+void RequestLatency::merge(const RequestLatency& other)
+{
+    requests += other.requests;
+    reused_connections += other.reused_connections;
+    bytes_sent += other.bytes_sent;
+    bytes_received += other.bytes_received;
+    namelookup.merge(other.namelookup);
+    connect.merge(other.connect);
+    appconnect.merge(other.appconnect);
+    pretransfer.merge(other.pretransfer);
+    starttransfer.merge(other.starttransfer);
+    total.merge(other.total);
+}
+
+} /* namespace Arrowhead */
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       HTTP/2 multiplexing transport implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+#include "arrowhead/http.hpp"
+#include "arrowhead/logging.hpp"
+#include "arrowhead/tracing.hpp"
+#include "arrowhead/transport.hpp"
+
+namespace Arrowhead {
+
+namespace {
+
+/// Context string of the Status objects returned by the transport
+const char CONTEXT[] = "CURLMultiplexTransport";
+
+#if LIBCURL_VERSION_NUM < 0x074400
+/// How often the worker looks for new requests without curl_multi_wakeup()
+const int POLL_INTERVAL_MS = 5;
+#endif
+
+/**
+ * @internal
+ * @brief One request handed to the worker thread, lives on the caller's stack
+ */
+struct Job {
+    std::unique_ptr<HTTP::CURLContext> ctx;
+    HTTPResponse *resp;
+    Status status;
+    bool done;
+    std::condition_variable cond;
+};
+
+} // anonymous namespace
+
+/**
+ * @internal
+ * @brief Multi handle and worker thread shared by all copies of a transport
+ */
+struct CURLMultiplexTransport::State {
+    explicit State(const Options& options) : options(options),
+        pool(options.tls, options.http_version, options.compression), multi(curl_multi_init()),
+        stopping(false)
+    {
+        if (multi == NULL) {
+            ARROWHEAD_THROW(TransportError("curl_multi_init() failed!"));
+        }
+        curl_multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+            static_cast<long>(options.max_host_connections));
+#if LIBCURL_VERSION_NUM >= 0x074300
+        /* Stream limit needs libcurl 7.67.0, the server's limit applies as well */
+        curl_multi_setopt(multi, CURLMOPT_MAX_CONCURRENT_STREAMS,
+            static_cast<long>(options.max_concurrent_streams));
+#endif
+        stats.requests = 0;
+        stats.http2_requests = 0;
+        stats.connections = 0;
+        worker = std::thread(&State::run, this);
+    }
+
+    ~State()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup();
+        worker.join();
+        curl_multi_cleanup(multi);
+    }
+
+    /**
+     * @brief Interrupt the worker waiting for transfers
+     */
+    void wakeup()
+    {
+#if LIBCURL_VERSION_NUM >= 0x074400
+        curl_multi_wakeup(multi);
+#endif
+    }
+
+    /**
+     * @brief Hand @p job over to the worker and wait for it to finish
+     */
+    void submit(Job& job)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        queue.push_back(&job);
+        lock.unlock();
+        wakeup();
+        lock.lock();
+        job.cond.wait(lock, [&job]() { return job.done; });
+    }
+
+    /**
+     * @brief Body of the worker thread
+     */
+    void run()
+    {
+        std::vector<Job *> incoming;
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) {
+                    /* Callers keep us alive while they wait, so nothing is left */
+                    break;
+                }
+                incoming.assign(queue.begin(), queue.end());
+                queue.clear();
+            }
+            for (Job *job: incoming) {
+                curl_multi_add_handle(multi, job->ctx->curl);
+            }
+            int running;
+            curl_multi_perform(multi, &running);
+            CURLMsg *msg;
+            int queued;
+            while ((msg = curl_multi_info_read(multi, &queued)) != NULL) {
+                if (msg->msg != CURLMSG_DONE) {
+                    continue;
+                }
+                char *priv = NULL;
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &priv);
+                Job *job = reinterpret_cast<Job *>(priv);
+                CURLcode curl_code = msg->data.result;
+                /* msg is invalid after removing the handle */
+                curl_multi_remove_handle(multi, job->ctx->curl);
+                finish(*job, curl_code);
+            }
+#if LIBCURL_VERSION_NUM >= 0x074400
+            curl_multi_poll(multi, NULL, 0, 1000, NULL);
+#else
+            curl_multi_wait(multi, NULL, 0, POLL_INTERVAL_MS, NULL);
+#endif
+        }
+    }
+
+    /**
+     * @brief Store the outcome of @p job and wake up its caller
+     */
+    void finish(Job& job, CURLcode curl_code)
+    {
+        Status status = job.ctx->result(curl_code, *job.resp, CONTEXT);
+        long connects = 0;
+        curl_easy_getinfo(job.ctx->curl, CURLINFO_NUM_CONNECTS, &connects);
+        long version = 0;
+        curl_easy_getinfo(job.ctx->curl, CURLINFO_HTTP_VERSION, &version);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.connections += connects;
+        if (status.ok()) {
+            ++stats.requests;
+            if (version == CURL_HTTP_VERSION_2_0) {
+                ++stats.http2_requests;
+            }
+        }
+        job.status = status;
+        job.done = true;
+        /* Notify under the lock, the caller destroys job as soon as it sees done */
+        job.cond.notify_one();
+    }
+
+    Options options;
+    /// Easy handles of finished jobs, for the next ones
+    HTTP::CURLHandlePool pool;
+    CURLM *multi;
+    std::mutex mutex;
+    /// Jobs not yet added to the multi handle
+    std::deque<Job *> queue;
+    bool stopping;
+    Stats stats;
+    std::thread worker;
+};
+
+CURLMultiplexTransport::CURLMultiplexTransport(const Options& options) :
+    state(std::make_shared<State>(options))
+{}
+
+Status CURLMultiplexTransport::perform(const HTTPRequest& req, HTTPResponse& resp) const
+{
+    if (req.deadline.expired()) {
+        return Status(Errc::TIMEOUT, 0, CONTEXT);
+    }
+    /* The worker records the phases as children of this span */
+    ARROWHEAD_LIB_SPAN(span, "http.request");
+    Job job;
+    job.resp = &resp;
+    job.done = false;
+    job.ctx = state->pool.acquire();
+    job.ctx->prepare(req, req.url, resp);
+    /* Wait for a connection being set up, it may turn out to multiplex */
+    curl_easy_setopt(job.ctx->curl, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(job.ctx->curl, CURLOPT_PRIVATE, static_cast<void *>(&job));
+    state->submit(job);
+    /* The worker removed the handle from the multi handle */
+    state->pool.release(std::move(job.ctx));
+    return job.status;
+}
+
+HTTPResponse CURLMultiplexTransport::perform(const HTTPRequest& req) const
+{
+    HTTPResponse resp;
+    Status status = perform(req, resp);
+    if (!status.ok()) {
+        status.raise();
+    }
+    return resp;
+}
+
+CURLMultiplexTransport::Stats CURLMultiplexTransport::stats() const
+{
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->stats;
+}
+
+} // namespace Arrowhead
+
+#endif /* ARROWHEAD_USE_LIBCURL */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Retry policy implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <algorithm>
+#include <random>
+
+#include "arrowhead/retry.hpp"
+
+namespace Arrowhead {
+
+bool RetryPolicy::should_retry(unsigned int attempt, const Status& status, bool idempotent) const
+{
+    if (attempt >= max_attempts_ || (!idempotent && !non_idempotent)) {
+        return false;
+    }
+    switch (status.code()) {
+        case Errc::TRANSPORT:
+        case Errc::TIMEOUT:
+            return true;
+        case Errc::HTTP_STATUS:
+            return status.detail() == 408 || status.detail() == 429 || status.detail() >= 500;
+        default:
+            return false;
+    }
+}
+
+std::chrono::milliseconds RetryPolicy::backoff(unsigned int attempt) const
+{
+    /* Exponential growth, capped before it can overflow */
+    std::chrono::milliseconds::rep cap = initial_backoff.count();
+    for (unsigned int i = 1; i < attempt && cap < max_backoff.count(); ++i) {
+        cap *= 2;
+    }
+    cap = std::min(cap, max_backoff.count());
+    if (cap <= 0) {
+        return std::chrono::milliseconds(0);
+    }
+    /* Full jitter, one generator per thread to avoid locking */
+    thread_local std::minstd_rand rng(std::random_device{}());
+    std::uniform_int_distribution<std::chrono::milliseconds::rep> dist(0, cap);
+    return std::chrono::milliseconds(dist(rng));
+}
+
+} /* namespace Arrowhead */
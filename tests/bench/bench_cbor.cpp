@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       CBOR versus JSON payload size and parse time benchmark
+ *
+ * Usage: bench_cbor [services] [iterations]
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "arrowhead/service.hpp"
+#include "arrowhead/detail/_nlohmann_json.hpp"
+
+namespace {
+
+std::vector<Arrowhead::ServiceDescription> make_services(size_t count)
+{
+    std::vector<Arrowhead::ServiceDescription> services(count);
+    for (size_t i = 0; i < count; ++i) {
+        Arrowhead::ServiceDescription& sd = services[i];
+        std::string n = std::to_string(i);
+        sd.name = "service" + n + "._orch-s-ws-https._tcp.srv.arces.unibo.it.";
+        sd.type = "_orch-s-ws-https._tcp";
+        sd.domain = "arces.unibo.it.";
+        sd.host = "host" + n + ".arces.unibo.it.";
+        sd.port = 8000 + (i % 1000);
+        sd.properties["version"] = "1.1";
+        sd.properties["path"] = "/orchestration/store/" + n;
+    }
+    return services;
+}
+
+template<class Func>
+double time_per_iteration(size_t iterations, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        func();
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+} /* anonymous namespace */
+
+int main(int argc, char **argv)
+{
+    size_t count = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 100;
+    size_t iterations = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 1000;
+    std::vector<Arrowhead::ServiceDescription> services = make_services(count);
+
+    nlohmann::json js;
+    js["service"] = nlohmann::json::array();
+    for (auto& sd: services) {
+        js["service"].push_back(Arrowhead::JSON::obj_from_service(sd));
+    }
+    std::string json_str = js.dump();
+
+    size_t len = Arrowhead::CBOR::encode_servicelist(services.begin(), services.end(), NULL, 0);
+    std::string cbor_str(len, '\0');
+    Arrowhead::CBOR::encode_servicelist(services.begin(), services.end(), &cbor_str[0], len);
+
+    std::vector<Arrowhead::ServiceDescription> out;
+    out.reserve(count);
+    double json_us = time_per_iteration(iterations, [&]() {
+        out.clear();
+        Arrowhead::parse_servicelist_json(std::back_inserter(out), json_str);
+    });
+    double cbor_us = time_per_iteration(iterations, [&]() {
+        out.clear();
+        Arrowhead::parse_servicelist_cbor(std::back_inserter(out), cbor_str);
+    });
+    std::string enc(len, '\0');
+    double encode_us = time_per_iteration(iterations, [&]() {
+        Arrowhead::CBOR::encode_servicelist(services.begin(), services.end(), &enc[0], len);
+    });
+
+    std::cout << "services:          " << count << std::endl;
+    std::cout << "JSON size:         " << json_str.size() << " bytes" << std::endl;
+    std::cout << "CBOR size:         " << cbor_str.size() << " bytes" << std::endl;
+    std::cout << "JSON parse:        " << json_us << " us" << std::endl;
+    std::cout << "CBOR parse:        " << cbor_us << " us" << std::endl;
+    std::cout << "CBOR encode:       " << encode_us << " us" << std::endl;
+    return 0;
+}
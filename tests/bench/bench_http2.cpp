@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+/**
+ * @file
+ * @brief       HTTP/1.1 versus multiplexed HTTP/2 throughput benchmark
+ *
+ * Many threads make registry-sized requests to a local stand-in server,
+ * once with one HTTP/1.1 connection per concurrent request and once
+ * multiplexed over HTTP/2 (h2c). The stand-in serves the streams of an
+ * HTTP/2 connection one after another, so the comparison is conservative.
+ *
+ * Usage: bench_http2 [threads] [requests per thread]
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stub_server.hpp"
+#include "arrowhead/transport.hpp"
+
+namespace {
+
+Arrowhead::HTTPResponse registry(const Arrowhead::HTTPRequest& req)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.content_type = "application/json";
+    resp.body = "{\"service\":[{\"name\":\"" + req.path + "\",\"port\":8080}]}";
+    return resp;
+}
+
+struct Outcome {
+    double requests_per_second;
+    unsigned int failures;
+};
+
+template<class Transport>
+Outcome run(const Transport& transport, const std::string& url, size_t threads,
+    size_t per_thread)
+{
+    std::atomic<unsigned int> failures(0);
+    std::vector<std::thread> workers;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&]() {
+            Arrowhead::HTTPRequest req;
+            req.method = "GET";
+            req.url = url;
+            req.accept = "application/json";
+            for (size_t i = 0; i < per_thread; ++i) {
+                Arrowhead::HTTPResponse resp;
+                if (!transport.perform(req, resp).ok() || resp.status != 200) {
+                    ++failures;
+                }
+            }
+        }));
+    }
+    for (std::thread& worker: workers) {
+        worker.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    Outcome outcome;
+    outcome.requests_per_second = threads * per_thread / elapsed.count();
+    outcome.failures = failures;
+    return outcome;
+}
+
+void report(const char *name, const Outcome& outcome, unsigned int connections)
+{
+    std::cout << name << outcome.requests_per_second << " requests/s, " <<
+        connections << " connections, " << outcome.failures << " failures" << std::endl;
+}
+
+} /* anonymous namespace */
+
+int main(int argc, char **argv)
+{
+    size_t threads = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 64;
+    size_t per_thread = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 100;
+
+    std::cout << "threads:           " << threads << std::endl;
+    std::cout << "requests/thread:   " << per_thread << std::endl;
+    {
+        StubServer server(registry, true);
+        Outcome outcome = run(Arrowhead::CURLEasyTransport(Arrowhead::TLSOptions(),
+            Arrowhead::HTTPVersion::HTTP1_1), server.url("/servicediscovery/service"),
+            threads, per_thread);
+        report("HTTP/1.1:           ", outcome, server.connection_count());
+    }
+    {
+        StubServer server(registry, true, true);
+        Outcome outcome = run(Arrowhead::CURLMultiplexTransport(),
+            server.url("/servicediscovery/service"), threads, per_thread);
+        report("HTTP/2 multiplexed: ", outcome, server.connection_count());
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Cost of recording metrics, alone and from concurrent threads
+ *
+ * Usage: bench_metrics [threads] [iterations]
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "arrowhead/metrics.hpp"
+
+namespace {
+
+/* Nanoseconds per call of func, each of @p threads threads making @p iterations calls */
+template<class Func>
+double time_per_call(size_t threads, size_t iterations, Func func)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([iterations, func]() {
+            for (size_t i = 0; i < iterations; ++i) {
+                func(i);
+            }
+        });
+    }
+    for (std::thread& w: workers) {
+        w.join();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+} /* anonymous namespace */
+
+int main(int argc, char **argv)
+{
+    size_t threads = (argc > 1) ? std::strtoul(argv[1], NULL, 10) : 4;
+    size_t iterations = (argc > 2) ? std::strtoul(argv[2], NULL, 10) : 10000000;
+    Arrowhead::Metrics::Registry& registry = Arrowhead::Metrics::Registry::instance();
+    Arrowhead::Metrics::Counter& counter = registry.counter("bench_total", "", "Benchmark");
+    Arrowhead::Metrics::Gauge& gauge = registry.gauge("bench_gauge", "", "Benchmark");
+    Arrowhead::Metrics::Histogram& histogram =
+        registry.histogram("bench_seconds", "", "Benchmark");
+
+    for (size_t n: {size_t(1), threads}) {
+        std::cout << n << " thread(s), ns per call:" << std::endl;
+        std::cout << "  Counter::add        " << time_per_call(n, iterations,
+            [&counter](size_t) { counter.add(); }) << std::endl;
+        std::cout << "  Gauge::add          " << time_per_call(n, iterations,
+            [&gauge](size_t) { gauge.add(1); }) << std::endl;
+        std::cout << "  Histogram::observe  " << time_per_call(n, iterations,
+            [&histogram](size_t i) {
+                histogram.observe(std::chrono::nanoseconds(1000 + (i & 0xffff)));
+            }) << std::endl;
+    }
+    std::cout << "Counter value " << counter.value() << ", histogram p99 " <<
+        histogram.snapshot().percentile(0.99).count() << " ns" << std::endl;
+    return 0;
+}
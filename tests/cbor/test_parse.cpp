@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service CBOR encoding and parsing tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "tempfile.hpp"
+#include "arrowhead/service.hpp"
+#include "arrowhead/exception.hpp"
+#include <vector>
+#include <iterator>
+#include <string>
+
+namespace {
+
+std::vector<Arrowhead::ServiceDescription> test_services()
+{
+    std::vector<Arrowhead::ServiceDescription> services(2);
+    services[0].name = "orchestration-store._orch-s-ws-https._tcp.srv.arces.unibo.it.";
+    services[0].type = "_orch-s-ws-https._tcp";
+    services[0].domain = "arces.unibo.it.";
+    services[0].host = "bedework.arces.unibo.it.";
+    services[0].port = 8181;
+    services[0].properties["version"] = "1.1";
+    services[0].properties["path"] = "/orchestration/store/";
+    services[1].name = "anotherprinterservice._printer-s-ws-https._tcp.srv.arces.unibo.it.";
+    services[1].type = "_printer-s-ws-https._tcp";
+    services[1].domain = "168.56.101.";
+    services[1].host = "192.168.56.101.";
+    services[1].port = 8055;
+    services[1].properties["version"] = "1.0";
+    return services;
+}
+
+std::string encode_list(const std::vector<Arrowhead::ServiceDescription>& services)
+{
+    size_t len = Arrowhead::CBOR::encode_servicelist(services.begin(), services.end(), NULL, 0);
+    std::string buf(len, '\0');
+    Arrowhead::CBOR::encode_servicelist(services.begin(), services.end(), &buf[0], buf.size());
+    return buf;
+}
+
+bool same_service(const Arrowhead::ServiceDescription& a, const Arrowhead::ServiceDescription& b)
+{
+    return a.name == b.name && a.type == b.type && a.domain == b.domain &&
+        a.host == b.host && a.port == b.port && a.properties == b.properties;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Services are encoded to and parsed from CBOR", "[servicecbor]" ) {
+
+    GIVEN("a list of services") {
+        std::vector<Arrowhead::ServiceDescription> services = test_services();
+
+        WHEN("the list is encoded and parsed") {
+            std::string cbor = encode_list(services);
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), cbor);
+            THEN("the services are unchanged") {
+                REQUIRE(parsed.size() == 2);
+                REQUIRE(same_service(parsed[0], services[0]));
+                REQUIRE(same_service(parsed[1], services[1]));
+            }
+        }
+        WHEN("the list is parsed from a file") {
+            TempFile file(encode_list(services));
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            Arrowhead::parse_servicelist_cbor_file(std::back_inserter(parsed), file.path());
+            THEN("the services are unchanged") {
+                REQUIRE(parsed.size() == 2);
+                REQUIRE(same_service(parsed[1], services[1]));
+            }
+        }
+        WHEN("the encoding buffer is too small") {
+            size_t len = Arrowhead::CBOR::encode_service(services[0], NULL, 0);
+            std::string buf(len / 2, 'x');
+            size_t ret = Arrowhead::CBOR::encode_service(services[0], &buf[0], buf.size());
+            THEN("the required size is returned and the buffer is not overrun") {
+                REQUIRE(ret == len);
+                REQUIRE(buf.size() == len / 2);
+            }
+        }
+        WHEN("a single service is encoded and parsed") {
+            std::string buf(256, '\0');
+            size_t len = Arrowhead::CBOR::encode_service(services[0], &buf[0], buf.size());
+            REQUIRE(len <= buf.size());
+            buf.resize(len);
+            Arrowhead::ServiceDescription sd = Arrowhead::ServiceDescription::from_cbor(buf);
+            THEN("the service is unchanged") {
+                REQUIRE(same_service(sd, services[0]));
+            }
+        }
+        WHEN("the list is fed to a stream decoder one byte at a time") {
+            std::string cbor = encode_list(services);
+            Arrowhead::CBOR::StreamDecoder decoder;
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            std::vector<size_t> counts;
+            for (size_t i = 0; i < cbor.size(); ++i) {
+                decoder.feed(std::back_inserter(parsed), &cbor[i], 1);
+                counts.push_back(parsed.size());
+            }
+            THEN("every service is emitted as soon as it is complete") {
+                REQUIRE(decoder.finished());
+                REQUIRE(parsed.size() == 2);
+                REQUIRE(same_service(parsed[0], services[0]));
+                REQUIRE(same_service(parsed[1], services[1]));
+                /* The second service is complete at the last byte */
+                REQUIRE(counts[cbor.size() - 2] == 1);
+                REQUIRE(counts[cbor.size() - 1] == 2);
+            }
+        }
+    }
+    GIVEN("an empty service list") {
+        std::vector<Arrowhead::ServiceDescription> services;
+        std::string cbor = encode_list(services);
+        WHEN("the list is parsed") {
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), cbor);
+            THEN("there are no services") {
+                REQUIRE(parsed.empty());
+            }
+        }
+    }
+    GIVEN("a list encoded with indefinite length containers and unknown keys") {
+        /* {_ "version": 1, "service": [_ {_ "name": "a", "extra": [1, 2], "port": 80 } ] } */
+        const char raw[] =
+            "\xbf" "\x67" "version" "\x01"
+            "\x67" "service" "\x9f"
+            "\xbf" "\x64" "name" "\x61" "a"
+            "\x65" "extra" "\x82\x01\x02"
+            "\x64" "port" "\x18\x50" "\xff"
+            "\xff" "\xff";
+        std::string cbor(raw, sizeof(raw) - 1);
+        WHEN("the list is parsed") {
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), cbor);
+            THEN("the known fields are decoded") {
+                REQUIRE(parsed.size() == 1);
+                REQUIRE(parsed[0].name == "a");
+                REQUIRE(parsed[0].port == 80);
+            }
+        }
+    }
+    GIVEN("a list with a key after the service array") {
+        /* {_ "service": [_ {"name": "a"} ], "version": [1, 2] } */
+        const char raw[] =
+            "\xbf" "\x67" "service" "\x9f"
+            "\xa1" "\x64" "name" "\x61" "a" "\xff"
+            "\x67" "version" "\x82\x01\x02"
+            "\xff";
+        std::string cbor(raw, sizeof(raw) - 1);
+        WHEN("the list is parsed") {
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), cbor);
+            THEN("the services are decoded and the rest of the map is skipped") {
+                REQUIRE(parsed.size() == 1);
+                REQUIRE(parsed[0].name == "a");
+            }
+        }
+        WHEN("the end of the map is missing") {
+            cbor.resize(cbor.size() - 1);
+            THEN("an exception is thrown") {
+                std::vector<Arrowhead::ServiceDescription> parsed;
+                REQUIRE_THROWS_AS(Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), cbor),
+                    const Arrowhead::ContentError&);
+            }
+        }
+    }
+    GIVEN("a service list followed by other data") {
+        std::string cbor = encode_list(test_services()) + "junk";
+        WHEN("the list is parsed") {
+            THEN("an exception is thrown") {
+                std::vector<Arrowhead::ServiceDescription> parsed;
+                REQUIRE_THROWS_AS(Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), cbor),
+                    const Arrowhead::ContentError&);
+            }
+        }
+        WHEN("the data is fed to a stream decoder after the list") {
+            Arrowhead::CBOR::StreamDecoder decoder;
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            decoder.feed(std::back_inserter(parsed), cbor.data(), cbor.size() - 4);
+            THEN("the decoder rejects it") {
+                REQUIRE(decoder.finished());
+                REQUIRE_THROWS_AS(decoder.feed(std::back_inserter(parsed), "junk", 4),
+                    const Arrowhead::ContentError&);
+            }
+        }
+    }
+    GIVEN("a truncated service list") {
+        std::string cbor = encode_list(test_services());
+        cbor.resize(cbor.size() - 3);
+        WHEN("the list is parsed") {
+            THEN("an exception is thrown") {
+                std::vector<Arrowhead::ServiceDescription> parsed;
+                REQUIRE_THROWS_AS(Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), cbor),
+                    const Arrowhead::ContentError&);
+            }
+        }
+    }
+    GIVEN("something that is not a CBOR service list") {
+        std::string text = "[]; []{ } <xml> blah";
+        WHEN("the text is parsed") {
+            THEN("an exception is thrown") {
+                std::vector<Arrowhead::ServiceDescription> parsed;
+                REQUIRE_THROWS_AS(Arrowhead::parse_servicelist_cbor(std::back_inserter(parsed), text),
+                    const Arrowhead::ContentError&);
+                REQUIRE_THROWS_AS(Arrowhead::ServiceDescription::from_cbor(text),
+                    const Arrowhead::ContentError&);
+            }
+        }
+    }
+}
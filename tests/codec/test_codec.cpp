@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Codec registry and content negotiation tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/codec.hpp"
+#include "arrowhead/exception.hpp"
+#include <vector>
+#include <iterator>
+#include <memory>
+#include <string>
+
+namespace {
+
+std::vector<Arrowhead::ServiceDescription> test_services()
+{
+    std::vector<Arrowhead::ServiceDescription> services(2);
+    services[0].name = "orchestration-store._orch-s-ws-https._tcp.srv.arces.unibo.it.";
+    services[0].type = "_orch-s-ws-https._tcp";
+    services[0].domain = "arces.unibo.it.";
+    services[0].host = "bedework.arces.unibo.it.";
+    services[0].port = 8181;
+    services[0].properties["version"] = "1.1";
+    services[0].properties["path"] = "/orchestration/store/?a=1&b=<2>";
+    services[1].name = "anotherprinterservice._printer-s-ws-https._tcp.srv.arces.unibo.it.";
+    services[1].type = "_printer-s-ws-https._tcp";
+    services[1].domain = "168.56.101.";
+    services[1].host = "192.168.56.101.";
+    services[1].port = 8055;
+    return services;
+}
+
+bool same_service(const Arrowhead::ServiceDescription& a, const Arrowhead::ServiceDescription& b)
+{
+    return a.name == b.name && a.type == b.type && a.domain == b.domain &&
+        a.host == b.host && a.port == b.port && a.properties == b.properties;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Codecs are looked up by media type", "[codec]" ) {
+
+    GIVEN("the built in codec registry") {
+        Arrowhead::CodecRegistry registry = Arrowhead::CodecRegistry::builtin();
+
+#if ARROWHEAD_USE_JSON
+        THEN("JSON is preferred by default") {
+            REQUIRE(std::string(registry.preferred().media_type()) == "application/json");
+        }
+        WHEN("a Content-Type with parameters and upper case letters is looked up") {
+            const Arrowhead::Codec *codec = registry.find(" Application/JSON ; charset=utf-8");
+            THEN("the JSON codec is found") {
+                REQUIRE(codec != NULL);
+                REQUIRE(std::string(codec->media_type()) == "application/json");
+            }
+        }
+        WHEN("an unknown media type is looked up") {
+            THEN("there is no codec") {
+                REQUIRE(registry.find("text/html") == NULL);
+            }
+        }
+        WHEN("another codec is preferred") {
+            registry.prefer("application/x-ndjson");
+            THEN("it is first in the Accept header with the others following") {
+                std::string accept = registry.accept_header();
+                REQUIRE(accept.compare(0, 22, "application/x-ndjson, ") == 0);
+                REQUIRE(accept.find("application/json;q=0.9") != std::string::npos);
+                REQUIRE(std::string(registry.preferred().media_type()) == "application/x-ndjson");
+            }
+        }
+        WHEN("a codec is registered again") {
+            size_t count = registry.codecs().size();
+            registry.add(std::make_shared<Arrowhead::JSONCodec>());
+            THEN("it replaces the old one") {
+                REQUIRE(registry.codecs().size() == count);
+                REQUIRE(std::string(registry.preferred().media_type()) == "application/json");
+            }
+        }
+#endif /* ARROWHEAD_USE_JSON */
+        WHEN("an unregistered codec is preferred") {
+            THEN("an exception is thrown") {
+                REQUIRE_THROWS_AS(registry.prefer("text/html"), const Arrowhead::Error&);
+            }
+        }
+    }
+    GIVEN("an empty codec registry") {
+        Arrowhead::CodecRegistry registry;
+        THEN("there is no preferred codec") {
+            REQUIRE_THROWS_AS(registry.preferred(), const Arrowhead::Error&);
+            REQUIRE(registry.accept_header().empty());
+        }
+    }
+}
+
+SCENARIO( "Every codec round trips services", "[codec]" ) {
+
+    GIVEN("a list of services and the built in codecs") {
+        std::vector<Arrowhead::ServiceDescription> services = test_services();
+        Arrowhead::CodecRegistry registry = Arrowhead::CodecRegistry::builtin();
+
+        for (auto& codec: registry.codecs()) {
+            WHEN(std::string("the list is encoded and decoded as ") + codec->media_type()) {
+                std::string buf = codec->encode_servicelist(services);
+                std::vector<Arrowhead::ServiceDescription> parsed;
+                codec->parse_servicelist(std::back_inserter(parsed), buf.data(), buf.size());
+                THEN("the services are unchanged") {
+                    REQUIRE(parsed.size() == 2);
+                    REQUIRE(same_service(parsed[0], services[0]));
+                    REQUIRE(same_service(parsed[1], services[1]));
+                }
+            }
+            WHEN(std::string("a single service is encoded and decoded as ") + codec->media_type()) {
+                std::string buf = codec->encode_service(services[0]);
+                Arrowhead::ServiceDescription sd = codec->decode_service(buf.data(), buf.size());
+                THEN("the service is unchanged") {
+                    REQUIRE(same_service(sd, services[0]));
+                }
+            }
+            WHEN(std::string("garbage is decoded as ") + codec->media_type()) {
+                std::string text = "[]; []{ } <xml> blah";
+                THEN("an exception is thrown") {
+                    std::vector<Arrowhead::ServiceDescription> parsed;
+                    REQUIRE_THROWS_AS(codec->decode_servicelist(parsed, text.data(), text.size()),
+                        const Arrowhead::ContentError&);
+                }
+            }
+            WHEN(std::string("garbage is decoded without throwing as ") + codec->media_type()) {
+                std::string text = "[]; []{ } <xml> blah";
+                std::vector<Arrowhead::ServiceDescription> parsed;
+                auto res = codec->try_parse_servicelist(std::back_inserter(parsed),
+                    text.data(), text.size());
+                THEN("a content error is returned and nothing is output") {
+                    REQUIRE(res.error().code() == Arrowhead::Errc::CONTENT);
+                    REQUIRE(parsed.empty());
+                }
+            }
+        }
+    }
+}
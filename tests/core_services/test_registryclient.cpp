@@ -0,0 +1,612 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Policy based Service Registry client tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "stub_registry.hpp"
+#include "stub_server.hpp"
+#include "stub_tls.hpp"
+#include "tempfile.hpp"
+#include "arrowhead/core_services/registryclient.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/retry.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+#include <string>
+#if ARROWHEAD_USE_LIBCURL
+#include <curl/curl.h>
+#endif
+
+namespace {
+
+std::vector<Arrowhead::ServiceDescription> test_services()
+{
+    std::vector<Arrowhead::ServiceDescription> services(2);
+    services[0].name = "orchestration-store._orch-s-ws-https._tcp.srv.arces.unibo.it.";
+    services[0].type = "_orch-s-ws-https._tcp";
+    services[0].domain = "arces.unibo.it.";
+    services[0].host = "bedework.arces.unibo.it.";
+    services[0].port = 8181;
+    services[0].properties["version"] = "1.1";
+    services[1].name = "anotherprinterservice._printer-s-ws-https._tcp.srv.arces.unibo.it.";
+    services[1].type = "_printer-s-ws-https._tcp";
+    services[1].domain = "168.56.101.";
+    services[1].host = "192.168.56.101.";
+    services[1].port = 8055;
+    return services;
+}
+
+/* The same checks for every transport and codec combination */
+template<class Client>
+void exercise(Client& client)
+{
+    std::vector<Arrowhead::ServiceDescription> services = test_services();
+    client.publish(services[0]);
+    client.publish(services[1]);
+
+    std::vector<Arrowhead::ServiceDescription> all = client.list_services();
+    REQUIRE(all.size() == 2);
+
+    std::vector<Arrowhead::ServiceDescription> typed = client.list_services(services[1].type);
+    REQUIRE(typed.size() == 1);
+    REQUIRE(typed[0].name == services[1].name);
+    REQUIRE(typed[0].port == services[1].port);
+
+    client.unpublish(services[0].name);
+    all = client.list_services();
+    REQUIRE(all.size() == 1);
+    REQUIRE(all[0].name == services[1].name);
+
+    /* The stub answers 404 for unknown services */
+    REQUIRE_THROWS_AS(client.unpublish("nonexistent"), const Arrowhead::TransportError&);
+}
+
+template<class Codec>
+void exercise_transports(const Codec& codec)
+{
+    WHEN("the client uses the loopback transport") {
+        StubRegistry registry;
+        Arrowhead::LoopbackTransport transport(
+            [&registry](const Arrowhead::HTTPRequest& req) { return registry.handle(req); });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Codec>
+            client("loopback:/servicediscovery", codec, transport);
+        THEN("services can be published, listed and unpublished") {
+            exercise(client);
+        }
+    }
+#if ARROWHEAD_USE_LIBCURL
+    WHEN("the client uses libcurl against a local server") {
+        StubRegistry registry;
+        StubServer server(
+            [&registry](const Arrowhead::HTTPRequest& req) { return registry.handle(req); });
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Codec>
+            client(server.url("/servicediscovery"), codec);
+        THEN("services can be published, listed and unpublished") {
+            exercise(client);
+        }
+    }
+    WHEN("the client multiplexes its requests over HTTP/2") {
+        StubRegistry registry;
+        StubServer server(
+            [&registry](const Arrowhead::HTTPRequest& req) { return registry.handle(req); },
+            true, true);
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLMultiplexTransport, Codec>
+            client(server.url("/servicediscovery"), codec);
+        THEN("services can be published, listed and unpublished") {
+            exercise(client);
+            REQUIRE(server.http2_connection_count() == 1);
+        }
+    }
+    WHEN("the client talks to a registry on a Unix domain socket") {
+        TempFile socket_file("", ".sock");
+        StubRegistry registry;
+        StubServer server(socket_file.path(),
+            [&registry](const Arrowhead::HTTPRequest& req) { return registry.handle(req); },
+            true);
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Codec>
+            client(server.url("/servicediscovery"), codec);
+        THEN("services can be published, listed and unpublished over one connection") {
+            exercise(client);
+            REQUIRE(server.connection_count() == 1);
+        }
+    }
+#endif
+#if ARROWHEAD_USE_OPENSSL
+    WHEN("the client uses libcurl against a local server with mutual TLS") {
+        TestCertificates certs;
+        std::shared_ptr<SSL_CTX> tls_ctx = certs.server_context(true);
+        StubRegistry registry;
+        StubServer server(
+            [&registry](const Arrowhead::HTTPRequest& req) { return registry.handle(req); },
+            tls_ctx.get());
+        Arrowhead::TLSOptions tls;
+        tls.ca_file = certs.server_cert;
+        tls.client_cert = certs.client_cert;
+        tls.client_key = certs.client_key;
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Codec>
+            client(server.url("/servicediscovery"), codec, Arrowhead::CURLEasyTransport(tls));
+        THEN("services can be published, listed and unpublished") {
+            exercise(client);
+        }
+    }
+#endif
+}
+
+Arrowhead::HTTPResponse canned_response(const std::string& content_type, const std::string& body)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.content_type = content_type;
+    resp.body = body;
+    return resp;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Registry clients work with every transport and codec", "[registryclient]" ) {
+
+#if ARROWHEAD_USE_JSON
+    GIVEN("the JSON codec") {
+        exercise_transports(Arrowhead::JSONCodec());
+    }
+    GIVEN("the NDJSON codec") {
+        exercise_transports(Arrowhead::NDJSONCodec());
+    }
+#endif
+#if ARROWHEAD_USE_CBOR
+    GIVEN("the CBOR codec") {
+        exercise_transports(Arrowhead::CBORCodec());
+    }
+#endif
+    GIVEN("negotiation with all built in codecs") {
+        exercise_transports(Arrowhead::CodecRegistry::builtin());
+    }
+#if ARROWHEAD_USE_CBOR
+    GIVEN("negotiation preferring CBOR") {
+        Arrowhead::CodecRegistry codecs = Arrowhead::CodecRegistry::builtin();
+        codecs.prefer("application/cbor");
+        exercise_transports(codecs);
+    }
+#endif
+}
+
+#if ARROWHEAD_USE_JSON
+SCENARIO( "Registry clients check the response format", "[registryclient]" ) {
+
+    std::string empty_list = Arrowhead::JSONCodec().encode_servicelist(
+        std::vector<Arrowhead::ServiceDescription>());
+
+    GIVEN("a fixed JSON client and a server answering in another format") {
+        Arrowhead::LoopbackTransport transport([](const Arrowhead::HTTPRequest&) {
+            return canned_response("application/xml", "<serviceList/>");
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::JSONCodec>
+            client("loopback:", Arrowhead::JSONCodec(), transport);
+        WHEN("services are listed") {
+            THEN("the response is rejected") {
+                REQUIRE_THROWS_AS(client.list_services(), const Arrowhead::ContentError&);
+            }
+        }
+    }
+    GIVEN("a negotiating client and a server without Content-Type") {
+        Arrowhead::LoopbackTransport transport([&empty_list](const Arrowhead::HTTPRequest&) {
+            return canned_response("", empty_list);
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::CodecRegistry>
+            client("loopback:", Arrowhead::CodecRegistry::builtin(), transport);
+        WHEN("services are listed") {
+            THEN("the response is parsed with the preferred codec") {
+                REQUIRE(client.list_services().empty());
+            }
+        }
+    }
+    GIVEN("a server answering with an error status") {
+        Arrowhead::LoopbackTransport transport([](const Arrowhead::HTTPRequest&) {
+            Arrowhead::HTTPResponse resp = canned_response("", "");
+            resp.status = 500;
+            return resp;
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::JSONCodec>
+            client("loopback:", Arrowhead::JSONCodec(), transport);
+        WHEN("services are listed") {
+            THEN("TransportError is thrown") {
+                REQUIRE_THROWS_AS(client.list(), const Arrowhead::TransportError&);
+            }
+        }
+    }
+}
+
+SCENARIO( "Registry clients unpublish services by name only", "[registryclient]" ) {
+
+    GIVEN("a JSON client recording its requests") {
+        Arrowhead::HTTPRequest sent;
+        Arrowhead::LoopbackTransport transport([&sent](const Arrowhead::HTTPRequest& req) {
+            sent = req;
+            return canned_response("", "");
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::JSONCodec>
+            client("loopback:", Arrowhead::JSONCodec(), transport);
+        WHEN("a service is unpublished") {
+            client.unpublish("printer._printer-s-ws-https._tcp.srv.arces.unibo.it.");
+            THEN("the body is the name object of the registry API") {
+                REQUIRE(sent.method == "POST");
+                REQUIRE(sent.content_type == "application/json");
+                REQUIRE(sent.body ==
+                    "{\"name\":\"printer._printer-s-ws-https._tcp.srv.arces.unibo.it.\"}");
+            }
+        }
+    }
+}
+#endif
+
+SCENARIO( "Registry clients report failures as error codes", "[registryclient]" ) {
+
+    GIVEN("a server answering with an error status") {
+        Arrowhead::LoopbackTransport transport([](const Arrowhead::HTTPRequest&) {
+            Arrowhead::HTTPResponse resp = canned_response("", "");
+            resp.status = 503;
+            return resp;
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::CodecRegistry>
+            client("loopback:", Arrowhead::CodecRegistry::builtin(), transport);
+        WHEN("services are listed without throwing") {
+            auto res = client.try_list_services();
+            THEN("the status code is returned") {
+                REQUIRE_FALSE(res);
+                REQUIRE(res.error().code() == Arrowhead::Errc::HTTP_STATUS);
+                REQUIRE(res.error().detail() == 503);
+                REQUIRE(res.error().message().find("503") != std::string::npos);
+            }
+            THEN("asking for the value throws the same exception as the throwing API") {
+                REQUIRE_THROWS_AS(res.value(), const Arrowhead::TransportError&);
+            }
+        }
+    }
+    GIVEN("a loopback transport without handler") {
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::CodecRegistry>
+            client("loopback:");
+        WHEN("a service is published without throwing") {
+            Arrowhead::ServiceDescription sd = test_services()[0];
+            auto res = client.try_publish(sd);
+            THEN("a transport error is returned") {
+                REQUIRE(res.error().code() == Arrowhead::Errc::TRANSPORT);
+            }
+        }
+    }
+    GIVEN("a server answering in an unknown format") {
+        Arrowhead::LoopbackTransport transport([](const Arrowhead::HTTPRequest&) {
+            return canned_response("text/plain", "nothing here");
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::CodecRegistry>
+            client("loopback:", Arrowhead::CodecRegistry::builtin(), transport);
+        WHEN("services are listed without throwing") {
+            auto res = client.try_list_services();
+            THEN("the media type is rejected") {
+                REQUIRE(res.error().code() == Arrowhead::Errc::UNSUPPORTED_MEDIA_TYPE);
+                REQUIRE(res.error().message().find("text/plain") != std::string::npos);
+                REQUIRE_THROWS_AS(res.value(), const Arrowhead::ContentError&);
+            }
+        }
+    }
+#if ARROWHEAD_USE_JSON
+    GIVEN("a server answering with malformed content") {
+        Arrowhead::LoopbackTransport transport([](const Arrowhead::HTTPRequest&) {
+            return canned_response("application/json", "{\"service\": [");
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::JSONCodec>
+            client("loopback:", Arrowhead::JSONCodec(), transport);
+        WHEN("services are listed without throwing") {
+            auto res = client.try_list_services();
+            THEN("a content error is returned") {
+                REQUIRE(res.error().code() == Arrowhead::Errc::CONTENT);
+                REQUIRE_THROWS_AS(res.value(), const Arrowhead::ContentError&);
+            }
+        }
+    }
+#endif
+#if ARROWHEAD_USE_PUGIXML
+    GIVEN("a server answering with malformed XML") {
+        Arrowhead::LoopbackTransport transport([](const Arrowhead::HTTPRequest&) {
+            return canned_response("application/xml", "<serviceList><service>");
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::XMLCodec>
+            client("loopback:", Arrowhead::XMLCodec(), transport);
+        WHEN("services are listed without throwing") {
+            auto res = client.try_list_services();
+            THEN("a content error is returned, also in builds without exceptions") {
+                REQUIRE(res.error().code() == Arrowhead::Errc::CONTENT);
+            }
+        }
+    }
+#endif
+#if ARROWHEAD_USE_LIBCURL
+    GIVEN("a registry that is down") {
+        std::string url;
+        {
+            /* Grab a free port and close it again */
+            StubServer server([](const Arrowhead::HTTPRequest&) { return canned_response("", ""); });
+            url = server.url("/servicediscovery");
+        }
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Arrowhead::CodecRegistry>
+            client(url);
+        WHEN("it is polled without throwing") {
+            Arrowhead::Status status;
+            for (int i = 0; i < 10; ++i) {
+                status = client.try_list_services().error();
+            }
+            THEN("every attempt fails with the libcurl error code") {
+                REQUIRE(status.code() == Arrowhead::Errc::TRANSPORT);
+                REQUIRE(status.detail() == CURLE_COULDNT_CONNECT);
+                REQUIRE(status.message().find("CURLError") != std::string::npos);
+            }
+        }
+    }
+#endif
+    GIVEN("a working registry") {
+        StubRegistry registry;
+        Arrowhead::LoopbackTransport transport(
+            [&registry](const Arrowhead::HTTPRequest& req) { return registry.handle(req); });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::CodecRegistry>
+            client("loopback:", Arrowhead::CodecRegistry::builtin(), transport);
+        WHEN("a service is published and listed without throwing") {
+            REQUIRE(client.try_publish(test_services()[0]));
+            auto res = client.try_list_services();
+            THEN("the result holds the services") {
+                REQUIRE(res.has_value());
+                REQUIRE(res.error().ok());
+                REQUIRE(res->size() == 1);
+                REQUIRE((*res)[0].name == test_services()[0].name);
+            }
+        }
+    }
+}
+
+SCENARIO( "Retry policies only retry transient failures", "[registryclient]" ) {
+
+    GIVEN("a policy with 4 attempts") {
+        Arrowhead::RetryPolicy policy(4, std::chrono::milliseconds(10),
+            std::chrono::milliseconds(25));
+        Arrowhead::Status unavailable(Arrowhead::Errc::HTTP_STATUS, 503);
+        THEN("transport errors, timeouts and 5xx are retried for idempotent requests") {
+            REQUIRE(policy.should_retry(1, Arrowhead::Status(Arrowhead::Errc::TRANSPORT), true));
+            REQUIRE(policy.should_retry(1, Arrowhead::Status(Arrowhead::Errc::TIMEOUT), true));
+            REQUIRE(policy.should_retry(3, unavailable, true));
+        }
+        THEN("the last attempt is not retried") {
+            REQUIRE_FALSE(policy.should_retry(4, unavailable, true));
+        }
+        THEN("client errors and content errors are not retried") {
+            REQUIRE_FALSE(policy.should_retry(1,
+                Arrowhead::Status(Arrowhead::Errc::HTTP_STATUS, 404), true));
+            REQUIRE_FALSE(policy.should_retry(1, Arrowhead::Status(Arrowhead::Errc::CONTENT), true));
+        }
+        THEN("requests which are not idempotent are only retried on request") {
+            REQUIRE_FALSE(policy.should_retry(1, unavailable, false));
+            policy.retry_non_idempotent();
+            REQUIRE(policy.should_retry(1, unavailable, false));
+        }
+        THEN("the pauses grow exponentially up to the limit") {
+            for (int i = 0; i < 100; ++i) {
+                REQUIRE(policy.backoff(1).count() <= 10);
+                REQUIRE(policy.backoff(2).count() <= 20);
+                REQUIRE(policy.backoff(10).count() <= 25);
+            }
+        }
+    }
+}
+
+SCENARIO( "Registry clients honour deadlines and retry policies", "[registryclient]" ) {
+
+    GIVEN("a registry failing the first two requests") {
+        StubRegistry registry;
+        std::atomic<int> failures(2);
+        Arrowhead::LoopbackTransport transport(
+            [&registry, &failures](const Arrowhead::HTTPRequest& req) {
+                if (failures-- > 0) {
+                    Arrowhead::HTTPResponse resp = canned_response("", "");
+                    resp.status = 503;
+                    return resp;
+                }
+                return registry.handle(req);
+            });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::CodecRegistry>
+            client("loopback:", Arrowhead::CodecRegistry::builtin(), transport);
+        client.set_retry_policy(Arrowhead::RetryPolicy(3, std::chrono::milliseconds(1)));
+        WHEN("services are listed") {
+            THEN("the third attempt succeeds") {
+                REQUIRE(client.try_list_services());
+                REQUIRE(registry.request_count() == 1);
+            }
+        }
+        WHEN("a service is published") {
+            THEN("it is not retried by default") {
+                REQUIRE(client.try_publish(test_services()[0]).error().detail() == 503);
+                REQUIRE(failures == 1);
+            }
+        }
+        WHEN("a service is published with retries of non-idempotent requests") {
+            client.set_retry_policy(
+                Arrowhead::RetryPolicy(3, std::chrono::milliseconds(1)).retry_non_idempotent());
+            THEN("it is retried") {
+                REQUIRE(client.try_publish(test_services()[0]));
+                REQUIRE(registry.request_count() == 1);
+            }
+        }
+    }
+    GIVEN("a registry which is always unavailable") {
+        std::atomic<int> attempts(0);
+        Arrowhead::LoopbackTransport transport([&attempts](const Arrowhead::HTTPRequest&) {
+            ++attempts;
+            Arrowhead::HTTPResponse resp = canned_response("", "");
+            resp.status = 503;
+            return resp;
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::LoopbackTransport, Arrowhead::CodecRegistry>
+            client("loopback:", Arrowhead::CodecRegistry::builtin(), transport);
+        client.set_retry_policy(Arrowhead::RetryPolicy(1000, std::chrono::milliseconds(10),
+            std::chrono::milliseconds(10)));
+        WHEN("services are listed with a deadline") {
+            auto start = std::chrono::steady_clock::now();
+            auto res = client.try_list_services("",
+                Arrowhead::Deadline::after(std::chrono::milliseconds(100)));
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            THEN("the deadline covers all attempts") {
+                REQUIRE(res.error().code() == Arrowhead::Errc::HTTP_STATUS);
+                REQUIRE(attempts > 1);
+                REQUIRE(attempts < 1000);
+                REQUIRE(elapsed < std::chrono::milliseconds(1000));
+            }
+        }
+        WHEN("services are listed after the deadline") {
+            auto res = client.try_list_services("",
+                Arrowhead::Deadline(std::chrono::steady_clock::now()));
+            THEN("no request is made") {
+                REQUIRE(res.error().code() == Arrowhead::Errc::TIMEOUT);
+                REQUIRE(attempts == 0);
+            }
+        }
+    }
+#if ARROWHEAD_USE_LIBCURL
+    GIVEN("a registry which answers too slowly") {
+        StubServer server([](const Arrowhead::HTTPRequest&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+            return canned_response("", "");
+        });
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Arrowhead::CodecRegistry>
+            client(server.url("/servicediscovery"));
+        client.set_timeout(std::chrono::milliseconds(50));
+        WHEN("services are listed") {
+            auto start = std::chrono::steady_clock::now();
+            auto res = client.try_list_services();
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            THEN("the call times out") {
+                REQUIRE(res.error().code() == Arrowhead::Errc::TIMEOUT);
+                REQUIRE(res.error().detail() == CURLE_OPERATION_TIMEDOUT);
+                REQUIRE(elapsed < std::chrono::milliseconds(250));
+                REQUIRE_THROWS_AS(client.list(), const Arrowhead::TransportError&);
+            }
+        }
+    }
+#endif
+}
+
+#if ARROWHEAD_USE_LIBCURL && !ARROWHEAD_USE_LOG4CPLUS
+
+namespace {
+
+/// Number of operator new calls made by the thread
+thread_local unsigned long allocations = 0;
+
+} /* anonymous namespace */
+
+/* Not inlined, GCC would take malloc() and free() for a mismatch with
+ * operator new and delete */
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void *operator new(size_t size)
+{
+    ++allocations;
+    void *p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+SCENARIO( "Registry calls are filled in from precompiled request templates", "[registryclient]" ) {
+
+    GIVEN("a client of a registry answering with empty bodies") {
+        StubServer server([](const Arrowhead::HTTPRequest&) {
+                Arrowhead::HTTPResponse resp;
+                resp.status = 200;
+                return resp;
+            }, true);
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Arrowhead::CodecRegistry>
+            client(server.url("/servicediscovery"));
+        WHEN("the calls are repeated once the client is warm") {
+            const std::string type = "_printer-s-ws-https._tcp";
+            REQUIRE(client.try_types().has_value());
+            REQUIRE(client.try_list(type).has_value());
+            unsigned long before = allocations;
+            bool ok = client.try_types().has_value();
+            ok = client.try_list(type).has_value() && ok;
+            ok = client.try_list().has_value() && ok;
+            unsigned long made = allocations - before;
+            THEN("setting up the requests allocates nothing") {
+                REQUIRE(ok);
+                REQUIRE(made == 0);
+                REQUIRE(client.transport().handles() == 1);
+            }
+        }
+    }
+    GIVEN("a client of a registry on a Unix domain socket") {
+        TempFile socket_file("", ".sock");
+        StubServer server(socket_file.path(), [](const Arrowhead::HTTPRequest&) {
+                Arrowhead::HTTPResponse resp;
+                resp.status = 200;
+                return resp;
+            }, true);
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Arrowhead::CodecRegistry>
+            client(server.url("/servicediscovery"));
+        WHEN("the calls are repeated once the client is warm") {
+            const std::string type = "_printer-s-ws-https._tcp";
+            REQUIRE(client.try_types().has_value());
+            REQUIRE(client.try_list(type).has_value());
+            unsigned long before = allocations;
+            bool ok = client.try_types().has_value();
+            ok = client.try_list(type).has_value() && ok;
+            ok = client.try_list().has_value() && ok;
+            unsigned long made = allocations - before;
+            THEN("finding the socket and setting up the requests allocates nothing") {
+                REQUIRE(ok);
+                REQUIRE(made == 0);
+                REQUIRE(server.connection_count() == 1);
+            }
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_LIBCURL && !ARROWHEAD_USE_LOG4CPLUS */
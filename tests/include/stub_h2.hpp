@@ -0,0 +1,582 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Minimal HTTP/2 server side for tests
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TESTS_STUB_H2_HPP_
+#define ARROWHEAD_TESTS_STUB_H2_HPP_
+
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "arrowhead/transport.hpp"
+
+/**
+ * @brief HPACK (RFC 7541) header block decoder, with Huffman and dynamic table
+ */
+class StubHPACKDecoder {
+    public:
+        /// Decoded header fields
+        typedef std::vector<std::pair<std::string, std::string>> Headers;
+
+        StubHPACKDecoder() : table_size(0), max_table_size(4096)
+        {
+            /* Canonical Huffman code, RFC 7541 appendix B, from the code lengths */
+            static const unsigned char lengths[257] = {
+                13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+                28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+                6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+                5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+                13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+                7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+                15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+                6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+                20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+                24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+                22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+                21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+                26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+                19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+                20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+                26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+                30,
+            };
+            for (unsigned int len = 0; len <= MAX_CODE_LENGTH; ++len) {
+                count[len] = 0;
+            }
+            for (unsigned int sym = 0; sym < 257; ++sym) {
+                ++count[lengths[sym]];
+            }
+            /* Symbols ordered by code length, then by value */
+            unsigned int code = 0;
+            unsigned int index = 0;
+            for (unsigned int len = 1; len <= MAX_CODE_LENGTH; ++len) {
+                first_code[len] = code;
+                first_index[len] = index;
+                for (unsigned int sym = 0; sym < 257; ++sym) {
+                    if (lengths[sym] == len) {
+                        symbols[index++] = sym;
+                    }
+                }
+                code = (code + count[len]) << 1;
+            }
+        }
+
+        /**
+         * @brief Decode the header block @p block
+         *
+         * @return false if the block is malformed
+         */
+        bool decode(const std::string& block, Headers& headers)
+        {
+            size_t pos = 0;
+            while (pos < block.size()) {
+                unsigned char b = block[pos];
+                uint64_t index;
+                std::string name;
+                std::string value;
+                if (b & 0x80) {
+                    /* Indexed field */
+                    if (!integer(block, pos, 7, index) || !lookup(index, name, value)) {
+                        return false;
+                    }
+                    headers.push_back(std::make_pair(name, value));
+                    continue;
+                }
+                if ((b & 0xe0) == 0x20) {
+                    /* Dynamic table size update */
+                    uint64_t size;
+                    if (!integer(block, pos, 5, size)) {
+                        return false;
+                    }
+                    max_table_size = size;
+                    evict(0);
+                    continue;
+                }
+                /* Literal, with incremental indexing or not */
+                bool indexing = (b & 0xc0) == 0x40;
+                if (!integer(block, pos, indexing ? 6 : 4, index)) {
+                    return false;
+                }
+                if (index == 0) {
+                    if (!string(block, pos, name)) {
+                        return false;
+                    }
+                }
+                else if (!lookup(index, name, value)) {
+                    return false;
+                }
+                if (!string(block, pos, value)) {
+                    return false;
+                }
+                if (indexing) {
+                    size_t size = name.size() + value.size() + 32;
+                    evict(size);
+                    if (size <= max_table_size) {
+                        table.push_front(std::make_pair(name, value));
+                        table_size += size;
+                    }
+                }
+                headers.push_back(std::make_pair(name, value));
+            }
+            return true;
+        }
+
+    private:
+        static const unsigned int MAX_CODE_LENGTH = 30;
+
+        static bool integer(const std::string& block, size_t& pos, unsigned int prefix,
+            uint64_t& value)
+        {
+            if (pos >= block.size()) {
+                return false;
+            }
+            uint64_t mask = (1u << prefix) - 1;
+            value = static_cast<unsigned char>(block[pos++]) & mask;
+            if (value < mask) {
+                return true;
+            }
+            unsigned int shift = 0;
+            unsigned char b;
+            do {
+                if (pos >= block.size() || shift > 56) {
+                    return false;
+                }
+                b = block[pos++];
+                value += static_cast<uint64_t>(b & 0x7f) << shift;
+                shift += 7;
+            } while (b & 0x80);
+            return true;
+        }
+
+        bool string(const std::string& block, size_t& pos, std::string& out) const
+        {
+            if (pos >= block.size()) {
+                return false;
+            }
+            bool huffman = block[pos] & 0x80;
+            uint64_t len;
+            if (!integer(block, pos, 7, len) || block.size() - pos < len) {
+                return false;
+            }
+            if (!huffman) {
+                out = block.substr(pos, len);
+                pos += len;
+                return true;
+            }
+            out.clear();
+            unsigned int code = 0;
+            unsigned int code_len = 0;
+            for (size_t i = pos; i < pos + len; ++i) {
+                for (int bit = 7; bit >= 0; --bit) {
+                    code = (code << 1) | ((static_cast<unsigned char>(block[i]) >> bit) & 1);
+                    ++code_len;
+                    if (code_len > MAX_CODE_LENGTH) {
+                        return false;
+                    }
+                    if (code - first_code[code_len] < count[code_len]) {
+                        unsigned int sym = symbols[first_index[code_len] + code - first_code[code_len]];
+                        if (sym == 256) {
+                            /* EOS must not appear in a string */
+                            return false;
+                        }
+                        out += static_cast<char>(sym);
+                        code = 0;
+                        code_len = 0;
+                    }
+                }
+            }
+            pos += len;
+            /* The rest is padding with the most significant bits of EOS, all ones */
+            return code_len < 8 && code == (1u << code_len) - 1;
+        }
+
+        bool lookup(uint64_t index, std::string& name, std::string& value) const
+        {
+            static const char *const static_table[61][2] = {
+                {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+                {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"},
+                {":status", "200"}, {":status", "204"}, {":status", "206"}, {":status", "304"},
+                {":status", "400"}, {":status", "404"}, {":status", "500"},
+                {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+                {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""},
+                {"access-control-allow-origin", ""}, {"age", ""}, {"allow", ""},
+                {"authorization", ""}, {"cache-control", ""}, {"content-disposition", ""},
+                {"content-encoding", ""}, {"content-language", ""}, {"content-length", ""},
+                {"content-location", ""}, {"content-range", ""}, {"content-type", ""},
+                {"cookie", ""}, {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""},
+                {"from", ""}, {"host", ""}, {"if-match", ""}, {"if-modified-since", ""},
+                {"if-none-match", ""}, {"if-range", ""}, {"if-unmodified-since", ""},
+                {"last-modified", ""}, {"link", ""}, {"location", ""}, {"max-forwards", ""},
+                {"proxy-authenticate", ""}, {"proxy-authorization", ""}, {"range", ""},
+                {"referer", ""}, {"refresh", ""}, {"retry-after", ""}, {"server", ""},
+                {"set-cookie", ""}, {"strict-transport-security", ""},
+                {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""}, {"via", ""},
+                {"www-authenticate", ""},
+            };
+            if (index >= 1 && index <= 61) {
+                name = static_table[index - 1][0];
+                value = static_table[index - 1][1];
+                return true;
+            }
+            if (index >= 62 && index - 62 < table.size()) {
+                name = table[index - 62].first;
+                value = table[index - 62].second;
+                return true;
+            }
+            return false;
+        }
+
+        /* Make room for an entry of @p size bytes */
+        void evict(size_t size)
+        {
+            while (!table.empty() && table_size + size > max_table_size) {
+                table_size -= table.back().first.size() + table.back().second.size() + 32;
+                table.pop_back();
+            }
+        }
+
+        unsigned int count[MAX_CODE_LENGTH + 1];
+        unsigned int first_code[MAX_CODE_LENGTH + 1];
+        unsigned int first_index[MAX_CODE_LENGTH + 1];
+        unsigned int symbols[257];
+        std::deque<std::pair<std::string, std::string>> table;
+        size_t table_size;
+        size_t max_table_size;
+};
+
+/**
+ * @brief Server side of one HTTP/2 connection
+ *
+ * Serves the streams one after another on the calling thread, as soon as a
+ * request is complete. Flow control is not enforced, responses must fit in
+ * the initial window of the client.
+ *
+ * @tparam Connection  type with `ssize_t recv(char *, size_t)` and
+ *                     `ssize_t send(const char *, size_t)`
+ */
+template<class Connection>
+class StubH2Session {
+    public:
+        /// Request handler
+        typedef std::function<Arrowhead::HTTPResponse(const Arrowhead::HTTPRequest&)> Handler;
+
+        /// Client connection preface
+        static const char *preface()
+        {
+            return "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+        }
+
+        /**
+         * @brief Constructor
+         *
+         * @param[in]  conn         connection to serve
+         * @param[in]  handler      function handling every request
+         * @param[in]  url_base     scheme and authority for HTTPRequest::url
+         * @param[in]  max_streams  value of SETTINGS_MAX_CONCURRENT_STREAMS
+         */
+        StubH2Session(Connection& conn, const Handler& handler, const std::string& url_base,
+            unsigned int max_streams) :
+            conn(conn), handler(handler), url_base(url_base), max_streams(max_streams)
+        {}
+
+        /**
+         * @brief Serve the connection until the client closes it
+         *
+         * @param[in]  data      bytes already received, starting with the preface
+         * @param[in]  upgraded  request which was upgraded from HTTP/1.1 and
+         *                       is answered on stream 1, NULL if none
+         */
+        void run(std::string data, const Arrowhead::HTTPRequest *upgraded = NULL)
+        {
+            buffer = std::move(data);
+            std::string settings;
+            put_setting(settings, 0x3, max_streams);
+            if (!send_frame(0x4, 0, 0, settings)) {
+                return;
+            }
+            if (upgraded != NULL && !respond(1, *upgraded)) {
+                return;
+            }
+            size_t preface_len = std::strlen(preface());
+            if (!fill(preface_len) || buffer.compare(0, preface_len, preface()) != 0) {
+                return;
+            }
+            buffer.erase(0, preface_len);
+            while (fill(9)) {
+                size_t len = (static_cast<unsigned char>(buffer[0]) << 16) |
+                    (static_cast<unsigned char>(buffer[1]) << 8) |
+                    static_cast<unsigned char>(buffer[2]);
+                unsigned char type = buffer[3];
+                unsigned char flags = buffer[4];
+                uint32_t id = ((static_cast<unsigned char>(buffer[5]) & 0x7f) << 24) |
+                    (static_cast<unsigned char>(buffer[6]) << 16) |
+                    (static_cast<unsigned char>(buffer[7]) << 8) |
+                    static_cast<unsigned char>(buffer[8]);
+                if (!fill(9 + len)) {
+                    return;
+                }
+                std::string payload = buffer.substr(9, len);
+                buffer.erase(0, 9 + len);
+                if (!frame(type, flags, id, payload)) {
+                    return;
+                }
+            }
+        }
+
+    private:
+        enum {
+            DATA = 0x0,
+            HEADERS = 0x1,
+            SETTINGS = 0x4,
+            PING = 0x6,
+            GOAWAY = 0x7,
+            WINDOW_UPDATE = 0x8,
+            CONTINUATION = 0x9,
+            RST_STREAM = 0x3,
+        };
+
+        enum {
+            END_STREAM = 0x1,
+            ACK = 0x1,
+            END_HEADERS = 0x4,
+            PADDED = 0x8,
+            PRIORITY = 0x20,
+        };
+
+        /* A request being received */
+        struct Stream {
+            Stream() : headers_done(false), end_stream(false) {}
+
+            std::string header_block;
+            Arrowhead::HTTPRequest req;
+            bool headers_done;
+            bool end_stream;
+        };
+
+        bool frame(unsigned char type, unsigned char flags, uint32_t id, std::string payload)
+        {
+            switch (type) {
+                case SETTINGS:
+                    return (flags & ACK) || send_frame(SETTINGS, ACK, 0, std::string());
+                case PING:
+                    return (flags & ACK) || send_frame(PING, ACK, 0, payload);
+                case GOAWAY:
+                    return false;
+                case RST_STREAM:
+                    streams.erase(id);
+                    return true;
+                case HEADERS:
+                case CONTINUATION:
+                case DATA:
+                    break;
+                default:
+                    /* PRIORITY, WINDOW_UPDATE and unknown frames */
+                    return true;
+            }
+            size_t flow_len = payload.size();
+            if (type != CONTINUATION && (flags & PADDED)) {
+                if (payload.empty() || static_cast<unsigned char>(payload[0]) >= payload.size()) {
+                    return false;
+                }
+                payload = payload.substr(1, payload.size() - 1 - static_cast<unsigned char>(payload[0]));
+            }
+            if (type == HEADERS && (flags & PRIORITY)) {
+                if (payload.size() < 5) {
+                    return false;
+                }
+                payload.erase(0, 5);
+            }
+            Stream& stream = streams[id];
+            if (type == DATA) {
+                stream.req.body += payload;
+                if (flow_len > 0) {
+                    /* Give the client the window back at once */
+                    std::string increment;
+                    put32(increment, static_cast<uint32_t>(flow_len));
+                    if (!send_frame(WINDOW_UPDATE, 0, 0, increment) ||
+                        ((flags & END_STREAM) == 0 &&
+                         !send_frame(WINDOW_UPDATE, 0, id, increment))) {
+                        return false;
+                    }
+                }
+            }
+            else {
+                stream.header_block += payload;
+                if (flags & END_HEADERS) {
+                    /* Decode in arrival order, the dynamic table depends on it */
+                    StubHPACKDecoder::Headers headers;
+                    if (!hpack.decode(stream.header_block, headers)) {
+                        return false;
+                    }
+                    request(headers, stream.req);
+                    stream.headers_done = true;
+                }
+            }
+            if (type != CONTINUATION && (flags & END_STREAM)) {
+                stream.end_stream = true;
+            }
+            if (stream.headers_done && stream.end_stream) {
+                Arrowhead::HTTPRequest req = std::move(stream.req);
+                streams.erase(id);
+                return respond(id, req);
+            }
+            return true;
+        }
+
+        void request(const StubHPACKDecoder::Headers& headers, Arrowhead::HTTPRequest& req)
+        {
+            for (const auto& field: headers) {
+                if (field.first == ":method") {
+                    req.method = field.second;
+                }
+                else if (field.first == ":path") {
+                    req.path = field.second;
+                    req.url = url_base + field.second;
+                }
+                else if (field.first == "accept") {
+                    req.accept = field.second;
+                }
+                else if (field.first == "content-type") {
+                    req.content_type = field.second;
+                }
+            }
+        }
+
+        bool respond(uint32_t id, const Arrowhead::HTTPRequest& req)
+        {
+            Arrowhead::HTTPResponse resp = handler(req);
+            /* Literals without indexing, names from the static table */
+            std::string block;
+            put_literal(block, 8, std::to_string(resp.status));
+            if (!resp.content_type.empty()) {
+                put_literal(block, 31, resp.content_type);
+            }
+            put_literal(block, 28, std::to_string(resp.body.size()));
+            if (!send_frame(HEADERS, END_HEADERS | (resp.body.empty() ? END_STREAM : 0), id,
+                    block)) {
+                return false;
+            }
+            /* Default SETTINGS_MAX_FRAME_SIZE */
+            const size_t max_frame = 16384;
+            for (size_t pos = 0; pos < resp.body.size(); pos += max_frame) {
+                bool last = pos + max_frame >= resp.body.size();
+                if (!send_frame(DATA, last ? END_STREAM : 0, id, resp.body.substr(pos, max_frame))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static void put_int(std::string& out, unsigned char first, unsigned int prefix,
+            uint64_t value)
+        {
+            uint64_t mask = (1u << prefix) - 1;
+            if (value < mask) {
+                out += static_cast<char>(first | value);
+                return;
+            }
+            out += static_cast<char>(first | mask);
+            value -= mask;
+            while (value >= 0x80) {
+                out += static_cast<char>((value & 0x7f) | 0x80);
+                value >>= 7;
+            }
+            out += static_cast<char>(value);
+        }
+
+        static void put_literal(std::string& out, unsigned int name_index, const std::string& value)
+        {
+            put_int(out, 0x00, 4, name_index);
+            put_int(out, 0x00, 7, value.size());
+            out += value;
+        }
+
+        static void put32(std::string& out, uint32_t value)
+        {
+            out += static_cast<char>(value >> 24);
+            out += static_cast<char>(value >> 16);
+            out += static_cast<char>(value >> 8);
+            out += static_cast<char>(value);
+        }
+
+        static void put_setting(std::string& out, uint16_t id, uint32_t value)
+        {
+            out += static_cast<char>(id >> 8);
+            out += static_cast<char>(id);
+            put32(out, value);
+        }
+
+        bool send_frame(unsigned char type, unsigned char flags, uint32_t id,
+            const std::string& payload)
+        {
+            std::string out;
+            out += static_cast<char>(payload.size() >> 16);
+            out += static_cast<char>(payload.size() >> 8);
+            out += static_cast<char>(payload.size());
+            out += static_cast<char>(type);
+            out += static_cast<char>(flags);
+            put32(out, id);
+            out += payload;
+            size_t sent = 0;
+            while (sent < out.size()) {
+                ssize_t n = conn.send(out.data() + sent, out.size() - sent);
+                if (n <= 0) {
+                    return false;
+                }
+                sent += n;
+            }
+            return true;
+        }
+
+        /* Receive until the buffer holds @p len bytes */
+        bool fill(size_t len)
+        {
+            char buf[16384];
+            while (buffer.size() < len) {
+                ssize_t n = conn.recv(buf, sizeof(buf));
+                if (n <= 0) {
+                    return false;
+                }
+                buffer.append(buf, n);
+            }
+            return true;
+        }
+
+        Connection& conn;
+        const Handler& handler;
+        std::string url_base;
+        unsigned int max_streams;
+        std::string buffer;
+        StubHPACKDecoder hpack;
+        std::map<uint32_t, Stream> streams;
+};
+
+#endif /* ARROWHEAD_TESTS_STUB_H2_HPP_ */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       In-memory Service Registry REST API for tests
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TESTS_STUB_REGISTRY_HPP_
+#define ARROWHEAD_TESTS_STUB_REGISTRY_HPP_
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "arrowhead/codec.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/transport.hpp"
+
+#if ARROWHEAD_USE_JSON
+#include "arrowhead/detail/_nlohmann_json.hpp"
+#endif
+
+/**
+ * @brief Minimal Service Registry implementing the REST API in memory
+ *
+ * Answers in the first format of the `Accept` header it supports and
+ * decodes request bodies by their `Content-Type`. Thread safe, so it can be
+ * served by StubServer and called through a LoopbackTransport at once.
+ */
+class StubRegistry {
+    public:
+        StubRegistry() : codecs(Arrowhead::CodecRegistry::builtin()), requests(0) {}
+
+        /**
+         * @brief Handle one request
+         */
+        Arrowhead::HTTPResponse handle(const Arrowhead::HTTPRequest& req)
+        {
+            ++requests;
+            Arrowhead::HTTPResponse resp;
+            resp.status = 200;
+            try {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (req.path.find("/type/") != std::string::npos) {
+                    std::string type = req.path.substr(req.path.find("/type/") + 6);
+                    std::vector<Arrowhead::ServiceDescription> list;
+                    for (auto& kv: services) {
+                        if (kv.second.type == type) {
+                            list.push_back(kv.second);
+                        }
+                    }
+                    encode(resp, req.accept, list);
+                }
+                else if (ends_with(req.path, "/service")) {
+                    std::vector<Arrowhead::ServiceDescription> list;
+                    for (auto& kv: services) {
+                        list.push_back(kv.second);
+                    }
+                    encode(resp, req.accept, list);
+                }
+                else if (ends_with(req.path, "/publish") && req.method == "POST") {
+                    Arrowhead::ServiceDescription sd = decode(req);
+                    services[sd.name] = sd;
+                }
+                else if (ends_with(req.path, "/unpublish") && req.method == "POST") {
+                    if (services.erase(decode_name(req)) == 0) {
+                        resp.status = 404;
+                    }
+                }
+                else {
+                    resp.status = 404;
+                }
+            }
+            catch (const Arrowhead::ContentError& e) {
+                resp.status = 400;
+                resp.body = e.what();
+            }
+            return resp;
+        }
+
+        /**
+         * @brief Number of requests handled so far
+         */
+        unsigned int request_count() const
+        {
+            return requests;
+        }
+
+    private:
+        static bool ends_with(const std::string& str, const std::string& suffix)
+        {
+            return str.size() >= suffix.size() &&
+                str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+        }
+
+        void encode(Arrowhead::HTTPResponse& resp, const std::string& accept,
+            const std::vector<Arrowhead::ServiceDescription>& list)
+        {
+            const Arrowhead::Codec *codec = NULL;
+            size_t begin = 0;
+            while (codec == NULL && begin < accept.size()) {
+                size_t end = accept.find(',', begin);
+                if (end == std::string::npos) {
+                    end = accept.size();
+                }
+                codec = codecs.find(accept.substr(begin, end - begin));
+                begin = end + 1;
+            }
+            if (codec == NULL) {
+                codec = &codecs.preferred();
+            }
+            resp.content_type = codec->media_type();
+            resp.body = codec->encode_servicelist(list);
+        }
+
+        Arrowhead::ServiceDescription decode(const Arrowhead::HTTPRequest& req)
+        {
+            const Arrowhead::Codec *codec = codecs.find(req.content_type);
+            if (codec == NULL) {
+                throw Arrowhead::ContentError("unsupported Content-Type " + req.content_type);
+            }
+            return codec->decode_service(req.body.data(), req.body.size());
+        }
+
+        /* The JSON formats unpublish with a `{"name": ...}` object, the others
+         * with a service description of which only the name is set */
+        std::string decode_name(const Arrowhead::HTTPRequest& req)
+        {
+#if ARROWHEAD_USE_JSON
+            std::string type = Arrowhead::media_type_of(req.content_type);
+            if (type == "application/json" || type == "application/x-ndjson") {
+                nlohmann::json js;
+                try {
+                    js = nlohmann::json::parse(req.body);
+                }
+                catch (const std::exception& e) {
+                    throw Arrowhead::ContentError(e.what());
+                }
+                auto it = js.find("name");
+                if (!js.is_object() || it == js.end() || !it->is_string()) {
+                    throw Arrowhead::ContentError("unpublish body without a name");
+                }
+                return it->get<std::string>();
+            }
+#endif
+            return decode(req).name;
+        }
+
+        Arrowhead::CodecRegistry codecs;
+        std::mutex mutex;
+        std::map<std::string, Arrowhead::ServiceDescription> services;
+        std::atomic<unsigned int> requests;
+};
+
+#endif /* ARROWHEAD_TESTS_STUB_REGISTRY_HPP_ */
@@ -0,0 +1,579 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Minimal HTTP/1.1 server on the loopback interface for tests
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TESTS_STUB_SERVER_HPP_
+#define ARROWHEAD_TESTS_STUB_SERVER_HPP_
+
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "arrowhead/config.h"
+#include "arrowhead/transport.hpp"
+#include "stub_h2.hpp"
+
+#if ARROWHEAD_USE_OPENSSL
+#include <openssl/ssl.h>
+#endif
+
+#if ARROWHEAD_USE_ZLIB
+#include <zlib.h>
+#endif
+
+/**
+ * @brief HTTP server passing every request to a handler function
+ *
+ * Listens on an ephemeral port of 127.0.0.1, or on a Unix domain socket,
+ * and serves every connection on a thread of its own. Every response closes the connection, unless the
+ * server is created with keep-alive. With an OpenSSL context the server
+ * speaks HTTPS instead.
+ *
+ * A server created with HTTP/2 also accepts h2c, with prior knowledge or as
+ * an upgrade from HTTP/1.1. Over TLS, HTTP/2 is used whenever the context
+ * selects it through ALPN.
+ *
+ * With zlib, gzip request bodies are decoded before they reach the handler
+ * and, over HTTP/1.1, responses are gzip compressed if the client accepts
+ * it and compress_responses() was called.
+ */
+class StubServer {
+    public:
+        /// Request handler
+        typedef std::function<Arrowhead::HTTPResponse(const Arrowhead::HTTPRequest&)> Handler;
+
+        /**
+         * @brief Start listening
+         *
+         * @param[in]  handler     function handling every request
+         * @param[in]  keep_alive  serve further requests on a connection
+         *                         until the client closes it
+         * @param[in]  http2       also speak h2c
+         */
+        explicit StubServer(Handler handler, bool keep_alive = false, bool http2 = false) :
+            handler(handler), keep_alive(keep_alive), http2(http2), stopping(false),
+            connections(0), resumed(0), http2_connections(0), compress(false),
+            compressed_requests(0), compressed_responses(0)
+        {
+            start();
+        }
+
+        /**
+         * @brief Start listening on a Unix domain socket
+         *
+         * @param[in]  socket_path  path of the socket, removed again by the
+         *                          destructor
+         * @param[in]  handler      function handling every request
+         * @param[in]  keep_alive   serve further requests on a connection
+         *                          until the client closes it
+         * @param[in]  http2        also speak h2c
+         */
+        StubServer(const std::string& socket_path, Handler handler, bool keep_alive = false,
+            bool http2 = false) :
+            handler(handler), keep_alive(keep_alive), http2(http2), socket_path(socket_path),
+            stopping(false), connections(0), resumed(0), http2_connections(0), compress(false),
+            compressed_requests(0), compressed_responses(0)
+        {
+            start();
+        }
+
+#if ARROWHEAD_USE_OPENSSL
+        /**
+         * @brief Start listening for TLS connections
+         *
+         * @param[in]  handler     function handling every request
+         * @param[in]  tls         server context, must outlive the server
+         * @param[in]  keep_alive  serve further requests on a connection
+         *                         until the client closes it
+         */
+        StubServer(Handler handler, SSL_CTX *tls, bool keep_alive = false) :
+            handler(handler), keep_alive(keep_alive), http2(false), stopping(false),
+            connections(0), resumed(0), http2_connections(0), compress(false),
+            compressed_requests(0), compressed_responses(0), tls(tls)
+        {
+            start();
+        }
+#endif
+
+        ~StubServer()
+        {
+            stopping = true;
+            /* Wakes up the blocking accept() */
+            ::shutdown(listen_fd, SHUT_RDWR);
+            thread.join();
+            {
+                /* Wakes up the blocking recv() of every connection */
+                std::lock_guard<std::mutex> lock(mutex);
+                for (int fd: client_fds) {
+                    ::shutdown(fd, SHUT_RDWR);
+                }
+            }
+            for (std::thread& t: connection_threads) {
+                t.join();
+            }
+            ::close(listen_fd);
+            if (!socket_path.empty()) {
+                ::unlink(socket_path.c_str());
+            }
+        }
+
+        StubServer(const StubServer&) = delete;
+        StubServer& operator=(const StubServer&) = delete;
+
+        /**
+         * @brief Port the server listens on
+         */
+        unsigned short port() const
+        {
+            return port_;
+        }
+
+        /**
+         * @brief Number of connections accepted so far
+         */
+        unsigned int connection_count() const
+        {
+            return connections;
+        }
+
+        /**
+         * @brief Number of connections which spoke HTTP/2
+         */
+        unsigned int http2_connection_count() const
+        {
+            return http2_connections;
+        }
+
+        /**
+         * @brief Number of TLS connections which resumed an earlier session
+         */
+        unsigned int resumed_count() const
+        {
+            return resumed;
+        }
+
+        /**
+         * @brief Compress the responses to clients accepting gzip
+         */
+        void compress_responses(bool on = true)
+        {
+            compress = on;
+        }
+
+        /**
+         * @brief Number of gzip request bodies received
+         */
+        unsigned int compressed_request_count() const
+        {
+            return compressed_requests;
+        }
+
+        /**
+         * @brief Number of responses sent gzip compressed
+         */
+        unsigned int compressed_response_count() const
+        {
+            return compressed_responses;
+        }
+
+        /**
+         * @brief Absolute URL of @p path on this server
+         */
+        std::string url(const std::string& path = std::string()) const
+        {
+            if (!socket_path.empty()) {
+                return "unix://" + socket_path + path;
+            }
+#if ARROWHEAD_USE_OPENSSL
+            if (tls != NULL) {
+                return "https://127.0.0.1:" + std::to_string(port_) + path;
+            }
+#endif
+            return "http://127.0.0.1:" + std::to_string(port_) + path;
+        }
+
+    private:
+        /* One accepted connection, plain or TLS */
+        struct Connection {
+            int fd;
+#if ARROWHEAD_USE_OPENSSL
+            SSL *ssl;
+#endif
+
+            ssize_t recv(char *buf, size_t len)
+            {
+#if ARROWHEAD_USE_OPENSSL
+                if (ssl != NULL) {
+                    return SSL_read(ssl, buf, static_cast<int>(len));
+                }
+#endif
+                return ::recv(fd, buf, len, 0);
+            }
+
+            ssize_t send(const char *buf, size_t len)
+            {
+#if ARROWHEAD_USE_OPENSSL
+                if (ssl != NULL) {
+                    return SSL_write(ssl, buf, static_cast<int>(len));
+                }
+#endif
+                return ::send(fd, buf, len, MSG_NOSIGNAL);
+            }
+        };
+
+        void start()
+        {
+            if (!socket_path.empty()) {
+                start_unix();
+                return;
+            }
+            listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (listen_fd < 0) {
+                throw std::runtime_error("StubServer: socket failed");
+            }
+            struct sockaddr_in addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = 0;
+            socklen_t len = sizeof(addr);
+            if (::bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+                ::listen(listen_fd, 16) != 0 ||
+                ::getsockname(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), &len) != 0) {
+                ::close(listen_fd);
+                throw std::runtime_error("StubServer: bind failed");
+            }
+            port_ = ntohs(addr.sin_port);
+            thread = std::thread(&StubServer::run, this);
+        }
+
+        void start_unix()
+        {
+            struct sockaddr_un addr;
+            std::memset(&addr, 0, sizeof(addr));
+            addr.sun_family = AF_UNIX;
+            if (socket_path.size() >= sizeof(addr.sun_path)) {
+                throw std::runtime_error("StubServer: socket path too long");
+            }
+            std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size());
+            listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            if (listen_fd < 0) {
+                throw std::runtime_error("StubServer: socket failed");
+            }
+            ::unlink(socket_path.c_str());
+            if (::bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+                ::listen(listen_fd, 16) != 0) {
+                ::close(listen_fd);
+                throw std::runtime_error("StubServer: bind failed");
+            }
+            port_ = 0;
+            thread = std::thread(&StubServer::run, this);
+        }
+
+        void run()
+        {
+            /* OpenSSL writes without MSG_NOSIGNAL, keep a client hanging up
+             * from killing us. Connection threads inherit the mask. */
+            sigset_t pipe_set;
+            sigemptyset(&pipe_set);
+            sigaddset(&pipe_set, SIGPIPE);
+            pthread_sigmask(SIG_BLOCK, &pipe_set, NULL);
+            while (!stopping) {
+                int fd = ::accept(listen_fd, NULL, NULL);
+                if (fd < 0) {
+                    continue;
+                }
+                ++connections;
+                /* HTTP/2 responses are written frame by frame */
+                int one = 1;
+                ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                std::lock_guard<std::mutex> lock(mutex);
+                client_fds.insert(fd);
+                connection_threads.push_back(std::thread(&StubServer::handle, this, fd));
+            }
+        }
+
+        void handle(int fd)
+        {
+            Connection conn;
+            conn.fd = fd;
+            bool ready = true;
+            bool h2 = false;
+#if ARROWHEAD_USE_OPENSSL
+            conn.ssl = NULL;
+            if (tls != NULL) {
+                conn.ssl = SSL_new(tls);
+                SSL_set_fd(conn.ssl, fd);
+                ready = SSL_accept(conn.ssl) == 1;
+                if (ready && SSL_session_reused(conn.ssl)) {
+                    ++resumed;
+                }
+                const unsigned char *alpn = NULL;
+                unsigned int alpn_len = 0;
+                SSL_get0_alpn_selected(conn.ssl, &alpn, &alpn_len);
+                h2 = alpn_len == 2 && std::memcmp(alpn, "h2", 2) == 0;
+            }
+#endif
+            std::string data;
+            if (ready && h2) {
+                serve_h2(conn, data, NULL);
+            }
+            else {
+                while (ready && serve(conn, data) && keep_alive && !stopping) {
+                    /* Next request on the same connection */
+                }
+            }
+#if ARROWHEAD_USE_OPENSSL
+            if (conn.ssl != NULL) {
+                if (ready) {
+                    SSL_shutdown(conn.ssl);
+                }
+                SSL_free(conn.ssl);
+            }
+#endif
+            std::lock_guard<std::mutex> lock(mutex);
+            client_fds.erase(fd);
+            ::close(fd);
+        }
+
+        void serve_h2(Connection& conn, std::string& data, const Arrowhead::HTTPRequest *upgraded)
+        {
+            ++http2_connections;
+            std::string base = url();
+            StubH2Session<Connection> session(conn, handler, base, 100);
+            session.run(data, upgraded);
+        }
+
+        static bool header_is(const std::string& line, const char *name)
+        {
+            size_t len = std::strlen(name);
+            if (line.size() <= len || line[len] != ':') {
+                return false;
+            }
+            for (size_t i = 0; i < len; ++i) {
+                if (std::tolower(static_cast<unsigned char>(line[i])) != name[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static std::string header_value(const std::string& line)
+        {
+            size_t pos = line.find(':') + 1;
+            while (pos < line.size() && line[pos] == ' ') {
+                ++pos;
+            }
+            return line.substr(pos);
+        }
+
+        /* Serve one request from @p data and @p conn, false when the client is gone */
+        bool serve(Connection& conn, std::string& data)
+        {
+            char buf[4096];
+            size_t head_end;
+            while ((head_end = data.find("\r\n\r\n")) == std::string::npos) {
+                ssize_t n = conn.recv(buf, sizeof(buf));
+                if (n <= 0) {
+                    return false;
+                }
+                data.append(buf, n);
+            }
+
+            Arrowhead::HTTPRequest req;
+            size_t content_length = 0;
+            bool expect_continue = false;
+            bool upgrade_h2c = false;
+            bool gzip_body = false;
+            bool accept_gzip = false;
+            size_t line_end = data.find("\r\n");
+            std::string request_line = data.substr(0, line_end);
+            if (http2 && request_line == "PRI * HTTP/2.0") {
+                /* h2c with prior knowledge, this was the connection preface */
+                serve_h2(conn, data, NULL);
+                return false;
+            }
+            size_t sp1 = request_line.find(' ');
+            size_t sp2 = request_line.find(' ', sp1 + 1);
+            req.method = request_line.substr(0, sp1);
+            req.path = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+            req.url = url(req.path);
+            while (line_end < head_end) {
+                size_t next = data.find("\r\n", line_end + 2);
+                std::string line = data.substr(line_end + 2, next - line_end - 2);
+                if (header_is(line, "content-length")) {
+                    content_length = std::strtoul(header_value(line).c_str(), NULL, 10);
+                }
+                else if (header_is(line, "accept")) {
+                    req.accept = header_value(line);
+                }
+                else if (header_is(line, "content-type")) {
+                    req.content_type = header_value(line);
+                }
+                else if (header_is(line, "content-encoding")) {
+                    gzip_body = header_value(line) == "gzip";
+                }
+                else if (header_is(line, "accept-encoding")) {
+                    accept_gzip = header_value(line).find("gzip") != std::string::npos;
+                }
+                else if (header_is(line, "expect")) {
+                    expect_continue = true;
+                }
+                else if (header_is(line, "upgrade")) {
+                    upgrade_h2c = http2 && header_value(line).find("h2c") != std::string::npos;
+                }
+                line_end = next;
+            }
+            if (expect_continue) {
+                static const char cont[] = "HTTP/1.1 100 Continue\r\n\r\n";
+                conn.send(cont, sizeof(cont) - 1);
+            }
+            while (data.size() < head_end + 4 + content_length) {
+                ssize_t n = conn.recv(buf, sizeof(buf));
+                if (n <= 0) {
+                    return false;
+                }
+                data.append(buf, n);
+            }
+            req.body = data.substr(head_end + 4, content_length);
+            data.erase(0, head_end + 4 + content_length);
+            if (gzip_body) {
+#if ARROWHEAD_USE_ZLIB
+                ++compressed_requests;
+                req.body = transcode(req.body, false);
+#endif
+            }
+
+            if (upgrade_h2c) {
+                static const char switching[] = "HTTP/1.1 101 Switching Protocols\r\n"
+                    "Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+                if (conn.send(switching, sizeof(switching) - 1) > 0) {
+                    /* The response goes out on stream 1 */
+                    serve_h2(conn, data, &req);
+                }
+                return false;
+            }
+
+            Arrowhead::HTTPResponse resp = handler(req);
+            std::string out = "HTTP/1.1 " + std::to_string(resp.status) +
+                (resp.status < 400 ? " OK" : " Error") + "\r\n";
+            if (!resp.content_type.empty()) {
+                out += "Content-Type: " + resp.content_type + "\r\n";
+            }
+            if (compress && accept_gzip && !resp.body.empty()) {
+#if ARROWHEAD_USE_ZLIB
+                ++compressed_responses;
+                resp.body = transcode(resp.body, true);
+                out += "Content-Encoding: gzip\r\n";
+#endif
+            }
+            out += "Content-Length: " + std::to_string(resp.body.size()) + "\r\n";
+            out += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+            out += resp.body;
+            size_t sent = 0;
+            while (sent < out.size()) {
+                ssize_t n = conn.send(out.data() + sent, out.size() - sent);
+                if (n <= 0) {
+                    return false;
+                }
+                sent += n;
+            }
+            return true;
+        }
+
+#if ARROWHEAD_USE_ZLIB
+        /* gzip compress or decompress @p in */
+        static std::string transcode(const std::string& in, bool deflate)
+        {
+            z_stream zs;
+            std::memset(&zs, 0, sizeof(zs));
+            int rc = deflate ?
+                deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) :
+                inflateInit2(&zs, 16 + MAX_WBITS);
+            if (rc != Z_OK) {
+                throw std::runtime_error("StubServer: zlib init failed");
+            }
+            zs.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.data()));
+            zs.avail_in = in.size();
+            std::string out;
+            char buf[16384];
+            do {
+                zs.next_out = reinterpret_cast<Bytef *>(buf);
+                zs.avail_out = sizeof(buf);
+                rc = deflate ? ::deflate(&zs, Z_FINISH) : ::inflate(&zs, Z_NO_FLUSH);
+                out.append(buf, sizeof(buf) - zs.avail_out);
+            } while (rc == Z_OK);
+            if (deflate) {
+                deflateEnd(&zs);
+            }
+            else {
+                inflateEnd(&zs);
+            }
+            if (rc != Z_STREAM_END) {
+                throw std::runtime_error("StubServer: bad gzip data");
+            }
+            return out;
+        }
+#endif
+
+        Handler handler;
+        bool keep_alive;
+        bool http2;
+        std::string socket_path;
+        int listen_fd;
+        unsigned short port_;
+        std::atomic<bool> stopping;
+        std::atomic<unsigned int> connections;
+        std::atomic<unsigned int> resumed;
+        std::atomic<unsigned int> http2_connections;
+        std::atomic<bool> compress;
+        std::atomic<unsigned int> compressed_requests;
+        std::atomic<unsigned int> compressed_responses;
+#if ARROWHEAD_USE_OPENSSL
+        SSL_CTX *tls = NULL;
+#endif
+        std::thread thread;
+        std::mutex mutex;
+        /// Open connections
+        std::set<int> client_fds;
+        std::vector<std::thread> connection_threads;
+};
+
+#endif /* ARROWHEAD_TESTS_STUB_SERVER_HPP_ */
@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Throwaway certificates and server TLS contexts for tests
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TESTS_STUB_TLS_HPP_
+#define ARROWHEAD_TESTS_STUB_TLS_HPP_
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_OPENSSL
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+/**
+ * @brief Self-signed server and client certificates in a temporary directory
+ *
+ * The server certificate is valid for 127.0.0.1 and localhost. Each
+ * certificate is its own trust anchor, so the server certificate file is
+ * the CA file of the client and vice versa.
+ */
+class TestCertificates {
+    public:
+        TestCertificates()
+        {
+            char tmpl[] = "/tmp/arrowhead-tls-XXXXXX";
+            if (::mkdtemp(tmpl) == NULL) {
+                throw std::runtime_error("TestCertificates: mkdtemp failed");
+            }
+            dir = tmpl;
+            server_cert = dir + "/server.pem";
+            server_key = dir + "/server.key";
+            client_cert = dir + "/client.pem";
+            client_key = dir + "/client.key";
+            create("localhost", "IP:127.0.0.1,DNS:localhost", server_cert, server_key);
+            create("client", "DNS:client", client_cert, client_key);
+        }
+
+        ~TestCertificates()
+        {
+            ::unlink(server_cert.c_str());
+            ::unlink(server_key.c_str());
+            ::unlink(client_cert.c_str());
+            ::unlink(client_key.c_str());
+            ::rmdir(dir.c_str());
+        }
+
+        TestCertificates(const TestCertificates&) = delete;
+        TestCertificates& operator=(const TestCertificates&) = delete;
+
+        /**
+         * @brief New server context
+         *
+         * @param[in]  require_client_cert  reject clients without the client
+         *                                  certificate (mutual TLS)
+         * @param[in]  http2                select HTTP/2 through ALPN if the
+         *                                  client offers it
+         */
+        std::shared_ptr<SSL_CTX> server_context(bool require_client_cert,
+            bool http2 = false) const
+        {
+            std::shared_ptr<SSL_CTX> ctx(SSL_CTX_new(TLS_server_method()), SSL_CTX_free);
+            if (!ctx ||
+                SSL_CTX_use_certificate_file(ctx.get(), server_cert.c_str(), SSL_FILETYPE_PEM) != 1 ||
+                SSL_CTX_use_PrivateKey_file(ctx.get(), server_key.c_str(), SSL_FILETYPE_PEM) != 1) {
+                throw std::runtime_error("TestCertificates: bad server context");
+            }
+            /* Sessions may only be resumed within the same context */
+            static const unsigned char sid_ctx[] = "arrowhead-tests";
+            SSL_CTX_set_session_id_context(ctx.get(), sid_ctx, sizeof(sid_ctx) - 1);
+            if (require_client_cert) {
+                SSL_CTX_load_verify_locations(ctx.get(), client_cert.c_str(), NULL);
+                SSL_CTX_set_verify(ctx.get(), SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+            }
+            if (http2) {
+                SSL_CTX_set_alpn_select_cb(ctx.get(), select_h2, NULL);
+            }
+            return ctx;
+        }
+
+        /// Directory holding the files
+        std::string dir;
+        /// Server certificate, PEM
+        std::string server_cert;
+        /// Server private key, PEM
+        std::string server_key;
+        /// Client certificate, PEM
+        std::string client_cert;
+        /// Client private key, PEM
+        std::string client_key;
+
+    private:
+        static int select_h2(SSL *, const unsigned char **out, unsigned char *outlen,
+            const unsigned char *in, unsigned int inlen, void *)
+        {
+            static const unsigned char protocols[] = "\x02h2\x08http/1.1";
+            if (SSL_select_next_proto(const_cast<unsigned char **>(out), outlen, protocols,
+                    sizeof(protocols) - 1, in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+                return SSL_TLSEXT_ERR_NOACK;
+            }
+            return SSL_TLSEXT_ERR_OK;
+        }
+
+        static void create(const char *cn, const char *san, const std::string& cert_path,
+            const std::string& key_path)
+        {
+            EVP_PKEY *key = EVP_EC_gen("P-256");
+            X509 *cert = X509_new();
+            if (key == NULL || cert == NULL) {
+                throw std::runtime_error("TestCertificates: out of memory");
+            }
+            X509_set_version(cert, 2);
+            ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+            X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+            X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+            X509_set_pubkey(cert, key);
+            X509_NAME *name = X509_get_subject_name(cert);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                reinterpret_cast<const unsigned char *>(cn), -1, -1, 0);
+            X509_set_issuer_name(cert, name);
+            X509V3_CTX v3;
+            X509V3_set_ctx_nodb(&v3);
+            X509V3_set_ctx(&v3, cert, cert, NULL, NULL, 0);
+            X509_EXTENSION *ext = X509V3_EXT_conf_nid(NULL, &v3, NID_subject_alt_name, san);
+            X509_add_ext(cert, ext, -1);
+            X509_EXTENSION_free(ext);
+            X509_sign(cert, key, EVP_sha256());
+
+            FILE *f = std::fopen(cert_path.c_str(), "w");
+            PEM_write_X509(f, cert);
+            std::fclose(f);
+            f = std::fopen(key_path.c_str(), "w");
+            PEM_write_PrivateKey(f, key, NULL, NULL, 0, NULL, NULL);
+            std::fclose(f);
+            X509_free(cert);
+            EVP_PKEY_free(key);
+        }
+};
+
+#endif /* ARROWHEAD_USE_OPENSSL */
+
+#endif /* ARROWHEAD_TESTS_STUB_TLS_HPP_ */
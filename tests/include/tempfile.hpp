@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Temporary file helper for tests
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#ifndef ARROWHEAD_TESTS_TEMPFILE_HPP_
+#define ARROWHEAD_TESTS_TEMPFILE_HPP_
+
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+/**
+ * @brief Uniquely named file in the temporary directory, removed on destruction
+ */
+class TempFile {
+    public:
+        /**
+         * @brief Create the file with the given contents
+         *
+         * @param[in]  contents  initial file contents
+         * @param[in]  suffix    file name suffix
+         */
+        explicit TempFile(const std::string& contents = std::string(),
+            const std::string& suffix = ".tmp")
+        {
+            static std::atomic<unsigned int> serial(0);
+            path_ = (std::filesystem::temp_directory_path() /
+                ("arrowhead_test_" + std::to_string(::getpid()) + "_" +
+                 std::to_string(serial++) + suffix)).string();
+            std::ofstream f(path_.c_str(), std::ios::binary);
+            f << contents;
+        }
+
+        ~TempFile()
+        {
+            std::remove(path_.c_str());
+        }
+
+        TempFile(const TempFile&) = delete;
+        TempFile& operator=(const TempFile&) = delete;
+
+        const std::string& path() const
+        {
+            return path_;
+        }
+
+    private:
+        std::string path_;
+};
+
+#endif /* ARROWHEAD_TESTS_TEMPFILE_HPP_ */
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Line delimited JSON service list tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "tempfile.hpp"
+#include "arrowhead/service.hpp"
+#include "arrowhead/exception.hpp"
+#include <algorithm>
+#include <vector>
+#include <iterator>
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::vector<Arrowhead::ServiceDescription> make_services(size_t count)
+{
+    std::vector<Arrowhead::ServiceDescription> services(count);
+    for (size_t i = 0; i < count; ++i) {
+        services[i].name = "service-" + std::to_string(i) + "._printer._tcp.srv.arces.unibo.it.";
+        services[i].type = "_printer._tcp";
+        services[i].domain = "arces.unibo.it.";
+        services[i].host = "host-" + std::to_string(i % 7) + ".";
+        services[i].port = 8000 + i;
+        services[i].properties["version"] = "1.0";
+    }
+    return services;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Services are read and written as line delimited JSON", "[servicejson][ndjson]" ) {
+
+    GIVEN("services with characters that need escaping") {
+        std::vector<Arrowhead::ServiceDescription> services = make_services(2);
+        services[1].properties["path"] = "/a \"quoted\"\\path\n\twith\x01control";
+
+        WHEN("they are written and read back") {
+            std::ostringstream os;
+            Arrowhead::write_servicelist_ndjson(os, services.begin(), services.end());
+            std::string text = os.str();
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            Arrowhead::parse_servicelist_ndjson(std::back_inserter(parsed), text);
+            THEN("there is one line per service and the services are unchanged") {
+                REQUIRE(std::count(text.begin(), text.end(), '\n') == 2);
+                REQUIRE(parsed.size() == 2);
+                REQUIRE(parsed[1].name == services[1].name);
+                REQUIRE(parsed[1].port == services[1].port);
+                REQUIRE(parsed[1].properties == services[1].properties);
+            }
+            THEN("every line is a valid single service JSON object") {
+                std::string first = text.substr(0, text.find('\n'));
+                Arrowhead::ServiceDescription sd = Arrowhead::ServiceDescription::from_json(first);
+                REQUIRE(sd.name == services[0].name);
+            }
+        }
+    }
+    GIVEN("a line delimited list with blank lines, CRLF and no final newline") {
+        std::ostringstream os;
+        std::vector<Arrowhead::ServiceDescription> services = make_services(3);
+        Arrowhead::write_servicelist_ndjson(os, services.begin(), services.end());
+        std::string text = os.str();
+        text.insert(text.find('\n'), "\r");
+        text.insert(0, "\n  \n");
+        text.pop_back();
+
+        WHEN("the list is fed to a line reader one byte at a time") {
+            Arrowhead::JSON::LineReader reader;
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            for (size_t i = 0; i < text.size(); ++i) {
+                reader.feed(std::back_inserter(parsed), &text[i], 1);
+            }
+            REQUIRE(parsed.size() == 2);
+            reader.finish(std::back_inserter(parsed));
+            THEN("the last service is output when the input is finished") {
+                REQUIRE(parsed.size() == 3);
+                REQUIRE(parsed[2].name == services[2].name);
+            }
+        }
+    }
+    GIVEN("a large line delimited list") {
+        std::vector<Arrowhead::ServiceDescription> services = make_services(20000);
+        std::ostringstream os;
+        Arrowhead::write_servicelist_ndjson(os, services.begin(), services.end());
+        std::string text = os.str();
+
+        WHEN("the list is parsed in parallel") {
+            std::vector<Arrowhead::ServiceDescription> parsed;
+            Arrowhead::parse_servicelist_ndjson_parallel(std::back_inserter(parsed),
+                text.data(), text.size(), 4);
+            THEN("all services are output in input order") {
+                REQUIRE(parsed.size() == services.size());
+                for (size_t i = 0; i < parsed.size(); i += 997) {
+                    REQUIRE(parsed[i].name == services[i].name);
+                }
+                REQUIRE(parsed.back().name == services.back().name);
+            }
+        }
+        WHEN("the list is parsed from a file") {
+            TempFile file(text);
+            std::vector<Arrowhead::ServiceDescription> sequential;
+            std::vector<Arrowhead::ServiceDescription> parallel;
+            Arrowhead::parse_servicelist_ndjson_file(std::back_inserter(sequential), file.path());
+            Arrowhead::parse_servicelist_ndjson_file(std::back_inserter(parallel), file.path(), 4);
+            THEN("all services are output") {
+                REQUIRE(sequential.size() == services.size());
+                REQUIRE(parallel.size() == services.size());
+                REQUIRE(parallel.back().name == services.back().name);
+            }
+        }
+        WHEN("a line in the middle is broken") {
+            text.insert(text.find('\n', text.size() / 2) + 1, "{\"name\": \"broken\"\n");
+            THEN("the parallel parser reports an error") {
+                std::vector<Arrowhead::ServiceDescription> parsed;
+                REQUIRE_THROWS_AS(Arrowhead::parse_servicelist_ndjson_parallel(
+                    std::back_inserter(parsed), text.data(), text.size(), 4),
+                    const Arrowhead::ContentError&);
+            }
+        }
+    }
+}
@@ -23,9 +23,12 @@
  */
 
 #include "catch.hpp"
+#include "tempfile.hpp"
 #include "arrowhead/service.hpp"
+#include "arrowhead/exception.hpp"
 #include <vector>
 #include <iterator>
+#include <memory_resource>
 
 #define TEST_JSON_LIST_2_SERVICES_TEXT \
     "{\n" \
@@ -119,3 +122,96 @@ SCENARIO( "Services are parsed from JSON", "[servicejson]" ) {
         }
     }
 }
+
+SCENARIO( "Services are parsed from JSON into a memory resource", "[servicejson][pmr]" ) {
+
+    GIVEN("a monotonic buffer resource and a destination vector using it") {
+        std::pmr::monotonic_buffer_resource arena;
+        std::pmr::vector<Arrowhead::pmr::ServiceDescription> servicelist(&arena);
+
+        WHEN("a JSON service list string containing 2 services is parsed" ) {
+            std::string js(TEST_JSON_LIST_2_SERVICES_TEXT);
+            Arrowhead::parse_servicelist_json(std::back_inserter(servicelist), js, &arena);
+            THEN("the vector is extended with the supplied services") {
+                REQUIRE(servicelist.size() == 2);
+                REQUIRE(servicelist[0].name == "orchestration-store._orch-s-ws-https._tcp.srv.arces.unibo.it.");
+                REQUIRE(servicelist[0].port == 8181);
+                REQUIRE(servicelist[0].properties["path"] == "/orchestration/store/");
+                REQUIRE(servicelist[1].host == "192.168.56.101.");
+                REQUIRE(servicelist[1].properties["version"] == "1.0");
+            }
+            THEN("the services are allocated from the arena") {
+                for (auto& srv: servicelist) {
+                    REQUIRE(srv.get_allocator().resource() == &arena);
+                    REQUIRE(srv.properties.get_allocator().resource() == &arena);
+                }
+            }
+        }
+        WHEN("a JSON document with other top level keys is parsed from a buffer") {
+            std::string js = "{\"version\": {\"service\": []}, \"service\": [" \
+                "{\"name\": \"a\", \"type\": \"t\", \"domain\": \"d\", \"host\": \"h\", " \
+                "\"port\": 1, \"properties\": {\"property\": []}}]}";
+            Arrowhead::parse_servicelist_json(std::back_inserter(servicelist),
+                js.data(), js.size(), &arena);
+            THEN("only the services in the service list are output") {
+                REQUIRE(servicelist.size() == 1);
+                REQUIRE(servicelist[0].name == "a");
+                REQUIRE(servicelist[0].port == 1);
+            }
+        }
+        WHEN("a JSON document without a service list is parsed") {
+            std::string js = "{\"version\": 1}";
+            Arrowhead::parse_servicelist_json(std::back_inserter(servicelist), js, &arena);
+            THEN("nothing is output") {
+                REQUIRE(servicelist.empty());
+            }
+        }
+    }
+}
+
+SCENARIO( "Services are parsed from JSON files", "[servicejson][file]" ) {
+
+    GIVEN("a JSON service list file with an extra top level key") {
+        TempFile file("{\"version\": {\"service\": []},\n\"service\": [\n" \
+            "{\"name\": \"a\", \"type\": \"t\", \"domain\": \"d\", \"host\": \"h\", \"port\": 1, " \
+            "\"properties\": {\"property\": [{\"name\": \"k\", \"value\": \"v\"}]}},\n" \
+            "{\"name\": \"b\", \"type\": \"t\", \"domain\": \"d\", \"host\": \"h\", \"port\": 2, " \
+            "\"properties\": {\"property\": []}}\n]}\n");
+        std::vector<Arrowhead::ServiceDescription> servicelist;
+
+        WHEN("the file is parsed") {
+            Arrowhead::parse_servicelist_json_file(std::back_inserter(servicelist), file.path());
+            THEN("only the services in the service list are output") {
+                REQUIRE(servicelist.size() == 2);
+                REQUIRE(servicelist[0].name == "a");
+                REQUIRE(servicelist[0].properties["k"] == "v");
+                REQUIRE(servicelist[1].port == 2);
+            }
+        }
+    }
+    GIVEN("the example service list in a file") {
+        TempFile file(TEST_JSON_LIST_2_SERVICES_TEXT);
+        WHEN("the file is parsed") {
+            std::vector<Arrowhead::ServiceDescription> servicelist;
+            Arrowhead::parse_servicelist_json_file(std::back_inserter(servicelist), file.path());
+            THEN("the result is the same as when parsing the string") {
+                std::vector<Arrowhead::ServiceDescription> expected;
+                Arrowhead::parse_servicelist_json(std::back_inserter(expected),
+                    std::string(TEST_JSON_LIST_2_SERVICES_TEXT));
+                REQUIRE(servicelist.size() == expected.size());
+                REQUIRE(servicelist[1].name == expected[1].name);
+                REQUIRE(servicelist[1].properties == expected[1].properties);
+            }
+        }
+    }
+    GIVEN("a file which is not JSON and a file which does not exist") {
+        TempFile file(TEST_NOT_JSON_TEXT);
+        std::vector<Arrowhead::ServiceDescription> servicelist;
+        THEN("errors are reported as exceptions") {
+            REQUIRE_THROWS_AS(Arrowhead::parse_servicelist_json_file(
+                std::back_inserter(servicelist), file.path()), const Arrowhead::ContentError&);
+            REQUIRE_THROWS_AS(Arrowhead::parse_servicelist_json_file(
+                std::back_inserter(servicelist), file.path() + ".missing"), const Arrowhead::Error&);
+        }
+    }
+}
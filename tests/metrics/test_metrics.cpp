@@ -0,0 +1,301 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Metrics registry tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/codec.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/metrics.hpp"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if ARROWHEAD_USE_LIBCURL
+#include "stub_server.hpp"
+#include "arrowhead/transport.hpp"
+#endif
+
+#if ARROWHEAD_USE_METRICS && ARROWHEAD_USE_JSON
+namespace {
+
+/* Value of the series @p name{@p labels} in the library registry, -1 if there is none */
+int64_t value_of(const std::string& name, const std::string& labels)
+{
+    for (const Arrowhead::Metrics::Sample& sample:
+        Arrowhead::Metrics::Registry::instance().snapshot()) {
+        if (sample.name == name && sample.labels == labels) {
+            return sample.type == Arrowhead::Metrics::Type::HISTOGRAM ?
+                static_cast<int64_t>(sample.histogram.count) : sample.value;
+        }
+    }
+    return -1;
+}
+
+} /* anonymous namespace */
+#endif /* ARROWHEAD_USE_METRICS && ARROWHEAD_USE_JSON */
+
+SCENARIO( "Counters and gauges sum up the updates of all threads", "[metrics]" ) {
+
+    GIVEN("a counter and a gauge") {
+        Arrowhead::Metrics::Counter counter;
+        Arrowhead::Metrics::Gauge gauge;
+        WHEN("many threads update them") {
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 12; ++t) {
+                threads.emplace_back([&counter, &gauge]() {
+                    for (int i = 0; i < 10000; ++i) {
+                        counter.add();
+                        gauge.add(2);
+                        gauge.add(-1);
+                    }
+                });
+            }
+            for (std::thread& t: threads) {
+                t.join();
+            }
+            THEN("no update is lost") {
+                REQUIRE(counter.value() == 120000);
+                REQUIRE(gauge.value() == 120000);
+            }
+        }
+        WHEN("the gauge is set") {
+            gauge.add(5);
+            gauge.set(-3);
+            THEN("it has the value set") {
+                REQUIRE(gauge.value() == -3);
+            }
+        }
+    }
+}
+
+SCENARIO( "Histograms know durations within 12.5%", "[metrics]" ) {
+
+    GIVEN("the bucket layout") {
+        THEN("every bucket starts where the one before it ends") {
+            for (size_t i = 0; i + 1 < Arrowhead::Metrics::Histogram::BUCKETS; ++i) {
+                uint64_t start = Arrowhead::Metrics::Histogram::bucket_start(i);
+                uint64_t next = Arrowhead::Metrics::Histogram::bucket_start(i + 1);
+                REQUIRE(next > start);
+                REQUIRE(Arrowhead::Metrics::Histogram::bucket_of(start) == i);
+                REQUIRE(Arrowhead::Metrics::Histogram::bucket_of(next - 1) == i);
+                /* The width is at most an eighth of the start */
+                REQUIRE((next - start) * 8 <= std::max<uint64_t>(start, 8));
+            }
+            REQUIRE(Arrowhead::Metrics::Histogram::bucket_of(~uint64_t(0)) ==
+                Arrowhead::Metrics::Histogram::BUCKETS - 1);
+        }
+    }
+    GIVEN("a histogram") {
+        Arrowhead::Metrics::Histogram histogram;
+        WHEN("durations are recorded from several threads") {
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t) {
+                threads.emplace_back([&histogram]() {
+                    for (int us = 1; us <= 1000; ++us) {
+                        histogram.observe(std::chrono::microseconds(us));
+                    }
+                });
+            }
+            for (std::thread& t: threads) {
+                t.join();
+            }
+            Arrowhead::Metrics::HistogramSnapshot snap = histogram.snapshot();
+            THEN("they are all counted") {
+                REQUIRE(snap.count == 4000);
+                REQUIRE(snap.sum == 4 * 500500 * 1000ull);
+            }
+            THEN("the percentiles are close") {
+                for (double q: {0.5, 0.9, 0.99}) {
+                    double exact = q * 1000e3;
+                    double p = static_cast<double>(snap.percentile(q).count());
+                    REQUIRE(p >= exact);
+                    REQUIRE(p <= exact * 1.126);
+                }
+            }
+            THEN("the counts below a power of two are exact") {
+                /* 1 to 524 µs are below 2^19 ns, 524.288 µs */
+                REQUIRE(snap.count_below(std::chrono::nanoseconds(1 << 19)) == 4 * 524);
+                REQUIRE(snap.count_below(std::chrono::seconds(1)) == 4000);
+                REQUIRE(snap.count_below(std::chrono::nanoseconds(0)) == 0);
+            }
+        }
+        WHEN("nothing is recorded") {
+            THEN("there are no percentiles") {
+                REQUIRE(histogram.snapshot().percentile(0.5).count() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO( "The registry renders its metrics for Prometheus", "[metrics]" ) {
+
+    GIVEN("a registry with metrics of each type") {
+        Arrowhead::Metrics::Registry registry;
+        Arrowhead::Metrics::Counter& ok = registry.counter("app_requests_total",
+            "result=\"ok\"", "Requests made");
+        Arrowhead::Metrics::Counter& failed = registry.counter("app_requests_total",
+            "result=\"failed\"", "ignored, the first help is used");
+        registry.gauge("app_connections", "", "Open connections").set(3);
+        Arrowhead::Metrics::Histogram& latency = registry.histogram("app_latency_seconds",
+            "op=\"get\"", "Request latency");
+        ok.add(5);
+        failed.add();
+        latency.observe(std::chrono::microseconds(3));
+        latency.observe(std::chrono::milliseconds(1));
+        WHEN("a metric is asked for again") {
+            THEN("the same one is returned") {
+                REQUIRE(&registry.counter("app_requests_total", "result=\"ok\"", "") == &ok);
+                REQUIRE(registry.counter("app_requests_total", "result=\"ok\"", "").value() == 5);
+            }
+        }
+        WHEN("a name is asked for as another type") {
+            THEN("it is refused") {
+                REQUIRE_THROWS_AS(registry.gauge("app_requests_total", "", ""),
+                    const Arrowhead::Error&);
+            }
+        }
+        WHEN("a snapshot is taken") {
+            std::vector<Arrowhead::Metrics::Sample> samples = registry.snapshot();
+            THEN("it is ordered by name and labels") {
+                REQUIRE(samples.size() == 4);
+                REQUIRE(samples[0].name == "app_connections");
+                REQUIRE(samples[0].value == 3);
+                REQUIRE(samples[1].name == "app_latency_seconds");
+                REQUIRE(samples[1].histogram.count == 2);
+                REQUIRE(samples[2].labels == "result=\"failed\"");
+                REQUIRE(samples[2].value == 1);
+                REQUIRE(samples[2].help == "Requests made");
+                REQUIRE(samples[3].labels == "result=\"ok\"");
+                REQUIRE(samples[3].value == 5);
+            }
+        }
+        WHEN("the metrics are rendered") {
+            std::string text = registry.prometheus();
+            THEN("every name has one HELP and TYPE line") {
+                REQUIRE(text.find("# HELP app_requests_total Requests made\n"
+                    "# TYPE app_requests_total counter\n"
+                    "app_requests_total{result=\"failed\"} 1\n"
+                    "app_requests_total{result=\"ok\"} 5\n") != std::string::npos);
+                REQUIRE(text.find("# TYPE app_connections gauge\napp_connections 3\n") !=
+                    std::string::npos);
+                REQUIRE(text.find("ignored") == std::string::npos);
+            }
+            THEN("histograms have cumulative buckets in seconds") {
+                REQUIRE(text.find("# TYPE app_latency_seconds histogram\n") != std::string::npos);
+                REQUIRE(text.find("app_latency_seconds_bucket{op=\"get\",le=\"1.024e-06\"} 0\n") !=
+                    std::string::npos);
+                REQUIRE(text.find("app_latency_seconds_bucket{op=\"get\",le=\"4.096e-06\"} 1\n") !=
+                    std::string::npos);
+                REQUIRE(text.find("app_latency_seconds_bucket{op=\"get\",le=\"0.001048576\"} 2\n") !=
+                    std::string::npos);
+                REQUIRE(text.find("app_latency_seconds_bucket{op=\"get\",le=\"+Inf\"} 2\n") !=
+                    std::string::npos);
+                REQUIRE(text.find("app_latency_seconds_sum{op=\"get\"} 0.001003\n") !=
+                    std::string::npos);
+                REQUIRE(text.find("app_latency_seconds_count{op=\"get\"} 2\n") !=
+                    std::string::npos);
+            }
+        }
+    }
+}
+
+#if ARROWHEAD_USE_METRICS && ARROWHEAD_USE_JSON
+SCENARIO( "The library records its operations", "[metrics]" ) {
+
+    GIVEN("the JSON codec") {
+        Arrowhead::JSONCodec codec;
+        const std::string list = "{\"service\":[]}";
+        std::vector<Arrowhead::ServiceDescription> services;
+        codec.decode_servicelist(services, list.data(), list.size());
+        int64_t before = value_of("arrowhead_parse_duration_seconds", "format=\"json\"");
+        WHEN("a service list is decoded") {
+            codec.decode_servicelist(services, list.data(), list.size());
+            THEN("the parse time is recorded") {
+                REQUIRE(value_of("arrowhead_parse_duration_seconds", "format=\"json\"") ==
+                    before + 1);
+            }
+        }
+    }
+#if ARROWHEAD_USE_LIBCURL
+    GIVEN("a transport") {
+        StubServer server([](const Arrowhead::HTTPRequest&) {
+                Arrowhead::HTTPResponse resp;
+                resp.status = 200;
+                resp.body = "hello";
+                return resp;
+            });
+        Arrowhead::CURLEasyTransport transport;
+        Arrowhead::HTTPRequest req;
+        req.method = "GET";
+        req.url = server.url("/service");
+        transport.perform(req);
+        int64_t requests = value_of("arrowhead_http_requests_total", "result=\"ok\"");
+        int64_t bytes = value_of("arrowhead_http_response_body_bytes_total", "");
+        int64_t durations = value_of("arrowhead_http_request_duration_seconds", "");
+        WHEN("a request is made") {
+            transport.perform(req);
+            THEN("it is counted") {
+                REQUIRE(value_of("arrowhead_http_requests_total", "result=\"ok\"") ==
+                    requests + 1);
+                REQUIRE(value_of("arrowhead_http_response_body_bytes_total", "") == bytes + 5);
+                REQUIRE(value_of("arrowhead_http_request_duration_seconds", "") ==
+                    durations + 1);
+                REQUIRE(value_of("arrowhead_curl_idle_handles", "") >= 1);
+            }
+        }
+    }
+#endif
+}
+#endif /* ARROWHEAD_USE_METRICS && ARROWHEAD_USE_JSON */
+
+#if ARROWHEAD_USE_LIBCURL
+SCENARIO( "The endpoint serves the metrics to Prometheus", "[metrics]" ) {
+
+    GIVEN("an endpoint on a free port") {
+        Arrowhead::Metrics::Registry registry;
+        registry.counter("app_scrapes_total", "", "Scrapes").add(7);
+        Arrowhead::Metrics::Endpoint endpoint(registry);
+        Arrowhead::CURLEasyTransport transport;
+        Arrowhead::HTTPRequest req;
+        req.method = "GET";
+        const std::string base = "http://127.0.0.1:" + std::to_string(endpoint.port());
+        WHEN("the metrics are scraped") {
+            req.url = base + "/metrics";
+            Arrowhead::HTTPResponse resp = transport.perform(req);
+            THEN("they are served in the text format") {
+                REQUIRE(resp.status == 200);
+                REQUIRE(resp.content_type == "text/plain; version=0.0.4; charset=utf-8");
+                REQUIRE(resp.body == registry.prometheus());
+                REQUIRE(resp.body.find("app_scrapes_total 7\n") != std::string::npos);
+            }
+        }
+        WHEN("another path is requested") {
+            req.url = base + "/";
+            THEN("it is not found") {
+                REQUIRE(transport.perform(req).status == 404);
+            }
+        }
+    }
+}
+#endif
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       DNS-SD name decomposition tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/dnssd.hpp"
+#include <string>
+
+SCENARIO( "Domain names are canonicalized", "[dnssd]" ) {
+
+    GIVEN("names differing in case and trailing dot") {
+        Arrowhead::CanonicalName a("Arrowhead.LTU.se.");
+        Arrowhead::CanonicalName b("arrowhead.ltu.se");
+        Arrowhead::CanonicalName c("arrowhead.ltu.sx");
+
+        THEN("the canonical forms and hashes are equal") {
+            REQUIRE(a.str() == "arrowhead.ltu.se");
+            REQUIRE(a.hash() == b.hash());
+            REQUIRE(a == b);
+            REQUIRE(a != c);
+            REQUIRE(a.label_count() == 3);
+            REQUIRE(a.label(0) == "arrowhead");
+            REQUIRE(a.label(2) == "se");
+        }
+    }
+    GIVEN("a name with an escaped dot") {
+        Arrowhead::CanonicalName a("My\\.Printer._ipp._tcp.local.");
+        THEN("the escaped dot does not split the label") {
+            REQUIRE(a.label_count() == 4);
+            REQUIRE(a.label(0) == "my\\.printer");
+        }
+    }
+}
+
+SCENARIO( "Service names are decomposed into DNS-SD components", "[dnssd]" ) {
+
+    GIVEN("a service description") {
+        Arrowhead::ServiceDescription sd;
+        sd.name = "Orchestration-Mgmt._orch-m-ws-http._tcp.srv.arrowhead.ltu.se.";
+        sd.type = "_orch-m-ws-http._tcp";
+        sd.domain = "arrowhead.ltu.se.";
+
+        WHEN("the service is decomposed") {
+            Arrowhead::ServiceNameComponents comp =
+                Arrowhead::ServiceNameComponents::from_service(sd);
+            THEN("the name is split into instance, service, protocol and domain") {
+                REQUIRE(comp.instance.str() == "orchestration-mgmt");
+                REQUIRE(comp.service.str() == "_orch-m-ws-http");
+                REQUIRE(comp.protocol.str() == "_tcp");
+                REQUIRE(comp.name_domain.str() == "srv.arrowhead.ltu.se");
+                REQUIRE(comp.type.str() == "_orch-m-ws-http._tcp");
+                REQUIRE(comp.domain == Arrowhead::CanonicalName("ARROWHEAD.ltu.se"));
+            }
+        }
+        WHEN("the name is not a DNS-SD service instance name") {
+            sd.name = "plain.example.com.";
+            THEN("the whole name is the instance") {
+                Arrowhead::ServiceNameComponents comp =
+                    Arrowhead::ServiceNameComponents::from_service(sd);
+                REQUIRE(comp.instance.str() == "plain.example.com");
+                REQUIRE(comp.service.empty());
+                REQUIRE(comp.protocol.empty());
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service list snapshot comparison tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/servicediff.hpp"
+#include <string>
+#include <vector>
+
+namespace {
+
+Arrowhead::ServiceDescription make_service(const std::string& name,
+    const std::string& host, unsigned int port)
+{
+    Arrowhead::ServiceDescription sd;
+    sd.name = name;
+    sd.type = "_printer-s-ws-https._tcp";
+    sd.domain = "arces.unibo.it.";
+    sd.host = host;
+    sd.port = port;
+    sd.properties["version"] = "1.0";
+    return sd;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Service list snapshots are compared", "[servicediff]" ) {
+
+    GIVEN("two snapshots with added, removed, modified and unchanged services") {
+        std::vector<Arrowhead::ServiceDescription> old_list;
+        old_list.push_back(make_service("d-unchanged", "host-a.", 8080));
+        old_list.push_back(make_service("b-removed", "host-a.", 8080));
+        old_list.push_back(make_service("c-moved", "host-a.", 8080));
+        old_list.push_back(make_service("a-props", "host-a.", 8080));
+
+        std::vector<Arrowhead::ServiceDescription> new_list;
+        new_list.push_back(make_service("e-added", "host-b.", 8081));
+        new_list.push_back(make_service("a-props", "host-a.", 8080));
+        new_list.back().properties["path"] = "/print/";
+        new_list.push_back(make_service("c-moved", "host-b.", 8081));
+        new_list.push_back(make_service("d-unchanged", "host-a.", 8080));
+
+        WHEN("the snapshots are diffed by hashing") {
+            Arrowhead::ServiceListDiff diff = Arrowhead::diff_servicelists(old_list, new_list);
+            THEN("the added, removed and modified services are reported") {
+                REQUIRE(!diff.empty());
+                REQUIRE(diff.added.size() == 1);
+                REQUIRE(diff.added[0]->name == "e-added");
+                REQUIRE(diff.removed.size() == 1);
+                REQUIRE(diff.removed[0]->name == "b-removed");
+                REQUIRE(diff.modified.size() == 2);
+                REQUIRE(diff.modified[0].new_service->name == "a-props");
+                REQUIRE(diff.modified[0].changed == Arrowhead::SERVICE_FIELD_PROPERTIES);
+                REQUIRE(diff.modified[1].old_service->name == "c-moved");
+                REQUIRE(diff.modified[1].old_service->host == "host-a.");
+                REQUIRE(diff.modified[1].changed ==
+                    (Arrowhead::SERVICE_FIELD_HOST | Arrowhead::SERVICE_FIELD_PORT));
+            }
+        }
+        WHEN("the snapshots are sorted and diffed by merging") {
+            Arrowhead::sort_servicelist(old_list);
+            Arrowhead::sort_servicelist(new_list);
+            Arrowhead::ServiceListDiff diff = Arrowhead::diff_sorted_servicelists(old_list, new_list);
+            THEN("the same changes are reported") {
+                REQUIRE(diff.added.size() == 1);
+                REQUIRE(diff.added[0]->name == "e-added");
+                REQUIRE(diff.removed.size() == 1);
+                REQUIRE(diff.removed[0]->name == "b-removed");
+                REQUIRE(diff.modified.size() == 2);
+                REQUIRE(diff.modified[0].changed == Arrowhead::SERVICE_FIELD_PROPERTIES);
+                REQUIRE(diff.modified[1].changed ==
+                    (Arrowhead::SERVICE_FIELD_HOST | Arrowhead::SERVICE_FIELD_PORT));
+            }
+        }
+        WHEN("a snapshot is diffed against itself") {
+            Arrowhead::ServiceListDiff diff = Arrowhead::diff_servicelists(old_list, old_list);
+            THEN("the diff is empty") {
+                REQUIRE(diff.empty());
+            }
+        }
+    }
+}
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Multi-key service index tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/serviceindex.hpp"
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Arrowhead::ServiceDescription make_service(const std::string& name,
+    const std::string& type, const std::string& host, const std::string& version)
+{
+    Arrowhead::ServiceDescription sd;
+    sd.name = name;
+    sd.type = type;
+    sd.domain = "arces.unibo.it.";
+    sd.host = host;
+    sd.port = 8181;
+    sd.properties["version"] = version;
+    return sd;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Services are looked up through a ServiceIndex", "[serviceindex]" ) {
+
+    GIVEN("an index with four services") {
+        Arrowhead::ServiceIndex idx;
+        std::vector<Arrowhead::ServiceDescription> services;
+        services.push_back(make_service("printer-1", "_printer._tcp", "host-a.", "1.0"));
+        services.push_back(make_service("printer-2", "_printer._tcp", "host-b.", "1.1"));
+        services.push_back(make_service("store-1", "_orch-s._tcp", "host-a.", "1.1"));
+        services.push_back(make_service("auth-1", "_auth._tcp", "host-b.", "0.2"));
+        idx.insert(services.begin(), services.end());
+        REQUIRE(idx.size() == 4);
+
+        WHEN("services are looked up by a single key") {
+            THEN("the matching services are returned") {
+                REQUIRE(idx.find("store-1") != NULL);
+                REQUIRE(idx.find("store-1")->type == "_orch-s._tcp");
+                REQUIRE(idx.find("nonexistent") == NULL);
+                REQUIRE(idx.find_by_type("_printer._tcp").size() == 2);
+                REQUIRE(idx.find_by_host("host-a.").size() == 2);
+                REQUIRE(idx.find_by_domain("arces.unibo.it.").size() == 4);
+                REQUIRE(idx.find_by_property("version", "1.1").size() == 2);
+                REQUIRE(idx.find_by_property("path", "/").empty());
+                REQUIRE(idx.find_by_type("_unknown._udp").empty());
+            }
+        }
+        WHEN("a compound query is made") {
+            Arrowhead::ServiceQuery q;
+            q.type("_printer._tcp").property("version", "1.1");
+            Arrowhead::ServiceIndex::result_type res = idx.select(q);
+            THEN("only services matching all criteria are returned") {
+                REQUIRE(res.size() == 1);
+                REQUIRE(res[0]->name == "printer-2");
+            }
+        }
+        WHEN("a service is replaced") {
+            idx.insert(make_service("printer-1", "_printer._tcp", "host-c.", "2.0"));
+            THEN("the indexes follow the new contents") {
+                REQUIRE(idx.size() == 4);
+                REQUIRE(idx.find_by_host("host-a.").size() == 1);
+                REQUIRE(idx.find_by_host("host-c.").size() == 1);
+                REQUIRE(idx.find_by_property("version", "1.0").empty());
+                REQUIRE(idx.find_by_property("version", "2.0").size() == 1);
+            }
+        }
+        WHEN("a service is erased") {
+            REQUIRE(idx.erase("auth-1"));
+            REQUIRE(!idx.erase("auth-1"));
+            THEN("it can no longer be found through any index") {
+                REQUIRE(idx.size() == 3);
+                REQUIRE(idx.find("auth-1") == NULL);
+                REQUIRE(idx.find_by_type("_auth._tcp").empty());
+                REQUIRE(idx.find_by_property("version", "0.2").empty());
+                REQUIRE(idx.find_by_host("host-b.").size() == 1);
+                REQUIRE(idx.select(Arrowhead::ServiceQuery()).size() == 3);
+            }
+        }
+        WHEN("a service with a DNS-SD name is inserted") {
+            const Arrowhead::ServiceDescription *sd = idx.insert(make_service(
+                "Printer-3._printer._tcp.srv.arces.unibo.it.", "_printer._tcp", "host-c.", "1.0"));
+            const Arrowhead::ServiceNameComponents *comp = idx.name_components(sd);
+            THEN("its decomposition is kept with it") {
+                REQUIRE(comp != NULL);
+                REQUIRE(comp->instance.str() == "printer-3");
+                REQUIRE(comp->service.str() == "_printer");
+                REQUIRE(comp->name_domain.str() == "srv.arces.unibo.it");
+                REQUIRE(comp->type == Arrowhead::CanonicalName("_printer._tcp."));
+                REQUIRE(idx.name_components(idx.find("printer-1"))->instance.str() == "printer-1");
+            }
+            THEN("it is computed anew when the service is replaced") {
+                std::string name = sd->name;
+                REQUIRE(idx.insert(make_service(name, "_scanner._tcp", "host-c.", "1.1")) == sd);
+                REQUIRE(idx.name_components(sd)->type == Arrowhead::CanonicalName("_scanner._tcp."));
+            }
+            THEN("services of other indexes have none") {
+                Arrowhead::ServiceIndex other(idx);
+                REQUIRE(idx.name_components(other.find(sd->name)) == NULL);
+                REQUIRE(idx.name_components(NULL) == NULL);
+            }
+        }
+        WHEN("the decompositions are asked for from several threads") {
+            const Arrowhead::ServiceIndex& shared = idx;
+            std::vector<std::vector<const Arrowhead::ServiceNameComponents *> > seen(4);
+            std::vector<std::thread> threads;
+            for (auto& comps: seen) {
+                threads.emplace_back([&shared, &services, &comps]() {
+                    for (const auto& srv: services) {
+                        comps.push_back(shared.name_components(shared.find(srv.name)));
+                    }
+                });
+            }
+            for (auto& t: threads) {
+                t.join();
+            }
+            THEN("every service is decomposed once") {
+                for (const auto& comps: seen) {
+                    REQUIRE(comps.size() == services.size());
+                    REQUIRE(comps == seen[0]);
+                }
+                REQUIRE(seen[0][0]->instance.str() == "printer-1");
+            }
+        }
+        WHEN("the index is copied and the original destroyed") {
+            std::unique_ptr<Arrowhead::ServiceIndex> original(new Arrowhead::ServiceIndex(idx));
+            Arrowhead::ServiceIndex copy(*original);
+            Arrowhead::ServiceIndex assigned;
+            assigned.insert(make_service("other-1", "_other._tcp", "host-d.", "9"));
+            assigned = *original;
+            original.reset();
+            THEN("the copies find their own services") {
+                for (const Arrowhead::ServiceIndex *c: {&copy, &assigned}) {
+                    REQUIRE(c->size() == 4);
+                    Arrowhead::ServiceIndex::result_type res = c->find_by_type("_printer._tcp");
+                    REQUIRE(res.size() == 2);
+                    for (const Arrowhead::ServiceDescription *sd: res) {
+                        REQUIRE(c->find(sd->name) == sd);
+                    }
+                    REQUIRE(c->find_by_type("_other._tcp").empty());
+                    REQUIRE(c->find_by_property("version", "0.2")[0] == c->find("auth-1"));
+                    REQUIRE(c->name_components(c->find("auth-1"))->name.str() == "auth-1");
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service name radix tree tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/servicenametree.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::string> names(const Arrowhead::ServiceNameTree::result_type& res)
+{
+    std::vector<std::string> out;
+    for (auto sd: res) {
+        out.push_back(sd->name);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Service names are searched through a radix tree", "[servicenametree]" ) {
+
+    GIVEN("a tree built from a parsed service list") {
+        std::vector<Arrowhead::ServiceDescription> services(5);
+        services[0].name = "orchestration-mgmt._orch-m-ws-http._tcp.srv.arrowhead.ltu.se.";
+        services[1].name = "orchestration-store._orch-s-ws-https._tcp.srv.arces.unibo.it.";
+        services[2].name = "orchestration-mgmt._orch-m-ws-http._tcp.srv.altu.se.";
+        services[3].name = "authorisation-ctrl._auth-ws-https._tcp.srv.arces.unibo.it.";
+        services[4].name = "orch._orch-m-ws-http._tcp.srv.arrowhead.ltu.se.";
+        Arrowhead::ServiceNameTree tree;
+        tree.insert(services.begin(), services.end());
+        REQUIRE(tree.size() == 5);
+
+        WHEN("names are looked up exactly") {
+            THEN("only complete names are found") {
+                REQUIRE(tree.find(services[2].name) == &services[2]);
+                REQUIRE(tree.find("orchestration-") == NULL);
+                REQUIRE(tree.find("orch") == NULL);
+            }
+        }
+        WHEN("names are searched by instance prefix") {
+            THEN("all names starting with the prefix are returned") {
+                REQUIRE(tree.find_prefix("orchestration-").size() == 3);
+                REQUIRE(tree.find_prefix("orch").size() == 4);
+                REQUIRE(tree.find_prefix("orchestration-store.").size() == 1);
+                REQUIRE(tree.find_prefix("x").empty());
+                REQUIRE(tree.find_prefix("").size() == 5);
+            }
+        }
+        WHEN("names are searched by domain suffix") {
+            THEN("the match is label aligned") {
+                std::vector<std::string> res = names(tree.find_suffix("ltu.se."));
+                REQUIRE(res.size() == 2);
+                REQUIRE(res[0] == services[4].name);
+                REQUIRE(res[1] == services[0].name);
+                REQUIRE(tree.find_suffix("arces.unibo.it").size() == 2);
+                REQUIRE(tree.find_suffix("se.").size() == 3);
+                REQUIRE(tree.find_suffix("tu.se.").empty());
+            }
+        }
+        WHEN("names are matched against wildcard patterns") {
+            THEN("a '*' label matches exactly one label") {
+                REQUIRE(tree.match("*._orch-m-ws-http._tcp.srv.*.ltu.se.").size() == 2);
+                REQUIRE(tree.match("*._orch-m-ws-http._tcp.srv.*.se.").size() == 1);
+                REQUIRE(tree.match("orchestration-mgmt.*._tcp.srv.*.*.").size() == 1);
+                REQUIRE(tree.match("*.*._tcp.srv.arces.unibo.it.").size() == 2);
+                REQUIRE(tree.match("*._tcp.srv.arces.unibo.it.").empty());
+                REQUIRE(tree.match(services[3].name).size() == 1);
+            }
+        }
+        WHEN("a name is erased") {
+            REQUIRE(tree.erase(services[0].name));
+            REQUIRE(!tree.erase(services[0].name));
+            THEN("it is gone from both trees and the others remain") {
+                REQUIRE(tree.size() == 4);
+                REQUIRE(tree.find(services[0].name) == NULL);
+                REQUIRE(tree.find(services[2].name) == &services[2]);
+                REQUIRE(tree.find_suffix("ltu.se.").size() == 1);
+                REQUIRE(tree.find_prefix("orchestration-mgmt").size() == 1);
+            }
+        }
+    }
+    GIVEN("a tree of names with and without trailing dots") {
+        std::vector<Arrowhead::ServiceDescription> services(3);
+        services[0].name = "printer._ipp._tcp.local.";
+        services[1].name = "scanner._ipp._tcp.local";
+        services[2].name = "printer._ipp._tcp.local";
+        Arrowhead::ServiceNameTree tree;
+        tree.insert(services[0]);
+        tree.insert(services[1]);
+        WHEN("they are looked up with and without the dot") {
+            THEN("the dot makes no difference") {
+                REQUIRE(tree.size() == 2);
+                REQUIRE(tree.find("printer._ipp._tcp.local") == &services[0]);
+                REQUIRE(tree.find("scanner._ipp._tcp.local.") == &services[1]);
+                REQUIRE(tree.find_suffix("local").size() == 2);
+                REQUIRE(tree.match("*._ipp._tcp.local").size() == 2);
+                REQUIRE(tree.match("scanner.*._tcp.*.").size() == 1);
+            }
+        }
+        WHEN("the same name is inserted without the dot") {
+            tree.insert(services[2]);
+            THEN("it replaces the service in both trees") {
+                REQUIRE(tree.size() == 2);
+                REQUIRE(tree.find(services[0].name) == &services[2]);
+                REQUIRE(tree.find_suffix("_tcp.local.").size() == 2);
+            }
+            AND_WHEN("it is erased with the dot") {
+                REQUIRE(tree.erase("printer._ipp._tcp.local."));
+                THEN("it is gone from both trees") {
+                    REQUIRE(tree.size() == 1);
+                    REQUIRE(tree.find(services[2].name) == NULL);
+                    REQUIRE(names(tree.find_suffix("local.")) ==
+                        std::vector<std::string>(1, services[1].name));
+                }
+            }
+        }
+    }
+    GIVEN("domain names with and without trailing dots") {
+        THEN("the labels are reversed") {
+            REQUIRE(Arrowhead::ServiceNameTree::reverse_labels("a.b.c.") == "c.b.a.");
+            REQUIRE(Arrowhead::ServiceNameTree::reverse_labels("a.b.c") == "c.b.a.");
+            REQUIRE(Arrowhead::ServiceNameTree::reverse_labels("") == "");
+        }
+    }
+}
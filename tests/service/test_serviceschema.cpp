@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Service field table tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/service.hpp"
+#include "arrowhead/serviceschema.hpp"
+#include "arrowhead/exception.hpp"
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/* Records the key and kind of every visited member */
+struct Recorder {
+    std::vector<std::string>& seen;
+
+    template<class CharT, class Traits, class Alloc>
+    void operator()(std::string_view key, std::basic_string<CharT, Traits, Alloc>&)
+    {
+        seen.push_back(std::string(key) + ":string");
+    }
+
+    void operator()(std::string_view key, unsigned int& port)
+    {
+        port = 42;
+        seen.push_back(std::string(key) + ":port");
+    }
+
+    template<class MapType>
+    void operator()(std::string_view key, MapType&)
+    {
+        seen.push_back(std::string(key) + ":map");
+    }
+};
+
+} /* anonymous namespace */
+
+SCENARIO( "Service fields are looked up through the compile time table", "[serviceschema]" ) {
+
+    GIVEN("the field keys") {
+        THEN("every key maps to its own index") {
+            for (size_t i = 0; i < Arrowhead::Schema::FIELD_COUNT; ++i) {
+                std::string_view key = Arrowhead::Schema::keys[i];
+                REQUIRE(Arrowhead::Schema::field_index(key.data(), key.size()) == static_cast<int>(i));
+            }
+        }
+        THEN("unknown keys and keys sharing a hash slot are rejected") {
+            REQUIRE(Arrowhead::Schema::field_index("", 0) == -1);
+            REQUIRE(Arrowhead::Schema::field_index("nope", 4) == -1);
+            REQUIRE(Arrowhead::Schema::field_index("names", 5) == -1);
+            /* same length and first byte as "port" */
+            REQUIRE(Arrowhead::Schema::field_index("post", 4) == -1);
+            REQUIRE(Arrowhead::Schema::field_index("portx", 4) == 4);
+        }
+    }
+    GIVEN("a service description") {
+        Arrowhead::ServiceDescription sd;
+        sd.port = 0;
+        std::vector<std::string> seen;
+        WHEN("all fields are visited") {
+            Arrowhead::Schema::for_each_field(sd, Recorder{seen});
+            THEN("they are visited in key order with their member types") {
+                REQUIRE(seen.size() == 6);
+                REQUIRE(seen[0] == "name:string");
+                REQUIRE(seen[3] == "host:string");
+                REQUIRE(seen[4] == "port:port");
+                REQUIRE(seen[5] == "properties:map");
+            }
+        }
+        WHEN("a single field is visited by key") {
+            int index = Arrowhead::Schema::visit_field(sd, "port", 4, Recorder{seen});
+            THEN("only that member is visited") {
+                REQUIRE(index == 4);
+                REQUIRE(seen.size() == 1);
+                REQUIRE(sd.port == 42);
+            }
+        }
+        WHEN("an unknown key is visited") {
+            int index = Arrowhead::Schema::visit_field(sd, "extra", 5, Recorder{seen});
+            THEN("nothing is visited") {
+                REQUIRE(index == -1);
+                REQUIRE(seen.empty());
+            }
+        }
+    }
+    GIVEN("an arena allocated service description") {
+        Arrowhead::pmr::ServiceDescription sd;
+        std::vector<std::string> seen;
+        WHEN("a field is visited by key") {
+            Arrowhead::Schema::visit_field(sd, "domain", 6, Recorder{seen});
+            THEN("the pmr member is visited") {
+                REQUIRE(seen.size() == 1);
+                REQUIRE(seen[0] == "domain:string");
+            }
+        }
+    }
+#if ARROWHEAD_USE_JSON
+    GIVEN("a JSON service without a port") {
+        std::string js = "{\"name\": \"a\", \"type\": \"t\", \"domain\": \"d\", \"host\": \"h\", "
+            "\"properties\": {\"property\": []}}";
+        WHEN("the service is parsed") {
+            THEN("the missing key is reported") {
+                REQUIRE_THROWS_AS(Arrowhead::ServiceDescription::from_json(js),
+                    const Arrowhead::ContentError&);
+            }
+        }
+    }
+#endif
+}
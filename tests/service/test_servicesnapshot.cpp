@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Binary service list snapshot tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "tempfile.hpp"
+#include "arrowhead/servicesnapshot.hpp"
+#include "arrowhead/exception.hpp"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+Arrowhead::ServiceDescription make_service(const std::string& name,
+    const std::string& type, const std::string& host)
+{
+    Arrowhead::ServiceDescription sd;
+    sd.name = name;
+    sd.type = type;
+    sd.domain = "arces.unibo.it.";
+    sd.host = host;
+    sd.port = 8181;
+    sd.properties["version"] = "1.1";
+    sd.properties["path"] = "/" + name;
+    return sd;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Service lists are stored in memory mapped snapshots", "[servicesnapshot]" ) {
+
+    GIVEN("a snapshot file written from a service list") {
+        std::vector<Arrowhead::ServiceDescription> services;
+        services.push_back(make_service("printer-2", "_printer._tcp", "host-b."));
+        services.push_back(make_service("store-1", "_orch-s._tcp", "host-a."));
+        services.push_back(make_service("printer-1", "_printer._tcp", "host-a."));
+        TempFile tmp;
+        const std::string& path = tmp.path();
+        Arrowhead::ServiceSnapshot::write(path, services.begin(), services.end());
+
+        WHEN("the snapshot is mapped") {
+            Arrowhead::ServiceSnapshot snap(path);
+            THEN("the services are found through the prebuilt indexes") {
+                REQUIRE(snap.size() == 3);
+                auto sd = snap.find("printer-1");
+                REQUIRE(sd);
+                REQUIRE(sd->host() == "host-a.");
+                REQUIRE(sd->port() == 8181);
+                REQUIRE(sd->property("path") == std::optional<std::string_view>("/printer-1"));
+                REQUIRE(!sd->property("missing"));
+                REQUIRE(!snap.find("printer-3"));
+                Arrowhead::ServiceSnapshot::result_type printers = snap.find_by_type("_printer._tcp");
+                REQUIRE(printers.size() == 2);
+                REQUIRE(printers[0].name() == "printer-1");
+                REQUIRE(printers[1].name() == "printer-2");
+                REQUIRE(snap.find_by_host("host-a.").size() == 2);
+            }
+            THEN("the services can be copied out unchanged") {
+                std::vector<Arrowhead::ServiceDescription> copied;
+                snap.copy(std::back_inserter(copied));
+                REQUIRE(copied.size() == 3);
+                REQUIRE(copied[1].name == services[1].name);
+                REQUIRE(copied[1].properties == services[1].properties);
+            }
+        }
+        WHEN("the file is corrupted") {
+            {
+                std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+                f.seekp(-1, std::ios::end);
+                f.put('!');
+            }
+            THEN("the checksum does not match") {
+                REQUIRE_THROWS_AS(Arrowhead::ServiceSnapshot snap(path), const Arrowhead::ContentError&);
+                Arrowhead::ServiceSnapshot snap;
+                REQUIRE(snap.open(path).code() == Arrowhead::Errc::CONTENT);
+                REQUIRE(snap.empty());
+            }
+            THEN("a cache starts out with an empty snapshot") {
+                Arrowhead::SnapshotCache cache(path);
+                REQUIRE(cache.current()->empty());
+                REQUIRE(cache.try_reload().error().code() == Arrowhead::Errc::CONTENT);
+                REQUIRE(cache.current()->empty());
+            }
+        }
+        WHEN("the snapshot is loaded through a cache and the file is updated") {
+            Arrowhead::SnapshotCache cache(path);
+            std::shared_ptr<const Arrowhead::ServiceSnapshot> old = cache.current();
+            REQUIRE(old->size() == 3);
+            REQUIRE(!cache.reload());
+            services.push_back(make_service("auth-1", "_auth._tcp", "host-c."));
+            cache.update(services.begin(), services.end());
+            THEN("new readers see the new snapshot and old readers keep the old one") {
+                REQUIRE(cache.current()->size() == 4);
+                REQUIRE(cache.current()->find("auth-1"));
+                REQUIRE(old->size() == 3);
+                REQUIRE(old->find("printer-2")->host() == "host-b.");
+            }
+        }
+    }
+    GIVEN("a file that is not a snapshot") {
+        TempFile tmp(std::string(200, 'x'));
+        THEN("mapping it fails") {
+            REQUIRE_THROWS_AS(Arrowhead::ServiceSnapshot snap(tmp.path()), const Arrowhead::ContentError&);
+        }
+    }
+    GIVEN("a file that does not exist") {
+        std::string path;
+        {
+            TempFile tmp;
+            path = tmp.path();
+        }
+        THEN("mapping it fails") {
+            REQUIRE_THROWS_AS(Arrowhead::ServiceSnapshot snap(path), const Arrowhead::Error&);
+            Arrowhead::ServiceSnapshot snap;
+            REQUIRE(snap.open(path).code() == Arrowhead::Errc::IO);
+        }
+    }
+}
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Tracing spans tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "tempfile.hpp"
+#include "arrowhead/exception.hpp"
+#include "arrowhead/tracing.hpp"
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if ARROWHEAD_USE_JSON
+#include "arrowhead/detail/_nlohmann_json.hpp"
+
+#if ARROWHEAD_USE_LIBCURL
+#include "stub_server.hpp"
+#include "arrowhead/core_services/registryclient.hpp"
+#include "arrowhead/transport.hpp"
+#endif
+
+namespace {
+
+/* The events of the trace file at @p path */
+nlohmann::json read_trace(const std::string& path)
+{
+    std::ifstream f(path.c_str());
+    std::string text((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    return nlohmann::json::parse(text);
+}
+
+/* The first event named @p name, null if there is none */
+nlohmann::json find_event(const nlohmann::json& events, const std::string& name)
+{
+    for (const auto& event: events) {
+        if (event["name"] == name) {
+            return event;
+        }
+    }
+    return nlohmann::json();
+}
+
+std::string id_of(const Arrowhead::Tracing::SpanContext& ctx)
+{
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(ctx.span_id));
+    return buf;
+}
+
+} /* anonymous namespace */
+#endif /* ARROWHEAD_USE_JSON */
+
+SCENARIO( "Spans cost nothing but a check while tracing is off", "[tracing]" ) {
+
+    GIVEN("no trace file") {
+        REQUIRE(!Arrowhead::Tracing::enabled());
+        WHEN("a span is opened") {
+            Arrowhead::Tracing::Span span("test.off");
+            span.arg("n", 1);
+            THEN("it has no identity and is not current") {
+                REQUIRE(!span.context().valid());
+                REQUIRE(!Arrowhead::Tracing::current().valid());
+            }
+        }
+    }
+}
+
+SCENARIO( "Spans form trees across threads", "[tracing]" ) {
+
+    GIVEN("a trace file") {
+        TempFile file;
+        WHEN("another trace file is opened") {
+            Arrowhead::Tracing::TraceFile trace(file.path());
+            TempFile other;
+            THEN("it is refused") {
+                REQUIRE_THROWS_AS(Arrowhead::Tracing::TraceFile(other.path()),
+                    const Arrowhead::Error&);
+            }
+        }
+        WHEN("spans are nested and continued in another thread") {
+            Arrowhead::Tracing::SpanContext outer_ctx = {0, 0};
+            Arrowhead::Tracing::SpanContext inner_ctx = {0, 0};
+            Arrowhead::Tracing::SpanContext worker_ctx = {0, 0};
+            size_t events_written = 0;
+            {
+                Arrowhead::Tracing::TraceFile trace(file.path());
+                {
+                    Arrowhead::Tracing::Span outer("test.outer");
+                    outer_ctx = outer.context();
+                    {
+                        Arrowhead::Tracing::Span inner("test.inner");
+                        inner.arg("items", 42);
+                        inner_ctx = inner.context();
+                        REQUIRE(Arrowhead::Tracing::current().span_id == inner_ctx.span_id);
+                    }
+                    REQUIRE(Arrowhead::Tracing::current().span_id == outer_ctx.span_id);
+                    Arrowhead::Tracing::SpanContext parent = Arrowhead::Tracing::current();
+                    std::thread worker([parent, &worker_ctx]() {
+                        Arrowhead::Tracing::Span span("test.worker", parent);
+                        worker_ctx = span.context();
+                    });
+                    worker.join();
+                }
+                events_written = trace.events();
+            }
+            THEN("the spans know their parents and share the trace") {
+                REQUIRE(!Arrowhead::Tracing::current().valid());
+                REQUIRE(!Arrowhead::Tracing::enabled());
+                REQUIRE(events_written == 3);
+                REQUIRE(outer_ctx.trace_id == outer_ctx.span_id);
+                REQUIRE(inner_ctx.trace_id == outer_ctx.trace_id);
+                REQUIRE(worker_ctx.trace_id == outer_ctx.trace_id);
+                REQUIRE(inner_ctx.span_id != outer_ctx.span_id);
+                REQUIRE(worker_ctx.span_id != outer_ctx.span_id);
+            }
+#if ARROWHEAD_USE_JSON
+            THEN("the file has a complete event per span") {
+                nlohmann::json events = read_trace(file.path());
+                REQUIRE(events.size() == 3);
+                nlohmann::json outer = find_event(events, "test.outer");
+                nlohmann::json inner = find_event(events, "test.inner");
+                nlohmann::json worker = find_event(events, "test.worker");
+                REQUIRE(outer["ph"] == "X");
+                REQUIRE(outer["args"]["span_id"] == id_of(outer_ctx));
+                REQUIRE(outer["args"].count("parent_id") == 0);
+                REQUIRE(inner["args"]["parent_id"] == id_of(outer_ctx));
+                REQUIRE(inner["args"]["items"] == 42);
+                REQUIRE(worker["args"]["parent_id"] == id_of(outer_ctx));
+                REQUIRE(worker["tid"] != outer["tid"]);
+                /* The inner span lies within the outer one */
+                REQUIRE(inner["ts"].get<double>() >= outer["ts"].get<double>());
+                REQUIRE(inner["ts"].get<double>() + inner["dur"].get<double>() <=
+                    outer["ts"].get<double>() + outer["dur"].get<double>() + 0.001);
+            }
+#endif
+        }
+    }
+}
+
+#if ARROWHEAD_USE_TRACING && ARROWHEAD_USE_JSON && ARROWHEAD_USE_LIBCURL
+SCENARIO( "A registry call is traced through its stages", "[tracing]" ) {
+
+    GIVEN("a registry client and a trace file") {
+        StubServer server([](const Arrowhead::HTTPRequest&) {
+                Arrowhead::HTTPResponse resp;
+                resp.status = 200;
+                resp.content_type = "application/json";
+                resp.body = "{\"service\":[]}";
+                return resp;
+            });
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Arrowhead::JSONCodec>
+            client(server.url());
+        TempFile file;
+        WHEN("services are listed") {
+            {
+                Arrowhead::Tracing::TraceFile trace(file.path());
+                client.list_services();
+            }
+            nlohmann::json events = read_trace(file.path());
+            nlohmann::json call = find_event(events, "registry.list_services");
+            nlohmann::json attempt = find_event(events, "registry.attempt");
+            nlohmann::json request = find_event(events, "http.request");
+            THEN("the call, the attempt and the transfer are nested") {
+                REQUIRE(!call.is_null());
+                REQUIRE(attempt["args"]["parent_id"] == call["args"]["span_id"]);
+                REQUIRE(attempt["args"]["attempt"] == 1);
+                REQUIRE(attempt["args"]["status"] == 200);
+                REQUIRE(request["args"]["parent_id"] == attempt["args"]["span_id"]);
+                REQUIRE(request["args"]["trace_id"] == call["args"]["trace_id"]);
+            }
+            THEN("the phases of the transfer are children of the request") {
+                for (const char *phase: {"http.connect", "http.first_byte", "http.last_byte"}) {
+                    nlohmann::json event = find_event(events, phase);
+                    REQUIRE(!event.is_null());
+                    REQUIRE(event["args"]["parent_id"] == request["args"]["span_id"]);
+                }
+            }
+            THEN("the parsing is a child of the call") {
+                nlohmann::json parse = find_event(events, "parse.json");
+                REQUIRE(parse["args"]["parent_id"] == call["args"]["span_id"]);
+                REQUIRE(parse["args"]["bytes"] == 14);
+            }
+        }
+    }
+}
+#endif /* ARROWHEAD_USE_TRACING && ARROWHEAD_USE_JSON && ARROWHEAD_USE_LIBCURL */
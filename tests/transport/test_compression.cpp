@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Content coding tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_ZLIB
+
+#include "catch.hpp"
+#include "stub_server.hpp"
+#include "arrowhead/compression.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/transport.hpp"
+#include <string>
+#include <vector>
+
+namespace {
+
+/* A service list is very redundant, like this */
+std::string redundant_body()
+{
+    std::string body;
+    for (int i = 0; i < 2000; ++i) {
+        body += "{\"name\":\"service" + std::to_string(i) +
+            "\",\"type\":\"_temperature._json._http._tcp\",\"port\":8080}\n";
+    }
+    return body;
+}
+
+/* Echoes the request body, or answers with the redundant body */
+Arrowhead::HTTPResponse echo(const Arrowhead::HTTPRequest& req)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.content_type = "application/json";
+    resp.body = req.method == "POST" ? req.body : redundant_body();
+    return resp;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Transports negotiate compressed responses", "[transport][compression]" ) {
+
+    StubServer server(echo);
+    server.compress_responses();
+    Arrowhead::HTTPRequest req;
+    req.method = "GET";
+    req.url = server.url("/service");
+
+    GIVEN("a transport with the default settings") {
+        Arrowhead::CURLEasyTransport transport;
+        Arrowhead::CompressionStats before = Arrowhead::compression_stats();
+        WHEN("a large response is received") {
+            Arrowhead::HTTPResponse resp = transport.perform(req);
+            Arrowhead::CompressionStats after = Arrowhead::compression_stats();
+            THEN("it is transferred compressed and decoded") {
+                REQUIRE(server.compressed_response_count() == 1);
+                REQUIRE(resp.body == redundant_body());
+                REQUIRE(resp.content_type == "application/json");
+            }
+            THEN("the compression is counted") {
+                REQUIRE(after.responses - before.responses == 1);
+                REQUIRE(after.compressed_responses - before.compressed_responses == 1);
+                REQUIRE(after.response_bytes - before.response_bytes == resp.body.size());
+                uint64_t wire = after.response_wire_bytes - before.response_wire_bytes;
+                REQUIRE(wire > 0);
+                REQUIRE(wire * 5 < resp.body.size());
+                REQUIRE(after.total_time > before.total_time);
+                REQUIRE(after.response_ratio() > 1.0);
+            }
+        }
+    }
+    GIVEN("a transport which does not accept compressed responses") {
+        Arrowhead::CompressionOptions compression;
+        compression.accept_compressed = false;
+        Arrowhead::CURLEasyTransport transport(Arrowhead::TLSOptions(),
+            Arrowhead::HTTPVersion::HTTP2_TLS, compression);
+        Arrowhead::CompressionStats before = Arrowhead::compression_stats();
+        WHEN("a large response is received") {
+            Arrowhead::HTTPResponse resp = transport.perform(req);
+            Arrowhead::CompressionStats after = Arrowhead::compression_stats();
+            THEN("it is transferred as it is") {
+                REQUIRE(server.compressed_response_count() == 0);
+                REQUIRE(resp.body == redundant_body());
+                REQUIRE(after.compressed_responses == before.compressed_responses);
+                REQUIRE(after.response_wire_bytes - before.response_wire_bytes == resp.body.size());
+            }
+        }
+    }
+    GIVEN("a multiplexing transport") {
+        Arrowhead::CURLMultiplexTransport transport;
+        THEN("it accepts compressed responses too") {
+            REQUIRE(transport.perform(req).body == redundant_body());
+            REQUIRE(server.compressed_response_count() == 1);
+        }
+    }
+    GIVEN("a hedged transport") {
+        Arrowhead::CURLHedgedTransport transport(
+            std::vector<std::string>(1, server.url("/servicediscovery")));
+        req.path = "/service";
+        THEN("it accepts compressed responses too") {
+            REQUIRE(transport.perform(req).body == redundant_body());
+            REQUIRE(server.compressed_response_count() == 1);
+        }
+    }
+    THEN("the libcurl in use decodes gzip") {
+        REQUIRE(Arrowhead::supported_encodings().find("gzip") != std::string::npos);
+    }
+}
+
+SCENARIO( "Transports compress request bodies", "[transport][compression]" ) {
+
+    StubServer server(echo);
+    Arrowhead::HTTPRequest req;
+    req.method = "POST";
+    req.url = server.url("/publish");
+    req.content_type = "application/json";
+    Arrowhead::CompressionOptions compression;
+    compression.compress_requests = true;
+
+    GIVEN("a transport compressing request bodies") {
+        Arrowhead::CURLEasyTransport transport(Arrowhead::TLSOptions(),
+            Arrowhead::HTTPVersion::HTTP2_TLS, compression);
+        Arrowhead::CompressionStats before = Arrowhead::compression_stats();
+        WHEN("a large body is published") {
+            req.body = redundant_body();
+            Arrowhead::HTTPResponse resp = transport.perform(req);
+            Arrowhead::CompressionStats after = Arrowhead::compression_stats();
+            THEN("it is sent compressed") {
+                REQUIRE(server.compressed_request_count() == 1);
+                REQUIRE(resp.body == req.body);
+            }
+            THEN("the compression is counted") {
+                REQUIRE(after.compressed_requests - before.compressed_requests == 1);
+                REQUIRE(after.request_bytes - before.request_bytes == req.body.size());
+                REQUIRE((after.request_wire_bytes - before.request_wire_bytes) * 5 <
+                    req.body.size());
+                REQUIRE(after.request_ratio() > 1.0);
+            }
+        }
+        WHEN("a body below the size limit is published") {
+            req.body = "{\"name\":\"small\"}";
+            Arrowhead::HTTPResponse resp = transport.perform(req);
+            THEN("it is sent as it is") {
+                REQUIRE(server.compressed_request_count() == 0);
+                REQUIRE(resp.body == req.body);
+            }
+        }
+    }
+    GIVEN("a transport with the default settings") {
+        Arrowhead::CURLEasyTransport transport;
+        req.body = redundant_body();
+        THEN("request bodies are sent as they are") {
+            REQUIRE(transport.perform(req).body == req.body);
+            REQUIRE(server.compressed_request_count() == 0);
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_ZLIB */
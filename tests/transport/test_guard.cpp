@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Circuit breaker and concurrency limit tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "catch.hpp"
+#include "arrowhead/guard.hpp"
+#include "arrowhead/retry.hpp"
+#include "arrowhead/transport.hpp"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+
+namespace {
+
+Arrowhead::HTTPRequest get(const std::string& path)
+{
+    Arrowhead::HTTPRequest req;
+    req.method = "GET";
+    req.url = "loopback:" + path;
+    req.path = path;
+    return req;
+}
+
+Arrowhead::GuardedTransport<Arrowhead::LoopbackTransport>::Options test_options()
+{
+    Arrowhead::GuardedTransport<Arrowhead::LoopbackTransport>::Options options;
+    options.breaker.window = 10;
+    options.breaker.min_calls = 4;
+    options.breaker.failure_rate = 0.5;
+    options.breaker.open_duration = std::chrono::milliseconds(50);
+    return options;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "The circuit breaker stops calls to a failing server", "[transport]" ) {
+
+    GIVEN("a server which fails while it is overloaded") {
+        std::atomic<bool> overloaded(false);
+        std::atomic<int> calls(0);
+        Arrowhead::LoopbackTransport server([&](const Arrowhead::HTTPRequest& req) {
+            ++calls;
+            Arrowhead::HTTPResponse resp;
+            resp.status = overloaded ? 503 : 200;
+            resp.body = req.path;
+            return resp;
+        });
+        Arrowhead::GuardedTransport<Arrowhead::LoopbackTransport> transport(server, test_options());
+        Arrowhead::HTTPResponse resp;
+        REQUIRE(transport.perform(get("/service"), resp).ok());
+        REQUIRE(transport.breaker().state() == Arrowhead::CircuitBreaker::CLOSED);
+
+        WHEN("most calls fail") {
+            overloaded = true;
+            for (int i = 0; i < 3; ++i) {
+                REQUIRE(transport.perform(get("/type/x"), resp).ok());
+                REQUIRE(resp.status == 503);
+            }
+            THEN("the breaker opens") {
+                REQUIRE(transport.breaker().state() == Arrowhead::CircuitBreaker::OPEN);
+            }
+            THEN("further calls fail fast without reaching the server") {
+                int before = calls;
+                Arrowhead::Status status = transport.perform(get("/type/x"), resp);
+                REQUIRE(status.code() == Arrowhead::Errc::CIRCUIT_OPEN);
+                REQUIRE(calls == before);
+                REQUIRE_THROWS_AS(transport.perform(get("/type/x")), const Arrowhead::TransportError&);
+            }
+            THEN("rejected calls are not retried") {
+                Arrowhead::RetryPolicy policy(5);
+                REQUIRE_FALSE(policy.should_retry(1,
+                    Arrowhead::Status(Arrowhead::Errc::CIRCUIT_OPEN), true));
+            }
+            THEN("a GET which succeeded before is served from the cache") {
+                resp = Arrowhead::HTTPResponse();
+                REQUIRE(transport.perform(get("/service"), resp).ok());
+                REQUIRE(resp.status == 200);
+                REQUIRE(resp.body == "/service");
+            }
+            AND_WHEN("the open period is over and the server recovered") {
+                std::this_thread::sleep_for(std::chrono::milliseconds(60));
+                overloaded = false;
+                THEN("a probe closes the breaker") {
+                    REQUIRE(transport.perform(get("/type/x"), resp).ok());
+                    REQUIRE(transport.breaker().state() == Arrowhead::CircuitBreaker::CLOSED);
+                }
+            }
+            AND_WHEN("the open period is over but the server still fails") {
+                std::this_thread::sleep_for(std::chrono::milliseconds(60));
+                THEN("the probe opens the breaker again") {
+                    REQUIRE(transport.perform(get("/type/x"), resp).ok());
+                    REQUIRE(resp.status == 503);
+                    REQUIRE(transport.breaker().state() == Arrowhead::CircuitBreaker::OPEN);
+                }
+            }
+        }
+    }
+    GIVEN("a slow server") {
+        Arrowhead::LoopbackTransport server([](const Arrowhead::HTTPRequest&) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            Arrowhead::HTTPResponse resp;
+            resp.status = 200;
+            return resp;
+        });
+        auto options = test_options();
+        options.slow_call = std::chrono::milliseconds(1);
+        Arrowhead::GuardedTransport<Arrowhead::LoopbackTransport> transport(server, options);
+        WHEN("calls exceed the latency limit") {
+            Arrowhead::HTTPResponse resp;
+            for (int i = 0; i < 4; ++i) {
+                transport.perform(get("/service"), resp);
+            }
+            THEN("they count as failures") {
+                REQUIRE(transport.breaker().state() == Arrowhead::CircuitBreaker::OPEN);
+                REQUIRE(transport.limit().limit() < 10);
+            }
+        }
+    }
+}
+
+SCENARIO( "The AIMD limit adapts to the load a server takes", "[transport]" ) {
+
+    GIVEN("a limit of 4") {
+        Arrowhead::AIMDLimit::Options options;
+        options.initial_limit = 4;
+        options.min_limit = 1;
+        options.max_limit = 8;
+        Arrowhead::AIMDLimit limit(options);
+        WHEN("4 calls are in flight") {
+            for (int i = 0; i < 4; ++i) {
+                REQUIRE(limit.try_acquire());
+            }
+            THEN("the fifth is rejected") {
+                REQUIRE_FALSE(limit.try_acquire());
+                REQUIRE(limit.in_flight() == 4);
+            }
+            AND_WHEN("one of them shows overload") {
+                limit.release(true);
+                THEN("the limit is halved") {
+                    REQUIRE(limit.limit() == Approx(2.0));
+                    REQUIRE_FALSE(limit.try_acquire());
+                }
+            }
+            AND_WHEN("they complete normally") {
+                for (int i = 0; i < 4; ++i) {
+                    limit.release(false);
+                }
+                THEN("the limit grows by about one") {
+                    REQUIRE(limit.limit() > 4.8);
+                    REQUIRE(limit.limit() < 5.0);
+                }
+            }
+        }
+        WHEN("many calls show overload") {
+            for (int i = 0; i < 10; ++i) {
+                REQUIRE(limit.try_acquire());
+                limit.release(true);
+            }
+            THEN("the limit stops at the minimum") {
+                REQUIRE(limit.limit() == Approx(1.0));
+            }
+        }
+    }
+    GIVEN("a guarded transport with a limit of 2 and a blocked server") {
+        std::promise<void> unblock;
+        std::shared_future<void> blocked = unblock.get_future().share();
+        Arrowhead::LoopbackTransport server([blocked](const Arrowhead::HTTPRequest&) {
+            blocked.wait();
+            Arrowhead::HTTPResponse resp;
+            resp.status = 200;
+            return resp;
+        });
+        auto options = test_options();
+        options.limit.initial_limit = 2;
+        options.serve_stale = false;
+        Arrowhead::GuardedTransport<Arrowhead::LoopbackTransport> transport(server, options);
+        auto call = [&transport]() {
+            Arrowhead::HTTPResponse resp;
+            return transport.perform(get("/service"), resp);
+        };
+        WHEN("two calls are in flight") {
+            std::future<Arrowhead::Status> first = std::async(std::launch::async, call);
+            std::future<Arrowhead::Status> second = std::async(std::launch::async, call);
+            while (transport.limit().in_flight() < 2) {
+                std::this_thread::yield();
+            }
+            Arrowhead::Status third = call();
+            unblock.set_value();
+            THEN("a third one is rejected") {
+                REQUIRE(third.code() == Arrowhead::Errc::OVERLOADED);
+                REQUIRE(first.get().ok());
+                REQUIRE(second.get().ok());
+                REQUIRE(transport.limit().in_flight() == 0);
+            }
+        }
+    }
+}
+
+SCENARIO( "The stale response cache drops the oldest response", "[transport]" ) {
+
+    GIVEN("a guard caching two responses") {
+        Arrowhead::TransportGuard::Options options;
+        options.cache_size = 2;
+        Arrowhead::TransportGuard guard(options);
+        auto store = [&guard](const std::string& path) {
+            Arrowhead::HTTPResponse resp;
+            resp.status = 200;
+            resp.body = path;
+            guard.complete(get(path), Arrowhead::Status(), resp,
+                Arrowhead::TransportGuard::clock::duration(0));
+        };
+        auto has = [&guard](const std::string& path) {
+            Arrowhead::HTTPResponse resp;
+            return guard.cached(get(path), resp) && resp.body == path;
+        };
+        /* Stored out of key order, so the oldest does not sort first */
+        store("/type/b");
+        store("/type/a");
+        WHEN("a third response is stored") {
+            store("/type/c");
+            THEN("the first one stored is dropped") {
+                REQUIRE(!has("/type/b"));
+                REQUIRE(has("/type/a"));
+                REQUIRE(has("/type/c"));
+            }
+        }
+        WHEN("the oldest response is refreshed before a third one is stored") {
+            store("/type/b");
+            store("/type/c");
+            THEN("the least recently stored one is dropped") {
+                REQUIRE(has("/type/b"));
+                REQUIRE(!has("/type/a"));
+                REQUIRE(has("/type/c"));
+            }
+        }
+    }
+}
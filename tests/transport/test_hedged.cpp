@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Hedging multi-endpoint transport tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include "catch.hpp"
+#include "stub_registry.hpp"
+#include "stub_server.hpp"
+#include "arrowhead/core_services/registryclient.hpp"
+#include "arrowhead/transport.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+
+namespace {
+
+Arrowhead::HTTPResponse respond(long status, const std::string& body)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = status;
+    resp.body = body;
+    return resp;
+}
+
+/* Server answering with @p body after @p delay */
+std::unique_ptr<StubServer> replica(const std::string& body,
+    std::chrono::milliseconds delay = std::chrono::milliseconds(0), long status = 200)
+{
+    return std::unique_ptr<StubServer>(new StubServer(
+        [body, delay, status](const Arrowhead::HTTPRequest&) {
+            std::this_thread::sleep_for(delay);
+            return respond(status, body);
+        }));
+}
+
+/* URL of a port nobody listens on */
+std::string dead_endpoint()
+{
+    StubServer server([](const Arrowhead::HTTPRequest&) { return respond(200, ""); });
+    return server.url();
+}
+
+Arrowhead::HTTPRequest get(const std::string& path)
+{
+    Arrowhead::HTTPRequest req;
+    req.method = "GET";
+    req.path = path;
+    return req;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Hedged requests use the fastest replica", "[transport]" ) {
+
+    GIVEN("a slow replica listed before a fast one") {
+        auto slow = replica("slow", std::chrono::milliseconds(400));
+        auto fast = replica("fast");
+        Arrowhead::CURLHedgedTransport::Options options;
+        options.initial_hedge_delay = std::chrono::milliseconds(20);
+        Arrowhead::CURLHedgedTransport transport({slow->url(), fast->url()}, options);
+        WHEN("a GET is performed") {
+            auto start = std::chrono::steady_clock::now();
+            Arrowhead::HTTPResponse resp;
+            Arrowhead::Status status = transport.perform(get("/service"), resp);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            THEN("the hedge to the fast replica wins and the slow transfer is cancelled") {
+                REQUIRE(status.ok());
+                REQUIRE(resp.body == "fast");
+                REQUIRE(elapsed < std::chrono::milliseconds(300));
+                auto stats = transport.endpoint_stats();
+                REQUIRE(stats[0].cancelled == 1);
+                REQUIRE(stats[1].requests == 1);
+                REQUIRE(stats[1].failures == 0);
+            }
+            THEN("the time of the cancelled transfer is not taken as its latency") {
+                auto stats = transport.endpoint_stats();
+                REQUIRE(stats[0].median_latency.count() == 0);
+                REQUIRE(stats[1].median_latency.count() > 0);
+            }
+            AND_WHEN("another GET is performed") {
+                transport.perform(get("/service"), resp);
+                THEN("the fast replica is asked first") {
+                    REQUIRE(resp.body == "fast");
+                    REQUIRE(transport.endpoint_stats()[1].requests == 2);
+                }
+                THEN("the handles of the first request are reused") {
+                    REQUIRE(transport.handles() == 2);
+                }
+            }
+        }
+    }
+    GIVEN("hedging disabled") {
+        auto slow = replica("slow", std::chrono::milliseconds(100));
+        auto fast = replica("fast");
+        Arrowhead::CURLHedgedTransport::Options options;
+        options.initial_hedge_delay = std::chrono::milliseconds(1);
+        options.max_hedges = 0;
+        Arrowhead::CURLHedgedTransport transport({slow->url(), fast->url()}, options);
+        WHEN("a GET is performed") {
+            Arrowhead::HTTPResponse resp;
+            REQUIRE(transport.perform(get("/service"), resp).ok());
+            THEN("only the first replica is asked") {
+                REQUIRE(resp.body == "slow");
+                REQUIRE(transport.endpoint_stats()[1].requests == 0);
+            }
+        }
+    }
+}
+
+SCENARIO( "Hedged transports reuse their easy handles", "[transport]" ) {
+
+    GIVEN("a replica keeping connections open") {
+        StubServer server([](const Arrowhead::HTTPRequest&) { return respond(200, "ok"); }, true);
+        Arrowhead::CURLHedgedTransport transport({server.url()});
+        WHEN("several GETs and POSTs are performed one after another") {
+            unsigned int ok = 0;
+            for (int i = 0; i < 4; ++i) {
+                Arrowhead::HTTPRequest req = get("/service");
+                if (i % 2 == 1) {
+                    req.method = "POST";
+                    req.body = "{}";
+                }
+                Arrowhead::HTTPResponse resp;
+                if (transport.perform(req, resp).ok() && resp.body == "ok") {
+                    ++ok;
+                }
+            }
+            THEN("they share one easy handle and one connection") {
+                REQUIRE(ok == 4);
+                REQUIRE(transport.handles() == 1);
+                REQUIRE(server.connection_count() == 1);
+            }
+        }
+    }
+}
+
+SCENARIO( "Failed replicas are replaced at once", "[transport]" ) {
+
+    GIVEN("a dead replica, a failing replica and a healthy one") {
+        auto failing = replica("overloaded", std::chrono::milliseconds(0), 503);
+        auto healthy = replica("ok");
+        Arrowhead::CURLHedgedTransport::Options options;
+        options.initial_hedge_delay = std::chrono::seconds(10);
+        Arrowhead::CURLHedgedTransport transport(
+            {dead_endpoint(), failing->url(), healthy->url()}, options);
+        WHEN("a GET is performed") {
+            Arrowhead::HTTPResponse resp;
+            Arrowhead::Status status = transport.perform(get("/service"), resp);
+            THEN("the request fails over without waiting for the hedge delay") {
+                REQUIRE(status.ok());
+                REQUIRE(resp.body == "ok");
+                auto stats = transport.endpoint_stats();
+                REQUIRE(stats[0].failures == 1);
+                REQUIRE(stats[1].failures == 1);
+                REQUIRE(stats[0].consecutive_failures == 1);
+            }
+        }
+        WHEN("a POST is performed") {
+            Arrowhead::HTTPRequest req = get("/publish");
+            req.method = "POST";
+            req.body = "x";
+            Arrowhead::HTTPResponse resp;
+            Arrowhead::Status status = transport.perform(req, resp);
+            THEN("it fails over from the dead replica but not from the failing one") {
+                REQUIRE(status.ok());
+                REQUIRE(resp.status == 503);
+                REQUIRE(transport.endpoint_stats()[2].requests == 0);
+            }
+        }
+    }
+    GIVEN("only dead replicas") {
+        Arrowhead::CURLHedgedTransport transport({dead_endpoint(), dead_endpoint()});
+        WHEN("a GET is performed") {
+            Arrowhead::HTTPResponse resp;
+            Arrowhead::Status status = transport.perform(get("/service"), resp);
+            THEN("the transport error is returned") {
+                REQUIRE(status.code() == Arrowhead::Errc::TRANSPORT);
+                REQUIRE(status.detail() == CURLE_COULDNT_CONNECT);
+            }
+        }
+    }
+    GIVEN("a replica slower than the deadline") {
+        auto slow = replica("slow", std::chrono::milliseconds(300));
+        Arrowhead::CURLHedgedTransport transport({slow->url()});
+        WHEN("a GET is performed") {
+            Arrowhead::HTTPRequest req = get("/service");
+            req.deadline = Arrowhead::Deadline::after(std::chrono::milliseconds(50));
+            Arrowhead::HTTPResponse resp;
+            THEN("it times out") {
+                REQUIRE(transport.perform(req, resp).code() == Arrowhead::Errc::TIMEOUT);
+            }
+        }
+    }
+}
+
+SCENARIO( "Registry clients can use replicated registries", "[transport]" ) {
+
+    GIVEN("a client for a dead replica and a working one") {
+        StubRegistry registry;
+        StubServer server(
+            [&registry](const Arrowhead::HTTPRequest& req) { return registry.handle(req); });
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLHedgedTransport, Arrowhead::CodecRegistry>
+            client("", Arrowhead::CodecRegistry::builtin(), Arrowhead::CURLHedgedTransport(
+                {dead_endpoint() + "/servicediscovery", server.url("/servicediscovery")}));
+        WHEN("a service is published and listed") {
+            Arrowhead::ServiceDescription sd;
+            sd.name = "replicated._test._tcp.example.org.";
+            sd.type = "_test._tcp";
+            sd.domain = "example.org.";
+            sd.host = "example.org.";
+            sd.port = 1234;
+            client.publish(sd);
+            THEN("the working replica has it") {
+                auto services = client.list_services();
+                REQUIRE(services.size() == 1);
+                REQUIRE(services[0].name == sd.name);
+            }
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_LIBCURL */
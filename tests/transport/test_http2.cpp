@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       HTTP/2 multiplexing transport tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include "catch.hpp"
+#include "stub_server.hpp"
+#include "stub_tls.hpp"
+#include "arrowhead/transport.hpp"
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Arrowhead::HTTPResponse echo(const Arrowhead::HTTPRequest& req)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.content_type = "text/plain";
+    resp.body = req.method + " " + req.path + " " + req.body;
+    return resp;
+}
+
+Arrowhead::HTTPResponse slow_echo(const Arrowhead::HTTPRequest& req)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    return echo(req);
+}
+
+/* Make @p per_thread requests from each of @p threads threads, count the failures */
+unsigned int concurrent_requests(const Arrowhead::CURLMultiplexTransport& transport,
+    const std::string& url, unsigned int threads, unsigned int per_thread)
+{
+    std::atomic<unsigned int> failures(0);
+    std::vector<std::thread> workers;
+    for (unsigned int t = 0; t < threads; ++t) {
+        workers.push_back(std::thread([&, t]() {
+            for (unsigned int i = 0; i < per_thread; ++i) {
+                Arrowhead::HTTPRequest req;
+                req.method = "POST";
+                req.url = url;
+                req.path = "/service";
+                req.content_type = "text/plain";
+                req.body = std::to_string(t) + "-" + std::to_string(i);
+                Arrowhead::HTTPResponse resp;
+                if (!transport.perform(req, resp).ok() ||
+                    resp.body != "POST /service " + req.body) {
+                    ++failures;
+                }
+            }
+        }));
+    }
+    for (std::thread& worker: workers) {
+        worker.join();
+    }
+    return failures;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Concurrent requests share one HTTP/2 connection", "[transport][http2]" ) {
+
+    GIVEN("a server speaking h2c") {
+        StubServer server(echo, true, true);
+        Arrowhead::CURLMultiplexTransport transport;
+        WHEN("many threads make requests at the same time") {
+            unsigned int failures = concurrent_requests(transport, server.url("/service"), 16, 8);
+            THEN("they are multiplexed over a single connection") {
+                REQUIRE(failures == 0);
+                REQUIRE(server.connection_count() == 1);
+                REQUIRE(server.http2_connection_count() == 1);
+                REQUIRE(transport.stats().requests == 128);
+                REQUIRE(transport.stats().http2_requests == 128);
+                REQUIRE(transport.stats().connections == 1);
+            }
+        }
+    }
+    GIVEN("a server which upgrades to h2c") {
+        StubServer server(echo, true, true);
+        Arrowhead::CURLMultiplexTransport transport;
+        Arrowhead::HTTPRequest req;
+        req.method = "GET";
+        req.url = server.url("/service");
+        WHEN("requests are made one after another") {
+            for (int i = 0; i < 3; ++i) {
+                REQUIRE(transport.perform(req).body == "GET /service ");
+            }
+            THEN("the first one upgrades the connection and the others reuse it") {
+                REQUIRE(server.connection_count() == 1);
+                REQUIRE(server.http2_connection_count() == 1);
+                REQUIRE(transport.stats().http2_requests == 3);
+            }
+        }
+    }
+    GIVEN("a transport with prior knowledge of h2c") {
+        StubServer server(echo, true, true);
+        Arrowhead::CURLMultiplexTransport::Options options;
+        options.http_version = Arrowhead::HTTPVersion::HTTP2_PRIOR_KNOWLEDGE;
+        Arrowhead::CURLMultiplexTransport transport(options);
+        Arrowhead::HTTPRequest req;
+        req.method = "GET";
+        req.url = server.url("/service");
+        WHEN("a request is made") {
+            Arrowhead::HTTPResponse resp = transport.perform(req);
+            THEN("it goes out over HTTP/2 at once") {
+                REQUIRE(resp.body == "GET /service ");
+                REQUIRE(server.http2_connection_count() == 1);
+                REQUIRE(transport.stats().http2_requests == 1);
+            }
+        }
+    }
+    GIVEN("a server speaking HTTP/1.1 only") {
+        StubServer server(echo, true);
+        Arrowhead::CURLMultiplexTransport transport;
+        WHEN("many threads make requests at the same time") {
+            unsigned int failures = concurrent_requests(transport, server.url("/service"), 4, 4);
+            THEN("the transport falls back to HTTP/1.1") {
+                REQUIRE(failures == 0);
+                REQUIRE(server.http2_connection_count() == 0);
+                REQUIRE(transport.stats().requests == 16);
+                REQUIRE(transport.stats().http2_requests == 0);
+            }
+        }
+    }
+    GIVEN("a slow h2c server") {
+        StubServer server(slow_echo, true, true);
+        Arrowhead::CURLMultiplexTransport::Options options;
+        options.max_concurrent_streams = 1;
+        WHEN("a transport allows one stream per connection") {
+            Arrowhead::CURLMultiplexTransport transport(options);
+            unsigned int failures = concurrent_requests(transport, server.url("/service"), 4, 1);
+            THEN("concurrent requests open more connections") {
+                REQUIRE(failures == 0);
+                REQUIRE(server.connection_count() > 1);
+            }
+        }
+        WHEN("it also allows only one connection") {
+            options.max_host_connections = 1;
+            Arrowhead::CURLMultiplexTransport transport(options);
+            unsigned int failures = concurrent_requests(transport, server.url("/service"), 4, 1);
+            THEN("concurrent requests wait for the connection") {
+                REQUIRE(failures == 0);
+                REQUIRE(server.connection_count() == 1);
+            }
+        }
+    }
+}
+
+#if ARROWHEAD_USE_OPENSSL
+SCENARIO( "HTTP/2 is negotiated over TLS", "[transport][http2][tls]" ) {
+
+    TestCertificates certs;
+    Arrowhead::TLSOptions tls;
+    tls.ca_file = certs.server_cert;
+
+    GIVEN("a TLS server offering h2") {
+        std::shared_ptr<SSL_CTX> tls_ctx = certs.server_context(false, true);
+        StubServer server(echo, tls_ctx.get(), true);
+        WHEN("many threads make requests with the multiplexing transport") {
+            Arrowhead::CURLMultiplexTransport::Options options;
+            options.tls = tls;
+            Arrowhead::CURLMultiplexTransport transport(options);
+            unsigned int failures = concurrent_requests(transport, server.url("/service"), 8, 4);
+            THEN("they share one HTTP/2 connection") {
+                REQUIRE(failures == 0);
+                REQUIRE(server.connection_count() == 1);
+                REQUIRE(server.http2_connection_count() == 1);
+                REQUIRE(transport.stats().http2_requests == 32);
+            }
+        }
+        WHEN("the easy transport makes a request") {
+            Arrowhead::CURLEasyTransport transport(tls);
+            Arrowhead::HTTPRequest req;
+            req.method = "GET";
+            req.url = server.url("/service");
+            THEN("it uses HTTP/2 as well") {
+                REQUIRE(transport.perform(req).body == "GET /service ");
+                REQUIRE(server.http2_connection_count() == 1);
+            }
+        }
+        WHEN("the easy transport is limited to HTTP/1.1") {
+            Arrowhead::CURLEasyTransport transport(tls, Arrowhead::HTTPVersion::HTTP1_1);
+            Arrowhead::HTTPRequest req;
+            req.method = "GET";
+            req.url = server.url("/service");
+            THEN("it does not use HTTP/2") {
+                REQUIRE(transport.perform(req).body == "GET /service ");
+                REQUIRE(server.http2_connection_count() == 0);
+            }
+        }
+    }
+    GIVEN("a TLS server without h2") {
+        std::shared_ptr<SSL_CTX> tls_ctx = certs.server_context(false);
+        StubServer server(echo, tls_ctx.get(), true);
+        Arrowhead::CURLMultiplexTransport::Options options;
+        options.tls = tls;
+        Arrowhead::CURLMultiplexTransport transport(options);
+        WHEN("requests are made") {
+            unsigned int failures = concurrent_requests(transport, server.url("/service"), 2, 2);
+            THEN("the transport falls back to HTTP/1.1") {
+                REQUIRE(failures == 0);
+                REQUIRE(server.http2_connection_count() == 0);
+                REQUIRE(transport.stats().http2_requests == 0);
+            }
+        }
+    }
+}
+#endif /* ARROWHEAD_USE_OPENSSL */
+
+#endif /* ARROWHEAD_USE_LIBCURL */
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Latency breakdown tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include "catch.hpp"
+#include "stub_server.hpp"
+#include "arrowhead/core_services/registryclient.hpp"
+#include "arrowhead/latency.hpp"
+#include "arrowhead/service.hpp"
+#include "arrowhead/transport.hpp"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/* Answers after a pause long enough to stand out from the connection setup */
+Arrowhead::HTTPResponse slow(const Arrowhead::HTTPRequest& req)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.content_type = "application/json";
+    resp.body = req.method == "POST" ? req.body : "[]";
+    return resp;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Latency histograms count durations in powers of two", "[transport][latency]" ) {
+
+    GIVEN("an empty histogram") {
+        Arrowhead::LatencyHistogram histogram;
+        THEN("it has no percentiles") {
+            REQUIRE(histogram.count() == 0);
+            REQUIRE(histogram.percentile(0.5).count() == 0);
+            REQUIRE(histogram.mean().count() == 0);
+        }
+        WHEN("durations are recorded") {
+            for (int us: {0, 1, 3, 900, 1000, 1100, 5000000}) {
+                histogram.record(std::chrono::microseconds(us));
+            }
+            THEN("they land in the bucket of their magnitude") {
+                REQUIRE(histogram.count() == 7);
+                REQUIRE(histogram.bucket(0) == 1);
+                REQUIRE(histogram.bucket(1) == 1);
+                REQUIRE(histogram.bucket(2) == 1);
+                /* 512 to 1023 µs */
+                REQUIRE(histogram.bucket(10) == 2);
+                REQUIRE(histogram.bucket(11) == 1);
+                REQUIRE(histogram.bucket(23) == 1);
+                REQUIRE(histogram.sum().count() == 5003004);
+                REQUIRE(histogram.max().count() == 5000000);
+            }
+            THEN("percentiles are bucket limits") {
+                REQUIRE(histogram.percentile(0.5).count() == 1024);
+                REQUIRE(histogram.percentile(0.7).count() == 1024);
+                REQUIRE(histogram.percentile(0.8).count() == 2048);
+                /* The last value is known exactly */
+                REQUIRE(histogram.percentile(1.0).count() == 5000000);
+            }
+            THEN("they can be merged into another histogram") {
+                Arrowhead::LatencyHistogram other;
+                other.record(std::chrono::microseconds(1000));
+                other.merge(histogram);
+                REQUIRE(other.count() == 8);
+                REQUIRE(other.bucket(10) == 3);
+                REQUIRE(other.max().count() == 5000000);
+            }
+        }
+        WHEN("a duration beyond the last limit is recorded") {
+            histogram.record(std::chrono::hours(1));
+            THEN("it lands in the last bucket") {
+                REQUIRE(histogram.bucket(Arrowhead::LatencyHistogram::BUCKETS - 1) == 1);
+                REQUIRE(histogram.percentile(0.5) == std::chrono::hours(1));
+            }
+        }
+    }
+}
+
+SCENARIO( "Transports break down where the time of a request went", "[transport][latency]" ) {
+
+    StubServer server(slow, true);
+    const std::string endpoint = server.url();
+    Arrowhead::HTTPRequest req;
+    req.method = "GET";
+    req.url = server.url("/service");
+    req.operation = "test-get";
+
+    GIVEN("a transport") {
+        Arrowhead::CURLEasyTransport transport;
+        Arrowhead::HTTPResponse first = transport.perform(req);
+        Arrowhead::HTTPResponse second = transport.perform(req);
+        WHEN("a request is made on a new connection") {
+            const Arrowhead::RequestTiming& t = first.timing;
+            THEN("the times follow the order of the phases") {
+                REQUIRE(!t.reused_connection);
+                REQUIRE(t.namelookup <= t.connect);
+                REQUIRE(t.connect > std::chrono::microseconds(0));
+                REQUIRE(t.appconnect.count() == 0);
+                REQUIRE(t.connect <= t.pretransfer);
+                REQUIRE(t.pretransfer <= t.starttransfer);
+                REQUIRE(t.starttransfer <= t.total);
+                REQUIRE(t.bytes_received == 2);
+            }
+            THEN("the server time stands out") {
+                REQUIRE(t.server_time() >= std::chrono::milliseconds(20));
+                REQUIRE(t.transfer_time() < t.server_time());
+            }
+        }
+        WHEN("a request is made on the same connection") {
+            const Arrowhead::RequestTiming& t = second.timing;
+            THEN("it has no connection setup") {
+                REQUIRE(t.reused_connection);
+                REQUIRE(t.connect.count() == 0);
+                REQUIRE(t.server_time() >= std::chrono::milliseconds(20));
+            }
+        }
+        WHEN("the breakdowns are collected") {
+            Arrowhead::LatencyStats stats = Arrowhead::latency_stats();
+            auto it = stats.find(std::make_pair(std::string("test-get"), endpoint));
+            THEN("the requests are counted under their operation and endpoint") {
+                REQUIRE(it != stats.end());
+                const Arrowhead::RequestLatency& latency = it->second;
+                REQUIRE(latency.requests == 2);
+                REQUIRE(latency.reused_connections == 1);
+                REQUIRE(latency.bytes_received == 4);
+                REQUIRE(latency.total.count() == 2);
+                REQUIRE(latency.starttransfer.percentile(0.5) >= std::chrono::milliseconds(20));
+                REQUIRE(latency.total.max() == std::max(first.timing.total, second.timing.total));
+            }
+        }
+    }
+    GIVEN("a multiplexing transport") {
+        Arrowhead::CURLMultiplexTransport transport;
+        req.operation = "test-multiplex";
+        THEN("it breaks down the requests too") {
+            REQUIRE(transport.perform(req).timing.server_time() >= std::chrono::milliseconds(20));
+            auto stats = Arrowhead::latency_stats();
+            REQUIRE(stats[std::make_pair(std::string("test-multiplex"), endpoint)].requests == 1);
+        }
+    }
+    GIVEN("transports on several threads") {
+        req.operation = "test-threads";
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&req]() {
+                Arrowhead::CURLEasyTransport transport;
+                for (int j = 0; j < 3; ++j) {
+                    transport.perform(req);
+                }
+            });
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+        THEN("the breakdowns of all threads are merged") {
+            auto stats = Arrowhead::latency_stats();
+            const Arrowhead::RequestLatency& latency =
+                stats[std::make_pair(std::string("test-threads"), endpoint)];
+            REQUIRE(latency.requests == 12);
+            REQUIRE(latency.reused_connections == 8);
+            REQUIRE(latency.total.count() == 12);
+            REQUIRE(latency.bytes_received == 24);
+        }
+    }
+}
+
+SCENARIO( "Registry clients break down the latency per operation", "[transport][latency]" ) {
+
+    GIVEN("a client of a registry") {
+        StubServer server(slow, true);
+        const std::string endpoint = server.url();
+        Arrowhead::ServiceRegistryClient<Arrowhead::CURLEasyTransport, Arrowhead::CodecRegistry>
+            client(server.url("/servicediscovery"));
+        WHEN("every operation is called") {
+            Arrowhead::ServiceDescription service;
+            service.name = "printer";
+            service.type = "_printer._tcp";
+            service.port = 631;
+            client.types();
+            client.list();
+            client.list(service.type);
+            client.publish(service);
+            client.unpublish(service.name);
+            auto stats = Arrowhead::latency_stats();
+            THEN("each operation has its own breakdown") {
+                REQUIRE(stats[std::make_pair(std::string("types"), endpoint)].requests == 1);
+                REQUIRE(stats[std::make_pair(std::string("list"), endpoint)].requests == 2);
+                REQUIRE(stats[std::make_pair(std::string("publish"), endpoint)].requests == 1);
+                REQUIRE(stats[std::make_pair(std::string("unpublish"), endpoint)].requests == 1);
+                const Arrowhead::RequestLatency& publish =
+                    stats[std::make_pair(std::string("publish"), endpoint)];
+                REQUIRE(publish.bytes_sent > 0);
+                REQUIRE(publish.bytes_received == publish.bytes_sent);
+                REQUIRE(publish.reused_connections == 1);
+            }
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_LIBCURL */
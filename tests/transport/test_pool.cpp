@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Easy handle reuse tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include "catch.hpp"
+#include "stub_server.hpp"
+#include "tempfile.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/transport.hpp"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+/* Describes the request it got */
+Arrowhead::HTTPResponse describe(const Arrowhead::HTTPRequest& req)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.body = req.method + " " + req.path + " accept=" + req.accept +
+        " type=" + req.content_type + " body=" + req.body;
+    return resp;
+}
+
+Arrowhead::HTTPResponse slow(const Arrowhead::HTTPRequest&)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    return resp;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Transports reuse their easy handles", "[transport][pool]" ) {
+
+    Arrowhead::HTTPRequest get;
+    get.method = "GET";
+    get.accept = "application/json";
+    Arrowhead::HTTPRequest post;
+    post.method = "POST";
+    post.accept = "application/json";
+    post.content_type = "application/cbor";
+    post.body = "data";
+
+    GIVEN("a server and an easy transport") {
+        StubServer server(describe, true);
+        get.url = server.url("/service");
+        post.url = server.url("/publish");
+        Arrowhead::CURLEasyTransport transport;
+        WHEN("requests of different kinds are made in turn") {
+            std::vector<std::string> bodies;
+            for (int i = 0; i < 2; ++i) {
+                bodies.push_back(transport.perform(get).body);
+                bodies.push_back(transport.perform(post).body);
+            }
+            get.accept.clear();
+            bodies.push_back(transport.perform(get).body);
+            THEN("one handle makes them all") {
+                REQUIRE(transport.handles() == 1);
+            }
+            THEN("no request inherits the method, headers or body of the one before") {
+                const std::string get_body = "GET /service accept=application/json type= body=";
+                const std::string post_body =
+                    "POST /publish accept=application/json type=application/cbor body=data";
+                REQUIRE(bodies[0] == get_body);
+                REQUIRE(bodies[1] == post_body);
+                REQUIRE(bodies[2] == get_body);
+                REQUIRE(bodies[3] == post_body);
+                /* libcurl sends its default */
+                REQUIRE(bodies[4] == "GET /service accept=*/* type= body=");
+            }
+        }
+        WHEN("a request with a deadline is followed by one without") {
+            get.deadline = Arrowhead::Deadline::after(std::chrono::milliseconds(5000));
+            transport.perform(get);
+            get.deadline = Arrowhead::Deadline();
+            THEN("the second one has no timeout") {
+                REQUIRE(transport.perform(get).status == 200);
+            }
+        }
+        WHEN("a copy of the transport makes a request") {
+            transport.perform(get);
+            Arrowhead::CURLEasyTransport copy(transport);
+            copy.perform(get);
+            THEN("it reuses the handle of the original") {
+                REQUIRE(transport.handles() == 1);
+            }
+        }
+    }
+    GIVEN("a server on a Unix domain socket and one on TCP") {
+        TempFile socket_file("", ".sock");
+        StubServer local(socket_file.path(), describe, true);
+        StubServer remote(describe, true);
+        Arrowhead::CURLEasyTransport transport;
+        WHEN("one handle alternates between them") {
+            get.url = local.url("/service");
+            transport.perform(get);
+            get.url = remote.url("/service");
+            transport.perform(get);
+            THEN("each request reaches its server") {
+                REQUIRE(local.connection_count() == 1);
+                REQUIRE(remote.connection_count() == 1);
+                REQUIRE(transport.handles() == 1);
+            }
+        }
+    }
+    GIVEN("a slow server and concurrent requests") {
+        StubServer server(slow, true);
+        get.url = server.url("/service");
+        Arrowhead::CURLEasyTransport transport;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i) {
+            threads.push_back(std::thread([&transport, &get]() { transport.perform(get); }));
+        }
+        for (std::thread& t: threads) {
+            t.join();
+        }
+        THEN("each request in flight has a handle of its own") {
+            REQUIRE(transport.handles() == 3);
+        }
+        THEN("the handles are reused afterwards") {
+            transport.perform(get);
+            REQUIRE(transport.handles() == 3);
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_LIBCURL */
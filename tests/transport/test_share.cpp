@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Shared libcurl state tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include "catch.hpp"
+#include "stub_server.hpp"
+#include "arrowhead/http.hpp"
+#include "arrowhead/transport.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+Arrowhead::HTTPResponse hello(const Arrowhead::HTTPRequest&)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.body = "hello";
+    return resp;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Handles share the DNS cache but keep their own connections", "[transport]" ) {
+
+    REQUIRE(Arrowhead::HTTP::CURLShare::instance().handle() != NULL);
+
+    GIVEN("a server keeping connections open") {
+        StubServer server(hello, true);
+        Arrowhead::HTTPRequest req;
+        req.method = "GET";
+        req.url = server.url("/service");
+        WHEN("several requests are made through one transport") {
+            Arrowhead::CURLEasyTransport transport;
+            for (int i = 0; i < 5; ++i) {
+                REQUIRE(transport.perform(req).body == "hello");
+            }
+            THEN("they use the same connection") {
+                REQUIRE(server.connection_count() == 1);
+            }
+        }
+        WHEN("requests are made from concurrent threads, each with its own transport") {
+            const unsigned int threads = 4;
+            const unsigned int requests = 20;
+            std::atomic<unsigned int> answered(0);
+            std::vector<std::thread> workers;
+            for (unsigned int t = 0; t < threads; ++t) {
+                workers.emplace_back([&req, &answered]() {
+                    Arrowhead::CURLEasyTransport transport;
+                    for (unsigned int i = 0; i < requests; ++i) {
+                        if (transport.perform(req).body == "hello") {
+                            ++answered;
+                        }
+                    }
+                });
+            }
+            for (auto& worker: workers) {
+                worker.join();
+            }
+            THEN("every request is answered and each thread keeps its connection") {
+                REQUIRE(answered == threads * requests);
+                REQUIRE(server.connection_count() == threads);
+            }
+        }
+    }
+    GIVEN("a server closing every connection") {
+        StubServer server(hello);
+        Arrowhead::CURLEasyTransport transport;
+        Arrowhead::HTTPRequest req;
+        req.method = "GET";
+        req.url = server.url("/service");
+        WHEN("several requests are made") {
+            for (int i = 0; i < 3; ++i) {
+                REQUIRE(transport.perform(req).body == "hello");
+            }
+            THEN("every request opens a new connection") {
+                REQUIRE(server.connection_count() == 3);
+            }
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_LIBCURL */
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       HTTPS transport tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_OPENSSL
+
+#include "catch.hpp"
+#include "stub_server.hpp"
+#include "stub_tls.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/tls.hpp"
+#include "arrowhead/transport.hpp"
+#include <memory>
+#include <string>
+#include <curl/curl.h>
+
+namespace {
+
+Arrowhead::HTTPResponse hello(const Arrowhead::HTTPRequest&)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.body = "hello";
+    return resp;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "HTTPS transports verify the server and authenticate the client", "[transport][tls]" ) {
+
+    TestCertificates certs;
+    Arrowhead::HTTPRequest req;
+    req.method = "GET";
+
+    GIVEN("a server requiring the client certificate") {
+        std::shared_ptr<SSL_CTX> tls_ctx = certs.server_context(true);
+        StubServer server(hello, tls_ctx.get());
+        req.url = server.url("/service");
+        Arrowhead::TLSOptions tls;
+        tls.ca_file = certs.server_cert;
+        tls.client_cert = certs.client_cert;
+        tls.client_key = certs.client_key;
+        WHEN("the client presents it") {
+            Arrowhead::CURLEasyTransport transport(tls);
+            THEN("the request succeeds") {
+                REQUIRE(transport.perform(req).body == "hello");
+            }
+        }
+        WHEN("the client has no certificate") {
+            tls.client_cert.clear();
+            tls.client_key.clear();
+            Arrowhead::CURLEasyTransport transport(tls);
+            Arrowhead::HTTPResponse resp;
+            Arrowhead::Status status = transport.perform(req, resp);
+            THEN("the request fails") {
+                REQUIRE(status.code() == Arrowhead::Errc::TRANSPORT);
+            }
+        }
+        WHEN("the client does not trust the server certificate") {
+            tls.ca_file = certs.client_cert;
+            Arrowhead::CURLEasyTransport transport(tls);
+            Arrowhead::HTTPResponse resp;
+            Arrowhead::Status status = transport.perform(req, resp);
+            THEN("the request fails verification") {
+                REQUIRE(status.code() == Arrowhead::Errc::TRANSPORT);
+                REQUIRE(status.detail() == CURLE_PEER_FAILED_VERIFICATION);
+            }
+        }
+    }
+    GIVEN("a hedged transport to a TLS server") {
+        std::shared_ptr<SSL_CTX> tls_ctx = certs.server_context(false);
+        StubServer server(hello, tls_ctx.get());
+        Arrowhead::CURLHedgedTransport::Options options;
+        options.tls.ca_file = certs.server_cert;
+        Arrowhead::CURLHedgedTransport transport(
+            std::vector<std::string>(1, server.url("/servicediscovery")), options);
+        req.path = "/service";
+        THEN("it uses the TLS settings") {
+            REQUIRE(transport.perform(req).body == "hello");
+        }
+    }
+}
+
+SCENARIO( "HTTPS connections resume earlier TLS sessions", "[transport][tls]" ) {
+
+    TestCertificates certs;
+    Arrowhead::TLSOptions tls;
+    tls.ca_file = certs.server_cert;
+    Arrowhead::HTTPRequest req;
+    req.method = "GET";
+
+    GIVEN("a server closing every connection") {
+        std::shared_ptr<SSL_CTX> tls_ctx = certs.server_context(false);
+        StubServer server(hello, tls_ctx.get());
+        req.url = server.url("/service");
+        Arrowhead::TLSStats before = Arrowhead::tls_stats();
+        WHEN("several requests are made") {
+            Arrowhead::CURLEasyTransport transport(tls);
+            for (int i = 0; i < 4; ++i) {
+                REQUIRE(transport.perform(req).body == "hello");
+            }
+            Arrowhead::TLSStats after = Arrowhead::tls_stats();
+            THEN("only the first connection makes a full handshake") {
+                REQUIRE(server.connection_count() == 4);
+                REQUIRE(server.resumed_count() == 3);
+                REQUIRE(after.full_handshakes - before.full_handshakes == 1);
+                REQUIRE(after.resumed_handshakes - before.resumed_handshakes == 3);
+                REQUIRE(after.reused_connections == before.reused_connections);
+            }
+        }
+        WHEN("every request is made with a new transport") {
+            for (int i = 0; i < 3; ++i) {
+                REQUIRE(Arrowhead::CURLEasyTransport(tls).perform(req).body == "hello");
+            }
+            THEN("the handles resume the session through the share") {
+                REQUIRE(server.resumed_count() == 2);
+            }
+        }
+        WHEN("session resumption is disabled") {
+            tls.session_resumption = false;
+            Arrowhead::CURLEasyTransport transport(tls);
+            for (int i = 0; i < 2; ++i) {
+                REQUIRE(transport.perform(req).body == "hello");
+            }
+            Arrowhead::TLSStats after = Arrowhead::tls_stats();
+            THEN("every connection makes a full handshake") {
+                REQUIRE(server.resumed_count() == 0);
+                REQUIRE(after.full_handshakes - before.full_handshakes == 2);
+                REQUIRE(after.resumed_handshakes == before.resumed_handshakes);
+            }
+        }
+    }
+    GIVEN("a server keeping connections open") {
+        std::shared_ptr<SSL_CTX> tls_ctx = certs.server_context(false);
+        StubServer server(hello, tls_ctx.get(), true);
+        req.url = server.url("/service");
+        Arrowhead::TLSStats before = Arrowhead::tls_stats();
+        WHEN("several requests are made") {
+            Arrowhead::CURLEasyTransport transport(tls);
+            for (int i = 0; i < 3; ++i) {
+                REQUIRE(transport.perform(req).body == "hello");
+            }
+            Arrowhead::TLSStats after = Arrowhead::tls_stats();
+            THEN("later requests make no handshake at all") {
+                REQUIRE(server.connection_count() == 1);
+                REQUIRE(after.full_handshakes - before.full_handshakes == 1);
+                REQUIRE(after.reused_connections - before.reused_connections == 2);
+            }
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_OPENSSL */
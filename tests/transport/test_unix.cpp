@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2015-2016 Fotonic
+ *
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * and Apache License v2.0 which accompanies this distribution.
+ *
+ *     The Eclipse Public License is available at
+ *       http://www.eclipse.org/legal/epl-v10.html
+ *
+ *     The Apache License v2.0 is available at
+ *       http://www.opensource.org/licenses/apache2.0.php
+ *
+ * You can redistribute this code under either of these licenses.
+ * For more information; see http://www.arrowhead.eu/licensing
+ */
+
+/**
+ * @file
+ * @brief       Unix domain socket transport tests implementation
+ *
+ * @author      Joakim Gebart Nohlgård <joakim@nohlgard.se>
+ */
+
+#include "arrowhead/config.h"
+
+#if ARROWHEAD_USE_LIBCURL
+
+#include "catch.hpp"
+#include "stub_server.hpp"
+#include "tempfile.hpp"
+#include "arrowhead/result.hpp"
+#include "arrowhead/transport.hpp"
+#include <string>
+#include <vector>
+#include <curl/curl.h>
+
+namespace {
+
+/* Answers with the request path */
+Arrowhead::HTTPResponse path_echo(const Arrowhead::HTTPRequest& req)
+{
+    Arrowhead::HTTPResponse resp;
+    resp.status = 200;
+    resp.body = req.path;
+    return resp;
+}
+
+} /* anonymous namespace */
+
+SCENARIO( "Transports reach servers on Unix domain sockets", "[transport][unix]" ) {
+
+    TempFile socket_file("", ".sock");
+    Arrowhead::HTTPRequest req;
+    req.method = "GET";
+
+    GIVEN("a server on a socket") {
+        StubServer server(socket_file.path(), path_echo, true);
+        WHEN("a resource is requested") {
+            req.url = server.url("/servicediscovery/service?tag=a");
+            Arrowhead::HTTPResponse resp = Arrowhead::CURLEasyTransport().perform(req);
+            THEN("the path after the socket is requested") {
+                REQUIRE(resp.status == 200);
+                REQUIRE(resp.body == "/servicediscovery/service?tag=a");
+            }
+        }
+        WHEN("the socket itself is requested") {
+            req.url = server.url();
+            THEN("the root is requested") {
+                REQUIRE(Arrowhead::CURLEasyTransport().perform(req).body == "/");
+            }
+        }
+        WHEN("several requests are made") {
+            req.url = server.url("/service");
+            Arrowhead::CURLEasyTransport transport;
+            for (int i = 0; i < 3; ++i) {
+                REQUIRE(transport.perform(req).body == "/service");
+            }
+            THEN("the connection is reused") {
+                REQUIRE(server.connection_count() == 1);
+            }
+        }
+        WHEN("a multiplexing transport is used") {
+            req.url = server.url("/service");
+            Arrowhead::CURLMultiplexTransport transport;
+            THEN("it reaches the server too") {
+                REQUIRE(transport.perform(req).body == "/service");
+            }
+        }
+        WHEN("a hedged transport is used") {
+            Arrowhead::CURLHedgedTransport transport(
+                std::vector<std::string>(1, server.url("/servicediscovery")));
+            req.path = "/service";
+            THEN("the request path is appended to the endpoint") {
+                REQUIRE(transport.perform(req).body == "/servicediscovery/service");
+            }
+        }
+    }
+    GIVEN("an HTTP/2 server on a socket") {
+        StubServer server(socket_file.path(), path_echo, true, true);
+        req.url = server.url("/service");
+        Arrowhead::CURLEasyTransport transport(Arrowhead::TLSOptions(),
+            Arrowhead::HTTPVersion::HTTP2);
+        THEN("h2c is negotiated over the socket") {
+            REQUIRE(transport.perform(req).body == "/service");
+            REQUIRE(server.http2_connection_count() == 1);
+        }
+    }
+    GIVEN("no server listening") {
+        req.url = "unix://" + socket_file.path() + "/service";
+        Arrowhead::HTTPResponse resp;
+        Arrowhead::Status status = Arrowhead::CURLEasyTransport().perform(req, resp);
+        THEN("the connection fails") {
+            REQUIRE(status.code() == Arrowhead::Errc::TRANSPORT);
+            REQUIRE(status.detail() == CURLE_COULDNT_CONNECT);
+        }
+    }
+}
+
+#endif /* ARROWHEAD_USE_LIBCURL */
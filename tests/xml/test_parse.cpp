@@ -23,9 +23,13 @@
  */
 
 #include "catch.hpp"
+#include "tempfile.hpp"
 #include "arrowhead/service.hpp"
 #include <vector>
+#include <fstream>
 #include <iterator>
+#include <memory_resource>
+#include <string>
 
 // Example XML data taken from the Arrowhead document repository.
 #define TEST_XML_LIST_3_SERVICES_TEXT "" \
@@ -174,3 +178,48 @@ SCENARIO( "Services are parsed from XML", "[servicexml]" ) {
         }
     }
 }
+
+SCENARIO( "Services are parsed from XML into a memory resource", "[servicexml][pmr]" ) {
+
+    GIVEN("a monotonic buffer resource and a destination vector using it") {
+        std::pmr::monotonic_buffer_resource arena;
+        std::pmr::vector<Arrowhead::pmr::ServiceDescription> servicelist(&arena);
+
+        WHEN("an XML service list string containing 3 services is parsed" ) {
+            std::string xml(TEST_XML_LIST_3_SERVICES_TEXT);
+            Arrowhead::parse_servicelist_xml(std::back_inserter(servicelist), xml, &arena);
+            THEN("the vector is extended with the supplied services") {
+                REQUIRE(servicelist.size() == 3);
+                REQUIRE(servicelist[1].name == "authorisation-ctrl._auth-ws-https._tcp.srv.arces.unibo.it.");
+                REQUIRE(servicelist[1].port == 8181);
+                REQUIRE(servicelist[1].properties["version"] == "0.2");
+                REQUIRE(servicelist[1].get_allocator().resource() == &arena);
+            }
+        }
+    }
+}
+
+SCENARIO( "Services are parsed from XML files in place", "[servicexml][file]" ) {
+
+    GIVEN("an XML service list file") {
+        TempFile file(TEST_XML_LIST_3_SERVICES_TEXT);
+        std::vector<Arrowhead::ServiceDescription> servicelist;
+
+        WHEN("the file is parsed") {
+            Arrowhead::parse_servicelist_xml_file(std::back_inserter(servicelist), file.path());
+            THEN("the result is the same as when parsing the string") {
+                std::vector<Arrowhead::ServiceDescription> expected;
+                Arrowhead::parse_servicelist_xml(std::back_inserter(expected),
+                    std::string(TEST_XML_LIST_3_SERVICES_TEXT));
+                REQUIRE(servicelist.size() == expected.size());
+                REQUIRE(servicelist[0].name == expected[0].name);
+                REQUIRE(servicelist[0].properties == expected[0].properties);
+            }
+            THEN("the file is not modified") {
+                std::ifstream f(file.path().c_str());
+                std::string contents((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+                REQUIRE(contents == TEST_XML_LIST_3_SERVICES_TEXT);
+            }
+        }
+    }
+}